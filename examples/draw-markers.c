@@ -0,0 +1,174 @@
+
+#include <stdio.h>
+#include <tchar.h>
+#include <windows.h>
+
+#include <wdl.h>
+
+
+/* This example is also a simple benchmark: It paints many markers (as in a
+ * scatter plot), either one by one with wdTranslateWorld() +
+ * wdSetSolidBrushColor() + wdFillPath(), or with a single call of
+ * wdFillPathInstances(). Click into the window to switch between the two.
+ * The time spent painting is shown in the window caption. */
+
+#define MARKER_COUNT    100000
+
+static HWND hwndMain = NULL;
+static BOOL bUseInstances = TRUE;
+
+static WD_INSTANCE* pInstances = NULL;
+
+
+static void
+MainWinInitMarkers(void)
+{
+    UINT seed = 12345;
+    int i;
+
+    pInstances = (WD_INSTANCE*) malloc(MARKER_COUNT * sizeof(WD_INSTANCE));
+    if(pInstances == NULL)
+        return;
+
+    for(i = 0; i < MARKER_COUNT; i++) {
+        WD_INSTANCE* inst = &pInstances[i];
+
+        /* Simple LCG, so each run paints the same picture. */
+        seed = seed * 1103515245 + 12345;
+        inst->matrix.m11 = 1.0f;
+        inst->matrix.m12 = 0.0f;
+        inst->matrix.m21 = 0.0f;
+        inst->matrix.m22 = 1.0f;
+        inst->matrix.dx = (float) ((seed >> 8) % 800);
+        seed = seed * 1103515245 + 12345;
+        inst->matrix.dy = (float) ((seed >> 8) % 600);
+        seed = seed * 1103515245 + 12345;
+        inst->color = WD_ARGB(127, (seed >> 8) & 0xff, (seed >> 16) & 0xff, (seed >> 24) & 0xff);
+    }
+}
+
+static void
+MainWinPaintToCanvas(WD_HCANVAS hCanvas)
+{
+    static const WD_POINT diamond[4] = {
+        { 0.0f, -4.0f }, { 4.0f, 0.0f }, { 0.0f, 4.0f }, { -4.0f, 0.0f }
+    };
+    WD_HPATH hPath;
+    LARGE_INTEGER freq, t0, t1;
+    TCHAR buffer[128];
+    int i;
+
+    wdBeginPaint(hCanvas);
+    wdClear(hCanvas, WD_RGB(255,255,255));
+
+    hPath = wdCreatePolygonPath(hCanvas, diamond, 4);
+    if(hPath == NULL  ||  pInstances == NULL)
+        goto done;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t0);
+
+    if(bUseInstances) {
+        wdFillPathInstances(hCanvas, hPath, pInstances, MARKER_COUNT);
+    } else {
+        WD_HBRUSH hBrush = wdCreateSolidBrush(hCanvas, 0);
+
+        for(i = 0; i < MARKER_COUNT; i++) {
+            wdTranslateWorld(hCanvas, pInstances[i].matrix.dx, pInstances[i].matrix.dy);
+            wdSetSolidBrushColor(hBrush, pInstances[i].color);
+            wdFillPath(hCanvas, hBrush, hPath);
+            wdTranslateWorld(hCanvas, -pInstances[i].matrix.dx, -pInstances[i].matrix.dy);
+        }
+
+        wdDestroyBrush(hBrush);
+    }
+
+    QueryPerformanceCounter(&t1);
+
+    _sntprintf(buffer, 128, _T("%d markers (%s): %.1f ms"), MARKER_COUNT,
+               (bUseInstances ? _T("wdFillPathInstances") : _T("wdFillPath loop")),
+               1000.0 * (double) (t1.QuadPart - t0.QuadPart) / (double) freq.QuadPart);
+    SetWindowText(hwndMain, buffer);
+
+done:
+    if(hPath != NULL)
+        wdDestroyPath(hPath);
+    wdEndPaint(hCanvas);
+}
+
+
+static void
+MainWinPaint(void)
+{
+    PAINTSTRUCT ps;
+    WD_HCANVAS hCanvas;
+
+    BeginPaint(hwndMain, &ps);
+    hCanvas = wdCreateCanvasWithPaintStruct(hwndMain, &ps, 0);
+    if(hCanvas != NULL) {
+        MainWinPaintToCanvas(hCanvas);
+        wdDestroyCanvas(hCanvas);
+    }
+    EndPaint(hwndMain, &ps);
+}
+
+/* Main window procedure */
+static LRESULT CALLBACK
+MainWinProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+    switch(uMsg) {
+        case WM_PAINT:
+            MainWinPaint();
+            return 0;
+
+        case WM_LBUTTONDOWN:
+            bUseInstances = !bUseInstances;
+            InvalidateRect(hwnd, NULL, FALSE);
+            return 0;
+
+        case WM_DESTROY:
+            PostQuitMessage(0);
+            return 0;
+    }
+
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+
+int APIENTRY
+WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
+{
+    WNDCLASS wc = { 0 };
+    MSG msg;
+
+    wdInitialize(0);
+    MainWinInitMarkers();
+
+    /* Register main window class */
+    wc.lpfnWndProc = MainWinProc;
+    wc.hInstance = hInstance;
+    wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
+    wc.lpszClassName = _T("main_window");
+    RegisterClass(&wc);
+
+    /* Create main window */
+    hwndMain = CreateWindow(
+        _T("main_window"), _T("LibWinDraw Example"),
+        WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, 800, 600,
+        NULL, NULL, hInstance, NULL
+    );
+    ShowWindow(hwndMain, nCmdShow);
+
+    /* Message loop */
+    while(GetMessage(&msg, NULL, 0, 0)) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+
+    free(pInstances);
+    wdTerminate(0);
+
+    /* Return exit code of WM_QUIT */
+    return (int)msg.wParam;
+}
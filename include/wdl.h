@@ -108,6 +108,13 @@ struct WD_MATRIX_tag {
     float dy;
 };
 
+/* One instance for wdFillPathInstances(). */
+typedef struct WD_INSTANCE_tag WD_INSTANCE;
+struct WD_INSTANCE_tag {
+    WD_MATRIX matrix;
+    WD_COLOR color;
+};
+
 /************************
  ***  Initialization  ***
  ************************/
@@ -178,6 +185,12 @@ typedef struct WD_FONT_tag *WD_HFONT;
 typedef struct WD_IMAGE_tag *WD_HIMAGE;
 typedef struct WD_CACHEDIMAGE_tag* WD_HCACHEDIMAGE;
 typedef struct WD_PATH_tag *WD_HPATH;
+typedef struct WD_MESH_tag *WD_HMESH;
+typedef struct WD_CACHEDPATHMASK_tag *WD_HCACHEDPATHMASK;
+typedef struct WD_DISPLAYLIST_tag *WD_HDISPLAYLIST;
+typedef struct WD_SCENE_tag *WD_HSCENE;
+typedef struct WD_PATHINDEX_tag *WD_HPATHINDEX;
+typedef struct WD_TEXTLAYOUT_tag *WD_HTEXTLAYOUT;
 
 
 /***************************
@@ -200,10 +213,42 @@ typedef struct WD_PATH_tag *WD_HPATH;
  * origin in the left top corner of the device context or window it is created
  * for. However with this flag the canvas shall have origin located in right
  * top corner and the x-coordinate shall grow to the left from it.
+ *
+ * WD_CANVAS_DEFERRED: The draw, fill, bit-blit and text output calls are not
+ * painted immediately but queued. The queue is painted by wdEndPaint(), by
+ * wdFlushCanvas(), or when the clip or the world transformation is changed.
+ * Before painting, the queued calls are reordered so that calls using the
+ * same brush and stroke style are painted together, as far as it can be done
+ * without changing the result (i.e. a call is never moved over another one
+ * it may overlap with). The color of a solid brush is remembered when the
+ * call is queued, so the brush may be reused with other colors (see
+ * wdSetSolidBrushColor()) or destroyed right after the call. Destroying or
+ * changing any other object used by the queued calls (e.g. wdDestroyPath()
+ * or the gradient brush setters) is allowed too, but it makes the queue
+ * painted first.
+ *
+ * WD_CANVAS_FRAMEDIFF: Intended for a canvas cached for the reuse (see
+ * wdBeginPaint()) whose application repaints everything on each WM_PAINT.
+ * The calls between wdBeginPaint() and wdEndPaint() are recorded, and
+ * wdEndPaint() compares them with the calls of the previous frame. Only the
+ * areas where the two frames differ (see wdGetDirtyRects()) are really
+ * painted. Note that the calls are compared by their arguments and by the
+ * handles of the objects they use; only brushes are compared by their color
+ * or gradient. Hence the application should keep all other objects (paths,
+ * fonts, images etc.) alive across the frames, and replacing the object
+ * behind a handle requires wdResizeCanvas() or other way to make the canvas
+ * repaint everything. Destroying or changing an object used by the frame
+ * before wdEndPaint() is allowed, but the rest of the frame then gets painted
+ * completely. This flag is supported only by Direct2D canvases
+ * created with wdCreateCanvasWithPaintStruct(); otherwise it is ignored. It
+ * takes precedence over WD_CANVAS_DEFERRED. wdStartGdi() should not be used
+ * with such canvas.
  */
 #define WD_CANVAS_DOUBLEBUFFER      0x0001
 #define WD_CANVAS_NOGDICOMPAT       0x0002
 #define WD_CANVAS_LAYOUTRTL         0x0004
+#define WD_CANVAS_DEFERRED          0x0008
+#define WD_CANVAS_FRAMEDIFF         0x0010
 
 WD_HCANVAS wdCreateCanvasWithPaintStruct(HWND hWnd, PAINTSTRUCT* pPS, DWORD dwFlags);
 WD_HCANVAS wdCreateCanvasWithHDC(HDC hDC, const RECT* pRect, DWORD dwFlags);
@@ -226,6 +271,15 @@ void wdDestroyCanvas(WD_HCANVAS hCanvas);
 void wdBeginPaint(WD_HCANVAS hCanvas);
 BOOL wdEndPaint(WD_HCANVAS hCanvas);
 
+/* Get the rectangles (in pixels) which the last wdEndPaint() has repainted on
+ * a canvas with WD_CANVAS_FRAMEDIFF. Returns the count of the rectangles
+ * (at most 8) written into pRects. (For other canvases, this returns zero.) */
+UINT wdGetDirtyRects(WD_HCANVAS hCanvas, WD_RECT* pRects, UINT uMaxRects);
+
+/* Paint all the calls queued on a canvas with WD_CANVAS_DEFERRED. (For other
+ * canvases, this is noop.) */
+void wdFlushCanvas(WD_HCANVAS hCanvas);
+
 /* This is supposed to be called to resize cached canvas (see above), if it
  * needs to be resized, typically as a response to WM_SIZE message.
  *
@@ -264,6 +318,99 @@ void wdTranslateWorld(WD_HCANVAS hCanvas, float dx, float dy);
 void wdTransformWorld(WD_HCANVAS hCanvas, const WD_MATRIX* pMatrix);
 void wdResetWorld(WD_HCANVAS hCanvas);
 
+/* Rendering quality. The canvas starts with WD_QUALITY_HIGH. Lower presets
+ * trade quality for speed; e.g. grids and tables made of crisp axis-aligned
+ * lines look the same without anti-aliasing, and they are painted much
+ * faster then.
+ *
+ * wdSetCanvasQuality() sets all the parameters as the preset specifies;
+ * wdSetCanvasQualityParam() then may override them one by one:
+ *
+ * WD_QUALITYPARAM_GEOMETRYAA: Anti-aliasing of the draw and fill operations.
+ * (Direct2D has no equivalent of WD_GEOMETRYAA_FAST; it uses
+ * WD_GEOMETRYAA_HIGH instead.)
+ *
+ * WD_QUALITYPARAM_TEXTAA: Anti-aliasing of text.
+ *
+ * WD_QUALITYPARAM_INTERPOLATION: Interpolation used when bit-blitting a
+ * scaled image and by the image brushes created afterwards.
+ *
+ * WD_QUALITYPARAM_COMPOSITING: Whether painting blends with the contents of
+ * the canvas, or just replaces it. (Only GDI+ supports WD_COMPOSITING_COPY;
+ * Direct2D ignores it.)
+ *
+ * Note the quality is not recorded in display lists, and on a canvas with
+ * WD_CANVAS_DEFERRED, any queued calls are flushed first.
+ */
+#define WD_QUALITY_FAST                 0   /* none, grayscale, nearest, blend */
+#define WD_QUALITY_BALANCED             1   /* fast, grayscale, linear, blend */
+#define WD_QUALITY_HIGH                 2   /* high, ClearType, linear, blend */
+
+#define WD_QUALITYPARAM_GEOMETRYAA      0
+#define WD_QUALITYPARAM_TEXTAA          1
+#define WD_QUALITYPARAM_INTERPOLATION   2
+#define WD_QUALITYPARAM_COMPOSITING     3
+
+#define WD_GEOMETRYAA_NONE              0
+#define WD_GEOMETRYAA_FAST              1
+#define WD_GEOMETRYAA_HIGH              2
+
+#define WD_TEXTAA_ALIASED               0
+#define WD_TEXTAA_GRAYSCALE             1
+#define WD_TEXTAA_CLEARTYPE             2
+
+#define WD_INTERPOLATION_NEAREST        0
+#define WD_INTERPOLATION_LINEAR         1
+
+#define WD_COMPOSITING_BLEND            0
+#define WD_COMPOSITING_COPY             1
+
+void wdSetCanvasQuality(WD_HCANVAS hCanvas, UINT uQuality);
+void wdSetCanvasQualityParam(WD_HCANVAS hCanvas, UINT uParam, UINT uValue);
+
+/* Canvas statistics, useful for profiling the painting code:
+ *
+ * uStateCalls: Number of calls made to change a state of some back-end object
+ * (e.g. the GDI+ pen or string format used internally by the canvas).
+ *
+ * uStateCallsSkipped: Number of such calls which were avoided because the
+ * object already was in the desired state.
+ *
+ * (Direct2D back-end does not need such internal objects so the counters
+ * remain zero there.)
+ *
+ * uDeferredCalls: Number of calls queued by WD_CANVAS_DEFERRED.
+ *
+ * uDeferredStateChanges: Number of brush or stroke style changes between the
+ * consecutive queued calls, as they have been painted.
+ *
+ * uDeferredStateChangesSaved: Number of such changes avoided by reordering
+ * the calls in the queue.
+ *
+ * uFrameDiffCalls: Number of calls recorded by WD_CANVAS_FRAMEDIFF.
+ *
+ * uFrameDiffCallsPainted: Number of calls really painted by it. (A call
+ * intersecting more dirty rectangles is counted for each of them.)
+ *
+ * uCulledCalls: Number of draw, fill, bit-blit and text output calls which
+ * have been skipped because they could not paint anything visible (i.e. their
+ * bounds lie completely outside of the canvas or of its clip).
+ */
+typedef struct WD_CANVASSTATS_tag WD_CANVASSTATS;
+struct WD_CANVASSTATS_tag {
+    UINT uStateCalls;
+    UINT uStateCallsSkipped;
+    UINT uDeferredCalls;
+    UINT uDeferredStateChanges;
+    UINT uDeferredStateChangesSaved;
+    UINT uFrameDiffCalls;
+    UINT uFrameDiffCallsPainted;
+    UINT uCulledCalls;
+};
+
+void wdGetCanvasStats(WD_HCANVAS hCanvas, WD_CANVASSTATS* pStats);
+void wdResetCanvasStats(WD_HCANVAS hCanvas);
+
 
 /**************************
  ***  Image Management  ***
@@ -300,6 +447,14 @@ void wdDestroyImage(WD_HIMAGE hImage);
 
 void wdGetImageSize(WD_HIMAGE hImage, UINT* puWidth, UINT* puHeight);
 
+/* Returns TRUE if the image is known to be fully opaque.
+ *
+ * The image creation functions check whether the image really uses its alpha
+ * channel (if any). When it does not, the image is stored without it and
+ * painting it (including cached images created from it) skips the blending.
+ */
+BOOL wdIsImageOpaque(WD_HIMAGE hImage);
+
 
 /*********************************
  ***  Cached Image Management  ***
@@ -346,9 +501,54 @@ WD_HBRUSH wdCreateRadialGradientBrush(WD_HCANVAS hCanvas, float cx, float cy, fl
             WD_COLOR color0, WD_COLOR color1);
 void wdDestroyBrush(WD_HBRUSH hBrush);
 
+/* Image brush paints with the image, repeated (or otherwise extended) over
+ * the whole area according to the extend modes. The optional matrix maps the
+ * image (in pixels) into the canvas coordinates. The image is copied into
+ * the brush, so it may be destroyed afterwards.
+ *
+ * Note GDI+ has only one mode for both directions: Unless both are
+ * WD_EXTEND_CLAMP, the image is repeated (mirrored in any direction which
+ * asks for WD_EXTEND_MIRROR). And its clamping paints nothing outside the
+ * image instead of extending its edge pixels.
+ */
+#define WD_EXTEND_CLAMP             0
+#define WD_EXTEND_WRAP              1
+#define WD_EXTEND_MIRROR            2
+
+WD_HBRUSH wdCreateImageBrush(WD_HCANVAS hCanvas, WD_HIMAGE hImage,
+            UINT extendModeX, UINT extendModeY, const WD_MATRIX* pMatrix);
+
 /* Can be only called for brushes created with wdCreateSolidBrush(). */
 void wdSetSolidBrushColor(WD_HBRUSH hBrush, WD_COLOR color);
 
+/* Change geometry of an existing gradient brush, so one brush can be reused
+ * e.g. for all frames of an animation or all items of a list. The former can
+ * be only called for brushes created with wdCreateLinearGradientBrush[Ex](),
+ * the latter for ones created with wdCreateRadialGradientBrush[Ex](). */
+void wdSetLinearGradientBrushPoints(WD_HBRUSH hBrush, float x0, float y0, float x1, float y1);
+void wdSetRadialGradientBrushGeometry(WD_HBRUSH hBrush, float cx, float cy, float r,
+            float fx, float fy);
+
+/* Set transformation of the brush (applied to the brush geometry, on top of
+ * the world transformation of the canvas). NULL resets it. It has no effect
+ * on solid brushes. */
+void wdSetBrushTransform(WD_HBRUSH hBrush, const WD_MATRIX* pMatrix);
+
+/* Shared solid brushes. The canvas keeps one brush per color, so code which
+ * paints with many (repeating) colors does not need to create and destroy
+ * a brush for each of them.
+ *
+ * Each wdGetSolidBrush() has to be paired with wdReleaseSolidBrush(). The
+ * brush must not be modified with wdSetSolidBrushColor() nor destroyed with
+ * wdDestroyBrush(). Released brushes are kept for reuse (up to some limit)
+ * until the canvas is destroyed.
+ *
+ * Note that gradient brushes share their gradient stops transparently, so
+ * there is no special API for them.
+ */
+WD_HBRUSH wdGetSolidBrush(WD_HCANVAS hCanvas, WD_COLOR color);
+void wdReleaseSolidBrush(WD_HCANVAS hCanvas, WD_HBRUSH hBrush);
+
 
 /*********************************
  ***  Stroke Style Management  ***
@@ -377,18 +577,52 @@ WD_HSTROKESTYLE wdCreateStrokeStyle(UINT dashStyle, UINT lineCap, UINT lineJoin)
 WD_HSTROKESTYLE wdCreateStrokeStyleCustom(const float* dashes, UINT dashesCount, UINT lineCap, UINT lineJoin);
 void wdDestroyStrokeStyle(WD_HSTROKESTYLE hStrokeStyle);
 
+/* Shared stroke styles. The same rules as for wdGetSolidBrush() apply: Each
+ * call has to be paired with wdReleaseStrokeStyle(), and the style must not
+ * be destroyed with wdDestroyStrokeStyle(). */
+WD_HSTROKESTYLE wdGetStrokeStyle(WD_HCANVAS hCanvas, UINT dashStyle, UINT lineCap, UINT lineJoin);
+WD_HSTROKESTYLE wdGetStrokeStyleCustom(WD_HCANVAS hCanvas, const float* dashes, UINT dashesCount,
+            UINT lineCap, UINT lineJoin);
+void wdReleaseStrokeStyle(WD_HCANVAS hCanvas, WD_HSTROKESTYLE hStrokeStyle);
+
 
 /*************************
  ***  Path Management  ***
  *************************/
 
 /* Path is an object representing more complex and reusable shapes which can
- * be painted at once. Note the path can only be used for the canvas it has
- * been created for. */
+ * be painted at once. The path records its figures on its own and builds the
+ * back-end geometry only when it is painted (or queried) for the first time,
+ * so it is not bound to any canvas: hCanvas of the constructors is only
+ * recorded by the API trace and may be NULL. */
 
 WD_HPATH wdCreatePath(WD_HCANVAS hCanvas);
 WD_HPATH wdCreatePolygonPath(WD_HCANVAS hCanvas, const WD_POINT* pPoints, UINT uCount);
 WD_HPATH wdCreateRoundedRectPath(WD_HCANVAS hCanvas, const WD_RECT* prc, float r);
+
+/* Create a path of many figures at once. The points of all the figures follow
+ * each other in pPoints; puFigureSizes[i] is the count of the points of the
+ * i-th figure. The first point of each figure is its start. By default, the
+ * figure continues with straight lines to the other points. With
+ * WD_PATH_BEZIERS, each following three points make a Bezier curve instead
+ * (see wdAddBeziers()), so each figure size has to be 1 + 3*k; otherwise the
+ * function fails and returns NULL. With WD_PATH_CLOSEFIGURES, all the figures
+ * are closed. */
+#define WD_PATH_CLOSEFIGURES        0x0001
+#define WD_PATH_BEZIERS             0x0002
+
+WD_HPATH wdCreatePathFromPoints(WD_HCANVAS hCanvas, const WD_POINT* pPoints,
+                const UINT* puFigureSizes, UINT uFigureCount, DWORD dwFlags);
+
+/* Create a copy of the path, or a copy transformed by the given matrix. These
+ * are cheap: The copy shares the figures with the source path until either of
+ * them is opened with wdOpenPathSink(), so drawing many instances of the same
+ * shape costs only one real path plus one transformed path per instance.
+ *
+ * The source path must be complete (its sink closed). */
+WD_HPATH wdCreateTransformedPath(const WD_HPATH hPath, const WD_MATRIX* pMatrix);
+WD_HPATH wdClonePath(const WD_HPATH hPath);
+
 void wdDestroyPath(WD_HPATH hPath);
 
 typedef struct WD_PATHSINK_tag WD_PATHSINK;
@@ -397,6 +631,10 @@ struct WD_PATHSINK_tag {
     WD_POINT ptEnd;
 };
 
+/* Opening a path which already has some figures appends new figures after
+ * them, starting at the end point of the last one. A segment added outside of
+ * any figure starts a new figure at the current end point (pSink->ptEnd).
+ * While the sink is open, the path must not be painted nor queried. */
 BOOL wdOpenPathSink(WD_PATHSINK* pSink, WD_HPATH hPath);
 void wdClosePathSink(WD_PATHSINK* pSink);
 
@@ -407,6 +645,125 @@ void wdAddLine(WD_PATHSINK* pSink, float x, float y);
 void wdAddArc(WD_PATHSINK* pSink, float cx, float cy, float fSweepAngle);
 void wdAddBezier(WD_PATHSINK* pSink, float x0, float y0, float x1, float y1, float x2, float y2);
 
+/* Bulk variants of wdAddLine() and wdAddBezier(), much faster for long runs
+ * of segments. wdAddLines() adds uCount lines; wdAddBeziers() adds uCount
+ * curves, each described by three points in pPoints (the two control points
+ * and the end point). */
+void wdAddLines(WD_PATHSINK* pSink, const WD_POINT* pPoints, UINT uCount);
+void wdAddBeziers(WD_PATHSINK* pSink, const WD_POINT* pPoints, UINT uCount);
+
+/* Geometry queries. The coordinates are those of the path itself, i.e. any
+ * world transformation of a canvas is not applied. wdPathStrokeContainsPoint()
+ * tests the outline the path would paint with wdDrawPathStyled().
+ *
+ * wdGetPathBounds() gets the exact bounds of the figures (i.e. not including
+ * any control points of Bezier curves outside of them). They are computed
+ * once when the path sink is closed, so the call is cheap.
+ *
+ * wdGetPathLength() returns zero on failure. */
+BOOL wdPathContainsPoint(const WD_HPATH hPath, float x, float y);
+BOOL wdPathStrokeContainsPoint(const WD_HPATH hPath, float x, float y,
+                float fStrokeWidth, WD_HSTROKESTYLE hStrokeStyle);
+BOOL wdGetPathBounds(const WD_HPATH hPath, WD_RECT* pRect);
+float wdGetPathLength(const WD_HPATH hPath);
+
+/* Get the figures of the path. Each verb (WD_PATHVERB_xxx) consumes the given
+ * count of points from pPoints. Arcs are recorded as Bezier curves. Points of
+ * a transformed path (wdCreateTransformedPath()) come transformed.
+ *
+ * On input, *puVerbCount and *puPointCount are the sizes of the buffers; on
+ * output, the counts of the verbs and points of the path. If any buffer is
+ * NULL or too small, nothing is copied and FALSE is returned. */
+#define WD_PATHVERB_BEGINFIGURE     0   /* 1 point: The start. */
+#define WD_PATHVERB_LINE            1   /* 1 point: The end. */
+#define WD_PATHVERB_BEZIER          2   /* 3 points: Control points and the end. */
+#define WD_PATHVERB_ENDFIGURE       3   /* 0 points. */
+#define WD_PATHVERB_CLOSEFIGURE     4   /* 0 points. */
+
+BOOL wdGetPathData(const WD_HPATH hPath, BYTE* pVerbs, UINT* puVerbCount,
+                WD_POINT* pPoints, UINT* puPointCount);
+
+
+/*******************
+ ***  Path Index  ***
+ *******************/
+
+/* Path index is a bounding volume hierarchy built over an array of paths. It
+ * allows to find the paths at some point or in some rectangle in logarithmic
+ * time, which makes it suitable e.g. for mouse picking among very many shapes.
+ *
+ * The index refers to the paths by their position in the array passed to
+ * wdCreatePathIndex(). It does not take ownership of the paths: They have to
+ * stay alive (and unchanged) as long as the index is used.
+ *
+ * wdHitTestPathIndex() returns the position of the last path (i.e. the one
+ * painted on top if the paths are painted in the order of the array) which
+ * contains the point, or -1 if there is none. If fStrokeWidth is positive,
+ * the path is considered to contain also the points of its outline of that
+ * width (see wdPathStrokeContainsPoint()).
+ *
+ * wdQueryPathIndex() finds the paths whose bounds intersect the rectangle.
+ * It writes at most uMaxCount of their positions (in no particular order)
+ * into puIndexes, and returns the count of all such paths.
+ */
+WD_HPATHINDEX wdCreatePathIndex(const WD_HPATH* phPaths, UINT uCount);
+void wdDestroyPathIndex(WD_HPATHINDEX hIndex);
+
+int wdHitTestPathIndex(WD_HPATHINDEX hIndex, float x, float y, float fStrokeWidth);
+UINT wdQueryPathIndex(WD_HPATHINDEX hIndex, const WD_RECT* pRect,
+                UINT* puIndexes, UINT uMaxCount);
+
+
+/*************************
+ ***  Mesh Management  ***
+ *************************/
+
+/* Mesh is a path pre-processed for repeated filling. When a path is filled
+ * with wdFillPath(), it has to be tessellated again and again on every call.
+ * A mesh holds the result of the tessellation so filling it with wdFillMesh()
+ * is much cheaper. This is useful for complex shapes which do not change but
+ * are painted in every frame.
+ *
+ * Note the mesh is always painted without anti-aliasing. Also, the curves of
+ * the path are flattened with respect to the path coordinates so scaling the
+ * mesh up by the canvas transformation may reveal the facets.
+ *
+ * The path may be destroyed after the mesh has been created. The mesh can
+ * only be used for the canvas it has been created for.
+ */
+
+WD_HMESH wdCreateMeshFromPath(WD_HCANVAS hCanvas, const WD_HPATH hPath);
+void wdDestroyMesh(WD_HMESH hMesh);
+
+
+/*************************************
+ ***  Cached Path Mask Management  ***
+ *************************************/
+
+/* Cached path mask is a path rasterized in advance into an opacity mask. It
+ * is useful for small complex shapes (e.g. vector icons) which are painted
+ * many times at the same size: Painting the mask with wdFillCachedPathMask()
+ * is much cheaper than painting the path with wdFillPath(), and it can still
+ * be used with any brush.
+ *
+ * The path is rasterized with the given scale factor. The mask is then painted
+ * with its original size in the canvas coordinates, so it looks best when the
+ * canvas transformation scales it by the same factor (usually 1.0).
+ *
+ * The path may be destroyed after the mask has been created. The mask can
+ * only be used for the canvas it has been created for.
+ *
+ * (With GDI+ back-end, the mask is emulated with a path whose curves have
+ * been flattened in advance.)
+ */
+
+/* Flags for wdCreateCachedPathMask() */
+#define WD_PATHMASK_ALIASED         0x0001  /* Rasterize without anti-aliasing. */
+
+WD_HCACHEDPATHMASK wdCreateCachedPathMask(WD_HCANVAS hCanvas, const WD_HPATH hPath,
+                float fScale, DWORD dwFlags);
+void wdDestroyCachedPathMask(WD_HCACHEDPATHMASK hMask);
+
 /*************************
  ***  Font Management  ***
  *************************/
@@ -416,6 +773,12 @@ void wdAddBezier(WD_PATHSINK* pSink, float x0, float y0, float x1, float y1, flo
  *
  * Also note that usage of non-TrueType fonts is not supported by GDI+
  * so attempt to create such WD_HFONT will fall back to a default GUI font.
+ *
+ * Fonts are cached process-wide: wdCreateFont() with the same LOGFONTW as
+ * some still existing (or recently destroyed) font returns the very same
+ * WD_HFONT, and its metrics are computed only once. Each wdCreateFont() has
+ * still to be paired with wdDestroyFont() as the handles are
+ * reference-counted.
  */
 
 WD_HFONT wdCreateFont(const LOGFONTW* pLogFont);
@@ -561,9 +924,27 @@ void wdFillEllipsePie(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
                 float cx, float cy, float rx, float ry,
                 float fBaseAngle, float fSweepAngle);
 void wdFillPath(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, const WD_HPATH hPath);
+void wdFillMesh(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, const WD_HMESH hMesh);
+void wdFillCachedPathMask(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
+                const WD_HCACHEDPATHMASK hMask, float x, float y);
 void wdFillRect(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
                 float x0, float y0, float x1, float y1);
 
+/* Fill the same path many times (e.g. markers of a scatter plot), each time
+ * with its own transformation (applied on top of the current one) and its
+ * own solid color. This is much faster than calling wdTransformWorld(),
+ * wdSetSolidBrushColor() and wdFillPath() for each instance.
+ *
+ * With Direct2D back-end, when all the instances (and the current
+ * transformation) are mere translations by whole pixels, the path may be
+ * rasterized only once into an opacity mask which is then just stamped at
+ * each position (as with wdFillCachedPathMask()). The mask is cached on the
+ * path for the last canvas it has been used with, and it is released when
+ * the path is modified or destroyed. Fractional offsets use the (slower)
+ * per-instance filling so the result stays the same as with wdFillPath(). */
+void wdFillPathInstances(WD_HCANVAS hCanvas, const WD_HPATH hPath,
+                const WD_INSTANCE* pInstances, UINT uCount);
+
 WD_INLINE void wdFillCircle(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
                 float cx, float cy, float r)
 {
@@ -638,16 +1019,356 @@ void wdDrawString(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
                 DWORD dwFlags);
 
 /* Note hCanvas here is optional. If hCanvas == NULL, GDI+ uses screen
- * for the computation; D2D back-end ignores that parameter altogether.
+ * for the computation (through a measuring context kept for each thread);
+ * D2D back-end ignores that parameter altogether.
  */
 void wdMeasureString(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
                 const WCHAR* pszText, int iTextLength, WD_RECT* pResult,
                 DWORD dwFlags);
 
+/* Measure many strings at once, e.g. all cells of a grid column. Each string
+ * is measured as wdMeasureString() would measure it in the rectangle
+ * (0, 0, fMaxWidth, 10000), and its bounding box is stored into
+ * pResults[i]. If fMaxWidth is zero or negative, the width is not limited
+ * (10000, as in wdStringWidth()).
+ *
+ * Unlike calling wdMeasureString() in a loop, the strings do not flush the
+ * layout cache of the font (see wdGetTextCacheStats()), and the GDI+
+ * back-end sets up its string format only once for the whole batch.
+ *
+ * hCanvas is optional as in wdMeasureString().
+ */
+typedef struct WD_STRINGREF_tag WD_STRINGREF;
+struct WD_STRINGREF_tag {
+    const WCHAR* pszText;
+    int iTextLength;        /* -1 if zero-terminated. */
+};
+
+void wdMeasureStrings(WD_HCANVAS hCanvas, WD_HFONT hFont,
+                const WD_STRINGREF* pStrings, UINT uCount, float fMaxWidth,
+                DWORD dwFlags, WD_RECT* pResults);
+
 /* Convenient wdMeasureString() wrapper. */
 float wdStringWidth(WD_HCANVAS hCanvas, WD_HFONT hFont, const WCHAR* pszText);
 float wdStringHeight(WD_HFONT hFont, const WCHAR* pszText);
 
+/* Width of a single-line string, as wdStringWidth() would return, but much
+ * cheaper for strings of simple scripts (Latin, Greek, Cyrillic and common
+ * symbols): With Direct2D, the width is just a sum of the glyph advances of
+ * the font, which the font caches. Kerning and ligatures are ignored, so the
+ * result may be a bit wider than the laid out string. This is meant for
+ * things like auto-sizing a column to its widest cell.
+ *
+ * Strings which need shaping (complex scripts, combining marks, bidi
+ * controls, line breaks, tabs or characters missing in the font) are
+ * measured by a full layout as wdStringWidth() does. So does the GDI+
+ * back-end always.
+ *
+ * If iTextLength is -1, the string has to be zero-terminated. hCanvas may be
+ * NULL.
+ */
+float wdMeasureStringFast(WD_HCANVAS hCanvas, WD_HFONT hFont,
+                const WCHAR* pszText, int iTextLength);
+
+/* Statistics of the text layout caches (process-wide):
+ *
+ * With Direct2D, each WD_HFONT remembers the layouts of the strings recently
+ * passed to wdDrawString() and wdMeasureString(), keyed by the text, the size
+ * of the rectangle and the flags. Repeated calls with the same arguments
+ * (e.g. when repainting a table) then reuse the layout. The count of the
+ * layouts cached by all fonts together is limited (see
+ * wdSetTextCacheLimit()).
+ *
+ * uLayoutHits: Number of calls which have found the layout in the cache.
+ *
+ * uLayoutMisses: Number of calls which had to create a new layout. (Strings
+ * too long for the cache are not counted at all.)
+ *
+ * (GDI+ back-end has no layout cache so the two counters above remain zero
+ * there.)
+ *
+ * uFontHits: Number of wdCreateFont() calls which have returned an already
+ * existing font (see wdCreateFont()).
+ *
+ * uFontMisses: Number of wdCreateFont() calls which had to create a new font.
+ */
+typedef struct WD_TEXTCACHESTATS_tag WD_TEXTCACHESTATS;
+struct WD_TEXTCACHESTATS_tag {
+    UINT uLayoutHits;
+    UINT uLayoutMisses;
+    UINT uFontHits;
+    UINT uFontMisses;
+};
+
+void wdGetTextCacheStats(WD_TEXTCACHESTATS* pStats);
+void wdResetTextCacheStats(void);
+
+/* Set the max. count of the text layouts cached by all fonts together. The
+ * default is 8192, enough for several thousand strings painted per frame.
+ * Each layout takes a few kilobytes, so applications painting much less text
+ * may want to lower it, and those painting more text to raise it. Zero
+ * disables the cache. Lowering the limit does not release the cached layouts
+ * at once; the caches shrink as new layouts are cached. (No-op with GDI+.)
+ */
+void wdSetTextCacheLimit(UINT uMaxLayouts);
+
+
+/*********************
+ ***  Text Layout  ***
+ *********************/
+
+/* Text layout is a string laid out for the given font, flags and size of the
+ * box. Unlike wdDrawString() and wdMeasureString(), the (expensive) shaping
+ * of the text is done only once, when creating the layout. That is useful
+ * e.g. for labels or text editors which paint, measure and hit-test the same
+ * text repeatedly.
+ *
+ * All these functions are usable only if the library has been initialized with
+ * the flag WD_INIT_DRAWSTRINGAPI. The layout is not canvas-specific, but it
+ * refers to the font so the font must not be destroyed before the layout.
+ *
+ * All coordinates (of the metrics and the hit testing) are relative to the
+ * top left corner of the layout box, i.e. to the point (x, y) passed to
+ * wdDrawTextLayout().
+ */
+
+/* Metrics of the text actually laid out in the box. */
+typedef struct WD_TEXTLAYOUTMETRICS_tag WD_TEXTLAYOUTMETRICS;
+struct WD_TEXTLAYOUTMETRICS_tag {
+    float fLeft;
+    float fTop;
+    float fWidth;
+    float fHeight;
+    UINT uLineCount;
+};
+
+/* Result of the hit testing. */
+typedef struct WD_TEXTHITTEST_tag WD_TEXTHITTEST;
+struct WD_TEXTHITTEST_tag {
+    UINT uPosition;     /* Index of the (first) character hit. */
+    UINT uLength;       /* Count of the characters (e.g. a surrogate pair or a ligature). */
+    WD_RECT rcBox;      /* Box of the characters. */
+    BOOL bTrailing;     /* The trailing side of the character. */
+    BOOL bInside;       /* The point is inside the text. */
+};
+
+WD_HTEXTLAYOUT wdCreateTextLayout(WD_HFONT hFont, const WCHAR* pszText,
+                int iTextLength, float fMaxWidth, float fMaxHeight, DWORD dwFlags);
+void wdDestroyTextLayout(WD_HTEXTLAYOUT hLayout);
+
+void wdDrawTextLayout(WD_HCANVAS hCanvas, WD_HTEXTLAYOUT hLayout,
+                float x, float y, WD_HBRUSH hBrush);
+
+void wdGetTextLayoutMetrics(WD_HTEXTLAYOUT hLayout, WD_TEXTLAYOUTMETRICS* pMetrics);
+
+/* Find the character at the given point. If the point is outside of the
+ * text, the nearest character is reported and FALSE is returned. */
+BOOL wdTextLayoutHitTestPoint(WD_HTEXTLAYOUT hLayout, float x, float y,
+                WD_TEXTHITTEST* pResult);
+
+/* Get the caret position for the leading (or trailing) edge of the character
+ * at the given index. pResult may be NULL. */
+void wdTextLayoutHitTestPosition(WD_HTEXTLAYOUT hLayout, UINT uPosition,
+                BOOL bTrailing, float* pfX, float* pfY, WD_TEXTHITTEST* pResult);
+
+
+/********************
+ ***  Glyph Runs  ***
+ ********************/
+
+/* Glyph run is a sequence of glyphs of a font, each with its advance. The
+ * application shapes the text once with wdShapeText(), keeps the glyphs and
+ * advances and then paints them with wdDrawGlyphRun() which involves no text
+ * layout or formatting at all. This is useful e.g. for lines of a log viewer
+ * or a hex editor which are painted again and again.
+ *
+ * The shaping is simple: Each character (Unicode code point, so a surrogate
+ * pair counts as one character) maps to exactly one glyph of the font (or
+ * glyph 0 if the font has none for it), with its nominal advance. (GDI+
+ * back-end maps only characters of the Basic Multilingual Plane.) There is
+ * no font fallback, kerning, ligatures, bidi reordering or complex script
+ * shaping, so use text layouts (or wdDrawString()) for such texts.
+ *
+ * The glyph indices are specific to the font. They may be passed to
+ * wdDrawGlyphRun() only with the same WD_HFONT they have been shaped for.
+ */
+
+/* Shape the text. The glyphs and advances of the first (at most) uMaxCount
+ * characters are stored into pGlyphs and pAdvances. Returns the number of
+ * glyphs of the whole text (i.e. the count of its characters, which is less
+ * than its length if it has surrogate pairs), or zero on an error. So
+ * uMaxCount == 0 can be used to ask for the size of the buffers. If
+ * iTextLength is -1, the string has to be zero-terminated. */
+UINT wdShapeText(WD_HFONT hFont, const WCHAR* pszText, int iTextLength,
+                UINT16* pGlyphs, float* pAdvances, UINT uMaxCount);
+
+/* Paint the glyph run. (x, y) is the origin of the first glyph on the base
+ * line (so for painting into a box, add WD_FONTMETRICS::fAscent to its top
+ * edge). With GDI+ back-end, it is painted with GdipDrawDriverString(). */
+void wdDrawGlyphRun(WD_HCANVAS hCanvas, WD_HFONT hFont, float x, float y,
+                const UINT16* pGlyphs, const float* pAdvances, UINT uCount,
+                WD_HBRUSH hBrush);
+
+
+/***********************
+ ***  Display Lists  ***
+ ***********************/
+
+/* Display list is a recorded sequence of drawing calls which can be replayed
+ * later, possibly many times. It is useful for static parts of the scene
+ * (e.g. axes, grids or legends of a chart) which are otherwise issued again
+ * and again on every WM_PAINT.
+ *
+ * Between wdBeginRecording() and wdEndRecording(), all the draw, fill,
+ * bit-blit, text output, clipping and world transformation calls on the
+ * canvas are recorded instead of being painted. (The calls of
+ * wdReplayDisplayList() are recorded as well so lists may be nested.)
+ *
+ * wdReplayDisplayList() then paints the list on the canvas. If pMatrix is not
+ * NULL, it is applied as by wdTransformWorld() for the time of the replay.
+ * Any changes of the world transformation made by the list are reverted when
+ * the replay ends, and wdResetWorld() in the list resets the world to the
+ * state when the replay has started. If the list sets any clip, the clip of
+ * the canvas is reset when the replay ends.
+ *
+ * Note the list does not own the objects used by the recorded calls (brushes,
+ * stroke styles, paths, images, fonts and also nested lists). The application
+ * has to keep them alive as long as the list is in use, and the list can
+ * only be replayed on a canvas where these objects can be used. (Only the
+ * strings passed to wdDrawString() are copied into the list.)
+ */
+
+BOOL wdBeginRecording(WD_HCANVAS hCanvas);
+WD_HDISPLAYLIST wdEndRecording(WD_HCANVAS hCanvas);
+
+void wdReplayDisplayList(WD_HCANVAS hCanvas, WD_HDISPLAYLIST hList, const WD_MATRIX* pMatrix);
+void wdDestroyDisplayList(WD_HDISPLAYLIST hList);
+
+/* wdSaveDisplayList() stores the list into a binary file which can be later
+ * loaded by wdLoadDisplayListMapped(). Only lists made of the clear, clip,
+ * world transformation, draw, fill (except meshes and cached path masks)
+ * and string calls can be saved, and only with solid brushes. The state of
+ * the brushes, stroke styles, paths and fonts is stored in the file, so the
+ * loaded list does not depend on them. Arcs in the paths are stored as
+ * Bezier curves.
+ *
+ * wdLoadDisplayListMapped() maps the file into memory and the list replays
+ * the commands directly from it, without any parsing. The list creates its
+ * own resources on the first replay (the brushes are recreated whenever the
+ * list is replayed on a different canvas) and destroys them together with
+ * the list (by wdDestroyDisplayList()). The file is kept open (and cannot be
+ * modified) as long as the list exists.
+ */
+BOOL wdSaveDisplayList(WD_HDISPLAYLIST hList, const WCHAR* pszPath);
+WD_HDISPLAYLIST wdLoadDisplayListMapped(const WCHAR* pszPath);
+
+
+/****************
+ ***  Scenes  ***
+ ****************/
+
+/* Scene is a retained set of items (rectangles, paths, texts and images),
+ * each with its brush, z-order and an application-defined lParam. The scene
+ * keeps the items in a spatial index so it can cheaply find the items which
+ * intersect a given area. This is useful for views with very many items
+ * (e.g. diagrams or CAD drawings) where typically only a small part needs
+ * to be repainted.
+ *
+ * wdCreateScene(): fCellSize is the size of the cells of the grid used as the
+ * spatial index. Ideally it should be a bit larger than a typical item. If it
+ * is zero or less, a default is used.
+ *
+ * wdAddSceneItem() returns an ID of the item, or zero on failure. The text of
+ * WD_SCENEITEM_TEXT is copied into the scene. All the other objects (brushes,
+ * stroke styles, paths, fonts and images) are only referred by the scene, so
+ * the application has to keep them alive and unchanged as long as the scene
+ * uses them. (The bounds of path items are computed when they are added.)
+ *
+ * wdRenderScene() paints the items which intersect pDirtyRect (or all items
+ * if it is NULL), in the order of their z-order. Items with equal z-order are
+ * painted in the order they have been added. The coordinates of the scene
+ * are subject to the current world transformation of the canvas, and so is
+ * pDirtyRect. Usually the application also sets the clip to pDirtyRect.
+ *
+ * wdSceneHitTest() returns the ID of the topmost item at the given point, or
+ * zero if there is none. If plParam is not NULL, it receives lParam of the
+ * item. Path items are tested with wdPathContainsPoint() or, for
+ * WD_SCENEITEM_DRAWPATH, with wdPathStrokeContainsPoint().
+ *
+ * wdRemoveSceneItem() releases all the memory the item uses in the scene.
+ * Its ID may then be reused by an item added later.
+ */
+
+#define WD_SCENEITEM_FILLRECT       1
+#define WD_SCENEITEM_DRAWRECT       2
+#define WD_SCENEITEM_FILLPATH       3
+#define WD_SCENEITEM_DRAWPATH       4
+#define WD_SCENEITEM_TEXT           5
+#define WD_SCENEITEM_IMAGE          6
+
+typedef struct WD_SCENEITEM_tag WD_SCENEITEM;
+struct WD_SCENEITEM_tag {
+    UINT uKind;                     /* WD_SCENEITEM_xxx */
+    int iZOrder;
+    WD_RECT rect;                   /* The rectangle, text layout rectangle or image destination. */
+    WD_HBRUSH hBrush;               /* Not used for images. */
+    float fStrokeWidth;             /* WD_SCENEITEM_DRAWRECT, WD_SCENEITEM_DRAWPATH */
+    WD_HSTROKESTYLE hStrokeStyle;   /* WD_SCENEITEM_DRAWRECT, WD_SCENEITEM_DRAWPATH */
+    WD_HPATH hPath;                 /* WD_SCENEITEM_FILLPATH, WD_SCENEITEM_DRAWPATH */
+    WD_HFONT hFont;                 /* WD_SCENEITEM_TEXT */
+    const WCHAR* pszText;           /* WD_SCENEITEM_TEXT */
+    int iTextLength;                /* WD_SCENEITEM_TEXT */
+    DWORD dwTextFlags;              /* WD_SCENEITEM_TEXT; see wdDrawString() */
+    WD_HIMAGE hImage;               /* WD_SCENEITEM_IMAGE */
+    LPARAM lParam;
+};
+
+WD_HSCENE wdCreateScene(float fCellSize);
+void wdDestroyScene(WD_HSCENE hScene);
+
+UINT wdAddSceneItem(WD_HSCENE hScene, const WD_SCENEITEM* pItem);
+void wdRemoveSceneItem(WD_HSCENE hScene, UINT uItemId);
+
+void wdRenderScene(WD_HCANVAS hCanvas, WD_HSCENE hScene, const WD_RECT* pDirtyRect);
+UINT wdSceneHitTest(WD_HSCENE hScene, float x, float y, LPARAM* plParam);
+
+
+/*******************
+ ***  API Trace  ***
+ *******************/
+
+/* If the library is built with the API trace support (meson option
+ * "apitrace"), the calls the application makes can be recorded into a binary
+ * file. The trace can then be replayed with the tool wd-replay, which reports
+ * how much time the calls of each type take. This allows to benchmark and
+ * compare the back-ends (or changes of the library) on the real workload of
+ * the application.
+ *
+ * Only canvases created while the trace is active are traced. The pixels of
+ * all images are recorded (for images loaded from files, streams, resources
+ * or HBITMAPs, they are read back from the created image), so the replay
+ * paints the same contents. Only when they cannot be read (e.g. GDI+
+ * metafiles), the image is replayed as a placeholder of the same size.
+ *
+ * Queries are not recorded: wdMeasureString(), wdMeasureStrings(),
+ * wdMeasureStringFast(), wdFontMetrics(), wdGetTextLayoutMetrics(),
+ * wdTextLayoutHitTestPoint(), wdTextLayoutHitTestPosition(),
+ * wdGetImageSize(), wdIsImageOpaque(), wdGetPathBounds(), wdGetPathLength(),
+ * wdPathContainsPoint(), wdPathStrokeContainsPoint(), wdHitTestPathIndex(),
+ * wdSceneHitTest(), wdGetDirtyRects(), and the statistics functions. They do
+ * not affect the painted output, and their results are consumed by the
+ * application logic, which the replay does not have, so their timing would
+ * not be comparable anyway. Profile them in the application itself.
+ *
+ * Alternatively, if the environment variable WD_APITRACE is set, the first
+ * wdInitialize() starts tracing into the file it names, and wdTerminate()
+ * stops it.
+ *
+ * wdStartApiTrace() fails if the library is built without the support.
+ */
+BOOL wdStartApiTrace(const WCHAR* pszPath);
+void wdStopApiTrace(void);
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
@@ -0,0 +1,323 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "apitrace.h"
+#include "backend-d2d.h"
+#include "backend-wic.h"
+#include "backend-gdix.h"
+#include "lock.h"
+
+#include <stdio.h>
+
+
+#ifdef WD_APITRACE
+
+static FILE* wd_apitrace_file = NULL;
+
+
+static void
+wd_apitrace_write(WORD op, const void* handle, const void* owner,
+                  const void* d0, UINT s0, const void* d1, UINT s1,
+                  const void* d2, UINT s2)
+{
+    static const BYTE zeros[WD_APITRACE_ALIGN] = { 0 };
+    wd_apitrace_record_t rec;
+    wd_apitrace_ids_t ids;
+    UINT pad;
+
+    rec.op = op;
+    rec.reserved = 0;
+    rec.size = (UINT32) (sizeof(wd_apitrace_ids_t) + s0 + s1 + s2);
+    pad = (WD_APITRACE_ALIGN - rec.size % WD_APITRACE_ALIGN) % WD_APITRACE_ALIGN;
+    ids.handle = (UINT64) (UINT_PTR) handle;
+    ids.owner = (UINT64) (UINT_PTR) owner;
+
+    wd_lock();
+    if(wd_apitrace_file != NULL) {
+        fwrite(&rec, sizeof(wd_apitrace_record_t), 1, wd_apitrace_file);
+        fwrite(&ids, sizeof(wd_apitrace_ids_t), 1, wd_apitrace_file);
+        if(s0 > 0)
+            fwrite(d0, 1, s0, wd_apitrace_file);
+        if(s1 > 0)
+            fwrite(d1, 1, s1, wd_apitrace_file);
+        if(s2 > 0)
+            fwrite(d2, 1, s2, wd_apitrace_file);
+        if(pad > 0)
+            fwrite(zeros, 1, pad, wd_apitrace_file);
+    }
+    wd_unlock();
+}
+
+void
+wd_apitrace_autostart(void)
+{
+    static BOOL done = FALSE;
+    WCHAR path[MAX_PATH];
+    DWORD n;
+
+    /* Only the first wdInitialize() in the process starts the trace. */
+    if(done)
+        return;
+    done = TRUE;
+
+    n = GetEnvironmentVariableW(L"WD_APITRACE", path, MAX_PATH);
+    if(n == 0  ||  n >= MAX_PATH)
+        return;
+
+    if(!wdStartApiTrace(path))
+        WD_TRACE("wd_apitrace_autostart: wdStartApiTrace() failed.");
+}
+
+void
+wd_apitrace_autostop(void)
+{
+    wdStopApiTrace();
+}
+
+void
+wd_apitrace_canvas(WD_HCANVAS hCanvas, UINT width, UINT height, DWORD flags)
+{
+    UINT32 args[3] = { width, height, flags };
+    wd_hook_t* hook;
+
+    if(wd_apitrace_file == NULL)
+        return;
+
+    wd_apitrace_write(WD_APITRACE_OP_CREATECANVAS, hCanvas, NULL,
+                      args, sizeof(args), NULL, 0, NULL, 0);
+
+    hook = wd_hook_acquire(hCanvas);
+    if(hook == NULL) {
+        WD_TRACE("wd_apitrace_canvas: wd_hook_acquire() failed.");
+        return;
+    }
+    hook->trace = TRUE;
+}
+
+void
+wd_apitrace_handle(WORD op, const void* handle)
+{
+    if(wd_apitrace_file == NULL  ||  handle == NULL)
+        return;
+
+    wd_apitrace_write(op, handle, NULL, NULL, 0, NULL, 0, NULL, 0);
+}
+
+void
+wd_apitrace_create(WORD op, const void* handle, const void* owner,
+                   const void* args, UINT args_size,
+                   const void* data0, UINT data0_size,
+                   const void* data1, UINT data1_size)
+{
+    if(wd_apitrace_file == NULL  ||  handle == NULL)
+        return;
+
+    wd_apitrace_write(op, handle, owner, args, args_size,
+                      data0, data0_size, data1, data1_size);
+}
+
+/* Read the pixels of the image, in the layout of
+ * WD_PIXELFORMAT_B8G8R8A8_PREMULTIPLIED (i.e. bottom-up), so that wd-replay
+ * can create the same image with wdCreateImageFromBuffer(). The caller has to
+ * free() the buffer. Returns NULL on failure (e.g. for GDI+ metafiles). */
+static BYTE*
+wd_apitrace_read_pixels(WD_HIMAGE hImage, UINT width, UINT height)
+{
+    UINT stride = width * 4;
+    BYTE* buffer;
+    UINT y;
+
+    if(width == 0  ||  height == 0)
+        return NULL;
+
+    buffer = (BYTE*) malloc(stride * height);
+    if(buffer == NULL) {
+        WD_TRACE("wd_apitrace_read_pixels: malloc() failed.");
+        return NULL;
+    }
+
+    if(d2d_enabled()) {
+        IWICBitmapSource* bitmap = (IWICBitmapSource*) hImage;
+        GUID pixel_format;
+        WICRect rect;
+        HRESULT hr;
+
+        /* Images are always in wic_pixel_format or wic_pixel_format_opaque
+         * (see wic_convert_bitmap()). Copy the rows in the reverse order. */
+        rect.X = 0;
+        rect.Width = width;
+        rect.Height = 1;
+        for(y = 0; y < height; y++) {
+            rect.Y = y;
+            hr = IWICBitmapSource_CopyPixels(bitmap, &rect, stride, stride,
+                        buffer + (height - 1 - y) * stride);
+            if(FAILED(hr)) {
+                WD_TRACE_HR("wd_apitrace_read_pixels: "
+                            "IWICBitmapSource::CopyPixels() failed.");
+                goto err;
+            }
+        }
+
+        /* The 4th byte of the opaque format is undefined. */
+        if(SUCCEEDED(IWICBitmapSource_GetPixelFormat(bitmap, &pixel_format))  &&
+           IsEqualGUID(&pixel_format, &wic_pixel_format_opaque))
+        {
+            for(y = 0; y < width * height; y++)
+                buffer[4 * y + 3] = 0xff;
+        }
+    } else {
+        c_GpBitmapData data;
+        c_GpRectI rect = { 0, 0, width, height };
+        int status;
+
+        status = gdix_vtable->fn_BitmapLockBits((c_GpBitmap*) hImage, &rect,
+                    c_ImageLockModeRead, c_PixelFormat32bppPARGB, &data);
+        if(status != 0)
+            goto err;
+        for(y = 0; y < height; y++) {
+            memcpy(buffer + (height - 1 - y) * stride,
+                   (const BYTE*) data.Scan0 + y * data.Stride, stride);
+        }
+        gdix_vtable->fn_BitmapUnlockBits((c_GpBitmap*) hImage, &data);
+    }
+
+    return buffer;
+
+err:
+    free(buffer);
+    return NULL;
+}
+
+void
+wd_apitrace_image(WD_HIMAGE hImage, UINT width, UINT height, UINT stride,
+                  const BYTE* buffer, int format, const COLORREF* palette,
+                  UINT palette_size)
+{
+    wd_apitrace_image_t args;
+    BYTE* pixels = NULL;
+
+    if(wd_apitrace_file == NULL  ||  hImage == NULL)
+        return;
+
+    if(buffer == NULL) {
+        /* The image has been loaded from a file, stream, resource or
+         * HBITMAP. Read its pixels back. If that fails, we record only the
+         * size and wd-replay substitutes a placeholder. */
+        wdGetImageSize(hImage, &width, &height);
+        pixels = wd_apitrace_read_pixels(hImage, width, height);
+        if(pixels != NULL) {
+            buffer = pixels;
+            stride = width * 4;
+            format = WD_PIXELFORMAT_B8G8R8A8_PREMULTIPLIED;
+        } else {
+            stride = 0;
+            format = 0;
+        }
+        palette = NULL;
+        palette_size = 0;
+    }
+
+    args.width = width;
+    args.height = height;
+    args.stride = stride;
+    args.format = format;
+    args.palette_size = (palette != NULL ? palette_size : 0);
+
+    wd_apitrace_write(WD_APITRACE_OP_CREATEIMAGE, hImage, NULL,
+                      &args, sizeof(args),
+                      palette, args.palette_size * sizeof(COLORREF),
+                      buffer, (buffer != NULL ? stride * height : 0));
+    free(pixels);
+}
+
+void
+wd_apitrace_cmd(WD_HCANVAS hCanvas, const wd_cmd_t* cmd)
+{
+    wd_apitrace_cmd_t args;
+    UINT data_size = 0;
+
+    if(wd_apitrace_file == NULL)
+        return;
+
+    memset(&args, 0, sizeof(args));
+    args.kind = cmd->kind;
+    args.flags = cmd->flags;
+    args.dw = cmd->dw;
+    args.len = cmd->len;
+    args.brush = (UINT64) (UINT_PTR) cmd->brush;
+    args.style = (UINT64) (UINT_PTR) cmd->style;
+    args.obj = (UINT64) (UINT_PTR) cmd->obj;
+    memcpy(args.a, cmd->a, sizeof(args.a));
+
+    data_size = wd_cmd_data_size(cmd);
+
+    wd_apitrace_write(WD_APITRACE_OP_CMD, hCanvas, NULL, &args, sizeof(args),
+                      cmd->data, data_size, NULL, 0);
+}
+
+#endif  /* WD_APITRACE */
+
+
+BOOL
+wdStartApiTrace(const WCHAR* pszPath)
+{
+#ifdef WD_APITRACE
+    wd_apitrace_header_t header;
+    FILE* f;
+
+    f = _wfopen(pszPath, L"wb");
+    if(f == NULL) {
+        WD_TRACE("wdStartApiTrace: _wfopen() failed.");
+        return FALSE;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WD_APITRACE_MAGIC, sizeof(WD_APITRACE_MAGIC));
+    header.version = WD_APITRACE_VERSION;
+    header.backend = (UINT32) wdBackend();
+    fwrite(&header, sizeof(header), 1, f);
+
+    wd_lock();
+    if(wd_apitrace_file != NULL)
+        fclose(wd_apitrace_file);
+    wd_apitrace_file = f;
+    wd_unlock();
+    return TRUE;
+#else
+    WD_TRACE("wdStartApiTrace: Not supported (built without WD_APITRACE).");
+    return FALSE;
+#endif
+}
+
+void
+wdStopApiTrace(void)
+{
+#ifdef WD_APITRACE
+    wd_lock();
+    if(wd_apitrace_file != NULL) {
+        fclose(wd_apitrace_file);
+        wd_apitrace_file = NULL;
+    }
+    wd_unlock();
+#endif
+}
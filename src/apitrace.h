@@ -0,0 +1,266 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_APITRACE_H
+#define WD_APITRACE_H
+
+#include "misc.h"
+#include "hook.h"
+
+
+/* API trace
+ * =========
+ *
+ * When the library is built with the meson option "apitrace" (which defines
+ * WD_APITRACE), the application may record the calls it makes into a binary
+ * file (see wdStartApiTrace()). The trace can then be replayed and timed
+ * with the wd-replay tool.
+ *
+ * The trace covers everything which affects the painted output: Lifetime of
+ * canvases and of all the resources, including their parameters and data
+ * (pixels of images, texts of wdDrawString()), and all the drawing calls
+ * which go through the canvas hook (see hook.h). Queries are not recorded
+ * (see wdStartApiTrace() in wdl.h).
+ *
+ * File format (all little-endian):
+ *
+ *   wd_apitrace_header_t
+ *   (wd_apitrace_record_t, payload, padding)*
+ *
+ * Each record starts on an offset aligned to WD_APITRACE_ALIGN (the payload
+ * is padded with zeros), so the reader may access the data in place. Each
+ * payload starts with wd_apitrace_ids_t. What follows depends on the
+ * record type; it is described below with each WD_APITRACE_OP_xxx. Handles
+ * are stored as their original pointer values, which serve only as their
+ * identities.
+ */
+
+#define WD_APITRACE_MAGIC           "WDTRACE"
+#define WD_APITRACE_VERSION         1
+#define WD_APITRACE_ALIGN           8
+
+#pragma pack(push, 4)
+
+typedef struct wd_apitrace_header_tag wd_apitrace_header_t;
+struct wd_apitrace_header_tag {
+    char magic[8];
+    UINT32 version;
+    UINT32 backend;         /* wdBackend() of the traced application. */
+};
+
+typedef struct wd_apitrace_record_tag wd_apitrace_record_t;
+struct wd_apitrace_record_tag {
+    UINT16 op;
+    UINT16 reserved;
+    UINT32 size;            /* Size of the payload (without the padding). */
+};
+
+typedef struct wd_apitrace_ids_tag wd_apitrace_ids_t;
+struct wd_apitrace_ids_tag {
+    UINT64 handle;
+    UINT64 owner;           /* Usually the canvas the object is created for. */
+};
+
+/* Args of WD_APITRACE_OP_CMD. Followed by the data of the command (see
+ * wd_cmd_data_size()), i.e. cmd.len WCHARs of the text, cmd.len
+ * WD_INSTANCE structures, or cmd.len advances and cmd.len glyph indices. */
+typedef struct wd_apitrace_cmd_tag wd_apitrace_cmd_t;
+struct wd_apitrace_cmd_tag {
+    UINT16 kind;
+    UINT16 flags;
+    UINT32 dw;
+    INT32 len;
+    UINT32 reserved;
+    UINT64 brush;
+    UINT64 style;
+    UINT64 obj;
+    float a[8];
+};
+
+/* Args of WD_APITRACE_OP_CREATEIMAGE. If format is zero, the pixels of the
+ * image could not be read and only its size is known. Otherwise followed by
+ * the palette (palette_size COLORREFs) and the buffer (stride * height
+ * bytes). Images not created from a buffer are recorded as
+ * WD_PIXELFORMAT_B8G8R8A8_PREMULTIPLIED. */
+typedef struct wd_apitrace_image_tag wd_apitrace_image_t;
+struct wd_apitrace_image_tag {
+    UINT32 width;
+    UINT32 height;
+    UINT32 stride;
+    INT32 format;
+    UINT32 palette_size;
+};
+
+/* Args of WD_APITRACE_OP_CREATEPATHMASK. */
+typedef struct wd_apitrace_pathmask_tag wd_apitrace_pathmask_t;
+struct wd_apitrace_pathmask_tag {
+    UINT64 path;
+    float scale;
+    UINT32 flags;
+};
+
+/* Args of WD_APITRACE_OP_CREATEIMAGEBRUSH. */
+typedef struct wd_apitrace_imagebrush_tag wd_apitrace_imagebrush_t;
+struct wd_apitrace_imagebrush_tag {
+    UINT64 image;
+    UINT32 extend_x;
+    UINT32 extend_y;
+    WD_MATRIX matrix;
+};
+
+/* Args of WD_APITRACE_OP_CREATETEXTLAYOUT. Followed by len WCHARs of the
+ * text. */
+typedef struct wd_apitrace_textlayout_tag wd_apitrace_textlayout_t;
+struct wd_apitrace_textlayout_tag {
+    float width;
+    float height;
+    UINT32 flags;
+    INT32 len;
+};
+
+#pragma pack(pop)
+
+                                                /* handle       owner   args */
+#define WD_APITRACE_OP_CREATECANVAS         1   /* canvas       -       UINT32 width, height, flags */
+#define WD_APITRACE_OP_DESTROYCANVAS        2   /* canvas */
+#define WD_APITRACE_OP_BEGINPAINT           3   /* canvas */
+#define WD_APITRACE_OP_ENDPAINT             4   /* canvas */
+#define WD_APITRACE_OP_FLUSHCANVAS          5   /* canvas */
+#define WD_APITRACE_OP_RESIZECANVAS         6   /* canvas       -       UINT32 width, height */
+#define WD_APITRACE_OP_STARTGDI             7   /* canvas (GDI painting itself is not traced.) */
+#define WD_APITRACE_OP_CMD                  8   /* canvas       -       wd_apitrace_cmd_t, data */
+#define WD_APITRACE_OP_SETCANVASQUALITY     9   /* canvas       -       UINT32 param, value */
+
+#define WD_APITRACE_OP_CREATESOLIDBRUSH     10  /* brush        canvas  UINT32 color */
+#define WD_APITRACE_OP_CREATELINEARBRUSH    11  /* brush        canvas  float x0, y0, x1, y1; UINT32 n; colors[n], offsets[n] */
+#define WD_APITRACE_OP_CREATERADIALBRUSH    12  /* brush        canvas  float cx, cy, r, fx, fy; UINT32 n; colors[n], offsets[n] */
+#define WD_APITRACE_OP_SETSOLIDBRUSHCOLOR   13  /* brush        -       UINT32 color */
+#define WD_APITRACE_OP_DESTROYBRUSH         14  /* brush */
+#define WD_APITRACE_OP_SETLINEARBRUSHPOINTS 15  /* brush        -       float x0, y0, x1, y1 */
+#define WD_APITRACE_OP_SETRADIALBRUSHGEOMETRY 16 /* brush       -       float cx, cy, r, fx, fy */
+#define WD_APITRACE_OP_SETBRUSHTRANSFORM    17  /* brush        -       WD_MATRIX matrix */
+#define WD_APITRACE_OP_CREATEIMAGEBRUSH     18  /* brush        canvas  wd_apitrace_imagebrush_t */
+
+#define WD_APITRACE_OP_CREATESTROKESTYLE    20  /* style        -       UINT32 dash_style, line_cap, line_join, n; dashes[n] */
+#define WD_APITRACE_OP_DESTROYSTROKESTYLE   21  /* style */
+
+#define WD_APITRACE_OP_CREATEPATH           30  /* path         canvas */
+#define WD_APITRACE_OP_CLONEPATH            31  /* path         path */
+#define WD_APITRACE_OP_CREATETRANSFORMEDPATH 32 /* path         path    WD_MATRIX matrix */
+#define WD_APITRACE_OP_DESTROYPATH          33  /* path */
+#define WD_APITRACE_OP_OPENPATHSINK         34  /* sink         path */
+#define WD_APITRACE_OP_CLOSEPATHSINK        35  /* sink */
+#define WD_APITRACE_OP_BEGINFIGURE          36  /* sink         -       float x, y */
+#define WD_APITRACE_OP_ENDFIGURE            37  /* sink         -       UINT32 close */
+#define WD_APITRACE_OP_ADDLINE              38  /* sink         -       float x, y */
+#define WD_APITRACE_OP_ADDARC               39  /* sink         -       float cx, cy, sweep */
+#define WD_APITRACE_OP_ADDBEZIER            40  /* sink         -       float x0, y0, x1, y1, x2, y2 */
+#define WD_APITRACE_OP_ADDLINES             41  /* sink         -       UINT32 n; WD_POINT points[n] */
+#define WD_APITRACE_OP_ADDBEZIERS           42  /* sink         -       UINT32 n; WD_POINT points[3*n] */
+
+#define WD_APITRACE_OP_CREATEIMAGE          50  /* image        -       wd_apitrace_image_t, palette, buffer */
+#define WD_APITRACE_OP_DESTROYIMAGE         51  /* image */
+#define WD_APITRACE_OP_CREATECACHEDIMAGE    52  /* cached image canvas  UINT64 image */
+#define WD_APITRACE_OP_DESTROYCACHEDIMAGE   53  /* cached image */
+
+#define WD_APITRACE_OP_CREATEMESH           60  /* mesh         canvas  UINT64 path */
+#define WD_APITRACE_OP_DESTROYMESH          61  /* mesh */
+#define WD_APITRACE_OP_CREATEPATHMASK       62  /* mask         canvas  wd_apitrace_pathmask_t */
+#define WD_APITRACE_OP_DESTROYPATHMASK      63  /* mask */
+
+#define WD_APITRACE_OP_CREATEFONT           70  /* font         -       LOGFONTW */
+#define WD_APITRACE_OP_DESTROYFONT          71  /* font */
+#define WD_APITRACE_OP_CREATETEXTLAYOUT     72  /* layout       font    wd_apitrace_textlayout_t, text */
+#define WD_APITRACE_OP_DESTROYTEXTLAYOUT    73  /* layout */
+
+#define WD_APITRACE_OP_BEGINRECORDING       80  /* canvas */
+#define WD_APITRACE_OP_ENDRECORDING         81  /* list         canvas */
+#define WD_APITRACE_OP_DESTROYDISPLAYLIST   82  /* list */
+
+
+#ifdef WD_APITRACE
+
+/* Start tracing into a file given by the environment variable WD_APITRACE
+ * (if set), and stop it, respectively. Called by wdInitialize() and
+ * wdTerminate(). */
+void wd_apitrace_autostart(void);
+void wd_apitrace_autostop(void);
+
+/* Called by the canvas constructors. If tracing, installs the hook so the
+ * drawing calls on the canvas get to wd_apitrace_cmd(). */
+void wd_apitrace_canvas(WD_HCANVAS hCanvas, UINT width, UINT height, DWORD flags);
+
+/* Record with no args. */
+void wd_apitrace_handle(WORD op, const void* handle);
+
+/* Generic record. Any of args, data0 and data1 may be NULL. */
+void wd_apitrace_create(WORD op, const void* handle, const void* owner,
+                        const void* args, UINT args_size,
+                        const void* data0, UINT data0_size,
+                        const void* data1, UINT data1_size);
+
+void wd_apitrace_image(WD_HIMAGE hImage, UINT width, UINT height, UINT stride,
+                       const BYTE* buffer, int format, const COLORREF* palette,
+                       UINT palette_size);
+
+void wd_apitrace_cmd(WD_HCANVAS hCanvas, const wd_cmd_t* cmd);
+
+#else
+
+static inline void
+wd_apitrace_autostart(void)
+{ }
+
+static inline void
+wd_apitrace_autostop(void)
+{ }
+
+static inline void
+wd_apitrace_canvas(WD_HCANVAS hCanvas, UINT width, UINT height, DWORD flags)
+{ }
+
+static inline void
+wd_apitrace_handle(WORD op, const void* handle)
+{ }
+
+static inline void
+wd_apitrace_create(WORD op, const void* handle, const void* owner,
+                   const void* args, UINT args_size,
+                   const void* data0, UINT data0_size,
+                   const void* data1, UINT data1_size)
+{ }
+
+static inline void
+wd_apitrace_image(WD_HIMAGE hImage, UINT width, UINT height, UINT stride,
+                  const BYTE* buffer, int format, const COLORREF* palette,
+                  UINT palette_size)
+{ }
+
+static inline void
+wd_apitrace_cmd(WD_HCANVAS hCanvas, const wd_cmd_t* cmd)
+{ }
+
+#endif  /* WD_APITRACE */
+
+
+#endif  /* WD_APITRACE_H */
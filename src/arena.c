@@ -0,0 +1,97 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "arena.h"
+
+
+#define WD_ARENA_BLOCK_SIZE     4096
+
+/* Keep all allocations aligned for any type we may store in the arena. */
+#define WD_ARENA_ALIGN(size)    (((size) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+
+void*
+wd_arena_alloc(wd_arena_t* arena, size_t size)
+{
+    wd_arena_block_t* block = arena->cur;
+    void* ptr;
+
+    size = WD_ARENA_ALIGN(size);
+
+    /* Move through the blocks kept by wd_arena_reset() before allocating a
+     * new one, so an arena refilled to the same size allocates nothing. */
+    while(block != NULL  &&  block->used + size > block->size  &&  block->next != NULL)
+        block = block->next;
+
+    if(block == NULL  ||  block->used + size > block->size) {
+        size_t block_size = WD_MAX(WD_ARENA_BLOCK_SIZE, size);
+        wd_arena_block_t* new_block;
+
+        new_block = (wd_arena_block_t*) malloc(
+                    WD_ARENA_ALIGN(sizeof(wd_arena_block_t)) + block_size);
+        if(new_block == NULL) {
+            WD_TRACE("wd_arena_alloc: malloc() failed.");
+            return NULL;
+        }
+
+        new_block->size = block_size;
+        new_block->used = 0;
+        new_block->next = NULL;
+        if(block != NULL)
+            block->next = new_block;
+        else
+            arena->head = new_block;
+        block = new_block;
+        arena->n_blocks++;
+    }
+
+    arena->cur = block;
+    ptr = ((BYTE*) block) + WD_ARENA_ALIGN(sizeof(wd_arena_block_t)) + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void
+wd_arena_fini(wd_arena_t* arena)
+{
+    wd_arena_block_t* block = arena->head;
+    wd_arena_block_t* next;
+
+    while(block != NULL) {
+        next = block->next;
+        free(block);
+        block = next;
+    }
+
+    wd_arena_init(arena);
+}
+
+void
+wd_arena_reset(wd_arena_t* arena)
+{
+    wd_arena_block_t* block;
+
+    for(block = arena->head; block != NULL; block = block->next)
+        block->used = 0;
+    arena->cur = arena->head;
+}
@@ -0,0 +1,69 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_ARENA_H
+#define WD_ARENA_H
+
+#include "misc.h"
+
+
+/* Simple grow-only memory arena. Allocations are never freed individually;
+ * everything is released at once by wd_arena_fini().
+ *
+ * The blocks form a chain in the order they have been allocated, and the
+ * allocations fill them in that order. wd_arena_reset() keeps the whole
+ * chain, so an arena filled again and again to about the same size (e.g. a
+ * display list recorded on every frame) reaches its steady state after the
+ * first cycle and does not allocate anymore. */
+
+typedef struct wd_arena_block_tag wd_arena_block_t;
+struct wd_arena_block_tag {
+    wd_arena_block_t* next;
+    size_t size;
+    size_t used;
+};
+
+typedef struct wd_arena_tag wd_arena_t;
+struct wd_arena_tag {
+    wd_arena_block_t* head;     /* First block of the chain. */
+    wd_arena_block_t* cur;      /* Block being filled. */
+    UINT n_blocks;              /* Count of blocks ever allocated. */
+};
+
+
+static inline void
+wd_arena_init(wd_arena_t* arena)
+{
+    arena->head = NULL;
+    arena->cur = NULL;
+    arena->n_blocks = 0;
+}
+
+void* wd_arena_alloc(wd_arena_t* arena, size_t size);
+void wd_arena_fini(wd_arena_t* arena);
+
+/* Forget all the allocations but keep all the blocks for the reuse. */
+void wd_arena_reset(wd_arena_t* arena);
+
+
+#endif  /* WD_ARENA_H */
@@ -111,6 +111,7 @@ d2d_canvas_alloc(c_ID2D1RenderTarget* target, WORD type, UINT width, BOOL rtl)
     c->type = type;
     c->flags = (rtl ? D2D_CANVASFLAG_RTL : 0);
     c->width = width;
+    c->serial = wd_canvas_new_serial();
     c->target = target;
 
     /* We use raw pixels as units. D2D by default works with DIPs ("device
@@ -135,6 +136,9 @@ d2d_reset_clip(d2d_canvas_t* c)
         c_ID2D1RenderTarget_PopAxisAlignedClip(c->target);
         c->flags &= ~D2D_CANVASFLAG_RECTCLIP;
     }
+
+    c->cull.has_clip = FALSE;
+    c->cull.valid = FALSE;
 }
 
 void
@@ -25,6 +25,9 @@
 #define WD_BACKEND_D2D_H
 
 #include "misc.h"
+#include "hook.h"
+#include "cull.h"
+#include "intern.h"
 #include <c-d2d1.h>
 
 
@@ -34,15 +37,18 @@
 
 #define D2D_CANVASFLAG_RECTCLIP     0x1
 #define D2D_CANVASFLAG_RTL          0x2
+#define D2D_CANVASFLAG_NEARESTIMAGE 0x4     /* WD_INTERPOLATION_NEAREST */
 
 #define D2D_BASEDELTA_X             0.5f
 #define D2D_BASEDELTA_Y             0.5f
 
 typedef struct d2d_canvas_tag d2d_canvas_t;
 struct d2d_canvas_tag {
+    wd_hook_t* hook;    /* Must be the first member (see hook.h). */
     WORD type;
     WORD flags;
     UINT width;
+    UINT serial;        /* See wd_canvas_serial(). */
     union {
         c_ID2D1RenderTarget* target;
         c_ID2D1BitmapRenderTarget* bmp_target;
@@ -50,6 +56,16 @@ struct d2d_canvas_tag {
     };
     c_ID2D1GdiInteropRenderTarget* gdi_interop;
     c_ID2D1Layer* clip_layer;
+    wd_cull_t cull;
+    wd_intern_t* intern;    /* Shared resources (see intern.h). */
+};
+
+/* Cached path mask (see wdCreateCachedPathMask()). The rectangle is where
+ * the bitmap has to be painted, in the coordinates of the original path. */
+typedef struct d2d_pathmask_tag d2d_pathmask_t;
+struct d2d_pathmask_tag {
+    c_ID2D1Bitmap* bitmap;
+    c_D2D1_RECT_F rect;
 };
 
 
@@ -70,6 +86,14 @@ d2d_init_color(c_D2D1_COLOR_F* c, WD_COLOR color)
     c->a = WD_AVALUE(color) / 255.0f;
 }
 
+static inline c_D2D1_BITMAP_INTERPOLATION_MODE
+d2d_interpolation_mode(d2d_canvas_t* c)
+{
+    return ((c->flags & D2D_CANVASFLAG_NEARESTIMAGE) ?
+                c_D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR :
+                c_D2D1_BITMAP_INTERPOLATION_MODE_LINEAR);
+}
+
 int d2d_init(void);
 void d2d_fini(void);
 
@@ -84,6 +108,11 @@ void d2d_apply_transform(d2d_canvas_t* c, const c_D2D1_MATRIX_3X2_F* matrix);
  * the original transformation then-after. */
 void d2d_disable_rtl_transform(d2d_canvas_t* c, c_D2D1_MATRIX_3X2_F* old_matrix);
 
+/* Rasterize the geometry into an opacity mask (see wdCreateCachedPathMask()). */
+d2d_pathmask_t* d2d_create_pathmask(d2d_canvas_t* c, c_ID2D1Geometry* g,
+                                    float fScale, DWORD dwFlags);
+void d2d_destroy_pathmask(d2d_pathmask_t* mask);
+
 void d2d_setup_arc_segment(c_D2D1_ARC_SEGMENT* arc_seg,
                            float cx, float cy, float rx, float ry,
                     float base_angle, float sweep_angle);
@@ -22,12 +22,21 @@
  */
 
 #include "backend-dwrite.h"
+#include "lock.h"
 
 
 static HMODULE dwrite_dll;
 
 c_IDWriteFactory* dwrite_factory = NULL;
 
+UINT dwrite_layout_hits = 0;
+UINT dwrite_layout_misses = 0;
+
+UINT dwrite_layout_limit = DWRITE_LAYOUT_CACHE_DEFAULT;
+
+/* Count of the layouts in the caches of all fonts. */
+static LONG dwrite_layout_count = 0;
+
 
 static int (WINAPI* fn_GetUserDefaultLocaleName)(WCHAR*, int) = NULL;
 
@@ -105,7 +114,7 @@ dwrite_default_user_locale(WCHAR buffer[LOCALE_NAME_MAX_LENGTH])
 
 c_IDWriteTextFormat*
 dwrite_create_text_format(const WCHAR* locale_name, const LOGFONTW* logfont,
-                          c_DWRITE_FONT_METRICS* metrics)
+                          c_DWRITE_FONT_METRICS* metrics, c_IDWriteFontFace** face)
 {
     /* See https://github.com/Microsoft/Windows-classic-samples/blob/master/Samples/Win7Samples/multimedia/DirectWrite/RenderTest/TextHelpers.cpp */
 
@@ -188,6 +197,15 @@ dwrite_create_text_format(const WCHAR* locale_name, const LOGFONTW* logfont,
         goto err_IDWriteFactory_CreateTextFormat;
     }
 
+    /* The font face is needed only by dwrite_measure_simple(), which falls
+     * back to a text layout without it. So its failure is not fatal. */
+    hr = c_IDWriteFont_CreateFontFace(font, face);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("dwrite_create_text_format: "
+                    "IDWriteFont::CreateFontFace() failed.");
+        *face = NULL;
+    }
+
 err_IDWriteFactory_CreateTextFormat:
 err_IDWriteLocalizedStrings_GetString:
     _freea(family_name_buffer);
@@ -204,10 +222,44 @@ err_IDWriteFactory_GetGdiInterop:
     return tf;
 }
 
+static c_IDWriteInlineObject*
+dwrite_font_trim_sign(dwrite_font_t* font)
+{
+    c_IDWriteInlineObject* trim_sign;
+    HRESULT hr;
+
+    wd_lock();
+    trim_sign = font->trim_sign;
+    wd_unlock();
+    if(trim_sign != NULL)
+        return trim_sign;
+
+    hr = c_IDWriteFactory_CreateEllipsisTrimmingSign(dwrite_factory, font->tf, &trim_sign);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("dwrite_font_trim_sign: "
+                    "IDWriteFactory::CreateEllipsisTrimmingSign() failed.");
+        return NULL;
+    }
+
+    wd_lock();
+    if(font->trim_sign == NULL) {
+        font->trim_sign = trim_sign;
+        trim_sign = NULL;
+    }
+    wd_unlock();
+
+    /* Another thread might have been faster. */
+    if(trim_sign != NULL)
+        c_IDWriteInlineObject_Release(trim_sign);
+
+    return font->trim_sign;
+}
+
 c_IDWriteTextLayout*
-dwrite_create_text_layout(c_IDWriteTextFormat* tf, const WD_RECT* rect,
+dwrite_create_text_layout(dwrite_font_t* font, const WD_RECT* rect,
                           const WCHAR* str, int len, DWORD flags)
 {
+    c_IDWriteTextFormat* tf = font->tf;
     c_IDWriteTextLayout* layout;
     HRESULT hr;
     int tla;
@@ -242,6 +294,11 @@ dwrite_create_text_layout(c_IDWriteTextFormat* tf, const WD_RECT* rect,
     if(flags & WD_STR_NOWRAP)
         c_IDWriteTextLayout_SetWordWrapping(layout, c_DWRITE_WORD_WRAPPING_NO_WRAP);
 
+    if(flags & DWRITE_LAYOUT_RTL) {
+        c_IDWriteTextLayout_SetReadingDirection(layout,
+                c_DWRITE_READING_DIRECTION_RIGHT_TO_LEFT);
+    }
+
     if((flags & WD_STR_ELLIPSISMASK) != 0) {
         static const c_DWRITE_TRIMMING trim_end = { c_DWRITE_TRIMMING_GRANULARITY_CHARACTER, 0, 0 };
         static const c_DWRITE_TRIMMING trim_word = { c_DWRITE_TRIMMING_GRANULARITY_WORD, 0, 0 };
@@ -250,11 +307,11 @@ dwrite_create_text_layout(c_IDWriteTextFormat* tf, const WD_RECT* rect,
         const c_DWRITE_TRIMMING* trim_options = NULL;
         c_IDWriteInlineObject* trim_sign;
 
-        hr = c_IDWriteFactory_CreateEllipsisTrimmingSign(dwrite_factory, tf, &trim_sign);
-        if(FAILED(hr)) {
-            WD_TRACE_HR("dwrite_create_text_layout: "
-                        "IDWriteFactory::CreateEllipsisTrimmingSign() failed.");
-            goto err_CreateEllipsisTrimmingSign;
+        trim_sign = dwrite_font_trim_sign(font);
+        if(trim_sign == NULL) {
+            WD_TRACE("dwrite_create_text_layout: "
+                     "dwrite_font_trim_sign() failed.");
+            goto err_trim_sign;
         }
 
         switch(flags & WD_STR_ELLIPSISMASK) {
@@ -265,10 +322,402 @@ dwrite_create_text_layout(c_IDWriteTextFormat* tf, const WD_RECT* rect,
 
         if(trim_options != NULL)
             c_IDWriteTextLayout_SetTrimming(layout, trim_options, trim_sign);
-
-        c_IDWriteInlineObject_Release(trim_sign);
     }
 
-err_CreateEllipsisTrimmingSign:
+err_trim_sign:
     return layout;
 }
+
+/* FNV-1a */
+static UINT32
+dwrite_layout_hash(const WCHAR* str, UINT32 len)
+{
+    const BYTE* bytes = (const BYTE*) str;
+    UINT32 hash = 2166136261U;
+    UINT i;
+
+    for(i = 0; i < len * sizeof(WCHAR); i++) {
+        hash ^= bytes[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static inline BOOL
+dwrite_layout_match(const dwrite_layout_t* a, const dwrite_layout_t* b, const WCHAR* b_str)
+{
+    return (a->hash == b->hash  &&  a->len == b->len  &&  a->flags == b->flags  &&
+            a->width == b->width  &&  a->height == b->height  &&
+            memcmp(a->str, b_str, a->len * sizeof(WCHAR)) == 0);
+}
+
+/* Called with font->layout_lock held. */
+static void
+dwrite_layout_unlink(dwrite_font_t* font, dwrite_layout_t* e)
+{
+    dwrite_layout_t** pp;
+
+    pp = &font->layout_buckets[e->hash & (font->layout_n_buckets - 1)];
+    while(*pp != e)
+        pp = &(*pp)->next;
+    *pp = e->next;
+
+    if(e->lru_prev != NULL)
+        e->lru_prev->lru_next = e->lru_next;
+    else
+        font->layout_lru_head = e->lru_next;
+    if(e->lru_next != NULL)
+        e->lru_next->lru_prev = e->lru_prev;
+    else
+        font->layout_lru_tail = e->lru_prev;
+
+    font->layout_n--;
+    InterlockedDecrement(&dwrite_layout_count);
+}
+
+/* Called with font->layout_lock held. Keep the load factor of the hash table
+ * at most 1. Returns FALSE if the table cannot be used. */
+static BOOL
+dwrite_layout_grow(dwrite_font_t* font)
+{
+    dwrite_layout_t** buckets;
+    dwrite_layout_t* e;
+    UINT n_buckets;
+    UINT i;
+
+    if(font->layout_n < font->layout_n_buckets)
+        return TRUE;
+
+    n_buckets = (font->layout_n_buckets > 0 ? 2 * font->layout_n_buckets : 64);
+    buckets = (dwrite_layout_t**) malloc(n_buckets * sizeof(dwrite_layout_t*));
+    if(buckets == NULL) {
+        WD_TRACE("dwrite_layout_grow: malloc() failed.");
+        /* Overfilled table still works, just slower. */
+        return (font->layout_n_buckets > 0);
+    }
+    memset(buckets, 0, n_buckets * sizeof(dwrite_layout_t*));
+
+    for(i = 0; i < font->layout_n_buckets; i++) {
+        while(font->layout_buckets[i] != NULL) {
+            e = font->layout_buckets[i];
+            font->layout_buckets[i] = e->next;
+            e->next = buckets[e->hash & (n_buckets - 1)];
+            buckets[e->hash & (n_buckets - 1)] = e;
+        }
+    }
+
+    free(font->layout_buckets);
+    font->layout_buckets = buckets;
+    font->layout_n_buckets = n_buckets;
+    return TRUE;
+}
+
+c_IDWriteTextLayout*
+dwrite_acquire_text_layout(dwrite_font_t* font, const WD_RECT* rect,
+                           const WCHAR* str, int len, DWORD flags,
+                           dwrite_layout_t* entry)
+{
+    dwrite_layout_t* e;
+
+    if(len < 0)
+        len = wcslen(str);
+
+    memset(entry, 0, sizeof(dwrite_layout_t));
+    entry->len = len;
+    entry->width = rect->x1 - rect->x0;
+    entry->height = rect->y1 - rect->y0;
+    entry->flags = flags;
+
+    if(len <= DWRITE_LAYOUT_CACHE_MAXLEN) {
+        entry->hash = dwrite_layout_hash(str, len);
+
+        EnterCriticalSection(&font->layout_lock);
+        e = NULL;
+        if(font->layout_n_buckets > 0) {
+            e = font->layout_buckets[entry->hash & (font->layout_n_buckets - 1)];
+            while(e != NULL  &&  !dwrite_layout_match(e, entry, str))
+                e = e->next;
+        }
+        if(e != NULL) {
+            /* Take it out of the cache while the caller uses it. */
+            dwrite_layout_unlink(font, e);
+            entry->layout = e->layout;
+            entry->str = e->str;
+            e->next = font->layout_free;
+            font->layout_free = e;
+            LeaveCriticalSection(&font->layout_lock);
+            InterlockedIncrement((LONG*) &dwrite_layout_hits);
+            return entry->layout;
+        }
+        LeaveCriticalSection(&font->layout_lock);
+        InterlockedIncrement((LONG*) &dwrite_layout_misses);
+    }
+
+    entry->layout = dwrite_create_text_layout(font, rect, str, len, flags);
+    return entry->layout;
+}
+
+void
+dwrite_release_text_layout(dwrite_font_t* font, const WCHAR* str,
+                           dwrite_layout_t* entry)
+{
+    dwrite_layout_t* victims = NULL;
+    dwrite_layout_t* e;
+
+    if(entry->layout == NULL)
+        return;
+
+    if(entry->len > DWRITE_LAYOUT_CACHE_MAXLEN  ||  dwrite_layout_limit == 0)
+        goto no_cache;
+
+    if(entry->str == NULL) {
+        /* A new layout. Make a copy of the string for the cache key. */
+        entry->str = (WCHAR*) malloc((entry->len + 1) * sizeof(WCHAR));
+        if(entry->str == NULL) {
+            WD_TRACE("dwrite_release_text_layout: malloc() failed.");
+            goto no_cache;
+        }
+        memcpy(entry->str, str, entry->len * sizeof(WCHAR));
+    }
+
+    EnterCriticalSection(&font->layout_lock);
+
+    if(font->layout_n_buckets > 0) {
+        e = font->layout_buckets[entry->hash & (font->layout_n_buckets - 1)];
+        while(e != NULL  &&  !dwrite_layout_match(e, entry, entry->str))
+            e = e->next;
+        if(e != NULL) {
+            /* Another thread has put the same layout back in the meantime. */
+            LeaveCriticalSection(&font->layout_lock);
+            goto no_cache;
+        }
+    }
+
+    /* Make room by evicting the least recently used layouts of this font.
+     * (The limit is shared by all fonts, so if this one has nothing to evict,
+     * the layout is not cached.) */
+    while((UINT) dwrite_layout_count >= dwrite_layout_limit  &&
+          font->layout_lru_tail != NULL)
+    {
+        e = font->layout_lru_tail;
+        dwrite_layout_unlink(font, e);
+        e->next = victims;
+        victims = e;
+    }
+
+    e = font->layout_free;
+    if(e != NULL)
+        font->layout_free = e->next;
+    else
+        e = (dwrite_layout_t*) malloc(sizeof(dwrite_layout_t));
+
+    if(e == NULL  ||  (UINT) dwrite_layout_count >= dwrite_layout_limit  ||
+       !dwrite_layout_grow(font))
+    {
+        if(e != NULL) {
+            e->next = font->layout_free;
+            font->layout_free = e;
+        }
+        LeaveCriticalSection(&font->layout_lock);
+        goto no_cache;
+    }
+
+    memcpy(e, entry, sizeof(dwrite_layout_t));
+    e->next = font->layout_buckets[e->hash & (font->layout_n_buckets - 1)];
+    font->layout_buckets[e->hash & (font->layout_n_buckets - 1)] = e;
+    e->lru_prev = NULL;
+    e->lru_next = font->layout_lru_head;
+    if(font->layout_lru_head != NULL)
+        font->layout_lru_head->lru_prev = e;
+    else
+        font->layout_lru_tail = e;
+    font->layout_lru_head = e;
+    font->layout_n++;
+    InterlockedIncrement(&dwrite_layout_count);
+
+    LeaveCriticalSection(&font->layout_lock);
+    goto release_victims;
+
+no_cache:
+    c_IDWriteTextLayout_Release(entry->layout);
+    free(entry->str);
+
+release_victims:
+    while(victims != NULL) {
+        e = victims;
+        victims = e->next;
+        c_IDWriteTextLayout_Release(e->layout);
+        free(e->str);
+        free(e);
+    }
+}
+
+/* Special values in dwrite_font_t::advances[]. */
+#define DWRITE_ADVANCE_UNKNOWN      0xffff  /* Not yet retrieved. */
+#define DWRITE_ADVANCE_NOGLYPH      0xfffe  /* Needs a font fallback. */
+#define DWRITE_ADVANCE_MAX          0xfffd
+
+/* Characters which DirectWrite lays out one glyph per character, i.e. with no
+ * shaping except kerning and (optional) ligatures. Anything else goes through
+ * a real text layout. */
+static const struct {
+    WCHAR from;
+    WCHAR to;
+} dwrite_simple_ranges[] = {
+    { 0x0020, 0x007e },     /* ASCII */
+    { 0x00a0, 0x00ac },     /* Latin-1 (skipping the soft hyphen) */
+    { 0x00ae, 0x02ff },     /* Latin-1, Latin Extended, IPA, modifier letters */
+    { 0x0370, 0x0482 },     /* Greek, Cyrillic */
+    { 0x048a, 0x052f },     /* Cyrillic */
+    { 0x1e00, 0x1fff },     /* Latin Extended Additional, Greek Extended */
+    { 0x2000, 0x200a },     /* Spaces */
+    { 0x2010, 0x2027 },     /* Punctuation */
+    { 0x2030, 0x205e },     /* Punctuation */
+    { 0x20a0, 0x20bf },     /* Currency symbols */
+    { 0x2100, 0x218f }      /* Letterlike symbols, number forms */
+};
+
+static BOOL
+dwrite_is_simple_char(WCHAR ch)
+{
+    int i;
+
+    for(i = 0; i < WD_SIZEOF_ARRAY(dwrite_simple_ranges); i++) {
+        if(ch < dwrite_simple_ranges[i].from)
+            return FALSE;
+        if(ch <= dwrite_simple_ranges[i].to)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Called with the lock held. */
+static UINT16
+dwrite_font_advance(dwrite_font_t* font, WCHAR ch)
+{
+    UINT16* page = font->advances[ch >> 8];
+    UINT32 code_point = ch;
+    UINT16 glyph;
+    c_DWRITE_GLYPH_METRICS gm;
+    HRESULT hr;
+
+    if(page == NULL) {
+        page = (UINT16*) malloc(256 * sizeof(UINT16));
+        if(page == NULL) {
+            WD_TRACE("dwrite_font_advance: malloc() failed.");
+            return DWRITE_ADVANCE_UNKNOWN;
+        }
+        memset(page, 0xff, 256 * sizeof(UINT16));
+        font->advances[ch >> 8] = page;
+    }
+
+    if(page[ch & 0xff] != DWRITE_ADVANCE_UNKNOWN)
+        return page[ch & 0xff];
+
+    hr = c_IDWriteFontFace_GetGlyphIndices(font->face, &code_point, 1, &glyph);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("dwrite_font_advance: "
+                    "IDWriteFontFace::GetGlyphIndices() failed.");
+        return DWRITE_ADVANCE_UNKNOWN;
+    }
+
+    if(glyph == 0) {
+        page[ch & 0xff] = DWRITE_ADVANCE_NOGLYPH;
+    } else {
+        hr = c_IDWriteFontFace_GetDesignGlyphMetrics(font->face, &glyph, 1, &gm, FALSE);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("dwrite_font_advance: "
+                        "IDWriteFontFace::GetDesignGlyphMetrics() failed.");
+            return DWRITE_ADVANCE_UNKNOWN;
+        }
+        page[ch & 0xff] = (UINT16) WD_MIN(gm.advanceWidth, DWRITE_ADVANCE_MAX);
+    }
+
+    return page[ch & 0xff];
+}
+
+BOOL
+dwrite_measure_simple(dwrite_font_t* font, const WCHAR* str, int len,
+                      float* width)
+{
+    UINT64 sum = 0;
+    UINT16 advance;
+    int i;
+
+    if(font->face == NULL)
+        return FALSE;
+
+    if(len < 0)
+        len = wcslen(str);
+
+    /* The layout metrics do not include the trailing white space. */
+    while(len > 0  &&  (str[len-1] == L' '  ||
+                (str[len-1] >= 0x2000  &&  str[len-1] <= 0x200a)))
+        len--;
+
+    for(i = 0; i < len; i++) {
+        if(!dwrite_is_simple_char(str[i]))
+            return FALSE;
+    }
+
+    wd_lock();
+    for(i = 0; i < len; i++) {
+        advance = dwrite_font_advance(font, str[i]);
+        if(advance > DWRITE_ADVANCE_MAX) {
+            wd_unlock();
+            return FALSE;
+        }
+        sum += advance;
+    }
+    wd_unlock();
+
+    *width = (float) sum * c_IDWriteTextFormat_GetFontSize(font->tf)
+                / (float) font->metrics.designUnitsPerEm;
+    return TRUE;
+}
+
+void
+dwrite_font_init(dwrite_font_t* font)
+{
+    InitializeCriticalSection(&font->layout_lock);
+}
+
+void
+dwrite_font_cleanup(dwrite_font_t* font)
+{
+    dwrite_layout_t* e;
+    UINT i;
+
+    while(font->layout_lru_head != NULL) {
+        e = font->layout_lru_head;
+        dwrite_layout_unlink(font, e);
+        c_IDWriteTextLayout_Release(e->layout);
+        free(e->str);
+        free(e);
+    }
+    while(font->layout_free != NULL) {
+        e = font->layout_free;
+        font->layout_free = e->next;
+        free(e);
+    }
+    free(font->layout_buckets);
+    font->layout_buckets = NULL;
+    font->layout_n_buckets = 0;
+    DeleteCriticalSection(&font->layout_lock);
+
+    if(font->trim_sign != NULL) {
+        c_IDWriteInlineObject_Release(font->trim_sign);
+        font->trim_sign = NULL;
+    }
+
+    for(i = 0; i < WD_SIZEOF_ARRAY(font->advances); i++) {
+        free(font->advances[i]);
+        font->advances[i] = NULL;
+    }
+
+    if(font->face != NULL) {
+        c_IDWriteFontFace_Release(font->face);
+        font->face = NULL;
+    }
+}
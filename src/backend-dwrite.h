@@ -31,24 +31,109 @@
 extern c_IDWriteFactory* dwrite_factory;
 
 
+/* Each font keeps a cache of the text layouts recently used by wdDrawString()
+ * and wdMeasureString(), so that repainting the same strings (e.g. cells of a
+ * table) does not need to lay them out again and again.
+ *
+ * The cache is a hash table with a LRU list, guarded by a lock of the font
+ * (not the global one). The count of the layouts cached by all fonts together
+ * is limited (see wdSetTextCacheLimit()); the default is enough for a screen
+ * full of small table cells. */
+#define DWRITE_LAYOUT_CACHE_DEFAULT 8192
+
+/* Longer strings are never cached. */
+#define DWRITE_LAYOUT_CACHE_MAXLEN  512
+
+/* Internal flag for dwrite_create_text_layout(), in addition to WD_STR_xxx:
+ * The layout is for the right-to-left reading direction. */
+#define DWRITE_LAYOUT_RTL           0x80000000
+
+typedef struct dwrite_layout_tag dwrite_layout_t;
+struct dwrite_layout_tag {
+    c_IDWriteTextLayout* layout;
+    WCHAR* str;                     /* Copy of the text owned by the cache. */
+    UINT32 hash;
+    UINT32 len;
+    float width;
+    float height;
+    DWORD flags;
+    dwrite_layout_t* next;          /* Next in the hash bucket. */
+    dwrite_layout_t* lru_prev;      /* Towards the most recently used. */
+    dwrite_layout_t* lru_next;      /* Towards the least recently used. */
+};
+
 typedef struct dwrite_font_tag dwrite_font_t;
 struct dwrite_font_tag {
     c_IDWriteTextFormat* tf;
     c_DWRITE_FONT_METRICS metrics;
+
+    /* Created on demand, shared by all the layouts with an ellipsis. */
+    c_IDWriteInlineObject* trim_sign;
+
+    /* The layout cache. Free nodes are kept in a list for reuse. */
+    CRITICAL_SECTION layout_lock;
+    dwrite_layout_t** layout_buckets;
+    UINT layout_n_buckets;          /* Power of 2, or zero. */
+    UINT layout_n;
+    dwrite_layout_t* layout_lru_head;
+    dwrite_layout_t* layout_lru_tail;
+    dwrite_layout_t* layout_free;
+
+    /* For dwrite_measure_simple(): The font face (may be NULL) and design
+     * advances of the characters, in pages of 256 characters allocated on
+     * demand. */
+    c_IDWriteFontFace* face;
+    UINT16* advances[256];
 };
 
 
+/* Statistics of the layout caches of all fonts (see wdGetTextCacheStats()). */
+extern UINT dwrite_layout_hits;
+extern UINT dwrite_layout_misses;
+
+/* Max. count of layouts in the caches of all fonts together. */
+extern UINT dwrite_layout_limit;
+
+
 int dwrite_init(void);
 void dwrite_fini(void);
 
 void dwrite_default_user_locale(WCHAR buffer[LOCALE_NAME_MAX_LENGTH]);
 
 c_IDWriteTextFormat* dwrite_create_text_format(const WCHAR* locale_name,
-            const LOGFONTW* logfont, c_DWRITE_FONT_METRICS* metrics);
+            const LOGFONTW* logfont, c_DWRITE_FONT_METRICS* metrics,
+            c_IDWriteFontFace** face);
 
-c_IDWriteTextLayout* dwrite_create_text_layout(c_IDWriteTextFormat* tf,
+c_IDWriteTextLayout* dwrite_create_text_layout(dwrite_font_t* font,
             const WD_RECT* rect, const WCHAR* str, int len, DWORD flags);
 
+/* Get a layout for the string, either from the cache of the font or a newly
+ * created one. The caller has an exclusive access to it until it passes it
+ * to dwrite_release_text_layout(), which (possibly) puts it back into the
+ * cache. So the caller must not change the layout in any way which is not
+ * reflected by the key (text, rect size and flags). */
+c_IDWriteTextLayout* dwrite_acquire_text_layout(dwrite_font_t* font,
+            const WD_RECT* rect, const WCHAR* str, int len, DWORD flags,
+            dwrite_layout_t* entry);
+void dwrite_release_text_layout(dwrite_font_t* font, const WCHAR* str,
+            dwrite_layout_t* entry);
+
+/* Measure width of a single-line string by summing the (cached) design
+ * advances of its glyphs, without creating any text layout. Returns FALSE if
+ * the string needs a real layout, i.e. if it contains a character which
+ * needs shaping (complex scripts, combining marks, bidi controls), a control
+ * character or a character the font has no glyph for. */
+BOOL dwrite_measure_simple(dwrite_font_t* font, const WCHAR* str, int len,
+            float* width);
+
+/* Initialize a zeroed font structure, so it can be later released by
+ * dwrite_font_cleanup(). */
+void dwrite_font_init(dwrite_font_t* font);
+
+/* Release the layout cache and other resources of the font (but not the font
+ * itself). */
+void dwrite_font_cleanup(dwrite_font_t* font);
+
 
 #endif  /* WD_BACKEND_DWRITE_H */
 
@@ -25,6 +25,9 @@
 #define WD_BACKEND_GDIX_H
 
 #include "misc.h"
+#include "hook.h"
+#include "cull.h"
+#include "intern.h"
 #include <c-gdiplus.h>
 
 
@@ -37,8 +40,34 @@ struct gdix_strokestyle_tag {
   float dashes[1];
 };
 
+/* State last applied to the canvas pen. Custom dash patterns longer than
+ * GDIX_PENSTATE_MAXDASHES are never considered equal. */
+#define GDIX_PENSTATE_MAXDASHES     8
+
+typedef struct gdix_penstate_tag gdix_penstate_t;
+struct gdix_penstate_tag {
+    c_GpBrush* brush;
+    LONG brush_serial;
+    float width;
+    c_GpLineCap lineCap;
+    c_GpLineJoin lineJoin;
+    c_GpDashStyle dashStyle;
+    UINT dashesCount;
+    float dashes[GDIX_PENSTATE_MAXDASHES];
+};
+
+/* State last applied to the canvas string format. (-1 means unknown.) */
+typedef struct gdix_formatstate_tag gdix_formatstate_t;
+struct gdix_formatstate_tag {
+    int align;
+    int line_align;
+    int flags;
+    int trimming;
+};
+
 typedef struct gdix_canvas_tag gdix_canvas_t;
 struct gdix_canvas_tag {
+    wd_hook_t* hook;    /* Must be the first member (see hook.h). */
     HDC dc;
     c_GpGraphics* graphics;
     c_GpPen* pen;
@@ -46,6 +75,7 @@ struct gdix_canvas_tag {
     int dc_layout;
     UINT width  : 31;
     UINT rtl    :  1;
+    UINT serial;        /* See wd_canvas_serial(). */
 
     HDC real_dc;        /* non-NULL if double buffering is enabled. */
     HBITMAP orig_bmp;
@@ -53,6 +83,15 @@ struct gdix_canvas_tag {
     int y;
     int cx;
     int cy;
+
+    /* To avoid redundant calls of the pen and string format setters. */
+    gdix_penstate_t pen_state;
+    gdix_formatstate_t format_state;
+    UINT state_calls;
+    UINT state_calls_skipped;
+
+    wd_cull_t cull;
+    wd_intern_t* intern;    /* Shared resources (see intern.h). */
 };
 
 
@@ -73,20 +112,40 @@ struct gdix_vtable_tag {
     int (WINAPI* fn_SetPageUnit)(c_GpGraphics*, c_GpUnit);
     int (WINAPI* fn_SetPixelOffsetMode)(c_GpGraphics*, c_GpPixelOffsetMode);
     int (WINAPI* fn_SetSmoothingMode)(c_GpGraphics*, c_GpSmoothingMode);
+    int (WINAPI* fn_SetTextRenderingHint)(c_GpGraphics*, c_GpTextRenderingHint);
+    int (WINAPI* fn_SetInterpolationMode)(c_GpGraphics*, c_GpInterpolationMode);
+    int (WINAPI* fn_GetCompositingMode)(c_GpGraphics*, c_GpCompositingMode*);
+    int (WINAPI* fn_SetCompositingMode)(c_GpGraphics*, c_GpCompositingMode);
     int (WINAPI* fn_TranslateWorldTransform)(c_GpGraphics*, float, float, c_GpMatrixOrder);
     int (WINAPI* fn_MultiplyWorldTransform)(c_GpGraphics*, c_GpMatrix*, c_GpMatrixOrder);
     int (WINAPI* fn_CreateMatrix2)(float, float, float, float, float, float, c_GpMatrix**);
     int (WINAPI* fn_DeleteMatrix)(c_GpMatrix*);
+    int (WINAPI* fn_CreateMatrix)(c_GpMatrix**);
+    int (WINAPI* fn_GetMatrixElements)(const c_GpMatrix*, float*);
+    int (WINAPI* fn_SetMatrixElements)(c_GpMatrix*, float, float, float, float, float, float);
+    int (WINAPI* fn_GetWorldTransform)(c_GpGraphics*, c_GpMatrix*);
+    int (WINAPI* fn_GetVisibleClipBounds)(c_GpGraphics*, c_GpRectF*);
+    int (WINAPI* fn_SetWorldTransform)(c_GpGraphics*, c_GpMatrix*);
 
     /* Brush functions */
     int (WINAPI* fn_CreateSolidFill)(c_ARGB, c_GpSolidFill**);
     int (WINAPI* fn_DeleteBrush)(c_GpBrush*);
     int (WINAPI* fn_SetSolidFillColor)(c_GpSolidFill*, c_ARGB);
+    int (WINAPI* fn_GetBrushType)(c_GpBrush*, c_GpBrushType*);
+    int (WINAPI* fn_GetSolidFillColor)(c_GpSolidFill*, c_ARGB*);
     int (WINAPI* fn_CreateLineBrush)(const c_GpPointF*, const c_GpPointF*, c_ARGB, c_ARGB, c_GpWrapMode, c_GpLineGradient**);
     int (WINAPI* fn_CreatePathGradientFromPath)(const c_GpPath*, c_GpPathGradient**);
     int (WINAPI* fn_SetLinePresetBlend)(c_GpLineGradient*, const c_ARGB*, const float*, INT);
     int (WINAPI* fn_SetPathGradientPresetBlend)(c_GpPathGradient*, const c_ARGB*, const float*, INT);
     int (WINAPI* fn_SetPathGradientCenterPoint)(c_GpPathGradient*, const c_GpPointF*);
+    int (WINAPI* fn_GetPathGradientRect)(c_GpPathGradient*, c_GpRectF*);
+    int (WINAPI* fn_GetLineTransform)(c_GpLineGradient*, c_GpMatrix*);
+    int (WINAPI* fn_SetLineTransform)(c_GpLineGradient*, const c_GpMatrix*);
+    int (WINAPI* fn_GetPathGradientTransform)(c_GpPathGradient*, c_GpMatrix*);
+    int (WINAPI* fn_SetPathGradientTransform)(c_GpPathGradient*, c_GpMatrix*);
+    int (WINAPI* fn_CreateTexture)(c_GpImage*, c_GpWrapMode, c_GpTexture**);
+    int (WINAPI* fn_GetTextureTransform)(c_GpTexture*, c_GpMatrix*);
+    int (WINAPI* fn_SetTextureTransform)(c_GpTexture*, const c_GpMatrix*);
 
     /* Pen functions */
     int (WINAPI* fn_CreatePen1)(c_ARGB, float, c_GpUnit, c_GpPen**);
@@ -102,6 +161,7 @@ struct gdix_vtable_tag {
 
     /* Path functions */
     int (WINAPI* fn_CreatePath)(c_GpFillMode, c_GpPath**);
+    int (WINAPI* fn_AddPathEllipse)(c_GpPath*, float, float, float, float);
     int (WINAPI* fn_DeletePath)(c_GpPath*);
     int (WINAPI* fn_ClosePathFigure)(c_GpPath*);
     int (WINAPI* fn_StartPathFigure)(c_GpPath*);
@@ -109,6 +169,17 @@ struct gdix_vtable_tag {
     int (WINAPI* fn_AddPathArc)(c_GpPath*, float, float, float, float, float, float);
     int (WINAPI* fn_AddPathBezier)(c_GpPath*, float, float, float, float, float, float, float, float);
     int (WINAPI* fn_AddPathLine)(c_GpPath*, float, float, float, float);
+    int (WINAPI* fn_AddPathLine2)(c_GpPath*, const c_GpPointF*, INT);
+    int (WINAPI* fn_AddPathBeziers)(c_GpPath*, const c_GpPointF*, INT);
+    int (WINAPI* fn_ClonePath)(c_GpPath*, c_GpPath**);
+    int (WINAPI* fn_FlattenPath)(c_GpPath*, c_GpMatrix*, float);
+    int (WINAPI* fn_TransformPath)(c_GpPath*, c_GpMatrix*);
+    int (WINAPI* fn_GetPathWorldBounds)(c_GpPath*, c_GpRectF*, const c_GpMatrix*, const c_GpPen*);
+    int (WINAPI* fn_GetPointCount)(c_GpPath*, INT*);
+    int (WINAPI* fn_GetPathPoints)(c_GpPath*, c_GpPointF*, INT);
+    int (WINAPI* fn_GetPathTypes)(c_GpPath*, BYTE*, INT);
+    int (WINAPI* fn_IsVisiblePathPoint)(c_GpPath*, float, float, c_GpGraphics*, BOOL*);
+    int (WINAPI* fn_IsOutlineVisiblePathPoint)(c_GpPath*, float, float, c_GpPen*, c_GpGraphics*, BOOL*);
 
     /* Font functions */
     int (WINAPI* fn_CreateFontFromLogfontW)(HDC, const LOGFONTW*, c_GpFont**);
@@ -121,6 +192,7 @@ struct gdix_vtable_tag {
     int (WINAPI* fn_GetFontSize)(c_GpFont*, float*);
     int (WINAPI* fn_GetFontStyle)(c_GpFont*, int*);
     int (WINAPI* fn_GetLineSpacing)(const c_GpFont*, int, UINT16*);
+    int (WINAPI* fn_GetLogFontW)(c_GpFont*, c_GpGraphics*, LOGFONTW*);
 
     /* Image & bitmap functions */
     int (WINAPI* fn_LoadImageFromFile)(const WCHAR*, c_GpImage**);
@@ -130,6 +202,8 @@ struct gdix_vtable_tag {
     int (WINAPI* fn_DisposeImage)(c_GpImage*);
     int (WINAPI* fn_GetImageWidth)(c_GpImage*, UINT*);
     int (WINAPI* fn_GetImageHeight)(c_GpImage*, UINT*);
+    int (WINAPI* fn_GetImagePixelFormat)(c_GpImage*, c_GpPixelFormat*);
+    int (WINAPI* fn_CloneBitmapAreaI)(INT, INT, INT, INT, c_GpPixelFormat, c_GpBitmap*, c_GpBitmap**);
     int (WINAPI* fn_CreateBitmapFromScan0)(UINT, UINT, INT, c_GpPixelFormat, BYTE*, c_GpBitmap**);
     int (WINAPI* fn_BitmapLockBits)(c_GpBitmap*, const c_GpRectI*, UINT, c_GpPixelFormat, c_GpBitmapData*);
     int (WINAPI* fn_BitmapUnlockBits)(c_GpBitmap*, c_GpBitmapData*);
@@ -147,6 +221,12 @@ struct gdix_vtable_tag {
     int (WINAPI* fn_SetStringFormatLineAlign)(c_GpStringFormat*, c_GpStringAlignment);
     int (WINAPI* fn_SetStringFormatFlags)(c_GpStringFormat*, int);
     int (WINAPI* fn_SetStringFormatTrimming)(c_GpStringFormat*, c_GpStringTrimming);
+    int (WINAPI* fn_SetStringFormatMeasurableCharacterRanges)(c_GpStringFormat*, INT, const c_GpCharacterRange*);
+
+    /* Region functions */
+    int (WINAPI* fn_CreateRegion)(c_GpRegion**);
+    int (WINAPI* fn_DeleteRegion)(c_GpRegion*);
+    int (WINAPI* fn_GetRegionBounds)(c_GpRegion*, c_GpGraphics*, c_GpRectF*);
 
     /* Draw/fill functions */
     int (WINAPI* fn_DrawArc)(c_GpGraphics*, c_GpPen*, float, float, float, float, float, float);
@@ -157,17 +237,30 @@ struct gdix_vtable_tag {
     int (WINAPI* fn_DrawPath)(c_GpGraphics*, c_GpPen*, c_GpPath*);
     int (WINAPI* fn_DrawPie)(c_GpGraphics*, c_GpPen*, float, float, float, float, float, float);
     int (WINAPI* fn_DrawRectangle)(c_GpGraphics*, void*, float, float, float, float);
+    int (WINAPI* fn_DrawDriverString)(c_GpGraphics*, const UINT16*, int, const c_GpFont*, const c_GpBrush*, const c_GpPointF*, int, const c_GpMatrix*);
     int (WINAPI* fn_DrawString)(c_GpGraphics*, const WCHAR*, int, const c_GpFont*, const c_GpRectF*, const c_GpStringFormat*, const c_GpBrush*);
     int (WINAPI* fn_FillEllipse)(c_GpGraphics*, c_GpBrush*, float, float, float, float);
     int (WINAPI* fn_FillPath)(c_GpGraphics*, c_GpBrush*, c_GpPath*);
     int (WINAPI* fn_FillPie)(c_GpGraphics*, c_GpBrush*, float, float, float, float, float, float);
     int (WINAPI* fn_FillRectangle)(c_GpGraphics*, void*, float, float, float, float);
     int (WINAPI* fn_MeasureString)(c_GpGraphics*, const WCHAR*, int, const c_GpFont*, const c_GpRectF*, const c_GpStringFormat*, c_GpRectF*, int*, int*);
+    int (WINAPI* fn_MeasureCharacterRanges)(c_GpGraphics*, const WCHAR*, int, const c_GpFont*, const c_GpRectF*, const c_GpStringFormat*, INT, c_GpRegion**);
 };
 
 
 extern gdix_vtable_t* gdix_vtable;
 
+/* Incremented whenever any brush is modified or destroyed. GDI+ pen keeps its
+ * own copy of the brush so the pen has to be updated even if the brush handle
+ * is still the same. (Use gdix_brush_changed() to increment it.) */
+extern LONG gdix_brush_serial;
+
+static inline void
+gdix_brush_changed(void)
+{
+    InterlockedIncrement(&gdix_brush_serial);
+}
+
 static inline BOOL
 gdix_enabled(void)
 {
@@ -186,8 +279,17 @@ void gdix_rtl_transform(gdix_canvas_t* c);
 void gdix_reset_transform(gdix_canvas_t* c);
 void gdix_delete_matrix(c_GpMatrix* m);
 void gdix_canvas_apply_string_flags(gdix_canvas_t* c, DWORD flags);
-void gdix_setpen(c_GpPen* pen, c_GpBrush* brush, float width, gdix_strokestyle_t* style);
+void gdix_setpen(gdix_canvas_t* c, c_GpBrush* brush, float width, gdix_strokestyle_t* style);
+
+/* Per-thread canvas for measuring strings when the caller provides none.
+ * gdix_measure_fini() has to be called with the lock held. */
+int gdix_measure_init(void);
+void gdix_measure_fini(void);
+gdix_canvas_t* gdix_measure_canvas(void);
 c_GpBitmap* gdix_bitmap_from_HBITMAP_with_alpha(HBITMAP hBmp, BOOL has_premultiplied_alpha);
 
+/* TRUE if the image has no alpha channel (see wdIsImageOpaque()). */
+BOOL gdix_image_is_opaque(c_GpImage* img);
+
 
 #endif  /* WD_BACKEND_GDIX_H */
@@ -34,6 +34,13 @@ IWICImagingFactory* wic_factory = NULL;
 const GUID wic_pixel_format =
         {0x6fddc324,0x4e03,0x4bfe,{0xb1,0x85,0x3d,0x77,0x76,0x8d,0xc9,0x10} };
 
+/* GUID_WICPixelFormat32bppBGR: Same memory layout but the alpha byte is
+ * ignored. We use it for images which are known to be fully opaque so that
+ * Direct2D creates the bitmaps with D2D1_ALPHA_MODE_IGNORE and it can skip
+ * the blending. */
+const GUID wic_pixel_format_opaque =
+        {0x6fddc324,0x4e03,0x4bfe,{0xb1,0x85,0x3d,0x77,0x76,0x8d,0xc9,0x0e} };
+
 
 int
 wic_init(void)
@@ -91,11 +98,121 @@ wic_fini(void)
 }
 
 
+BOOL
+wic_format_has_alpha(const GUID* format)
+{
+    /* All the native WIC pixel formats share the same GUID prefix and differ
+     * only in the last byte. These are the ones without any alpha channel
+     * (BlackWhite, 2/4/8/16bppGray, 16bppBGR555/565, 24bppBGR/RGB, 32bppBGR,
+     * 32bppBGR101010 and 48bppRGB). Indexed formats may carry alpha in the
+     * palette, so we treat them (as well as anything unknown) as having
+     * alpha. */
+    static const GUID prefix =
+            {0x6fddc324,0x4e03,0x4bfe,{0xb1,0x85,0x3d,0x77,0x76,0x8d,0xc9,0x00} };
+    static const BYTE opaque_ids[] = {
+        0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x14, 0x15
+    };
+    UINT i;
+
+    if(memcmp(format, &prefix, sizeof(GUID) - 1) != 0)
+        return TRUE;
+
+    for(i = 0; i < WD_SIZEOF_ARRAY(opaque_ids); i++) {
+        if(format->Data4[7] == opaque_ids[i])
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static IWICBitmapSource*
+wic_convert_to(IWICBitmapSource* bitmap, const GUID* pixel_format)
+{
+    IWICFormatConverter* converter;
+    HRESULT hr;
+
+    hr = IWICImagingFactory_CreateFormatConverter(wic_factory, &converter);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("wic_convert_to: "
+                    "IWICImagingFactory::CreateFormatConverter() failed.");
+        return NULL;
+    }
+
+    hr = IWICFormatConverter_Initialize(converter, bitmap, pixel_format,
+            WICBitmapDitherTypeNone, NULL, 0.0f, WICBitmapPaletteTypeCustom);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("wic_convert_to: "
+                    "IWICFormatConverter::Initialize() failed.");
+        IWICFormatConverter_Release(converter);
+        return NULL;
+    }
+
+    return (IWICBitmapSource*) converter;
+}
+
+/* Check whether the (32bppPBGRA) bitmap source is fully opaque. This decodes
+ * the whole image so it is done only once, when the image is being created.
+ * Any failure is interpreted as "not opaque" which is always safe. */
+static BOOL
+wic_is_opaque(IWICBitmapSource* bitmap)
+{
+    UINT width, height;
+    UINT stride;
+    UINT rows_per_chunk;
+    BYTE* buffer;
+    WICRect rect;
+    BOOL opaque = TRUE;
+    HRESULT hr;
+
+    hr = IWICBitmapSource_GetSize(bitmap, &width, &height);
+    if(FAILED(hr)  ||  width == 0  ||  height == 0)
+        return FALSE;
+
+    /* Copy (and decode) the pixels in chunks of about 64 KB so we do not need
+     * to allocate a buffer for the whole image. */
+    stride = width * 4;
+    rows_per_chunk = (64 * 1024) / stride;
+    if(rows_per_chunk < 1)
+        rows_per_chunk = 1;
+    if(rows_per_chunk > height)
+        rows_per_chunk = height;
+
+    buffer = (BYTE*) malloc(stride * rows_per_chunk);
+    if(buffer == NULL) {
+        WD_TRACE("wic_is_opaque: malloc() failed.");
+        return FALSE;
+    }
+
+    rect.X = 0;
+    rect.Width = width;
+    for(rect.Y = 0; rect.Y < (INT) height; rect.Y += rect.Height) {
+        rect.Height = rows_per_chunk;
+        if(rect.Height > (INT) height - rect.Y)
+            rect.Height = (INT) height - rect.Y;
+
+        hr = IWICBitmapSource_CopyPixels(bitmap, &rect, stride,
+                                         stride * rect.Height, buffer);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wic_is_opaque: IWICBitmapSource::CopyPixels() failed.");
+            opaque = FALSE;
+            break;
+        }
+
+        if(!wd_alpha_is_opaque(buffer, stride, width, rect.Height)) {
+            opaque = FALSE;
+            break;
+        }
+    }
+
+    free(buffer);
+    return opaque;
+}
+
 IWICBitmapSource*
 wic_convert_bitmap(IWICBitmapSource* bitmap)
 {
     GUID pixel_format;
-    IWICFormatConverter* converter;
+    IWICBitmapSource* converted;
     HRESULT hr;
 
     hr = IWICBitmapSource_GetPixelFormat(bitmap, &pixel_format);
@@ -105,27 +222,36 @@ wic_convert_bitmap(IWICBitmapSource* bitmap)
         return NULL;
     }
 
-    if(IsEqualGUID(&pixel_format, &wic_pixel_format)) {
+    if(IsEqualGUID(&pixel_format, &wic_pixel_format_opaque)) {
         /* No conversion needed. */
         IWICBitmapSource_AddRef(bitmap);
         return bitmap;
     }
 
-    hr = IWICImagingFactory_CreateFormatConverter(wic_factory, &converter);
-    if(FAILED(hr)) {
-        WD_TRACE_HR("wc_convert_bitmap: "
-                    "IWICImagingFactory::CreateFormatConverter() failed.");
-        return NULL;
+    if(!wic_format_has_alpha(&pixel_format))
+        return wic_convert_to(bitmap, &wic_pixel_format_opaque);
+
+    if(IsEqualGUID(&pixel_format, &wic_pixel_format)) {
+        IWICBitmapSource_AddRef(bitmap);
+        converted = bitmap;
+    } else {
+        converted = wic_convert_to(bitmap, &wic_pixel_format);
+        if(converted == NULL)
+            return NULL;
     }
 
-    hr = IWICFormatConverter_Initialize(converter, bitmap, &wic_pixel_format,
-            WICBitmapDitherTypeNone, NULL, 0.0f, WICBitmapPaletteTypeCustom);
-    if(FAILED(hr)) {
-        WD_TRACE_HR("wc_convert_bitmap: "
-                    "IWICFormatConverter::Initialize() failed.");
-        IWICFormatConverter_Release(converter);
-        return NULL;
+    /* Many images have an alpha channel but do not really use it (e.g. PNG
+     * files saved by various tools, or screenshots). Detect them so that
+     * they can be painted without blending. */
+    if(wic_is_opaque(converted)) {
+        IWICBitmapSource* opaque;
+
+        opaque = wic_convert_to(bitmap, &wic_pixel_format_opaque);
+        if(opaque != NULL) {
+            IWICBitmapSource_Release(converted);
+            converted = opaque;
+        }
     }
 
-    return (IWICBitmapSource*) converter;
+    return converted;
 }
@@ -32,6 +32,7 @@
 extern IWICImagingFactory* wic_factory;
 
 extern const GUID wic_pixel_format;
+extern const GUID wic_pixel_format_opaque;
 
 
 int wic_init(void);
@@ -39,6 +40,7 @@ void wic_fini(void);
 
 
 IWICBitmapSource* wic_convert_bitmap(IWICBitmapSource* bitmap);
+BOOL wic_format_has_alpha(const GUID* format);
 
 
 #endif  /* WD_BACKEND_WIC_H */
@@ -28,10 +28,47 @@
 #include "lock.h"
 
 
+/* Check whether the blit maps the source pixels 1:1 onto the device pixels,
+ * i.e. there is no scaling, no rotation and everything is aligned on whole
+ * pixels. */
+static BOOL
+bitblt_gdix_is_pixel_aligned(gdix_canvas_t* c, float dx, float dy, float dw, float dh,
+                             float sw, float sh)
+{
+    c_GpMatrix* m;
+    float e[6];
+    int status;
+
+    if(dw != sw  ||  dh != sh)
+        return FALSE;
+    if(dx != floorf(dx)  ||  dy != floorf(dy)  ||  dw != floorf(dw)  ||  dh != floorf(dh))
+        return FALSE;
+
+    status = gdix_vtable->fn_CreateMatrix(&m);
+    if(status != 0)
+        return FALSE;
+    status = gdix_vtable->fn_GetWorldTransform(c->graphics, m);
+    if(status == 0)
+        status = gdix_vtable->fn_GetMatrixElements(m, e);
+    gdix_delete_matrix(m);
+    if(status != 0)
+        return FALSE;
+
+    return (e[0] == 1.0f  &&  e[1] == 0.0f  &&  e[2] == 0.0f  &&  e[3] == 1.0f  &&
+            e[4] == floorf(e[4])  &&  e[5] == floorf(e[5]));
+}
+
 void
 wdBitBltImage(WD_HCANVAS hCanvas, const WD_HIMAGE hImage,
                const WD_RECT* pDestRect, const WD_RECT* pSourceRect)
 {
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook_rects(hCanvas, WD_CMD_BITBLTIMAGE, (void*) hImage, pDestRect, pSourceRect))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_BITBLTIMAGE, (void*) hImage, 0, (const float*) pDestRect))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         IWICBitmapSource* bitmap = (IWICBitmapSource*) hImage;
@@ -57,13 +94,14 @@ wdBitBltImage(WD_HCANVAS hCanvas, const WD_HIMAGE hImage,
         }
 
         c_ID2D1RenderTarget_DrawBitmap(c->target, b, &dest, 1.0f,
-                c_D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, (c_D2D1_RECT_F*) pSourceRect);
+                d2d_interpolation_mode(c), (c_D2D1_RECT_F*) pSourceRect);
         c_ID2D1Bitmap_Release(b);
     } else {
         gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
         c_GpImage* b = (c_GpImage*) hImage;
         float dx, dy, dw, dh;
         float sx, sy, sw, sh;
+        c_GpCompositingMode mode = c_CompositingModeSourceCopy;
 
         dx = pDestRect->x0;
         dy = pDestRect->y0;
@@ -87,8 +125,21 @@ wdBitBltImage(WD_HCANVAS hCanvas, const WD_HIMAGE hImage,
             sh = (float) h;
         }
 
+        /* Opaque images need no blending: When the image lands precisely on
+         * the pixel grid, let GDI+ just copy the pixels. */
+        if(gdix_image_is_opaque(b)  &&
+           bitblt_gdix_is_pixel_aligned(c, dx, dy, dw, dh, sw, sh)  &&
+           gdix_vtable->fn_GetCompositingMode(c->graphics, &mode) == 0  &&
+           mode == c_CompositingModeSourceOver)
+        {
+            gdix_vtable->fn_SetCompositingMode(c->graphics, c_CompositingModeSourceCopy);
+        }
+
         gdix_vtable->fn_DrawImageRectRect(c->graphics, b, dx, dy, dw, dh,
                  sx, sy, sw, sh, c_UnitPixel, NULL, NULL, NULL);
+
+        if(mode == c_CompositingModeSourceOver)
+            gdix_vtable->fn_SetCompositingMode(c->graphics, c_CompositingModeSourceOver);
     }
 }
 
@@ -96,6 +147,15 @@ void
 wdBitBltCachedImage(WD_HCANVAS hCanvas, const WD_HCACHEDIMAGE hCachedImage,
                     float x, float y)
 {
+    float a[2] = { x, y };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_BITBLTCACHED, NULL, NULL, (void*) hCachedImage, a, 2))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_BITBLTCACHED, (void*) hCachedImage, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Bitmap* b = (c_ID2D1Bitmap*) hCachedImage;
@@ -110,7 +170,7 @@ wdBitBltCachedImage(WD_HCANVAS hCanvas, const WD_HCACHEDIMAGE hCachedImage,
         dest.bottom = (y + sz.height) - D2D_BASEDELTA_X;
 
         c_ID2D1RenderTarget_DrawBitmap(c->target, b, &dest, 1.0f,
-                c_D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, NULL);
+                d2d_interpolation_mode(c), NULL);
     } else {
         gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
         c_GpCachedBitmap* cb = (c_GpCachedBitmap*) hCachedImage;
@@ -123,6 +183,13 @@ void
 wdBitBltHICON(WD_HCANVAS hCanvas, HICON hIcon,
               const WD_RECT* pDestRect, const WD_RECT* pSourceRect)
 {
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook_rects(hCanvas, WD_CMD_BITBLTHICON, (void*) hIcon, pDestRect, pSourceRect))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_BITBLTHICON, (void*) hIcon, 0, (const float*) pDestRect))
+        return;
+
     if(d2d_enabled()) {
         IWICBitmap* bitmap;
         IWICFormatConverter* converter;
@@ -151,7 +218,11 @@ wdBitBltHICON(WD_HCANVAS hCanvas, HICON hIcon,
             goto err_Initialize;
         }
 
+        /* The call has already been seen by the hook (if any) as
+         * wdBitBltHICON(). */
+        wd_hook_enter(hCanvas);
         wdBitBltImage(hCanvas, (WD_HIMAGE) converter, pDestRect, pSourceRect);
+        wd_hook_leave(hCanvas);
 
 err_Initialize:
         IWICFormatConverter_Release(converter);
@@ -169,7 +240,9 @@ err_CreateBitmapFromHICON:
                      "[%d]", status);
             return;
         }
+        wd_hook_enter(hCanvas);
         wdBitBltImage(hCanvas, (WD_HIMAGE) b, pDestRect, pSourceRect);
+        wd_hook_leave(hCanvas);
         gdix_vtable->fn_DisposeImage(b);
     }
 }
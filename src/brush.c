@@ -24,10 +24,32 @@
 #include "misc.h"
 #include "backend-d2d.h"
 #include "backend-gdix.h"
+#include "lock.h"
+#include "apitrace.h"
+#include "hook.h"
 
 
+/* Gradients with up to this count of stops are handled without malloc(), and
+ * their stop collections are shared (see brush_get_stops()). */
+#define BRUSH_MAX_STOPS     16
+
+
+static void
+brush_trace_gradient(WORD op, WD_HBRUSH hBrush, WD_HCANVAS hCanvas,
+                     const float* geom, UINT n_geom, const WD_COLOR* colors,
+                     const float* offsets, UINT numStops)
+{
+    BYTE args[6 * sizeof(float)];
+    UINT32 n = numStops;
+
+    memcpy(args, geom, n_geom * sizeof(float));
+    memcpy(args + n_geom * sizeof(float), &n, sizeof(UINT32));
+    wd_apitrace_create(op, hBrush, hCanvas, args, n_geom * sizeof(float) + sizeof(UINT32),
+                       colors, numStops * sizeof(WD_COLOR), offsets, numStops * sizeof(float));
+}
+
 WD_HBRUSH
-wdCreateSolidBrush(WD_HCANVAS hCanvas, WD_COLOR color)
+wd_brush_create_solid(WD_HCANVAS hCanvas, WD_COLOR color)
 {
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
@@ -39,7 +61,7 @@ wdCreateSolidBrush(WD_HCANVAS hCanvas, WD_COLOR color)
         hr = c_ID2D1RenderTarget_CreateSolidColorBrush(
                         c->target, &clr, NULL, &b);
         if(FAILED(hr)) {
-            WD_TRACE_HR("wdCreateSolidBrush: "
+            WD_TRACE_HR("wd_brush_create_solid: "
                         "ID2D1RenderTarget::CreateSolidColorBrush() failed.");
             return NULL;
         }
@@ -50,7 +72,7 @@ wdCreateSolidBrush(WD_HCANVAS hCanvas, WD_COLOR color)
 
         status = gdix_vtable->fn_CreateSolidFill(color, &b);
         if(status != 0) {
-            WD_TRACE("wdCreateSolidBrush: "
+            WD_TRACE("wd_brush_create_solid: "
                      "GdipCreateSolidFill() failed. [%d]", status);
             return NULL;
         }
@@ -58,18 +80,337 @@ wdCreateSolidBrush(WD_HCANVAS hCanvas, WD_COLOR color)
     }
 }
 
+WD_HBRUSH
+wdCreateSolidBrush(WD_HCANVAS hCanvas, WD_COLOR color)
+{
+    WD_HBRUSH b;
+
+    b = wd_brush_create_solid(hCanvas, color);
+    if(b == NULL) {
+        WD_TRACE("wdCreateSolidBrush: wd_brush_create_solid() failed.");
+        return NULL;
+    }
+
+    wd_apitrace_create(WD_APITRACE_OP_CREATESOLIDBRUSH, b, hCanvas,
+                       &color, sizeof(WD_COLOR), NULL, 0, NULL, 0);
+    return b;
+}
+
+WD_HBRUSH
+wdGetSolidBrush(WD_HCANVAS hCanvas, WD_COLOR color)
+{
+    wd_intern_t* intern = wd_canvas_intern(hCanvas);
+    WD_HBRUSH b;
+
+    if(intern != NULL) {
+        b = (WD_HBRUSH) wd_intern_lookup(&intern->brushes, &color, sizeof(WD_COLOR), TRUE);
+        if(b != NULL)
+            return b;
+    }
+
+    b = wdCreateSolidBrush(hCanvas, color);
+    if(b == NULL) {
+        WD_TRACE("wdGetSolidBrush: wdCreateSolidBrush() failed.");
+        return NULL;
+    }
+
+    /* If it cannot be shared, it is still a valid brush. It is just
+     * destroyed by wdReleaseSolidBrush(). */
+    if(intern != NULL)
+        wd_intern_insert(&intern->brushes, &color, sizeof(WD_COLOR), b, TRUE);
+    return b;
+}
+
 void
-wdDestroyBrush(WD_HBRUSH hBrush)
+wdReleaseSolidBrush(WD_HCANVAS hCanvas, WD_HBRUSH hBrush)
+{
+    wd_intern_t* intern = wd_canvas_intern(hCanvas);
+
+    if(intern == NULL  ||  !wd_intern_release(&intern->brushes, hBrush))
+        wdDestroyBrush(hBrush);
+}
+
+/* Get a gradient stop collection for the given stops. The caller owns one
+ * reference of it. Collections of small gradients are shared by all brushes
+ * of the canvas. */
+static c_ID2D1GradientStopCollection*
+brush_get_stops(WD_HCANVAS hCanvas, const WD_COLOR* colors, const float* offsets,
+                UINT numStops)
+{
+    d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+    wd_intern_t* intern = NULL;
+    c_ID2D1GradientStopCollection* collection;
+    c_D2D1_GRADIENT_STOP stops_buffer[BRUSH_MAX_STOPS];
+    c_D2D1_GRADIENT_STOP* stops = stops_buffer;
+    BYTE key[BRUSH_MAX_STOPS * (sizeof(WD_COLOR) + sizeof(float))];
+    UINT key_size = numStops * (sizeof(WD_COLOR) + sizeof(float));
+    UINT i;
+    HRESULT hr;
+
+    if(numStops <= BRUSH_MAX_STOPS) {
+        memcpy(key, colors, numStops * sizeof(WD_COLOR));
+        memcpy(key + numStops * sizeof(WD_COLOR), offsets, numStops * sizeof(float));
+
+        intern = wd_canvas_intern(hCanvas);
+        if(intern != NULL) {
+            collection = (c_ID2D1GradientStopCollection*)
+                    wd_intern_lookup(&intern->stops, key, key_size, FALSE);
+            if(collection != NULL) {
+                c_ID2D1GradientStopCollection_AddRef(collection);
+                return collection;
+            }
+        }
+    } else {
+        stops = (c_D2D1_GRADIENT_STOP*) malloc(numStops * sizeof(c_D2D1_GRADIENT_STOP));
+        if(stops == NULL) {
+            WD_TRACE("brush_get_stops: malloc() failed.");
+            return NULL;
+        }
+    }
+
+    for(i = 0; i < numStops; i++) {
+        d2d_init_color(&stops[i].color, colors[i]);
+        stops[i].position = offsets[i];
+    }
+    hr = c_ID2D1RenderTarget_CreateGradientStopCollection(c->target, stops, numStops,
+                c_D2D1_GAMMA_2_2, c_D2D1_EXTEND_MODE_CLAMP, &collection);
+    if(stops != stops_buffer)
+        free(stops);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("brush_get_stops: "
+                    "ID2D1RenderTarget::CreateGradientStopCollection() failed.");
+        return NULL;
+    }
+
+    /* The table keeps its own reference. */
+    if(intern != NULL) {
+        c_ID2D1GradientStopCollection_AddRef(collection);
+        if(!wd_intern_insert(&intern->stops, key, key_size, collection, FALSE))
+            c_ID2D1GradientStopCollection_Release(collection);
+    }
+
+    return collection;
+}
+
+/* GDI+ gradient brushes have no way to change their geometry, and we cannot
+ * even ask them what it is. So we change it by the brush transformation,
+ * which then has two parts: The geometry part (mapping the geometry the
+ * brush has been created with to the current one), and the part set by
+ * wdSetBrushTransform().
+ *
+ * For brushes which have ever been changed, we remember both parts here, in
+ * a hash table keyed by the brush handle. (GDI+ brushes are used directly as
+ * WD_HBRUSH so there is no place in the brush itself.) Other brushes have no
+ * record, their whole transformation is the geometry part. */
+#define BRUSH_XFORM_BUCKETS     256
+
+typedef struct brush_xform_tag brush_xform_t;
+struct brush_xform_tag {
+    c_GpBrush* brush;
+    WD_MATRIX geom;
+    WD_MATRIX user;
+    brush_xform_t* next;
+};
+
+static brush_xform_t* brush_xforms[BRUSH_XFORM_BUCKETS];
+
+static const WD_MATRIX brush_identity = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+
+/* res = a, then b. */
+static void
+brush_multiply(const WD_MATRIX* a, const WD_MATRIX* b, WD_MATRIX* res)
+{
+    res->m11 = a->m11 * b->m11 + a->m12 * b->m21;
+    res->m12 = a->m11 * b->m12 + a->m12 * b->m22;
+    res->m21 = a->m21 * b->m11 + a->m22 * b->m21;
+    res->m22 = a->m21 * b->m12 + a->m22 * b->m22;
+    res->dx = a->dx * b->m11 + a->dy * b->m21 + b->dx;
+    res->dy = a->dx * b->m12 + a->dy * b->m22 + b->dy;
+}
+
+/* Matrix mapping the segment [0,0]-[1,0] onto [x0,y0]-[x1,y1]. */
+static void
+brush_linear_geom(float x0, float y0, float x1, float y1, WD_MATRIX* res)
+{
+    res->m11 = x1 - x0;
+    res->m12 = y1 - y0;
+    res->m21 = -(y1 - y0);
+    res->m22 = x1 - x0;
+    res->dx = x0;
+    res->dy = y0;
+}
+
+static int
+brush_gdix_transform(c_GpBrush* b, c_GpBrushType type, WD_MATRIX* m, BOOL get)
+{
+    c_GpMatrix* matrix;
+    int status;
+
+    if(get)
+        status = gdix_vtable->fn_CreateMatrix(&matrix);
+    else
+        status = gdix_vtable->fn_CreateMatrix2(m->m11, m->m12, m->m21, m->m22,
+                                               m->dx, m->dy, &matrix);
+    if(status != 0) {
+        WD_TRACE("brush_gdix_transform: GdipCreateMatrix() failed. [%d]", status);
+        return status;
+    }
+
+    switch(type) {
+        case c_BrushTypeLinearGradient:
+            if(get)
+                status = gdix_vtable->fn_GetLineTransform((c_GpLineGradient*) b, matrix);
+            else
+                status = gdix_vtable->fn_SetLineTransform((c_GpLineGradient*) b, matrix);
+            break;
+
+        case c_BrushTypePathGradient:
+            if(get)
+                status = gdix_vtable->fn_GetPathGradientTransform((c_GpPathGradient*) b, matrix);
+            else
+                status = gdix_vtable->fn_SetPathGradientTransform((c_GpPathGradient*) b, matrix);
+            break;
+
+        case c_BrushTypeTextureFill:
+            if(get)
+                status = gdix_vtable->fn_GetTextureTransform((c_GpTexture*) b, matrix);
+            else
+                status = gdix_vtable->fn_SetTextureTransform((c_GpTexture*) b, matrix);
+            break;
+
+        default:
+            /* Solid brushes have no transformation. */
+            if(get)
+                memcpy(m, &brush_identity, sizeof(WD_MATRIX));
+            gdix_delete_matrix(matrix);
+            return 0;
+    }
+
+    if(status == 0  &&  get)
+        gdix_vtable->fn_GetMatrixElements(matrix, (float*) m);
+    gdix_delete_matrix(matrix);
+    return status;
+}
+
+static inline UINT
+brush_xform_bucket(c_GpBrush* b)
+{
+    return (UINT) ((((UINT_PTR) b >> 4) * 2654435761u) % BRUSH_XFORM_BUCKETS);
+}
+
+/* Find (or create) the record of the brush. Caller has to hold wd_lock(). */
+static brush_xform_t*
+brush_xform(c_GpBrush* b, c_GpBrushType type)
+{
+    brush_xform_t** bucket = &brush_xforms[brush_xform_bucket(b)];
+    brush_xform_t* xform;
+
+    for(xform = *bucket; xform != NULL; xform = xform->next) {
+        if(xform->brush == b)
+            return xform;
+    }
+
+    xform = (brush_xform_t*) malloc(sizeof(brush_xform_t));
+    if(xform == NULL) {
+        WD_TRACE("brush_xform: malloc() failed.");
+        return NULL;
+    }
+    if(brush_gdix_transform(b, type, &xform->geom, TRUE) != 0) {
+        free(xform);
+        return NULL;
+    }
+    xform->brush = b;
+    memcpy(&xform->user, &brush_identity, sizeof(WD_MATRIX));
+    xform->next = *bucket;
+    *bucket = xform;
+    return xform;
+}
+
+static void
+brush_xform_forget(c_GpBrush* b)
+{
+    brush_xform_t** pp;
+    brush_xform_t* xform = NULL;
+
+    wd_lock();
+    for(pp = &brush_xforms[brush_xform_bucket(b)]; *pp != NULL; pp = &(*pp)->next) {
+        if((*pp)->brush == b) {
+            xform = *pp;
+            *pp = xform->next;
+            break;
+        }
+    }
+    wd_unlock();
+
+    free(xform);
+}
+
+/* Set the geometry part (if geom != NULL) or the user part (if user != NULL)
+ * of the GDI+ brush transformation. */
+static void
+brush_gdix_update(c_GpBrush* b, c_GpBrushType type,
+                  const WD_MATRIX* geom, const WD_MATRIX* user)
+{
+    brush_xform_t* xform;
+    WD_MATRIX m;
+    int status;
+
+    wd_lock();
+    xform = brush_xform(b, type);
+    if(xform == NULL) {
+        wd_unlock();
+        WD_TRACE("brush_gdix_update: brush_xform() failed.");
+        return;
+    }
+    if(geom != NULL)
+        memcpy(&xform->geom, geom, sizeof(WD_MATRIX));
+    if(user != NULL)
+        memcpy(&xform->user, user, sizeof(WD_MATRIX));
+    brush_multiply(&xform->geom, &xform->user, &m);
+    wd_unlock();
+
+    status = brush_gdix_transform(b, type, &m, FALSE);
+    if(status != 0)
+        WD_TRACE("brush_gdix_update: Setting brush transform failed. [%d]", status);
+
+    /* The canvas pen may be using the brush. */
+    gdix_brush_changed();
+}
+
+void
+wd_brush_destroy(WD_HBRUSH hBrush)
 {
     if(d2d_enabled()) {
         c_ID2D1Brush_Release((c_ID2D1Brush*) hBrush);
     } else {
+        brush_xform_forget((c_GpBrush*) hBrush);
         gdix_vtable->fn_DeleteBrush((void*) hBrush);
+        gdix_brush_changed();
     }
 }
 
+void
+wdDestroyBrush(WD_HBRUSH hBrush)
+{
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYBRUSH, hBrush);
+
+    wd_hook_object_changing(hBrush);
+    wd_brush_destroy(hBrush);
+}
+
 void
 wdSetSolidBrushColor(WD_HBRUSH hBrush, WD_COLOR color)
+{
+    wd_apitrace_create(WD_APITRACE_OP_SETSOLIDBRUSHCOLOR, hBrush, NULL,
+                       &color, sizeof(WD_COLOR), NULL, 0, NULL, 0);
+
+    /* Calls held back by a canvas have captured the color they use (see
+     * wd_cmd_capture()), so the change does not affect them. */
+    wd_brush_set_solid_color(hBrush, color);
+}
+
+void
+wd_brush_set_solid_color(WD_HBRUSH hBrush, WD_COLOR color)
 {
     if(d2d_enabled()) {
         c_D2D1_COLOR_F clr;
@@ -80,6 +421,134 @@ wdSetSolidBrushColor(WD_HBRUSH hBrush, WD_COLOR color)
         c_GpSolidFill* b = (c_GpSolidFill*) hBrush;
 
         gdix_vtable->fn_SetSolidFillColor(b, (c_ARGB) color);
+        gdix_brush_changed();
+    }
+}
+
+BOOL
+wd_brush_solid_color(WD_HBRUSH hBrush, WD_COLOR* color)
+{
+    if(d2d_enabled()) {
+        c_ID2D1SolidColorBrush* b;
+        c_D2D1_COLOR_F clr;
+        HRESULT hr;
+
+        hr = c_ID2D1Brush_QueryInterface((c_ID2D1Brush*) hBrush,
+                    &c_IID_ID2D1SolidColorBrush, (void**) &b);
+        if(FAILED(hr))
+            return FALSE;
+        c_ID2D1SolidColorBrush_GetColor(b, &clr);
+        c_ID2D1SolidColorBrush_Release(b);
+
+        *color = WD_ARGB(clr.a * 255.0f + 0.5f, clr.r * 255.0f + 0.5f,
+                         clr.g * 255.0f + 0.5f, clr.b * 255.0f + 0.5f);
+    } else {
+        c_GpBrushType type;
+        c_ARGB argb;
+
+        if(gdix_vtable->fn_GetBrushType((c_GpBrush*) hBrush, &type) != 0  ||
+           type != c_BrushTypeSolidColor)
+            return FALSE;
+        if(gdix_vtable->fn_GetSolidFillColor((c_GpSolidFill*) hBrush, &argb) != 0)
+            return FALSE;
+
+        *color = (WD_COLOR) argb;
+    }
+
+    return TRUE;
+}
+
+WD_HBRUSH
+wdCreateImageBrush(WD_HCANVAS hCanvas, WD_HIMAGE hImage, UINT extendModeX,
+                   UINT extendModeY, const WD_MATRIX* pMatrix)
+{
+    wd_apitrace_imagebrush_t args;
+
+    if(pMatrix == NULL)
+        pMatrix = &brush_identity;
+
+    args.image = (UINT64) (UINT_PTR) hImage;
+    args.extend_x = extendModeX;
+    args.extend_y = extendModeY;
+    memcpy(&args.matrix, pMatrix, sizeof(WD_MATRIX));
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        c_ID2D1Bitmap* bitmap;
+        c_ID2D1BitmapBrush* b;
+        c_D2D1_BITMAP_BRUSH_PROPERTIES props;
+        c_D2D1_BRUSH_PROPERTIES brush_props;
+        HRESULT hr;
+
+        hr = c_ID2D1RenderTarget_CreateBitmapFromWicBitmap(c->target,
+                    (IWICBitmapSource*) hImage, NULL, &bitmap);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdCreateImageBrush: "
+                        "ID2D1RenderTarget::CreateBitmapFromWicBitmap() failed.");
+            return NULL;
+        }
+
+        props.extendModeX = (c_D2D1_EXTEND_MODE) extendModeX;
+        props.extendModeY = (c_D2D1_EXTEND_MODE) extendModeY;
+        props.interpolationMode = d2d_interpolation_mode(c);
+
+        /* Same compensation as in wdBitBltImage(), so the image pixels fit
+         * the pixel grid of the canvas. */
+        brush_props.opacity = 1.0f;
+        memcpy(&brush_props.transform, pMatrix, sizeof(WD_MATRIX));
+        brush_props.transform._31 -= D2D_BASEDELTA_X;
+        brush_props.transform._32 -= D2D_BASEDELTA_Y;
+
+        hr = c_ID2D1RenderTarget_CreateBitmapBrush(c->target, bitmap,
+                    &props, &brush_props, &b);
+        c_ID2D1Bitmap_Release(bitmap);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdCreateImageBrush: "
+                        "ID2D1RenderTarget::CreateBitmapBrush() failed.");
+            return NULL;
+        }
+
+        wd_apitrace_create(WD_APITRACE_OP_CREATEIMAGEBRUSH, b, hCanvas,
+                           &args, sizeof(args), NULL, 0, NULL, 0);
+        return (WD_HBRUSH) b;
+    } else {
+        c_GpTexture* b;
+        c_GpWrapMode wrap_mode;
+        int status;
+
+        /* GDI+ has only one wrap mode for both directions, and its clamping
+         * paints nothing outside of the image. */
+        if(extendModeX == WD_EXTEND_CLAMP  &&  extendModeY == WD_EXTEND_CLAMP)
+            wrap_mode = c_WrapModeClamp;
+        else if(extendModeX == WD_EXTEND_MIRROR  &&  extendModeY == WD_EXTEND_MIRROR)
+            wrap_mode = c_WrapModeTileFlipXY;
+        else if(extendModeX == WD_EXTEND_MIRROR)
+            wrap_mode = c_WrapModeTileFlipX;
+        else if(extendModeY == WD_EXTEND_MIRROR)
+            wrap_mode = c_WrapModeTileFlipY;
+        else
+            wrap_mode = c_WrapModeTile;
+
+        status = gdix_vtable->fn_CreateTexture((c_GpImage*) hImage, wrap_mode, &b);
+        if(status != 0) {
+            WD_TRACE("wdCreateImageBrush: GdipCreateTexture() failed. [%d]", status);
+            return NULL;
+        }
+
+        if(pMatrix != &brush_identity) {
+            status = brush_gdix_transform(b, c_BrushTypeTextureFill,
+                                          (WD_MATRIX*) pMatrix, FALSE);
+            if(status != 0) {
+                WD_TRACE("wdCreateImageBrush: "
+                         "brush_gdix_transform() failed. [%d]", status);
+                gdix_vtable->fn_DeleteBrush(b);
+                return NULL;
+            }
+        }
+
+        wd_apitrace_create(WD_APITRACE_OP_CREATEIMAGEBRUSH, b, hCanvas,
+                           &args, sizeof(args), NULL, 0, NULL, 0);
+        return (WD_HBRUSH) b;
     }
 }
 
@@ -87,6 +556,8 @@ WD_HBRUSH
 wdCreateLinearGradientBrushEx(WD_HCANVAS hCanvas, float x0, float y0, float x1, float y1,
     const WD_COLOR* colors, const float* offsets, UINT numStops)
 {
+    float geom[4] = { x0, y0, x1, y1 };
+
     if(numStops < 2)
         return NULL;
     if(d2d_enabled()) {
@@ -95,19 +566,11 @@ wdCreateLinearGradientBrushEx(WD_HCANVAS hCanvas, float x0, float y0, float x1,
         HRESULT hr;
         c_ID2D1GradientStopCollection* collection;
         c_ID2D1LinearGradientBrush* b;
-        c_D2D1_GRADIENT_STOP* stops = (c_D2D1_GRADIENT_STOP*)malloc(numStops * sizeof(c_D2D1_GRADIENT_STOP));
         c_D2D1_LINEAR_GRADIENT_BRUSH_PROPERTIES gradientProperties;
 
-        for (UINT i = 0; i < numStops; i++)
-        {
-            d2d_init_color(&stops[i].color, colors[i]);
-            stops[i].position = offsets[i];
-        }
-        hr = c_ID2D1RenderTarget_CreateGradientStopCollection(c->target, stops, numStops, c_D2D1_GAMMA_2_2, c_D2D1_EXTEND_MODE_CLAMP, &collection);
-        if(FAILED(hr)) {
-            WD_TRACE_HR("wdCreateLinearGradientBrushEx: "
-                        "ID2D1RenderTarget::CreateGradientStopCollection() failed.");
-            free(stops);
+        collection = brush_get_stops(hCanvas, colors, offsets, numStops);
+        if(collection == NULL) {
+            WD_TRACE("wdCreateLinearGradientBrushEx: brush_get_stops() failed.");
             return NULL;
         }
         gradientProperties.startPoint.x = x0;
@@ -116,24 +579,26 @@ wdCreateLinearGradientBrushEx(WD_HCANVAS hCanvas, float x0, float y0, float x1,
         gradientProperties.endPoint.y = y1;
         hr = c_ID2D1RenderTarget_CreateLinearGradientBrush(c->target, &gradientProperties, NULL, collection, &b);
         c_ID2D1GradientStopCollection_Release(collection);
-		free(stops);
         if(FAILED(hr)) {
             WD_TRACE_HR("wdCreateLinearGradientBrushEx: "
                         "ID2D1RenderTarget::CreateLinearGradientBrush() failed.");
             return NULL;
         }
+        brush_trace_gradient(WD_APITRACE_OP_CREATELINEARBRUSH, (WD_HBRUSH) b, hCanvas,
+                             geom, 4, colors, offsets, numStops);
         return (WD_HBRUSH) b;
     } else {
         int status;
         WD_COLOR color0 = colors[0];
         WD_COLOR color1 = colors[numStops - 1];
         c_GpLineGradient* grad;
-        c_GpPointF p0;
-        c_GpPointF p1;
-        p0.x = x0;
-        p0.y = y0;
-        p1.x = x1;
-        p1.y = y1;
+        c_GpPointF p0 = { 0.0f, 0.0f };
+        c_GpPointF p1 = { 1.0f, 0.0f };
+        WD_MATRIX m;
+
+        /* The brush is created for the unit segment and then transformed
+         * onto the real one, so wdSetLinearGradientBrushPoints() can later
+         * move it. */
         status = gdix_vtable->fn_CreateLineBrush(&p0, &p1, color0, color1, c_WrapModeTile, &grad);
         if(status != 0) {
             WD_TRACE("wdCreateLinearGradientBrushEx: "
@@ -144,8 +609,19 @@ wdCreateLinearGradientBrushEx(WD_HCANVAS hCanvas, float x0, float y0, float x1,
         if(status != 0) {
             WD_TRACE("wdCreateLinearGradientBrushEx: "
                      "GdipSetLinePresetBlend() failed. [%d]", status);
+            gdix_vtable->fn_DeleteBrush((void*) grad);
             return NULL;
         }
+        brush_linear_geom(x0, y0, x1, y1, &m);
+        status = brush_gdix_transform((c_GpBrush*) grad, c_BrushTypeLinearGradient, &m, FALSE);
+        if(status != 0) {
+            WD_TRACE("wdCreateLinearGradientBrushEx: "
+                     "brush_gdix_transform() failed. [%d]", status);
+            gdix_vtable->fn_DeleteBrush((void*) grad);
+            return NULL;
+        }
+        brush_trace_gradient(WD_APITRACE_OP_CREATELINEARBRUSH, (WD_HBRUSH) grad, hCanvas,
+                             geom, 4, colors, offsets, numStops);
         return (WD_HBRUSH)grad;
     }
     return NULL;
@@ -164,6 +640,8 @@ WD_HBRUSH
 wdCreateRadialGradientBrushEx(WD_HCANVAS hCanvas, float cx, float cy, float r,
     float fx, float fy, const WD_COLOR* colors, const float* offsets, UINT numStops)
 {
+    float geom[5] = { cx, cy, r, fx, fy };
+
     if(numStops < 2)
         return NULL;
     if(d2d_enabled()) {
@@ -172,19 +650,11 @@ wdCreateRadialGradientBrushEx(WD_HCANVAS hCanvas, float cx, float cy, float r,
         HRESULT hr;
         c_ID2D1GradientStopCollection* collection;
         c_ID2D1RadialGradientBrush* b;
-        c_D2D1_GRADIENT_STOP* stops = (c_D2D1_GRADIENT_STOP*)malloc(numStops * sizeof(c_D2D1_GRADIENT_STOP));
         c_D2D1_RADIAL_GRADIENT_BRUSH_PROPERTIES gradientProperties;
 
-        for (UINT i = 0; i < numStops; i++)
-        {
-            d2d_init_color(&stops[i].color, colors[i]);
-            stops[i].position = offsets[i];
-        }
-        hr = c_ID2D1RenderTarget_CreateGradientStopCollection(c->target, stops, numStops, c_D2D1_GAMMA_2_2, c_D2D1_EXTEND_MODE_CLAMP, &collection);
-        if(FAILED(hr)) {
-            WD_TRACE_HR("wdCreateRadialGradientBrushEx: "
-                        "ID2D1RenderTarget::CreateGradientStopCollection() failed.");
-            free(stops);
+        collection = brush_get_stops(hCanvas, colors, offsets, numStops);
+        if(collection == NULL) {
+            WD_TRACE("wdCreateRadialGradientBrushEx: brush_get_stops() failed.");
             return NULL;
         }
         gradientProperties.center.x = cx;
@@ -195,28 +665,32 @@ wdCreateRadialGradientBrushEx(WD_HCANVAS hCanvas, float cx, float cy, float r,
         gradientProperties.radiusY = r;
         hr = c_ID2D1RenderTarget_CreateRadialGradientBrush(c->target, &gradientProperties, NULL, collection, &b);
         c_ID2D1GradientStopCollection_Release(collection);
-        free(stops);
         if(FAILED(hr)) {
             WD_TRACE_HR("wdCreateRadialGradientBrushEx: "
                         "ID2D1RenderTarget::CreateRadialGradientBrush() failed.");
             return NULL;
         }
+        brush_trace_gradient(WD_APITRACE_OP_CREATERADIALBRUSH, (WD_HBRUSH) b, hCanvas,
+                             geom, 5, colors, offsets, numStops);
         return (WD_HBRUSH) b;
     } else {
         // TODO: Colors outside of the ellipse can only get faked
         // with a second brush.
-        WD_HPATH p;
-        WD_RECT rect;
-        rect.x0 = cx - r;
-        rect.y0 = cy - r;
-        rect.x1 = cx + r;
-        rect.y1 = cy + r;
-        p = wdCreateRoundedRectPath(hCanvas, &rect, r);
-
+        c_GpPath* p;
         int status;
         c_GpPathGradient* grad;
-        status = gdix_vtable->fn_CreatePathGradientFromPath((void*)p, &grad);
-        wdDestroyPath(p);
+
+        /* Plain ellipse path; no need for the whole wdCreatePath() machinery
+         * (and its tracing) here. */
+        status = gdix_vtable->fn_CreatePath(c_FillModeAlternate, &p);
+        if(status != 0) {
+            WD_TRACE("wdCreateRadialGradientBrushEx: "
+                     "GdipCreatePath() failed. [%d]", status);
+            return NULL;
+        }
+        gdix_vtable->fn_AddPathEllipse(p, cx - r, cy - r, 2.0f * r, 2.0f * r);
+        status = gdix_vtable->fn_CreatePathGradientFromPath(p, &grad);
+        gdix_vtable->fn_DeletePath(p);
         if(status != 0) {
             WD_TRACE("wdCreateRadialGradientBrushEx: "
                      "GdipCreatePathGradientFromPath() failed. [%d]", status);
@@ -227,21 +701,34 @@ wdCreateRadialGradientBrushEx(WD_HCANVAS hCanvas, float cx, float cy, float r,
         focalPoint[0].y = fy;
         gdix_vtable->fn_SetPathGradientCenterPoint(grad, (c_GpPointF*)focalPoint);
 
-        float* reverseStops = (float*)malloc(numStops * sizeof(float));
-        WD_COLOR* reverseColors = (WD_COLOR*)malloc(numStops * sizeof(WD_COLOR));
+        float reverseBuffer[2 * BRUSH_MAX_STOPS];
+        float* reverseStops = reverseBuffer;
+        WD_COLOR* reverseColors;
+        if(numStops > BRUSH_MAX_STOPS) {
+            reverseStops = (float*) malloc(numStops * (sizeof(float) + sizeof(WD_COLOR)));
+            if(reverseStops == NULL) {
+                WD_TRACE("wdCreateRadialGradientBrushEx: malloc() failed.");
+                gdix_vtable->fn_DeleteBrush((void*) grad);
+                return NULL;
+            }
+        }
+        reverseColors = (WD_COLOR*) (reverseStops + numStops);
         for (UINT i = 0; i < numStops; i++) {
             reverseStops[i] = 1 - offsets[numStops - i - 1];
             reverseColors[i] = colors[numStops - i - 1];
         }
 
         status = gdix_vtable->fn_SetPathGradientPresetBlend(grad, reverseColors, reverseStops, numStops);
-        free(reverseStops);
-        free(reverseColors);
+        if(reverseStops != reverseBuffer)
+            free(reverseStops);
         if(status != 0) {
             WD_TRACE("wdCreateRadialGradientBrushEx: "
                      "GdipSetPathGradientPresetBlend() failed. [%d]", status);
+            gdix_vtable->fn_DeleteBrush((void*) grad);
             return NULL;
         }
+        brush_trace_gradient(WD_APITRACE_OP_CREATERADIALBRUSH, (WD_HBRUSH) grad, hCanvas,
+                             geom, 5, colors, offsets, numStops);
         return (WD_HBRUSH) grad;
     }
     return NULL;
@@ -255,3 +742,116 @@ wdCreateRadialGradientBrush(WD_HCANVAS hCanvas, float cx, float cy, float r,
     float offsets[] = { 0.0f, 1.0f };
     return wdCreateRadialGradientBrushEx(hCanvas, cx, cy, r, cx, cy, colors, offsets, 2);
 }
+
+void
+wdSetLinearGradientBrushPoints(WD_HBRUSH hBrush, float x0, float y0, float x1, float y1)
+{
+    float a[4] = { x0, y0, x1, y1 };
+
+    wd_apitrace_create(WD_APITRACE_OP_SETLINEARBRUSHPOINTS, hBrush, NULL,
+                       a, sizeof(a), NULL, 0, NULL, 0);
+    wd_hook_object_changing(hBrush);
+
+    if(d2d_enabled()) {
+        c_ID2D1LinearGradientBrush* b = (c_ID2D1LinearGradientBrush*) hBrush;
+        c_D2D1_POINT_2F pt0 = { x0, y0 };
+        c_D2D1_POINT_2F pt1 = { x1, y1 };
+
+        c_ID2D1LinearGradientBrush_SetStartPoint(b, pt0);
+        c_ID2D1LinearGradientBrush_SetEndPoint(b, pt1);
+    } else {
+        WD_MATRIX geom;
+
+        brush_linear_geom(x0, y0, x1, y1, &geom);
+        brush_gdix_update((c_GpBrush*) hBrush, c_BrushTypeLinearGradient, &geom, NULL);
+    }
+}
+
+void
+wdSetRadialGradientBrushGeometry(WD_HBRUSH hBrush, float cx, float cy, float r,
+                                 float fx, float fy)
+{
+    float a[5] = { cx, cy, r, fx, fy };
+
+    wd_apitrace_create(WD_APITRACE_OP_SETRADIALBRUSHGEOMETRY, hBrush, NULL,
+                       a, sizeof(a), NULL, 0, NULL, 0);
+    wd_hook_object_changing(hBrush);
+
+    if(d2d_enabled()) {
+        c_ID2D1RadialGradientBrush* b = (c_ID2D1RadialGradientBrush*) hBrush;
+        c_D2D1_POINT_2F center = { cx, cy };
+        c_D2D1_POINT_2F offset = { fx - cx, fy - cy };
+
+        c_ID2D1RadialGradientBrush_SetCenter(b, center);
+        c_ID2D1RadialGradientBrush_SetGradientOriginOffset(b, offset);
+        c_ID2D1RadialGradientBrush_SetRadiusX(b, r);
+        c_ID2D1RadialGradientBrush_SetRadiusY(b, r);
+    } else {
+        c_GpPathGradient* grad = (c_GpPathGradient*) hBrush;
+        c_GpRectF rect;
+        c_GpPointF focal;
+        WD_MATRIX geom;
+        float s;
+        int status;
+
+        /* The path of the brush is still the original circle. Map it onto
+         * the new one. */
+        status = gdix_vtable->fn_GetPathGradientRect(grad, &rect);
+        if(status != 0  ||  rect.w <= 0.0f) {
+            WD_TRACE("wdSetRadialGradientBrushGeometry: "
+                     "GdipGetPathGradientRect() failed. [%d]", status);
+            return;
+        }
+        s = 2.0f * r / rect.w;
+        geom.m11 = s;
+        geom.m12 = 0.0f;
+        geom.m21 = 0.0f;
+        geom.m22 = s;
+        geom.dx = cx - s * (rect.x + 0.5f * rect.w);
+        geom.dy = cy - s * (rect.y + 0.5f * rect.h);
+
+        /* The focal point lives in the path coordinates too. */
+        if(s != 0.0f) {
+            focal.x = (fx - geom.dx) / s;
+            focal.y = (fy - geom.dy) / s;
+            gdix_vtable->fn_SetPathGradientCenterPoint(grad, &focal);
+        }
+
+        brush_gdix_update((c_GpBrush*) grad, c_BrushTypePathGradient, &geom, NULL);
+    }
+}
+
+void
+wdSetBrushTransform(WD_HBRUSH hBrush, const WD_MATRIX* pMatrix)
+{
+    if(pMatrix == NULL)
+        pMatrix = &brush_identity;
+
+    wd_apitrace_create(WD_APITRACE_OP_SETBRUSHTRANSFORM, hBrush, NULL,
+                       pMatrix, sizeof(WD_MATRIX), NULL, 0, NULL, 0);
+    wd_hook_object_changing(hBrush);
+
+    if(d2d_enabled()) {
+        c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
+        c_ID2D1BitmapBrush* bb;
+        c_D2D1_MATRIX_3X2_F m;
+
+        memcpy(&m, pMatrix, sizeof(WD_MATRIX));
+        if(SUCCEEDED(c_ID2D1Brush_QueryInterface(b, &c_IID_ID2D1BitmapBrush, (void**) &bb))) {
+            /* Keep the image brush aligned to the pixel grid (see
+             * wdCreateImageBrush()). */
+            m._31 -= D2D_BASEDELTA_X;
+            m._32 -= D2D_BASEDELTA_Y;
+            c_ID2D1Brush_Release((c_ID2D1Brush*) bb);
+        }
+        c_ID2D1Brush_SetTransform(b, &m);
+    } else {
+        c_GpBrushType type;
+
+        if(gdix_vtable->fn_GetBrushType((c_GpBrush*) hBrush, &type) != 0  ||
+           type == c_BrushTypeSolidColor)
+            return;
+
+        brush_gdix_update((c_GpBrush*) hBrush, type, NULL, pMatrix);
+    }
+}
@@ -40,9 +40,27 @@
 static const GUID c_IID_ID2D1Factory =
         {0x06152247,0x6f50,0x465a,{0x92,0x45,0x11,0x8b,0xfd,0x3b,0x60,0x07}};
 
+static const GUID c_IID_ID2D1BitmapBrush =
+        {0x2cd906aa,0x12e2,0x11dc,{0x9f,0xed,0x00,0x11,0x43,0xa0,0x55,0xf9}};
+
 static const GUID c_IID_ID2D1GdiInteropRenderTarget =
         {0xe0db51c3,0x6f77,0x4bae,{0xb3,0xd5,0xe4,0x75,0x09,0xb3,0x58,0x38}};
 
+static const GUID c_IID_ID2D1LinearGradientBrush =
+        {0x2cd906ab,0x12e2,0x11dc,{0x9f,0xed,0x00,0x11,0x43,0xa0,0x55,0xf9}};
+
+static const GUID c_IID_ID2D1PathGeometry =
+        {0x2cd906a5,0x12e2,0x11dc,{0x9f,0xed,0x00,0x11,0x43,0xa0,0x55,0xf9}};
+
+static const GUID c_IID_ID2D1RadialGradientBrush =
+        {0x2cd906ac,0x12e2,0x11dc,{0x9f,0xed,0x00,0x11,0x43,0xa0,0x55,0xf9}};
+
+static const GUID c_IID_ID2D1SimplifiedGeometrySink =
+        {0x2cd9069e,0x12e2,0x11dc,{0x9f,0xed,0x00,0x11,0x43,0xa0,0x55,0xf9}};
+
+static const GUID c_IID_ID2D1SolidColorBrush =
+        {0x2cd906a9,0x12e2,0x11dc,{0x9f,0xed,0x00,0x11,0x43,0xa0,0x55,0xf9}};
+
 
 /******************************
  ***  Forward declarations  ***
@@ -51,6 +69,7 @@ static const GUID c_IID_ID2D1GdiInteropRenderTarget =
 typedef struct c_IDWriteTextLayout_tag              c_IDWriteTextLayout;
 
 typedef struct c_ID2D1Bitmap_tag                    c_ID2D1Bitmap;
+typedef struct c_ID2D1BitmapBrush_tag               c_ID2D1BitmapBrush;
 typedef struct c_ID2D1BitmapRenderTarget_tag        c_ID2D1BitmapRenderTarget;
 typedef struct c_ID2D1Brush_tag                     c_ID2D1Brush;
 typedef struct c_ID2D1StrokeStyle_tag               c_ID2D1StrokeStyle;
@@ -61,12 +80,15 @@ typedef struct c_ID2D1Geometry_tag                  c_ID2D1Geometry;
 typedef struct c_ID2D1GeometrySink_tag              c_ID2D1GeometrySink;
 typedef struct c_ID2D1HwndRenderTarget_tag          c_ID2D1HwndRenderTarget;
 typedef struct c_ID2D1Layer_tag                     c_ID2D1Layer;
+typedef struct c_ID2D1Mesh_tag                      c_ID2D1Mesh;
 typedef struct c_ID2D1PathGeometry_tag              c_ID2D1PathGeometry;
 typedef struct c_ID2D1RenderTarget_tag              c_ID2D1RenderTarget;
+typedef struct c_ID2D1SimplifiedGeometrySink_tag    c_ID2D1SimplifiedGeometrySink;
 typedef struct c_ID2D1SolidColorBrush_tag           c_ID2D1SolidColorBrush;
 typedef struct c_ID2D1LinearGradientBrush_tag       c_ID2D1LinearGradientBrush;
 typedef struct c_ID2D1RadialGradientBrush_tag       c_ID2D1RadialGradientBrush;
 typedef struct c_ID2D1GradientStopCollection_tag    c_ID2D1GradientStopCollection;
+typedef struct c_ID2D1TessellationSink_tag          c_ID2D1TessellationSink;
 
 
 /*****************************
@@ -75,22 +97,29 @@ typedef struct c_ID2D1GradientStopCollection_tag    c_ID2D1GradientStopCollectio
 
 #define c_D2D1_DRAW_TEXT_OPTIONS_CLIP               0x00000002
 #define c_D2D1_PRESENT_OPTIONS_NONE                 0x00000000
+#define c_D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS      0x00000001
 #define c_D2D1_LAYER_OPTIONS_NONE                   0x00000000
 #define c_D2D1_RENDER_TARGET_USAGE_GDI_COMPATIBLE   0x00000002
+#define c_D2D1_COMPATIBLE_RENDER_TARGET_OPTIONS_NONE 0x00000000
 
 typedef enum c_D2D1_TEXT_ANTIALIAS_MODE_tag c_D2D1_TEXT_ANTIALIAS_MODE;
 enum  c_D2D1_TEXT_ANTIALIAS_MODE_tag {
-    c_D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE = 1
+    c_D2D1_TEXT_ANTIALIAS_MODE_DEFAULT = 0,
+    c_D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE = 1,
+    c_D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE = 2,
+    c_D2D1_TEXT_ANTIALIAS_MODE_ALIASED = 3
 };
 
 typedef enum c_DXGI_FORMAT_tag c_DXGI_FORMAT;
 enum c_DXGI_FORMAT_tag {
+    c_DXGI_FORMAT_A8_UNORM = 65,
     c_DXGI_FORMAT_B8G8R8A8_UNORM = 87
 };
 
 typedef enum c_D2D1_ANTIALIAS_MODE_tag c_D2D1_ANTIALIAS_MODE;
 enum c_D2D1_ANTIALIAS_MODE_tag {
-    c_D2D1_ANTIALIAS_MODE_PER_PRIMITIVE = 0
+    c_D2D1_ANTIALIAS_MODE_PER_PRIMITIVE = 0,
+    c_D2D1_ANTIALIAS_MODE_ALIASED = 1
 };
 
 typedef enum c_D2D1_ALPHA_MODE_tag c_D2D1_ALPHA_MODE;
@@ -188,6 +217,32 @@ enum c_D2D1_GAMMA_tag {
     c_D2D1_GAMMA_FORCE_DWORD = 2
 };
 
+typedef enum c_D2D1_OPACITY_MASK_CONTENT_tag c_D2D1_OPACITY_MASK_CONTENT;
+enum c_D2D1_OPACITY_MASK_CONTENT_tag {
+    c_D2D1_OPACITY_MASK_CONTENT_GRAPHICS = 0,
+    c_D2D1_OPACITY_MASK_CONTENT_TEXT_NATURAL = 1,
+    c_D2D1_OPACITY_MASK_CONTENT_TEXT_GDI_COMPATIBLE = 2
+};
+
+typedef enum c_D2D1_FILL_MODE_tag c_D2D1_FILL_MODE;
+enum c_D2D1_FILL_MODE_tag {
+    c_D2D1_FILL_MODE_ALTERNATE = 0,
+    c_D2D1_FILL_MODE_WINDING = 1
+};
+
+typedef enum c_D2D1_GEOMETRY_SIMPLIFICATION_OPTION_tag c_D2D1_GEOMETRY_SIMPLIFICATION_OPTION;
+enum c_D2D1_GEOMETRY_SIMPLIFICATION_OPTION_tag {
+    c_D2D1_GEOMETRY_SIMPLIFICATION_OPTION_CUBICS_AND_LINES = 0,
+    c_D2D1_GEOMETRY_SIMPLIFICATION_OPTION_LINES = 1
+};
+
+typedef enum c_D2D1_PATH_SEGMENT_tag c_D2D1_PATH_SEGMENT;
+enum c_D2D1_PATH_SEGMENT_tag {
+    c_D2D1_PATH_SEGMENT_NONE = 0,
+    c_D2D1_PATH_SEGMENT_FORCE_UNSTROKED = 1,
+    c_D2D1_PATH_SEGMENT_FORCE_ROUND_LINE_JOIN = 2
+};
+
 typedef enum c_D2D1_EXTEND_MODE_tag c_D2D1_EXTEND_MODE;
 enum c_D2D1_EXTEND_MODE_tag {
     c_D2D1_EXTEND_MODE_CLAMP = 0,
@@ -215,6 +270,18 @@ typedef struct D2D_SIZE_U                       c_D2D1_SIZE_U;
  ***  Helper Structures  ***
  ***************************/
 
+struct c_D2D1_BRUSH_PROPERTIES_tag {
+    FLOAT opacity;
+    c_D2D1_MATRIX_3X2_F transform;
+};
+
+typedef struct c_D2D1_BITMAP_BRUSH_PROPERTIES_tag c_D2D1_BITMAP_BRUSH_PROPERTIES;
+struct c_D2D1_BITMAP_BRUSH_PROPERTIES_tag {
+    c_D2D1_EXTEND_MODE extendModeX;
+    c_D2D1_EXTEND_MODE extendModeY;
+    c_D2D1_BITMAP_INTERPOLATION_MODE interpolationMode;
+};
+
 typedef struct c_D2D1_LINEAR_GRADIENT_BRUSH_PROPERTIES_tag c_D2D1_LINEAR_GRADIENT_BRUSH_PROPERTIES;
 struct c_D2D1_LINEAR_GRADIENT_BRUSH_PROPERTIES_tag {
     c_D2D1_POINT_2F startPoint;
@@ -251,6 +318,13 @@ struct c_D2D1_BEZIER_SEGMENT_tag {
     c_D2D1_POINT_2F point3;
 };
 
+typedef struct c_D2D1_TRIANGLE_tag c_D2D1_TRIANGLE;
+struct c_D2D1_TRIANGLE_tag {
+    c_D2D1_POINT_2F point1;
+    c_D2D1_POINT_2F point2;
+    c_D2D1_POINT_2F point3;
+};
+
 typedef struct c_D2D1_ELLIPSE_tag c_D2D1_ELLIPSE;
 struct c_D2D1_ELLIPSE_tag {
     c_D2D1_POINT_2F point;
@@ -440,7 +514,7 @@ struct c_ID2D1BitmapRenderTargetVtbl_tag {
     STDMETHOD(dummy_IsSupported)(void);
 
     /* ID2D1BitmapRenderTarget methods */
-    STDMETHOD(dummy_GetBitmap)(void);
+    STDMETHOD(GetBitmap)(c_ID2D1BitmapRenderTarget*, c_ID2D1Bitmap**);
 };
 
 struct c_ID2D1BitmapRenderTarget_tag {
@@ -450,6 +524,7 @@ struct c_ID2D1BitmapRenderTarget_tag {
 #define c_ID2D1BitmapRenderTarget_QueryInterface(self,a,b)  (self)->vtbl->QueryInterface(self,a,b)
 #define c_ID2D1BitmapRenderTarget_AddRef(self)              (self)->vtbl->AddRef(self)
 #define c_ID2D1BitmapRenderTarget_Release(self)             (self)->vtbl->Release(self)
+#define c_ID2D1BitmapRenderTarget_GetBitmap(self,a)         (self)->vtbl->GetBitmap(self,a)
 
 
 /******************************
@@ -468,9 +543,9 @@ struct c_ID2D1BrushVtbl_tag {
 
     /* ID2D1Brush methods */
     STDMETHOD(dummy_SetOpacity)(void);
-    STDMETHOD(dummy_SetTransform)(void);
+    STDMETHOD_(void, SetTransform)(c_ID2D1Brush*, const c_D2D1_MATRIX_3X2_F*);
     STDMETHOD(dummy_GetOpacity)(void);
-    STDMETHOD(dummy_GetTransform)(void);
+    STDMETHOD_(void, GetTransform)(c_ID2D1Brush*, c_D2D1_MATRIX_3X2_F*);
 };
 
 struct c_ID2D1Brush_tag {
@@ -480,6 +555,8 @@ struct c_ID2D1Brush_tag {
 #define c_ID2D1Brush_QueryInterface(self,a,b)               (self)->vtbl->QueryInterface(self,a,b)
 #define c_ID2D1Brush_AddRef(self)                           (self)->vtbl->AddRef(self)
 #define c_ID2D1Brush_Release(self)                          (self)->vtbl->Release(self)
+#define c_ID2D1Brush_SetTransform(self,a)                   (self)->vtbl->SetTransform(self,a)
+#define c_ID2D1Brush_GetTransform(self,a)                   (self)->vtbl->GetTransform(self,a)
 
 
 /***********************************
@@ -497,15 +574,15 @@ struct c_ID2D1StrokeStyleVtbl_tag {
     STDMETHOD(dummy_GetFactory)(void);
 
     /* ID2D1StrokeStyle methods */
-    STDMETHOD(dummy_GetStartCap)(void);
+    STDMETHOD_(c_D2D1_CAP_STYLE, GetStartCap)(c_ID2D1StrokeStyle*);
     STDMETHOD(dummy_GetEndCap)(void);
     STDMETHOD(dummy_GetDashCap)(void);
     STDMETHOD(dummy_GetMiterLimit)(void);
-    STDMETHOD(dummy_GetLineJoin)(void);
+    STDMETHOD_(c_D2D1_LINE_JOIN, GetLineJoin)(c_ID2D1StrokeStyle*);
     STDMETHOD(dummy_GetDashOffset)(void);
-    STDMETHOD(dummy_GetDashStyle)(void);
-    STDMETHOD(dummy_GetDashesCount)(void);
-    STDMETHOD(dummy_GetDashes)(void);
+    STDMETHOD_(c_D2D1_DASH_STYLE, GetDashStyle)(c_ID2D1StrokeStyle*);
+    STDMETHOD_(UINT32, GetDashesCount)(c_ID2D1StrokeStyle*);
+    STDMETHOD_(void, GetDashes)(c_ID2D1StrokeStyle*, FLOAT*, UINT32);
 };
 
 struct c_ID2D1StrokeStyle_tag {
@@ -515,6 +592,11 @@ struct c_ID2D1StrokeStyle_tag {
 #define c_ID2D1StrokeStyle_QueryInterface(self,a,b)               (self)->vtbl->QueryInterface(self,a,b)
 #define c_ID2D1StrokeStyle_AddRef(self)                           (self)->vtbl->AddRef(self)
 #define c_ID2D1StrokeStyle_Release(self)                          (self)->vtbl->Release(self)
+#define c_ID2D1StrokeStyle_GetStartCap(self)                      (self)->vtbl->GetStartCap(self)
+#define c_ID2D1StrokeStyle_GetLineJoin(self)                      (self)->vtbl->GetLineJoin(self)
+#define c_ID2D1StrokeStyle_GetDashStyle(self)                     (self)->vtbl->GetDashStyle(self)
+#define c_ID2D1StrokeStyle_GetDashesCount(self)                   (self)->vtbl->GetDashesCount(self)
+#define c_ID2D1StrokeStyle_GetDashes(self,a,b)                    (self)->vtbl->GetDashes(self,a,b)
 
 
 /*****************************************
@@ -618,7 +700,9 @@ struct c_ID2D1FactoryVtbl_tag {
     STDMETHOD(dummy_CreateRoundedRectangleGeometry)(void);
     STDMETHOD(dummy_CreateEllipseGeometry)(void);
     STDMETHOD(dummy_CreateGeometryGroup)(void);
-    STDMETHOD(dummy_CreateTransformedGeometry)(void);
+    /* The original returns ID2D1TransformedGeometry. We only ever use the
+     * ID2D1Geometry methods of it so we declare it this way. */
+    STDMETHOD(CreateTransformedGeometry)(c_ID2D1Factory*, c_ID2D1Geometry*, const c_D2D1_MATRIX_3X2_F*, c_ID2D1Geometry**);
     STDMETHOD(CreatePathGeometry)(c_ID2D1Factory*, c_ID2D1PathGeometry**);
     STDMETHOD(CreateStrokeStyle)(c_ID2D1Factory*, const c_D2D1_STROKE_STYLE_PROPERTIES*, const FLOAT*, UINT32, c_ID2D1StrokeStyle**);
     STDMETHOD(dummy_CreateDrawingStateBlock)(void);
@@ -636,6 +720,7 @@ struct c_ID2D1Factory_tag {
 #define c_ID2D1Factory_QueryInterface(self,a,b)             (self)->vtbl->QueryInterface(self,a,b)
 #define c_ID2D1Factory_AddRef(self)                         (self)->vtbl->AddRef(self)
 #define c_ID2D1Factory_Release(self)                        (self)->vtbl->Release(self)
+#define c_ID2D1Factory_CreateTransformedGeometry(self,a,b,c) (self)->vtbl->CreateTransformedGeometry(self,a,b,c)
 #define c_ID2D1Factory_CreatePathGeometry(self,a)           (self)->vtbl->CreatePathGeometry(self,a)
 #define c_ID2D1Factory_CreateHwndRenderTarget(self,a,b,c)   (self)->vtbl->CreateHwndRenderTarget(self,a,b,c)
 #define c_ID2D1Factory_CreateDCRenderTarget(self,a,b)       (self)->vtbl->CreateDCRenderTarget(self,a,b)
@@ -684,17 +769,19 @@ struct c_ID2D1GeometryVtbl_tag {
     STDMETHOD(dummy_GetFactory)(void);
 
     /* ID2D1Geometry methods */
-    STDMETHOD(dummy_GetBounds)(void);
+    STDMETHOD(GetBounds)(c_ID2D1Geometry*, const c_D2D1_MATRIX_3X2_F*, c_D2D1_RECT_F*);
     STDMETHOD(dummy_GetWidenedBounds)(void);
-    STDMETHOD(dummy_StrokeContainsPoint)(void);
-    STDMETHOD(dummy_FillContainsPoint)(void);
+    STDMETHOD(StrokeContainsPoint)(c_ID2D1Geometry*, c_D2D1_POINT_2F, FLOAT, c_ID2D1StrokeStyle*,
+            const c_D2D1_MATRIX_3X2_F*, FLOAT, BOOL*);
+    STDMETHOD(FillContainsPoint)(c_ID2D1Geometry*, c_D2D1_POINT_2F, const c_D2D1_MATRIX_3X2_F*, FLOAT, BOOL*);
     STDMETHOD(dummy_CompareWithGeometry)(void);
-    STDMETHOD(dummy_Simplify)(void);
-    STDMETHOD(dummy_Tessellate)(void);
+    STDMETHOD(Simplify)(c_ID2D1Geometry*, c_D2D1_GEOMETRY_SIMPLIFICATION_OPTION,
+            const c_D2D1_MATRIX_3X2_F*, FLOAT, c_ID2D1SimplifiedGeometrySink*);
+    STDMETHOD(Tessellate)(c_ID2D1Geometry*, const c_D2D1_MATRIX_3X2_F*, FLOAT, c_ID2D1TessellationSink*);
     STDMETHOD(dummy_CombineWithGeometry)(void);
     STDMETHOD(dummy_Outline)(void);
     STDMETHOD(dummy_ComputeArea)(void);
-    STDMETHOD(dummy_ComputeLength)(void);
+    STDMETHOD(ComputeLength)(c_ID2D1Geometry*, const c_D2D1_MATRIX_3X2_F*, FLOAT, FLOAT*);
     STDMETHOD(dummy_ComputePointAtLength)(void);
     STDMETHOD(dummy_Widen)(void);
 };
@@ -706,6 +793,40 @@ struct c_ID2D1Geometry_tag {
 #define c_ID2D1Geometry_QueryInterface(self,a,b)    (self)->vtbl->QueryInterface(self,a,b)
 #define c_ID2D1Geometry_AddRef(self)                (self)->vtbl->AddRef(self)
 #define c_ID2D1Geometry_Release(self)               (self)->vtbl->Release(self)
+#define c_ID2D1Geometry_GetBounds(self,a,b)         (self)->vtbl->GetBounds(self,a,b)
+#define c_ID2D1Geometry_StrokeContainsPoint(self,a,b,c,d,e,f)  (self)->vtbl->StrokeContainsPoint(self,a,b,c,d,e,f)
+#define c_ID2D1Geometry_FillContainsPoint(self,a,b,c,d)        (self)->vtbl->FillContainsPoint(self,a,b,c,d)
+#define c_ID2D1Geometry_ComputeLength(self,a,b,c)   (self)->vtbl->ComputeLength(self,a,b,c)
+#define c_ID2D1Geometry_Simplify(self,a,b,c,d)      (self)->vtbl->Simplify(self,a,b,c,d)
+#define c_ID2D1Geometry_Tessellate(self,a,b,c)      (self)->vtbl->Tessellate(self,a,b,c)
+
+
+/***********************************************
+ ***  Interface ID2D1SimplifiedGeometrySink  ***
+ ***********************************************/
+
+/* Note this interface is implemented by us (and called by D2D), so all its
+ * methods have to be declared. */
+typedef struct c_ID2D1SimplifiedGeometrySinkVtbl_tag c_ID2D1SimplifiedGeometrySinkVtbl;
+struct c_ID2D1SimplifiedGeometrySinkVtbl_tag {
+    /* IUnknown methods */
+    STDMETHOD(QueryInterface)(c_ID2D1SimplifiedGeometrySink*, REFIID, void**);
+    STDMETHOD_(ULONG, AddRef)(c_ID2D1SimplifiedGeometrySink*);
+    STDMETHOD_(ULONG, Release)(c_ID2D1SimplifiedGeometrySink*);
+
+    /* ID2D1SimplifiedGeometrySink methods */
+    STDMETHOD_(void, SetFillMode)(c_ID2D1SimplifiedGeometrySink*, c_D2D1_FILL_MODE);
+    STDMETHOD_(void, SetSegmentFlags)(c_ID2D1SimplifiedGeometrySink*, c_D2D1_PATH_SEGMENT);
+    STDMETHOD_(void, BeginFigure)(c_ID2D1SimplifiedGeometrySink*, c_D2D1_POINT_2F, c_D2D1_FIGURE_BEGIN);
+    STDMETHOD_(void, AddLines)(c_ID2D1SimplifiedGeometrySink*, const c_D2D1_POINT_2F*, UINT32);
+    STDMETHOD_(void, AddBeziers)(c_ID2D1SimplifiedGeometrySink*, const c_D2D1_BEZIER_SEGMENT*, UINT32);
+    STDMETHOD_(void, EndFigure)(c_ID2D1SimplifiedGeometrySink*, c_D2D1_FIGURE_END);
+    STDMETHOD(Close)(c_ID2D1SimplifiedGeometrySink*);
+};
+
+struct c_ID2D1SimplifiedGeometrySink_tag {
+    c_ID2D1SimplifiedGeometrySinkVtbl* vtbl;
+};
 
 
 /*************************************
@@ -723,8 +844,8 @@ struct c_ID2D1GeometrySinkVtbl_tag {
     STDMETHOD(dummy_SetFillMode)(void);
     STDMETHOD(dummy_SetSegmentFlags)(void);
     STDMETHOD_(void, BeginFigure)(c_ID2D1GeometrySink*, c_D2D1_POINT_2F, c_D2D1_FIGURE_BEGIN);
-    STDMETHOD(dummy_AddLines)(void);
-    STDMETHOD(dummy_AddBeziers)(void);
+    STDMETHOD_(void, AddLines)(c_ID2D1GeometrySink*, const c_D2D1_POINT_2F*, UINT32);
+    STDMETHOD_(void, AddBeziers)(c_ID2D1GeometrySink*, const c_D2D1_BEZIER_SEGMENT*, UINT32);
     STDMETHOD_(void, EndFigure)(c_ID2D1GeometrySink*, c_D2D1_FIGURE_END);
     STDMETHOD(Close)(c_ID2D1GeometrySink*) PURE;
 
@@ -744,6 +865,8 @@ struct c_ID2D1GeometrySink_tag {
 #define c_ID2D1GeometrySink_AddRef(self)                (self)->vtbl->AddRef(self)
 #define c_ID2D1GeometrySink_Release(self)               (self)->vtbl->Release(self)
 #define c_ID2D1GeometrySink_BeginFigure(self,a,b)       (self)->vtbl->BeginFigure(self,a,b)
+#define c_ID2D1GeometrySink_AddLines(self,a,b)          (self)->vtbl->AddLines(self,a,b)
+#define c_ID2D1GeometrySink_AddBeziers(self,a,b)        (self)->vtbl->AddBeziers(self,a,b)
 #define c_ID2D1GeometrySink_EndFigure(self,a)           (self)->vtbl->EndFigure(self,a)
 #define c_ID2D1GeometrySink_Close(self)                 (self)->vtbl->Close(self)
 #define c_ID2D1GeometrySink_AddLine(self,a)             (self)->vtbl->AddLine(self,a)
@@ -863,6 +986,34 @@ struct c_ID2D1Layer_tag {
 #define c_ID2D1Layer_Release(self)              (self)->vtbl->Release(self)
 
 
+/*****************************
+ ***  Interface ID2D1Mesh  ***
+ *****************************/
+
+typedef struct c_ID2D1MeshVtbl_tag c_ID2D1MeshVtbl;
+struct c_ID2D1MeshVtbl_tag {
+    /* IUnknown methods */
+    STDMETHOD(QueryInterface)(c_ID2D1Mesh*, REFIID, void**);
+    STDMETHOD_(ULONG, AddRef)(c_ID2D1Mesh*);
+    STDMETHOD_(ULONG, Release)(c_ID2D1Mesh*);
+
+    /* ID2D1Resource methods */
+    STDMETHOD(dummy_GetFactory)(void);
+
+    /* ID2D1Mesh methods */
+    STDMETHOD(Open)(c_ID2D1Mesh*, c_ID2D1TessellationSink**);
+};
+
+struct c_ID2D1Mesh_tag {
+    c_ID2D1MeshVtbl* vtbl;
+};
+
+#define c_ID2D1Mesh_QueryInterface(self,a,b)    (self)->vtbl->QueryInterface(self,a,b)
+#define c_ID2D1Mesh_AddRef(self)                (self)->vtbl->AddRef(self)
+#define c_ID2D1Mesh_Release(self)               (self)->vtbl->Release(self)
+#define c_ID2D1Mesh_Open(self,a)                (self)->vtbl->Open(self,a)
+
+
 /*************************************
  ***  Interface ID2D1PathGeometry  ***
  *************************************/
@@ -927,14 +1078,14 @@ struct c_ID2D1RenderTargetVtbl_tag {
     STDMETHOD(dummy_CreateBitmap)(void);
     STDMETHOD(CreateBitmapFromWicBitmap)(c_ID2D1RenderTarget*, IWICBitmapSource*, const c_D2D1_BITMAP_PROPERTIES*, c_ID2D1Bitmap**);
     STDMETHOD(dummy_CreateSharedBitmap)(void);
-    STDMETHOD(dummy_CreateBitmapBrush)(void);
+    STDMETHOD(CreateBitmapBrush)(c_ID2D1RenderTarget*, c_ID2D1Bitmap*, const c_D2D1_BITMAP_BRUSH_PROPERTIES*, const c_D2D1_BRUSH_PROPERTIES*, c_ID2D1BitmapBrush**);
     STDMETHOD(CreateSolidColorBrush)(c_ID2D1RenderTarget*, const c_D2D1_COLOR_F*, const void*, c_ID2D1SolidColorBrush**);
     STDMETHOD(CreateGradientStopCollection)(c_ID2D1RenderTarget*, const c_D2D1_GRADIENT_STOP*, UINT32, c_D2D1_GAMMA, c_D2D1_EXTEND_MODE, c_ID2D1GradientStopCollection**);
     STDMETHOD(CreateLinearGradientBrush)(c_ID2D1RenderTarget*, const c_D2D1_LINEAR_GRADIENT_BRUSH_PROPERTIES*, const c_D2D1_BRUSH_PROPERTIES*, c_ID2D1GradientStopCollection*, c_ID2D1LinearGradientBrush**);
     STDMETHOD(CreateRadialGradientBrush)(c_ID2D1RenderTarget*, const c_D2D1_RADIAL_GRADIENT_BRUSH_PROPERTIES*, const c_D2D1_BRUSH_PROPERTIES*, c_ID2D1GradientStopCollection*, c_ID2D1RadialGradientBrush**);
-    STDMETHOD(dummy_CreateCompatibleRenderTarget)(void);
+    STDMETHOD(CreateCompatibleRenderTarget)(c_ID2D1RenderTarget*, const c_D2D1_SIZE_F*, const c_D2D1_SIZE_U*, const c_D2D1_PIXEL_FORMAT*, unsigned, c_ID2D1BitmapRenderTarget**);
     STDMETHOD(CreateLayer)(c_ID2D1RenderTarget*, const c_D2D1_SIZE_F*, c_ID2D1Layer**);
-    STDMETHOD(dummy_CreateMesh)(void);
+    STDMETHOD(CreateMesh)(c_ID2D1RenderTarget*, c_ID2D1Mesh**);
     STDMETHOD_(void, DrawLine)(c_ID2D1RenderTarget*, c_D2D1_POINT_2F, c_D2D1_POINT_2F, c_ID2D1Brush*, FLOAT, c_ID2D1StrokeStyle*);
     STDMETHOD_(void, DrawRectangle)(c_ID2D1RenderTarget*, const c_D2D1_RECT_F*, c_ID2D1Brush*, FLOAT, c_ID2D1StrokeStyle*);
     STDMETHOD_(void, FillRectangle)(c_ID2D1RenderTarget*, const c_D2D1_RECT_F*, c_ID2D1Brush*);
@@ -944,8 +1095,8 @@ struct c_ID2D1RenderTargetVtbl_tag {
     STDMETHOD_(void, FillEllipse)(c_ID2D1RenderTarget*, const c_D2D1_ELLIPSE*, c_ID2D1Brush*);
     STDMETHOD_(void, DrawGeometry)(c_ID2D1RenderTarget*, c_ID2D1Geometry*, c_ID2D1Brush*, FLOAT, c_ID2D1StrokeStyle*);
     STDMETHOD_(void, FillGeometry)(c_ID2D1RenderTarget*, c_ID2D1Geometry*, c_ID2D1Brush*, c_ID2D1Brush*);
-    STDMETHOD(dummy_FillMesh)(void);
-    STDMETHOD(dummy_FillOpacityMask)(void);
+    STDMETHOD_(void, FillMesh)(c_ID2D1RenderTarget*, c_ID2D1Mesh*, c_ID2D1Brush*);
+    STDMETHOD_(void, FillOpacityMask)(c_ID2D1RenderTarget*, c_ID2D1Bitmap*, c_ID2D1Brush*, c_D2D1_OPACITY_MASK_CONTENT, const c_D2D1_RECT_F*, const c_D2D1_RECT_F*);
     STDMETHOD_(void, DrawBitmap)(c_ID2D1RenderTarget*, c_ID2D1Bitmap*, const c_D2D1_RECT_F*, FLOAT,
                                  c_D2D1_BITMAP_INTERPOLATION_MODE, const c_D2D1_RECT_F*);
     STDMETHOD(dummy_DrawText)(void);
@@ -953,8 +1104,8 @@ struct c_ID2D1RenderTargetVtbl_tag {
     STDMETHOD_(void, DrawGlyphRun)(c_ID2D1RenderTarget*, c_D2D1_POINT_2F, const c_DWRITE_GLYPH_RUN*, c_ID2D1Brush*, c_DWRITE_MEASURING_MODE);
     STDMETHOD_(void, SetTransform)(c_ID2D1RenderTarget*, const c_D2D1_MATRIX_3X2_F*);
     STDMETHOD_(void, GetTransform)(c_ID2D1RenderTarget*, c_D2D1_MATRIX_3X2_F*);
-    STDMETHOD(dummy_SetAntialiasMode)(void);
-    STDMETHOD(dummy_GetAntialiasMode)(void);
+    STDMETHOD_(void, SetAntialiasMode)(c_ID2D1RenderTarget*, c_D2D1_ANTIALIAS_MODE);
+    STDMETHOD_(c_D2D1_ANTIALIAS_MODE, GetAntialiasMode)(c_ID2D1RenderTarget*);
     STDMETHOD(SetTextAntialiasMode)(c_ID2D1RenderTarget*, c_D2D1_TEXT_ANTIALIAS_MODE);
     STDMETHOD(dummy_GetTextAntialiasMode)(void);
     STDMETHOD(dummy_SetTextRenderingParams)(void);
@@ -974,8 +1125,12 @@ struct c_ID2D1RenderTargetVtbl_tag {
     STDMETHOD(dummy_GetPixelFormat)(void);
     STDMETHOD_(void, SetDpi)(c_ID2D1RenderTarget*, FLOAT, FLOAT);
     STDMETHOD_(void, GetDpi)(c_ID2D1RenderTarget*, FLOAT*, FLOAT*);
-    STDMETHOD(dummy_GetSize)(void);
-    STDMETHOD(dummy_GetPixelSize)(void);
+    /* The original returns D2D1_SIZE_F. See the comment for
+     * ID2D1Bitmap::GetPixelSize() why we declare it this way. */
+    STDMETHOD_(void, GetSize)(c_ID2D1RenderTarget*, c_D2D1_SIZE_F*);
+    /* The original returns D2D1_SIZE_U. See the comment for
+     * ID2D1Bitmap::GetPixelSize() why we declare it this way. */
+    STDMETHOD_(void, GetPixelSize)(c_ID2D1RenderTarget*, c_D2D1_SIZE_U*);
     STDMETHOD(dummy_GetMaximumBitmapSize)(void);
     STDMETHOD(dummy_IsSupported)(void);
 };
@@ -988,11 +1143,14 @@ struct c_ID2D1RenderTarget_tag {
 #define c_ID2D1RenderTarget_AddRef(self)                            (self)->vtbl->AddRef(self)
 #define c_ID2D1RenderTarget_Release(self)                           (self)->vtbl->Release(self)
 #define c_ID2D1RenderTarget_CreateBitmapFromWicBitmap(self,a,b,c)   (self)->vtbl->CreateBitmapFromWicBitmap(self,a,b,c)
+#define c_ID2D1RenderTarget_CreateBitmapBrush(self,a,b,c,d)         (self)->vtbl->CreateBitmapBrush(self,a,b,c,d)
 #define c_ID2D1RenderTarget_CreateSolidColorBrush(self,a,b,c)       (self)->vtbl->CreateSolidColorBrush(self,a,b,c)
 #define c_ID2D1RenderTarget_CreateLinearGradientBrush(self,a,b,c,d) (self)->vtbl->CreateLinearGradientBrush(self,a,b,c,d)
 #define c_ID2D1RenderTarget_CreateRadialGradientBrush(self,a,b,c,d) (self)->vtbl->CreateRadialGradientBrush(self,a,b,c,d)
 #define c_ID2D1RenderTarget_CreateGradientStopCollection(self,a,b,c,d,e) (self)->vtbl->CreateGradientStopCollection(self,a,b,c,d,e)
+#define c_ID2D1RenderTarget_CreateCompatibleRenderTarget(self,a,b,c,d,e) (self)->vtbl->CreateCompatibleRenderTarget(self,a,b,c,d,e)
 #define c_ID2D1RenderTarget_CreateLayer(self,a,b)                   (self)->vtbl->CreateLayer(self,a,b)
+#define c_ID2D1RenderTarget_CreateMesh(self,a)                      (self)->vtbl->CreateMesh(self,a)
 #define c_ID2D1RenderTarget_DrawLine(self,a,b,c,d,e)                (self)->vtbl->DrawLine(self,a,b,c,d,e)
 #define c_ID2D1RenderTarget_DrawRectangle(self,a,b,c,d)             (self)->vtbl->DrawRectangle(self,a,b,c,d)
 #define c_ID2D1RenderTarget_FillRectangle(self,a,b)                 (self)->vtbl->FillRectangle(self,a,b)
@@ -1000,11 +1158,15 @@ struct c_ID2D1RenderTarget_tag {
 #define c_ID2D1RenderTarget_FillEllipse(self,a,b)                   (self)->vtbl->FillEllipse(self,a,b)
 #define c_ID2D1RenderTarget_DrawGeometry(self,a,b,c,d)              (self)->vtbl->DrawGeometry(self,a,b,c,d)
 #define c_ID2D1RenderTarget_FillGeometry(self,a,b,c)                (self)->vtbl->FillGeometry(self,a,b,c)
+#define c_ID2D1RenderTarget_FillMesh(self,a,b)                      (self)->vtbl->FillMesh(self,a,b)
+#define c_ID2D1RenderTarget_FillOpacityMask(self,a,b,c,d,e)         (self)->vtbl->FillOpacityMask(self,a,b,c,d,e)
 #define c_ID2D1RenderTarget_DrawBitmap(self,a,b,c,d,e)              (self)->vtbl->DrawBitmap(self,a,b,c,d,e)
 #define c_ID2D1RenderTarget_DrawTextLayout(self,a,b,c,d)            (self)->vtbl->DrawTextLayout(self,a,b,c,d)
 #define c_ID2D1RenderTarget_DrawGlyphRun(self,a,b,c,d)              (self)->vtbl->DrawGlyphRun(self,a,b,c,d)
 #define c_ID2D1RenderTarget_SetTransform(self,a)                    (self)->vtbl->SetTransform(self,a)
 #define c_ID2D1RenderTarget_GetTransform(self,a)                    (self)->vtbl->GetTransform(self,a)
+#define c_ID2D1RenderTarget_SetAntialiasMode(self,a)                (self)->vtbl->SetAntialiasMode(self,a)
+#define c_ID2D1RenderTarget_GetAntialiasMode(self)                  (self)->vtbl->GetAntialiasMode(self)
 #define c_ID2D1RenderTarget_SetTextAntialiasMode(self,a)            (self)->vtbl->SetTextAntialiasMode(self,a)
 #define c_ID2D1RenderTarget_PushLayer(self,a,b)                     (self)->vtbl->PushLayer(self,a,b)
 #define c_ID2D1RenderTarget_PopLayer(self)                          (self)->vtbl->PopLayer(self)
@@ -1015,6 +1177,8 @@ struct c_ID2D1RenderTarget_tag {
 #define c_ID2D1RenderTarget_EndDraw(self,a,b)                       (self)->vtbl->EndDraw(self,a,b)
 #define c_ID2D1RenderTarget_SetDpi(self,a,b)                        (self)->vtbl->SetDpi(self,a,b)
 #define c_ID2D1RenderTarget_GetDpi(self,a,b)                        (self)->vtbl->GetDpi(self,a,b)
+#define c_ID2D1RenderTarget_GetSize(self,a)                         (self)->vtbl->GetSize(self,a)
+#define c_ID2D1RenderTarget_GetPixelSize(self,a)                    (self)->vtbl->GetPixelSize(self,a)
 
 
 /*********************************************
@@ -1039,7 +1203,9 @@ struct c_ID2D1SolidColorBrushVtbl_tag {
 
     /* ID2D1SolidColorBrushBrush methods */
     STDMETHOD_(void, SetColor)(c_ID2D1SolidColorBrush*, const c_D2D1_COLOR_F*);
-    STDMETHOD(dummy_GetColor)(void);
+    /* The original returns D2D1_COLOR_F. See the comment for
+     * ID2D1Bitmap::GetPixelSize() why we declare it this way. */
+    STDMETHOD_(void, GetColor)(c_ID2D1SolidColorBrush*, c_D2D1_COLOR_F*);
 };
 
 struct c_ID2D1SolidColorBrush_tag {
@@ -1050,6 +1216,7 @@ struct c_ID2D1SolidColorBrush_tag {
 #define c_ID2D1SolidColorBrush_AddRef(self)                 (self)->vtbl->AddRef(self)
 #define c_ID2D1SolidColorBrush_Release(self)                (self)->vtbl->Release(self)
 #define c_ID2D1SolidColorBrush_SetColor(self,a)             (self)->vtbl->SetColor(self,a)
+#define c_ID2D1SolidColorBrush_GetColor(self,a)             (self)->vtbl->GetColor(self,a)
 
 
 /*********************************************
@@ -1068,16 +1235,18 @@ struct c_ID2D1LinearGradientBrushVtbl_tag {
 
     /* ID2D1Brush methods */
     STDMETHOD(dummy_SetOpacity)(void);
-    STDMETHOD(dummy_SetTransform)(void);
+    STDMETHOD_(void, SetTransform)(c_ID2D1LinearGradientBrush*, const c_D2D1_MATRIX_3X2_F*);
     STDMETHOD(dummy_GetOpacity)(void);
     STDMETHOD(dummy_GetTransform)(void);
 
     /* ID2D1LinearGradientBrush methods */
-    STDMETHOD(dummy_SetStartPoint)(void);
-    STDMETHOD(dummy_SetEndPoint)(void);
-    STDMETHOD(dummy_GetStartPoint)(void);
-    STDMETHOD(dummy_GetEndPoint)(void);
-    STDMETHOD(dummy_GetGradientStopCollection)(void);
+    STDMETHOD_(void, SetStartPoint)(c_ID2D1LinearGradientBrush*, c_D2D1_POINT_2F);
+    STDMETHOD_(void, SetEndPoint)(c_ID2D1LinearGradientBrush*, c_D2D1_POINT_2F);
+    /* The original returns D2D1_POINT_2F. See the comment for
+     * ID2D1Bitmap::GetPixelSize() why we declare it this way. */
+    STDMETHOD_(void, GetStartPoint)(c_ID2D1LinearGradientBrush*, c_D2D1_POINT_2F*);
+    STDMETHOD_(void, GetEndPoint)(c_ID2D1LinearGradientBrush*, c_D2D1_POINT_2F*);
+    STDMETHOD_(void, GetGradientStopCollection)(c_ID2D1LinearGradientBrush*, c_ID2D1GradientStopCollection**);
 };
 
 struct c_ID2D1LinearGradientBrush_tag {
@@ -1087,6 +1256,11 @@ struct c_ID2D1LinearGradientBrush_tag {
 #define c_ID2D1LinearGradientBrush_QueryInterface(self,a,b)     (self)->vtbl->QueryInterface(self,a,b)
 #define c_ID2D1LinearGradientBrush_AddRef(self)                 (self)->vtbl->AddRef(self)
 #define c_ID2D1LinearGradientBrush_Release(self)                (self)->vtbl->Release(self)
+#define c_ID2D1LinearGradientBrush_SetStartPoint(self,a)        (self)->vtbl->SetStartPoint(self,a)
+#define c_ID2D1LinearGradientBrush_SetEndPoint(self,a)          (self)->vtbl->SetEndPoint(self,a)
+#define c_ID2D1LinearGradientBrush_GetStartPoint(self,a)        (self)->vtbl->GetStartPoint(self,a)
+#define c_ID2D1LinearGradientBrush_GetEndPoint(self,a)          (self)->vtbl->GetEndPoint(self,a)
+#define c_ID2D1LinearGradientBrush_GetGradientStopCollection(self,a) (self)->vtbl->GetGradientStopCollection(self,a)
 
 
 /*********************************************
@@ -1105,20 +1279,22 @@ struct c_ID2D1RadialGradientBrushVtbl_tag {
 
     /* ID2D1Brush methods */
     STDMETHOD(dummy_SetOpacity)(void);
-    STDMETHOD(dummy_SetTransform)(void);
+    STDMETHOD_(void, SetTransform)(c_ID2D1RadialGradientBrush*, const c_D2D1_MATRIX_3X2_F*);
     STDMETHOD(dummy_GetOpacity)(void);
     STDMETHOD(dummy_GetTransform)(void);
 
     /* ID2D1RadialGradientBrush methods */
-    STDMETHOD(dummy_SetCenter)(void);
-    STDMETHOD(dummy_SetGradientOriginOffset)(void);
-    STDMETHOD(dummy_SetRadiusX)(void);
-    STDMETHOD(dummy_SetRadiusY)(void);
-    STDMETHOD(dummy_GetCenter)(void);
-    STDMETHOD(dummy_GetGradientOriginOffset)(void);
-    STDMETHOD(dummy_GetRadiusX)(void);
-    STDMETHOD(dummy_GetRadiusY)(void);
-    STDMETHOD(dummy_GetGradientStopCollection)(void);
+    STDMETHOD_(void, SetCenter)(c_ID2D1RadialGradientBrush*, c_D2D1_POINT_2F);
+    STDMETHOD_(void, SetGradientOriginOffset)(c_ID2D1RadialGradientBrush*, c_D2D1_POINT_2F);
+    STDMETHOD_(void, SetRadiusX)(c_ID2D1RadialGradientBrush*, FLOAT);
+    STDMETHOD_(void, SetRadiusY)(c_ID2D1RadialGradientBrush*, FLOAT);
+    /* The original returns D2D1_POINT_2F. See the comment for
+     * ID2D1Bitmap::GetPixelSize() why we declare it this way. */
+    STDMETHOD_(void, GetCenter)(c_ID2D1RadialGradientBrush*, c_D2D1_POINT_2F*);
+    STDMETHOD_(void, GetGradientOriginOffset)(c_ID2D1RadialGradientBrush*, c_D2D1_POINT_2F*);
+    STDMETHOD_(FLOAT, GetRadiusX)(c_ID2D1RadialGradientBrush*);
+    STDMETHOD_(FLOAT, GetRadiusY)(c_ID2D1RadialGradientBrush*);
+    STDMETHOD_(void, GetGradientStopCollection)(c_ID2D1RadialGradientBrush*, c_ID2D1GradientStopCollection**);
 };
 
 struct c_ID2D1RadialGradientBrush_tag {
@@ -1128,6 +1304,15 @@ struct c_ID2D1RadialGradientBrush_tag {
 #define c_ID2D1RadialGradientBrush_QueryInterface(self,a,b)     (self)->vtbl->QueryInterface(self,a,b)
 #define c_ID2D1RadialGradientBrush_AddRef(self)                 (self)->vtbl->AddRef(self)
 #define c_ID2D1RadialGradientBrush_Release(self)                (self)->vtbl->Release(self)
+#define c_ID2D1RadialGradientBrush_SetCenter(self,a)            (self)->vtbl->SetCenter(self,a)
+#define c_ID2D1RadialGradientBrush_SetGradientOriginOffset(self,a) (self)->vtbl->SetGradientOriginOffset(self,a)
+#define c_ID2D1RadialGradientBrush_SetRadiusX(self,a)           (self)->vtbl->SetRadiusX(self,a)
+#define c_ID2D1RadialGradientBrush_SetRadiusY(self,a)           (self)->vtbl->SetRadiusY(self,a)
+#define c_ID2D1RadialGradientBrush_GetCenter(self,a)            (self)->vtbl->GetCenter(self,a)
+#define c_ID2D1RadialGradientBrush_GetGradientOriginOffset(self,a) (self)->vtbl->GetGradientOriginOffset(self,a)
+#define c_ID2D1RadialGradientBrush_GetRadiusX(self)             (self)->vtbl->GetRadiusX(self)
+#define c_ID2D1RadialGradientBrush_GetRadiusY(self)             (self)->vtbl->GetRadiusY(self)
+#define c_ID2D1RadialGradientBrush_GetGradientStopCollection(self,a) (self)->vtbl->GetGradientStopCollection(self,a)
 
 
 /************************************************
@@ -1145,8 +1330,8 @@ struct c_ID2D1GradientStopCollectionVtbl_tag {
     STDMETHOD(dummy_GetFactory)(void);
 
     /* ID2D1GradientStopCollection methods */
-    STDMETHOD(dummy_GetGradientStopCount)(void);
-    STDMETHOD(dummy_GetGradientStops)(void);
+    STDMETHOD_(UINT32, GetGradientStopCount)(c_ID2D1GradientStopCollection*);
+    STDMETHOD_(void, GetGradientStops)(c_ID2D1GradientStopCollection*, c_D2D1_GRADIENT_STOP*, UINT32);
     STDMETHOD(dummy_GetColorInterpolationGamma)(void);
     STDMETHOD(dummy_GetExtendMode)(void);
 };
@@ -1158,6 +1343,35 @@ struct c_ID2D1GradientStopCollection_tag {
 #define c_ID2D1GradientStopCollection_QueryInterface(self,a,b)     (self)->vtbl->QueryInterface(self,a,b)
 #define c_ID2D1GradientStopCollection_AddRef(self)                 (self)->vtbl->AddRef(self)
 #define c_ID2D1GradientStopCollection_Release(self)                (self)->vtbl->Release(self)
+#define c_ID2D1GradientStopCollection_GetGradientStopCount(self)   (self)->vtbl->GetGradientStopCount(self)
+#define c_ID2D1GradientStopCollection_GetGradientStops(self,a,b)   (self)->vtbl->GetGradientStops(self,a,b)
+
+
+/*******************************************
+ ***  Interface ID2D1TessellationSink   ***
+ *******************************************/
+
+typedef struct c_ID2D1TessellationSinkVtbl_tag c_ID2D1TessellationSinkVtbl;
+struct c_ID2D1TessellationSinkVtbl_tag {
+    /* IUnknown methods */
+    STDMETHOD(QueryInterface)(c_ID2D1TessellationSink*, REFIID, void**);
+    STDMETHOD_(ULONG, AddRef)(c_ID2D1TessellationSink*);
+    STDMETHOD_(ULONG, Release)(c_ID2D1TessellationSink*);
+
+    /* ID2D1TessellationSink methods */
+    STDMETHOD_(void, AddTriangles)(c_ID2D1TessellationSink*, const c_D2D1_TRIANGLE*, UINT32);
+    STDMETHOD(Close)(c_ID2D1TessellationSink*);
+};
+
+struct c_ID2D1TessellationSink_tag {
+    c_ID2D1TessellationSinkVtbl* vtbl;
+};
+
+#define c_ID2D1TessellationSink_QueryInterface(self,a,b)    (self)->vtbl->QueryInterface(self,a,b)
+#define c_ID2D1TessellationSink_AddRef(self)                (self)->vtbl->AddRef(self)
+#define c_ID2D1TessellationSink_Release(self)               (self)->vtbl->Release(self)
+#define c_ID2D1TessellationSink_AddTriangles(self,a,b)      (self)->vtbl->AddTriangles(self,a,b)
+#define c_ID2D1TessellationSink_Close(self)                 (self)->vtbl->Close(self)
 
 
 #endif  /* C_D2D1_H */
@@ -183,6 +183,17 @@ struct c_DWRITE_FONT_METRICS_tag {
     UINT16 strikethroughThickness;
 };
 
+typedef struct c_DWRITE_GLYPH_METRICS_tag c_DWRITE_GLYPH_METRICS;
+struct c_DWRITE_GLYPH_METRICS_tag {
+    INT32 leftSideBearing;
+    UINT32 advanceWidth;
+    INT32 rightSideBearing;
+    INT32 topSideBearing;
+    UINT32 advanceHeight;
+    INT32 bottomSideBearing;
+    INT32 verticalOriginY;
+};
+
 typedef struct c_DWRITE_TEXT_METRICS_tag c_DWRITE_TEXT_METRICS;
 struct c_DWRITE_TEXT_METRICS_tag {
     FLOAT left;
@@ -359,7 +370,7 @@ struct c_IDWriteFontVtbl_tag {
     STDMETHOD(dummy_GetSimulations)(void);
     STDMETHOD_(void, GetMetrics)(c_IDWriteFont*, c_DWRITE_FONT_METRICS*);
     STDMETHOD(dummy_HasCharacter)(void);
-    STDMETHOD(dummy_CreateFontFace)(void);
+    STDMETHOD(CreateFontFace)(c_IDWriteFont*, c_IDWriteFontFace**);
 };
 
 struct c_IDWriteFont_tag {
@@ -374,6 +385,7 @@ struct c_IDWriteFont_tag {
 #define c_IDWriteFont_GetStyle(self)            (self)->vtbl->GetStyle(self)
 #define c_IDWriteFont_GetMetrics(self,a)        (self)->vtbl->GetMetrics(self,a)
 #define c_IDWriteFont_GetFontFamily(self,a)     (self)->vtbl->GetFontFamily(self,a)
+#define c_IDWriteFont_CreateFontFace(self,a)    (self)->vtbl->CreateFontFace(self,a)
 
 
 /***********************************
@@ -395,8 +407,9 @@ struct c_IDWriteFontFaceVtbl_tag {
     STDMETHOD(dummy_IsSymbolFont)(void);
     STDMETHOD(dummy_GetMetrics)(void);
     STDMETHOD(dummy_GetGlyphCount)(void);
-    STDMETHOD(dummy_GetDesignGlyphMetrics)(void);
-    STDMETHOD(dummy_GetGlyphIndices)(void);
+    STDMETHOD(GetDesignGlyphMetrics)(c_IDWriteFontFace*, UINT16 const*, UINT32,
+            c_DWRITE_GLYPH_METRICS*, BOOL);
+    STDMETHOD(GetGlyphIndices)(c_IDWriteFontFace*, UINT32 const*, UINT32, UINT16*);
     STDMETHOD(dummy_TryGetFontTable)(void);
     STDMETHOD(dummy_ReleaseFontTable)(void);
     STDMETHOD(dummy_GetGlyphRunOutline)(void);
@@ -412,6 +425,8 @@ struct c_IDWriteFontFace_tag {
 #define c_IDWriteFontFace_QueryInterface(self,a,b)  (self)->vtbl->QueryInterface(self,a,b)
 #define c_IDWriteFontFace_AddRef(self)              (self)->vtbl->AddRef(self)
 #define c_IDWriteFontFace_Release(self)             (self)->vtbl->Release(self)
+#define c_IDWriteFontFace_GetDesignGlyphMetrics(self,a,b,c,d)   (self)->vtbl->GetDesignGlyphMetrics(self,a,b,c,d)
+#define c_IDWriteFontFace_GetGlyphIndices(self,a,b,c)           (self)->vtbl->GetGlyphIndices(self,a,b,c)
 
 
 /*****************************************
@@ -696,7 +711,7 @@ struct c_IDWriteTextLayoutVtbl_tag {
     STDMETHOD(dummy_GetClusterMetrics)(void);
     STDMETHOD(DetermineMinWidth)(c_IDWriteTextLayout*, FLOAT*);
     STDMETHOD(HitTestPoint)(c_IDWriteTextLayout*, FLOAT, FLOAT, BOOL*, BOOL*, c_DWRITE_HIT_TEST_METRICS*);
-    STDMETHOD(dummy_HitTestTextPosition)(void);
+    STDMETHOD(HitTestTextPosition)(c_IDWriteTextLayout*, UINT32, BOOL, FLOAT*, FLOAT*, c_DWRITE_HIT_TEST_METRICS*);
     STDMETHOD(dummy_HitTestTextRange)(void);
 };
 
@@ -729,6 +744,7 @@ struct c_IDWriteTextLayout_tag {
 #define c_IDWriteTextLayout_GetMetrics(self,a)              (self)->vtbl->GetMetrics(self,a)
 #define c_IDWriteTextLayout_DetermineMinWidth(self,a)       (self)->vtbl->DetermineMinWidth(self,a)
 #define c_IDWriteTextLayout_HitTestPoint(self,a,b,c,d,e)    (self)->vtbl->HitTestPoint(self,a,b,c,d,e)
+#define c_IDWriteTextLayout_HitTestTextPosition(self,a,b,c,d,e) (self)->vtbl->HitTestTextPosition(self,a,b,c,d,e)
 
 
 /***************************************
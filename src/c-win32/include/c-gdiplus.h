@@ -39,14 +39,17 @@
 typedef DWORD c_ARGB;
 
 typedef INT c_GpPixelFormat;
+#define c_PixelFormatIndexed        0x00010000 /* Indexes into a palette */
 #define c_PixelFormatGDI            0x00020000 /* Is a GDI-supported format */
 #define c_PixelFormatAlpha          0x00040000 /* Has an alpha component */
 #define c_PixelFormatPAlpha         0x00080000 /* Pre-multiplied alpha */
 #define c_PixelFormatCanonical      0x00200000
 #define c_PixelFormat24bppRGB       (8 | (24 << 8) | c_PixelFormatGDI)
+#define c_PixelFormat32bppRGB       (9 | (32 << 8) | c_PixelFormatGDI)
 #define c_PixelFormat32bppARGB      (10 | (32 << 8) | c_PixelFormatAlpha | c_PixelFormatGDI | c_PixelFormatCanonical)
 #define c_PixelFormat32bppPARGB     (11 | (32 << 8) | c_PixelFormatAlpha | c_PixelFormatPAlpha | c_PixelFormatGDI)
 
+#define c_ImageLockModeRead         1
 #define c_ImageLockModeWrite        2
 
 
@@ -103,6 +106,24 @@ enum c_GpUnit_tag {
     c_UnitMillimeter = 6
 };
 
+typedef enum c_GpBrushType_tag c_GpBrushType;
+enum c_GpBrushType_tag {
+    c_BrushTypeSolidColor = 0,
+    c_BrushTypeHatchFill = 1,
+    c_BrushTypeTextureFill = 2,
+    c_BrushTypePathGradient = 3,
+    c_BrushTypeLinearGradient = 4
+};
+
+typedef enum c_GpPathPointType_tag c_GpPathPointType;
+enum c_GpPathPointType_tag {
+    c_PathPointTypeStart = 0,
+    c_PathPointTypeLine = 1,
+    c_PathPointTypeBezier = 3,
+    c_PathPointTypePathTypeMask = 0x07,
+    c_PathPointTypeCloseSubpath = 0x80
+};
+
 typedef enum c_GpFillMode_tag c_GpFillMode;
 enum c_GpFillMode_tag {
     c_FillModeAlternate = 0,
@@ -173,6 +194,35 @@ enum c_GpWrapMode_tag {
     c_WrapModeClamp = 4
 };
 
+typedef enum c_GpTextRenderingHint_tag c_GpTextRenderingHint;
+enum c_GpTextRenderingHint_tag {
+    c_TextRenderingHintSystemDefault = 0,
+    c_TextRenderingHintSingleBitPerPixelGridFit = 1,
+    c_TextRenderingHintSingleBitPerPixel = 2,
+    c_TextRenderingHintAntiAliasGridFit = 3,
+    c_TextRenderingHintAntiAlias = 4,
+    c_TextRenderingHintClearTypeGridFit = 5
+};
+
+typedef enum c_GpInterpolationMode_tag c_GpInterpolationMode;
+enum c_GpInterpolationMode_tag {
+    c_InterpolationModeInvalid = -1,
+    c_InterpolationModeDefault = 0,
+    c_InterpolationModeLowQuality = 1,
+    c_InterpolationModeHighQuality = 2,
+    c_InterpolationModeBilinear = 3,
+    c_InterpolationModeBicubic = 4,
+    c_InterpolationModeNearestNeighbor = 5,
+    c_InterpolationModeHighQualityBilinear = 6,
+    c_InterpolationModeHighQualityBicubic = 7
+};
+
+typedef enum c_GpCompositingMode_tag c_GpCompositingMode;
+enum c_GpCompositingMode_tag {
+    c_CompositingModeSourceOver = 0,
+    c_CompositingModeSourceCopy = 1
+};
+
 
 /***************************
  ***  Helper Structures  ***
@@ -208,6 +258,12 @@ struct c_GpRectI_tag {
     INT h;
 };
 
+typedef struct c_GpCharacterRange_tag c_GpCharacterRange;
+struct c_GpCharacterRange_tag {
+    INT first;
+    INT length;
+};
+
 typedef struct c_GpBitmapData_tag c_GpBitmapData;
 struct c_GpBitmapData_tag {
     UINT width;
@@ -230,6 +286,7 @@ typedef struct c_GpGraphics_tag     c_GpGraphics;
 typedef struct c_GpImage_tag        c_GpImage;
 typedef struct c_GpPath_tag         c_GpPath;
 typedef struct c_GpPen_tag          c_GpPen;
+typedef struct c_GpRegion_tag       c_GpRegion;
 typedef struct c_GpStringFormat_tag c_GpStringFormat;
 typedef struct c_GpMatrix_tag       c_GpMatrix;
 
@@ -238,6 +295,7 @@ typedef struct c_GpImage_tag        c_GpBitmap;
 typedef struct c_GpBrush_tag        c_GpSolidFill;
 typedef struct c_GpBrush_tag        c_GpLineGradient;
 typedef struct c_GpBrush_tag        c_GpPathGradient;
+typedef struct c_GpBrush_tag        c_GpTexture;
 
 
 #endif  /* C_GDIPLUS_H */
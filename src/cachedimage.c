@@ -25,11 +25,15 @@
 #include "backend-d2d.h"
 #include "backend-wic.h"
 #include "backend-gdix.h"
+#include "apitrace.h"
+#include "hook.h"
 
 
 WD_HCACHEDIMAGE
 wdCreateCachedImage(WD_HCANVAS hCanvas, WD_HIMAGE hImage)
 {
+    UINT64 image = (UINT64) (UINT_PTR) hImage;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Bitmap* b;
@@ -43,6 +47,8 @@ wdCreateCachedImage(WD_HCANVAS hCanvas, WD_HIMAGE hImage)
             return NULL;
         }
 
+        wd_apitrace_create(WD_APITRACE_OP_CREATECACHEDIMAGE, b, hCanvas,
+                           &image, sizeof(UINT64), NULL, 0, NULL, 0);
         return (WD_HCACHEDIMAGE) b;
     } else {
         gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
@@ -57,6 +63,8 @@ wdCreateCachedImage(WD_HCANVAS hCanvas, WD_HIMAGE hImage)
             return NULL;
         }
 
+        wd_apitrace_create(WD_APITRACE_OP_CREATECACHEDIMAGE, cb, hCanvas,
+                           &image, sizeof(UINT64), NULL, 0, NULL, 0);
         return (WD_HCACHEDIMAGE) cb;
     }
 }
@@ -64,6 +72,9 @@ wdCreateCachedImage(WD_HCANVAS hCanvas, WD_HIMAGE hImage)
 void
 wdDestroyCachedImage(WD_HCACHEDIMAGE hCachedImage)
 {
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYCACHEDIMAGE, hCachedImage);
+    wd_hook_object_changing(hCachedImage);
+
     if(d2d_enabled()) {
         c_ID2D1Bitmap_Release((c_ID2D1Bitmap*) hCachedImage);
     } else {
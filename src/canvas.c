@@ -24,6 +24,9 @@
 #include "misc.h"
 #include "backend-d2d.h"
 #include "backend-gdix.h"
+#include "apitrace.h"
+#include "defer.h"
+#include "framediff.h"
 #include "lock.h"
 
 
@@ -51,7 +54,10 @@ wdCreateCanvasWithPaintStruct(HWND hWnd, PAINTSTRUCT* pPS, DWORD dwFlags)
         props2.hwnd = hWnd;
         props2.pixelSize.width = rect.right - rect.left;
         props2.pixelSize.height = rect.bottom - rect.top;
-        props2.presentOptions = c_D2D1_PRESENT_OPTIONS_NONE;
+        /* WD_CANVAS_FRAMEDIFF repaints only what has changed since the
+         * previous frame, so the rest of it has to be retained. */
+        props2.presentOptions = ((dwFlags & WD_CANVAS_FRAMEDIFF) ?
+                    c_D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS : c_D2D1_PRESENT_OPTIONS_NONE);
 
         wd_lock();
         /* Note ID2D1HwndRenderTarget is implicitly double-buffered. */
@@ -74,6 +80,13 @@ wdCreateCanvasWithPaintStruct(HWND hWnd, PAINTSTRUCT* pPS, DWORD dwFlags)
         /* make sure text anti-aliasing is clear type */
         c_ID2D1RenderTarget_SetTextAntialiasMode(c->target, c_D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE);
 
+        wd_apitrace_canvas((WD_HCANVAS) c, rect.right - rect.left,
+                           rect.bottom - rect.top, dwFlags);
+        if(dwFlags & WD_CANVAS_FRAMEDIFF)
+            wd_framediff_install((WD_HCANVAS) c);
+        else if(dwFlags & WD_CANVAS_DEFERRED)
+            wd_defer_install((WD_HCANVAS) c);
+
         return (WD_HCANVAS) c;
     } else {
         BOOL use_doublebuffer = (dwFlags & WD_CANVAS_DOUBLEBUFFER);
@@ -85,6 +98,12 @@ wdCreateCanvasWithPaintStruct(HWND hWnd, PAINTSTRUCT* pPS, DWORD dwFlags)
             WD_TRACE("wdCreateCanvasWithPaintStruct: gdix_canvas_alloc() failed.");
             return NULL;
         }
+
+        wd_apitrace_canvas((WD_HCANVAS) c, rect.right - rect.left,
+                           rect.bottom - rect.top, dwFlags);
+        if(dwFlags & WD_CANVAS_DEFERRED)
+            wd_defer_install((WD_HCANVAS) c);
+
         return (WD_HCANVAS) c;
     }
 }
@@ -131,6 +150,11 @@ wdCreateCanvasWithHDC(HDC hDC, const RECT* pRect, DWORD dwFlags)
         /* make sure text anti-aliasing is clear type */
         c_ID2D1RenderTarget_SetTextAntialiasMode(c->target, c_D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE);
 
+        wd_apitrace_canvas((WD_HCANVAS) c, pRect->right - pRect->left,
+                           pRect->bottom - pRect->top, dwFlags);
+        if(dwFlags & WD_CANVAS_DEFERRED)
+            wd_defer_install((WD_HCANVAS) c);
+
         return (WD_HCANVAS) c;
 
 err_d2d_canvas_alloc:
@@ -148,6 +172,12 @@ err_CreateDCRenderTarget:
             WD_TRACE("wdCreateCanvasWithHDC: gdix_canvas_alloc() failed.");
             return NULL;
         }
+
+        wd_apitrace_canvas((WD_HCANVAS) c, pRect->right - pRect->left,
+                           pRect->bottom - pRect->top, dwFlags);
+        if(dwFlags & WD_CANVAS_DEFERRED)
+            wd_defer_install((WD_HCANVAS) c);
+
         return (WD_HCANVAS) c;
     }
 }
@@ -155,6 +185,12 @@ err_CreateDCRenderTarget:
 void
 wdDestroyCanvas(WD_HCANVAS hCanvas)
 {
+    /* Shared resources first, so (when tracing) they are recorded as
+     * destroyed while the canvas still exists. */
+    wd_intern_destroy(hCanvas);
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYCANVAS, hCanvas);
+    wd_hook_destroy(hCanvas);
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
 
@@ -188,9 +224,16 @@ wdDestroyCanvas(WD_HCANVAS hCanvas)
 void
 wdBeginPaint(WD_HCANVAS hCanvas)
 {
+    wd_apitrace_handle(WD_APITRACE_OP_BEGINPAINT, hCanvas);
+    wd_cull_invalidate(hCanvas);
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
         c_ID2D1RenderTarget_BeginDraw(c->target);
+        if(hook != NULL  &&  hook->framediff != NULL)
+            wd_framediff_begin(hCanvas, hook->framediff);
     } else {
         gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
         SetLayout(c->dc, 0);
@@ -200,6 +243,13 @@ wdBeginPaint(WD_HCANVAS hCanvas)
 BOOL
 wdEndPaint(WD_HCANVAS hCanvas)
 {
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
+    wd_apitrace_handle(WD_APITRACE_OP_ENDPAINT, hCanvas);
+    if(hook != NULL  &&  hook->framediff != NULL)
+        wd_framediff_end(hCanvas, hook->framediff);
+    wd_hook_flush(hCanvas);
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         HRESULT hr;
@@ -208,6 +258,10 @@ wdEndPaint(WD_HCANVAS hCanvas)
 
         hr = c_ID2D1RenderTarget_EndDraw(c->target, NULL, NULL);
         if(FAILED(hr)) {
+            /* The frame has not been presented, so it cannot serve as a base
+             * for the next one. */
+            if(hook != NULL  &&  hook->framediff != NULL)
+                wd_framediff_invalidate(hook->framediff);
             if(hr != D2DERR_RECREATE_TARGET)
                 WD_TRACE_HR("wdEndPaint: ID2D1RenderTarget::EndDraw() failed.");
             return FALSE;
@@ -227,9 +281,21 @@ wdEndPaint(WD_HCANVAS hCanvas)
     }
 }
 
+void
+wdFlushCanvas(WD_HCANVAS hCanvas)
+{
+    wd_apitrace_handle(WD_APITRACE_OP_FLUSHCANVAS, hCanvas);
+    wd_hook_flush(hCanvas);
+}
+
 BOOL
 wdResizeCanvas(WD_HCANVAS hCanvas, UINT uWidth, UINT uHeight)
 {
+    UINT32 size[2] = { uWidth, uHeight };
+
+    wd_apitrace_create(WD_APITRACE_OP_RESIZECANVAS, hCanvas, NULL,
+                       size, sizeof(size), NULL, 0, NULL, 0);
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         if(c->type == D2D_CANVASTYPE_HWND) {
@@ -243,6 +309,11 @@ wdResizeCanvas(WD_HCANVAS hCanvas, UINT uWidth, UINT uHeight)
                 return FALSE;
             }
 
+            if(wd_hooked(hCanvas)  &&  wd_canvas_hook(hCanvas)->framediff != NULL)
+                wd_framediff_invalidate(wd_canvas_hook(hCanvas)->framediff);
+
+            wd_cull_invalidate(hCanvas);
+
             /* In RTL mode, we have to update the transformation matrix
              * accordingly. */
             if(c->flags & D2D_CANVASFLAG_RTL) {
@@ -272,6 +343,9 @@ wdResizeCanvas(WD_HCANVAS hCanvas, UINT uWidth, UINT uHeight)
 HDC
 wdStartGdi(WD_HCANVAS hCanvas, BOOL bKeepContents)
 {
+    wd_apitrace_handle(WD_APITRACE_OP_STARTGDI, hCanvas);
+    wd_hook_flush(hCanvas);
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1GdiInteropRenderTarget* gdi_interop;
@@ -343,6 +417,15 @@ wdEndGdi(WD_HCANVAS hCanvas, HDC hDC)
 void
 wdClear(WD_HCANVAS hCanvas, WD_COLOR color)
 {
+    if(wd_hooked(hCanvas)) {
+        wd_cmd_t cmd;
+
+        wd_cmd_init(&cmd, WD_CMD_CLEAR);
+        cmd.dw = color;
+        if(wd_hook_cmd(hCanvas, &cmd))
+            return;
+    }
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_D2D1_COLOR_F clr;
@@ -358,16 +441,27 @@ wdClear(WD_HCANVAS hCanvas, WD_COLOR color)
 void
 wdSetClip(WD_HCANVAS hCanvas, const WD_RECT* pRect, const WD_HPATH hPath)
 {
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook_rects(hCanvas, WD_CMD_SETCLIP, (void*) hPath, pRect, NULL))
+            return;
+    }
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
 
         d2d_reset_clip(c);
 
         if(hPath != NULL) {
-            c_ID2D1PathGeometry* g = (c_ID2D1PathGeometry*) hPath;
+            c_ID2D1Geometry* g;
             c_D2D1_LAYER_PARAMETERS layer_params;
             HRESULT hr;
 
+            g = (c_ID2D1Geometry*) wd_path_geometry(hPath);
+            if(g == NULL) {
+                WD_TRACE("wdSetClip: wd_path_geometry() failed.");
+                return;
+            }
+
             hr = c_ID2D1RenderTarget_CreateLayer(c->target, NULL, &c->clip_layer);
             if(FAILED(hr)) {
                 WD_TRACE_HR("wdSetClip: ID2D1RenderTarget::CreateLayer() failed.");
@@ -403,10 +497,14 @@ wdSetClip(WD_HCANVAS hCanvas, const WD_RECT* pRect, const WD_HPATH hPath)
                     (const c_D2D1_RECT_F*) pRect, c_D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
             c->flags |= D2D_CANVASFLAG_RECTCLIP;
         }
+
+        wd_cull_set_clip(hCanvas, pRect, hPath);
     } else {
         gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
         int mode;
 
+        wd_cull_invalidate(hCanvas);
+
         if(pRect == NULL  &&  hPath == NULL) {
             gdix_vtable->fn_ResetClip(c->graphics);
             return;
@@ -420,14 +518,29 @@ wdSetClip(WD_HCANVAS hCanvas, const WD_RECT* pRect, const WD_HPATH hPath)
             mode = c_CombineModeIntersect;
         }
 
-        if(hPath != NULL)
-            gdix_vtable->fn_SetClipPath(c->graphics, (void*) hPath, mode);
+        if(hPath != NULL) {
+            c_GpPath* p = (c_GpPath*) wd_path_geometry(hPath);
+
+            if(p == NULL) {
+                WD_TRACE("wdSetClip: wd_path_geometry() failed.");
+                return;
+            }
+            gdix_vtable->fn_SetClipPath(c->graphics, p, mode);
+        }
     }
 }
 
 void
 wdRotateWorld(WD_HCANVAS hCanvas, float cx, float cy, float fAngle)
 {
+    if(wd_hooked(hCanvas)) {
+        float a[3] = { cx, cy, fAngle };
+        if(wd_hook(hCanvas, WD_CMD_ROTATEWORLD, NULL, NULL, NULL, a, 3))
+            return;
+    }
+
+    wd_cull_invalidate(hCanvas);
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_D2D1_MATRIX_3X2_F m;
@@ -452,6 +565,14 @@ wdRotateWorld(WD_HCANVAS hCanvas, float cx, float cy, float fAngle)
 void
 wdTranslateWorld(WD_HCANVAS hCanvas, float dx, float dy)
 {
+    if(wd_hooked(hCanvas)) {
+        float a[2] = { dx, dy };
+        if(wd_hook(hCanvas, WD_CMD_TRANSLATEWORLD, NULL, NULL, NULL, a, 2))
+            return;
+    }
+
+    wd_cull_invalidate(hCanvas);
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_D2D1_MATRIX_3X2_F m;
@@ -473,6 +594,16 @@ wdTransformWorld(WD_HCANVAS hCanvas, const WD_MATRIX* pMatrix)
         WD_TRACE("wdSetWorldTransform: Invalid pMatrix");
         return;
     }
+    if(wd_hooked(hCanvas)) {
+        wd_cmd_t cmd;
+
+        wd_cmd_init(&cmd, WD_CMD_TRANSFORMWORLD);
+        cmd.flags = WD_CMDFLAG_HASMATRIX;
+        memcpy(cmd.a, pMatrix, sizeof(WD_MATRIX));
+        if(wd_hook_cmd(hCanvas, &cmd))
+            return;
+    }
+    wd_cull_invalidate(hCanvas);
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
 
@@ -510,6 +641,13 @@ wdTransformWorld(WD_HCANVAS hCanvas, const WD_MATRIX* pMatrix)
 void
 wdResetWorld(WD_HCANVAS hCanvas)
 {
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_RESETWORLD, NULL, NULL, NULL, NULL, 0))
+            return;
+    }
+
+    wd_cull_invalidate(hCanvas);
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         d2d_reset_transform(c);
@@ -519,3 +657,285 @@ wdResetWorld(WD_HCANVAS hCanvas)
     }
 }
 
+void
+wdSetCanvasQuality(WD_HCANVAS hCanvas, UINT uQuality)
+{
+    static const BYTE presets[][4] = {
+        /* WD_QUALITY_FAST */
+        { WD_GEOMETRYAA_NONE, WD_TEXTAA_GRAYSCALE, WD_INTERPOLATION_NEAREST, WD_COMPOSITING_BLEND },
+        /* WD_QUALITY_BALANCED */
+        { WD_GEOMETRYAA_FAST, WD_TEXTAA_GRAYSCALE, WD_INTERPOLATION_LINEAR, WD_COMPOSITING_BLEND },
+        /* WD_QUALITY_HIGH */
+        { WD_GEOMETRYAA_HIGH, WD_TEXTAA_CLEARTYPE, WD_INTERPOLATION_LINEAR, WD_COMPOSITING_BLEND }
+    };
+    UINT i;
+
+    if(uQuality >= WD_SIZEOF_ARRAY(presets))
+        uQuality = WD_QUALITY_HIGH;
+
+    for(i = 0; i < WD_SIZEOF_ARRAY(presets[0]); i++)
+        wdSetCanvasQualityParam(hCanvas, i, presets[uQuality][i]);
+}
+
+void
+wdSetCanvasQualityParam(WD_HCANVAS hCanvas, UINT uParam, UINT uValue)
+{
+    UINT32 args[2] = { uParam, uValue };
+
+    wd_apitrace_create(WD_APITRACE_OP_SETCANVASQUALITY, hCanvas, NULL,
+                       args, sizeof(args), NULL, 0, NULL, 0);
+
+    /* Queued calls have to be painted with the old settings. */
+    wd_hook_flush(hCanvas);
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+
+        switch(uParam) {
+            case WD_QUALITYPARAM_GEOMETRYAA:
+                c_ID2D1RenderTarget_SetAntialiasMode(c->target,
+                        (uValue == WD_GEOMETRYAA_NONE) ?
+                            c_D2D1_ANTIALIAS_MODE_ALIASED :
+                            c_D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+                break;
+
+            case WD_QUALITYPARAM_TEXTAA:
+            {
+                c_D2D1_TEXT_ANTIALIAS_MODE mode;
+
+                switch(uValue) {
+                    case WD_TEXTAA_ALIASED:     mode = c_D2D1_TEXT_ANTIALIAS_MODE_ALIASED; break;
+                    case WD_TEXTAA_GRAYSCALE:   mode = c_D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE; break;
+                    default:                    mode = c_D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE; break;
+                }
+                c_ID2D1RenderTarget_SetTextAntialiasMode(c->target, mode);
+                break;
+            }
+
+            case WD_QUALITYPARAM_INTERPOLATION:
+                if(uValue == WD_INTERPOLATION_NEAREST)
+                    c->flags |= D2D_CANVASFLAG_NEARESTIMAGE;
+                else
+                    c->flags &= ~D2D_CANVASFLAG_NEARESTIMAGE;
+                break;
+
+            case WD_QUALITYPARAM_COMPOSITING:
+                /* Not supported by ID2D1RenderTarget. */
+                break;
+        }
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        int status = 0;
+
+        switch(uParam) {
+            case WD_QUALITYPARAM_GEOMETRYAA:
+                if(uValue == WD_GEOMETRYAA_NONE) {
+                    status = gdix_vtable->fn_SetSmoothingMode(c->graphics,
+                                c_SmoothingModeNone);
+                } else if(uValue == WD_GEOMETRYAA_FAST) {
+                    status = gdix_vtable->fn_SetSmoothingMode(c->graphics,
+                                c_SmoothingModeAntiAlias8x4);
+                } else {
+                    /* See gdix_canvas_alloc(). */
+                    status = gdix_vtable->fn_SetSmoothingMode(c->graphics,
+                                c_SmoothingModeAntiAlias8x8);
+                    if(status != 0) {
+                        status = gdix_vtable->fn_SetSmoothingMode(c->graphics,
+                                    c_SmoothingModeHighQuality);
+                    }
+                }
+                break;
+
+            case WD_QUALITYPARAM_TEXTAA:
+            {
+                c_GpTextRenderingHint hint;
+
+                switch(uValue) {
+                    case WD_TEXTAA_ALIASED:     hint = c_TextRenderingHintSingleBitPerPixelGridFit; break;
+                    case WD_TEXTAA_GRAYSCALE:   hint = c_TextRenderingHintAntiAliasGridFit; break;
+                    default:                    hint = c_TextRenderingHintClearTypeGridFit; break;
+                }
+                status = gdix_vtable->fn_SetTextRenderingHint(c->graphics, hint);
+                break;
+            }
+
+            case WD_QUALITYPARAM_INTERPOLATION:
+                status = gdix_vtable->fn_SetInterpolationMode(c->graphics,
+                            (uValue == WD_INTERPOLATION_NEAREST) ?
+                                c_InterpolationModeNearestNeighbor :
+                                c_InterpolationModeBilinear);
+                break;
+
+            case WD_QUALITYPARAM_COMPOSITING:
+                status = gdix_vtable->fn_SetCompositingMode(c->graphics,
+                            (uValue == WD_COMPOSITING_COPY) ?
+                                c_CompositingModeSourceCopy :
+                                c_CompositingModeSourceOver);
+                break;
+        }
+
+        if(status != 0)
+            WD_TRACE("wdSetCanvasQualityParam: Setting param %u failed. [%d]", uParam, status);
+    }
+}
+
+static LONG wd_canvas_serial_counter = 0;
+
+UINT
+wd_canvas_new_serial(void)
+{
+    return (UINT) InterlockedIncrement(&wd_canvas_serial_counter);
+}
+
+UINT
+wd_canvas_serial(WD_HCANVAS hCanvas)
+{
+    if(d2d_enabled())
+        return ((d2d_canvas_t*) hCanvas)->serial;
+    else
+        return ((gdix_canvas_t*) hCanvas)->serial;
+}
+
+void
+wd_canvas_get_transform(WD_HCANVAS hCanvas, WD_MATRIX* pMatrix)
+{
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        c_D2D1_MATRIX_3X2_F m;
+
+        c_ID2D1RenderTarget_GetTransform(c->target, &m);
+        pMatrix->m11 = m._11;
+        pMatrix->m12 = m._12;
+        pMatrix->m21 = m._21;
+        pMatrix->m22 = m._22;
+        pMatrix->dx = m._31;
+        pMatrix->dy = m._32;
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        c_GpMatrix* matrix;
+        float elements[6];
+        int status;
+
+        status = gdix_vtable->fn_CreateMatrix(&matrix);
+        if(status != 0) {
+            WD_TRACE_ERR_("wd_canvas_get_transform: GdipCreateMatrix() failed", status);
+            return;
+        }
+        gdix_vtable->fn_GetWorldTransform(c->graphics, matrix);
+        gdix_vtable->fn_GetMatrixElements(matrix, elements);
+        gdix_delete_matrix(matrix);
+
+        pMatrix->m11 = elements[0];
+        pMatrix->m12 = elements[1];
+        pMatrix->m21 = elements[2];
+        pMatrix->m22 = elements[3];
+        pMatrix->dx = elements[4];
+        pMatrix->dy = elements[5];
+    }
+}
+
+void
+wd_canvas_set_transform(WD_HCANVAS hCanvas, const WD_MATRIX* pMatrix)
+{
+    wd_cull_invalidate(hCanvas);
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        c_D2D1_MATRIX_3X2_F m;
+
+        m._11 = pMatrix->m11;
+        m._12 = pMatrix->m12;
+        m._21 = pMatrix->m21;
+        m._22 = pMatrix->m22;
+        m._31 = pMatrix->dx;
+        m._32 = pMatrix->dy;
+        c_ID2D1RenderTarget_SetTransform(c->target, &m);
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        c_GpMatrix* matrix;
+        int status;
+
+        status = gdix_vtable->fn_CreateMatrix2(pMatrix->m11, pMatrix->m12,
+                                               pMatrix->m21, pMatrix->m22,
+                                               pMatrix->dx, pMatrix->dy, &matrix);
+        if(status != 0) {
+            WD_TRACE_ERR_("wd_canvas_set_transform: GdipCreateMatrix2() failed", status);
+            return;
+        }
+        gdix_vtable->fn_SetWorldTransform(c->graphics, matrix);
+        gdix_delete_matrix(matrix);
+    }
+}
+
+void
+wdGetCanvasStats(WD_HCANVAS hCanvas, WD_CANVASSTATS* pStats)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
+    memset(pStats, 0, sizeof(WD_CANVASSTATS));
+
+    if(hook != NULL  &&  hook->defer != NULL) {
+        pStats->uDeferredCalls = hook->defer->calls;
+        pStats->uDeferredStateChanges = hook->defer->state_changes;
+        pStats->uDeferredStateChangesSaved = hook->defer->state_changes_saved;
+    }
+
+    if(hook != NULL  &&  hook->framediff != NULL) {
+        pStats->uFrameDiffCalls = hook->framediff->calls;
+        pStats->uFrameDiffCallsPainted = hook->framediff->calls_painted;
+    }
+
+    pStats->uCulledCalls = wd_canvas_cull(hCanvas)->culled;
+
+    if(d2d_enabled()) {
+        /* noop */
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        pStats->uStateCalls = c->state_calls;
+        pStats->uStateCallsSkipped = c->state_calls_skipped;
+    }
+}
+
+void
+wdResetCanvasStats(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
+    if(hook != NULL  &&  hook->defer != NULL) {
+        hook->defer->calls = 0;
+        hook->defer->state_changes = 0;
+        hook->defer->state_changes_saved = 0;
+    }
+
+    if(hook != NULL  &&  hook->framediff != NULL) {
+        hook->framediff->calls = 0;
+        hook->framediff->calls_painted = 0;
+    }
+
+    wd_canvas_cull(hCanvas)->culled = 0;
+
+    if(d2d_enabled()) {
+        /* noop */
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        c->state_calls = 0;
+        c->state_calls_skipped = 0;
+    }
+}
+
+UINT
+wdGetDirtyRects(WD_HCANVAS hCanvas, WD_RECT* pRects, UINT uMaxRects)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+    wd_framediff_t* fd;
+    UINT n;
+
+    if(hook == NULL  ||  hook->framediff == NULL)
+        return 0;
+
+    fd = hook->framediff;
+    n = WD_MIN(fd->n_dirty, uMaxRects);
+    if(pRects != NULL)
+        memcpy(pRects, fd->dirty, n * sizeof(WD_RECT));
+    return n;
+}
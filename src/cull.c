@@ -0,0 +1,219 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "cull.h"
+#include "backend-d2d.h"
+#include "backend-gdix.h"
+
+
+wd_cull_t*
+wd_canvas_cull(WD_HCANVAS hCanvas)
+{
+    if(d2d_enabled())
+        return &((d2d_canvas_t*) hCanvas)->cull;
+    else
+        return &((gdix_canvas_t*) hCanvas)->cull;
+}
+
+void
+wd_cull_transform_rect(const WD_MATRIX* m, const WD_RECT* r, WD_RECT* res)
+{
+    float xs[4] = { r->x0, r->x1, r->x0, r->x1 };
+    float ys[4] = { r->y0, r->y0, r->y1, r->y1 };
+    int i;
+
+    for(i = 0; i < 4; i++) {
+        float x = xs[i] * m->m11 + ys[i] * m->m21 + m->dx;
+        float y = xs[i] * m->m12 + ys[i] * m->m22 + m->dy;
+
+        if(i == 0  ||  x < res->x0)  res->x0 = x;
+        if(i == 0  ||  y < res->y0)  res->y0 = y;
+        if(i == 0  ||  x > res->x1)  res->x1 = x;
+        if(i == 0  ||  y > res->y1)  res->y1 = y;
+    }
+}
+
+void
+wd_cull_set_clip(WD_HCANVAS hCanvas, const WD_RECT* pRect, const WD_HPATH hPath)
+{
+    wd_cull_t* cull = wd_canvas_cull(hCanvas);
+    WD_MATRIX m;
+    WD_RECT r;
+    WD_RECT tmp;
+
+    cull->valid = FALSE;
+    cull->has_clip = FALSE;
+
+    if(pRect == NULL  &&  hPath == NULL)
+        return;
+
+    wd_canvas_get_transform(hCanvas, &m);
+
+    if(pRect != NULL) {
+        tmp.x0 = WD_MIN(pRect->x0, pRect->x1);
+        tmp.y0 = WD_MIN(pRect->y0, pRect->y1);
+        tmp.x1 = WD_MAX(pRect->x0, pRect->x1);
+        tmp.y1 = WD_MAX(pRect->y0, pRect->y1);
+        wd_cull_transform_rect(&m, &tmp, &cull->clip);
+        cull->has_clip = TRUE;
+    }
+
+    if(hPath != NULL  &&  wdGetPathBounds(hPath, &tmp)) {
+        wd_cull_transform_rect(&m, &tmp, &r);
+        if(cull->has_clip) {
+            cull->clip.x0 = WD_MAX(cull->clip.x0, r.x0);
+            cull->clip.y0 = WD_MAX(cull->clip.y0, r.y0);
+            cull->clip.x1 = WD_MIN(cull->clip.x1, r.x1);
+            cull->clip.y1 = WD_MIN(cull->clip.y1, r.y1);
+        } else {
+            memcpy(&cull->clip, &r, sizeof(WD_RECT));
+            cull->has_clip = TRUE;
+        }
+    }
+}
+
+/* Anti-aliasing may touch one more device pixel around the primitive. */
+#define WD_CULL_AA_MARGIN       1.0f
+
+static void
+wd_cull_update(WD_HCANVAS hCanvas, wd_cull_t* cull)
+{
+    WD_MATRIX m;
+    WD_MATRIX inv;
+    float det;
+
+    cull->valid = TRUE;
+    cull->unbounded = FALSE;
+    cull->margin_x = 0.0f;
+    cull->margin_y = 0.0f;
+
+    wd_canvas_get_transform(hCanvas, &m);
+    det = m.m11 * m.m22 - m.m12 * m.m21;
+    if(fabsf(det) < 1e-12f) {
+        cull->unbounded = TRUE;
+        return;
+    }
+    inv.m11 = m.m22 / det;
+    inv.m12 = -m.m12 / det;
+    inv.m21 = -m.m21 / det;
+    inv.m22 = m.m11 / det;
+    inv.dx = -(m.dx * inv.m11 + m.dy * inv.m21);
+    inv.dy = -(m.dx * inv.m12 + m.dy * inv.m22);
+
+    /* The anti-aliasing margin is given in device pixels, so its size in the
+     * world depends on the scale of the transformation. */
+    cull->margin_x = WD_CULL_AA_MARGIN * (fabsf(inv.m11) + fabsf(inv.m21));
+    cull->margin_y = WD_CULL_AA_MARGIN * (fabsf(inv.m12) + fabsf(inv.m22));
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        c_D2D1_SIZE_F size;
+        WD_RECT dev;
+
+        /* The visible area in device space. */
+        c_ID2D1RenderTarget_GetSize(c->target, &size);
+        dev.x0 = 0.0f;
+        dev.y0 = 0.0f;
+        dev.x1 = size.width;
+        dev.y1 = size.height;
+        if(cull->has_clip) {
+            dev.x0 = WD_MAX(dev.x0, cull->clip.x0);
+            dev.y0 = WD_MAX(dev.y0, cull->clip.y0);
+            dev.x1 = WD_MIN(dev.x1, cull->clip.x1);
+            dev.y1 = WD_MIN(dev.y1, cull->clip.y1);
+        }
+
+        /* Grow it by the margin, and map it into the world through the
+         * inverse transformation. */
+        dev.x0 -= WD_CULL_AA_MARGIN;
+        dev.y0 -= WD_CULL_AA_MARGIN;
+        dev.x1 += WD_CULL_AA_MARGIN;
+        dev.y1 += WD_CULL_AA_MARGIN;
+        wd_cull_transform_rect(&inv, &dev, &cull->visible);
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        c_GpRectF r;
+        int status;
+
+        status = gdix_vtable->fn_GetVisibleClipBounds(c->graphics, &r);
+        if(status != 0) {
+            WD_TRACE("wd_cull_update: GdipGetVisibleClipBounds() failed. [%d]", status);
+            cull->unbounded = TRUE;
+            return;
+        }
+        cull->visible.x0 = r.x - cull->margin_x;
+        cull->visible.y0 = r.y - cull->margin_y;
+        cull->visible.x1 = r.x + r.w + cull->margin_x;
+        cull->visible.y1 = r.y + r.h + cull->margin_y;
+    }
+}
+
+BOOL
+wd_cull_visible(WD_HCANVAS hCanvas, WD_RECT* pRect)
+{
+    wd_cull_t* cull = wd_canvas_cull(hCanvas);
+
+    if(!cull->valid)
+        wd_cull_update(hCanvas, cull);
+    if(cull->unbounded)
+        return FALSE;
+
+    memcpy(pRect, &cull->visible, sizeof(WD_RECT));
+    return TRUE;
+}
+
+void
+wd_cull_aa_margin(WD_HCANVAS hCanvas, float* p_margin_x, float* p_margin_y)
+{
+    wd_cull_t* cull = wd_canvas_cull(hCanvas);
+
+    if(!cull->valid)
+        wd_cull_update(hCanvas, cull);
+
+    *p_margin_x = cull->margin_x;
+    *p_margin_y = cull->margin_y;
+}
+
+BOOL
+wd_culled(WD_HCANVAS hCanvas, WORD kind, void* obj, DWORD dw, const float* a)
+{
+    wd_cull_t* cull = wd_canvas_cull(hCanvas);
+    WD_RECT r;
+
+    if(!cull->valid)
+        wd_cull_update(hCanvas, cull);
+    if(cull->unbounded)
+        return FALSE;
+
+    if(!wd_bounds(kind, obj, dw, a, &r))
+        return FALSE;
+
+    if(r.x1 < cull->visible.x0  ||  r.x0 > cull->visible.x1  ||
+       r.y1 < cull->visible.y0  ||  r.y0 > cull->visible.y1)
+    {
+        cull->culled++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,94 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_CULL_H
+#define WD_CULL_H
+
+#include "misc.h"
+
+
+/* Culling of invisible primitives
+ * ===============================
+ *
+ * Each canvas keeps the bounds of its visible area (i.e. of the canvas
+ * intersected with the clip) mapped into the world coordinates. Drawing
+ * functions ask wd_culled() first, and a primitive whose bounds (see
+ * wd_bounds()) do not intersect the visible area is not passed to the
+ * back-end at all.
+ *
+ * The visible bounds are computed lazily by the first primitive painted after
+ * the world transformation or the clip has changed. Any code which changes
+ * them has to call wd_cull_invalidate().
+ *
+ * With Direct2D, we track the clip bounds in device space ourselves, as the
+ * render target cannot be asked for them. GDI+ can tell the visible bounds
+ * directly in world coordinates.
+ *
+ * The bounds of the primitives do not include the pixels anti-aliasing may
+ * touch around them. That margin is one device pixel, whatever the scale of
+ * the world transformation is, so it is added to the visible area instead.
+ */
+
+typedef struct wd_cull_tag wd_cull_t;
+struct wd_cull_tag {
+    BOOL valid;         /* Is visible up to date? */
+    BOOL unbounded;     /* Nothing can be culled (e.g. degenerate transformation). */
+    WD_RECT visible;    /* Bounds of the visible area in world coordinates. */
+    float margin_x;     /* Anti-aliasing margin in world coordinates. */
+    float margin_y;
+    BOOL has_clip;      /* Direct2D only: Clip bounds in device space. */
+    WD_RECT clip;
+    UINT culled;        /* Count of the culled primitives (see WD_CANVASSTATS). */
+};
+
+
+wd_cull_t* wd_canvas_cull(WD_HCANVAS hCanvas);
+
+static inline void
+wd_cull_invalidate(WD_HCANVAS hCanvas)
+{
+    wd_canvas_cull(hCanvas)->valid = FALSE;
+}
+
+/* Direct2D only: Remember the bounds of a new clip. (Called by wdSetClip()
+ * after the clip has been set up, so the current transformation applies.) */
+void wd_cull_set_clip(WD_HCANVAS hCanvas, const WD_RECT* pRect, const WD_HPATH hPath);
+
+/* Get the visible area in the world coordinates. Returns FALSE if it is
+ * unbounded, i.e. nothing can be culled. */
+BOOL wd_cull_visible(WD_HCANVAS hCanvas, WD_RECT* pRect);
+
+/* Get the anti-aliasing margin (one device pixel) in the world coordinates,
+ * i.e. how much the world bounds of a primitive have to grow in each
+ * direction to cover all the pixels it may touch. */
+void wd_cull_aa_margin(WD_HCANVAS hCanvas, float* p_margin_x, float* p_margin_y);
+
+/* Returns TRUE if the primitive (described as for wd_bounds()) cannot paint
+ * anything visible and hence should be skipped. */
+BOOL wd_culled(WD_HCANVAS hCanvas, WORD kind, void* obj, DWORD dw, const float* a);
+
+/* Bounding box of the rectangle transformed by the matrix. */
+void wd_cull_transform_rect(const WD_MATRIX* m, const WD_RECT* r, WD_RECT* res);
+
+
+#endif  /* WD_CULL_H */
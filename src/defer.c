@@ -0,0 +1,343 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "defer.h"
+#include "dlist.h"
+#include "cull.h"
+
+
+/* How many batches back we look for one the command can join. This bounds
+ * the cost of the flush for long queues with little to share. */
+#define WD_DEFER_LOOKBACK       32
+
+#define WD_DEFER_NONE           ((UINT) -1)
+
+
+struct wd_defer_batch_tag {
+    void* brush;
+    void* style;
+    WORD kind;
+    BOOL solid;                 /* Calls with WD_CMDFLAG_SOLIDCOLOR. */
+    WD_COLOR color;
+    BOOL bounded;
+    WD_RECT bounds;
+    UINT head;
+    UINT tail;
+};
+
+
+static inline BOOL
+wd_defer_overlap(BOOL bounded0, const WD_RECT* r0, BOOL bounded1, const WD_RECT* r1)
+{
+    if(!bounded0  ||  !bounded1)
+        return TRUE;
+
+    return (r0->x0 < r1->x1  &&  r1->x0 < r0->x1  &&
+            r0->y0 < r1->y1  &&  r1->y0 < r0->y1);
+}
+
+/* Calls with a captured solid color are all painted with the private brush
+ * of the hook (see wd_cmd_execute()), so only the color matters for them. */
+static inline BOOL
+wd_defer_state_differs(const wd_cmd_t* cmd0, const wd_cmd_t* cmd1)
+{
+    if(cmd0->style != cmd1->style)
+        return TRUE;
+    if((cmd0->flags ^ cmd1->flags) & WD_CMDFLAG_SOLIDCOLOR)
+        return TRUE;
+    if(cmd0->flags & WD_CMDFLAG_SOLIDCOLOR)
+        return (cmd0->color != cmd1->color);
+    return (cmd0->brush != cmd1->brush);
+}
+
+static inline BOOL
+wd_defer_batch_matches(const wd_defer_batch_t* b, const wd_cmd_t* cmd)
+{
+    if(b->kind != cmd->kind  ||  b->style != cmd->style)
+        return FALSE;
+    if(cmd->flags & WD_CMDFLAG_SOLIDCOLOR)
+        return (b->solid  &&  b->color == cmd->color);
+    return (!b->solid  &&  b->brush == cmd->brush);
+}
+
+BOOL
+wd_defer_install(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook;
+    wd_defer_t* defer;
+
+    hook = wd_hook_acquire(hCanvas);
+    if(hook == NULL) {
+        WD_TRACE("wd_defer_install: wd_hook_acquire() failed.");
+        goto err_wd_hook_acquire;
+    }
+
+    defer = (wd_defer_t*) malloc(sizeof(wd_defer_t));
+    if(defer == NULL) {
+        WD_TRACE("wd_defer_install: malloc() failed.");
+        goto err_malloc;
+    }
+    memset(defer, 0, sizeof(wd_defer_t));
+
+    defer->queue = wd_dlist_alloc();
+    if(defer->queue == NULL) {
+        WD_TRACE("wd_defer_install: wd_dlist_alloc() failed.");
+        goto err_wd_dlist_alloc;
+    }
+
+    hook->defer = defer;
+    return TRUE;
+
+    /* Error path unwinding */
+err_wd_dlist_alloc:
+    free(defer);
+err_malloc:
+    wd_hook_release(hCanvas);
+err_wd_hook_acquire:
+    return FALSE;
+}
+
+void
+wd_defer_free(wd_defer_t* defer)
+{
+    if(defer->queue->n > 0)
+        WD_TRACE("wd_defer_free: Discarding %u unflushed calls.", defer->queue->n);
+
+    wd_dlist_free(defer->queue);
+    free(defer->bounds);
+    free(defer->bounded);
+    free(defer->next);
+    free(defer->batches);
+    free(defer);
+}
+
+static BOOL
+wd_defer_grow(wd_defer_t* defer)
+{
+    UINT alloc = (defer->alloc > 0 ? 2 * defer->alloc : 64);
+    WD_RECT* bounds;
+    BOOL* bounded;
+    UINT* next;
+
+    bounds = (WD_RECT*) realloc(defer->bounds, alloc * sizeof(WD_RECT));
+    if(bounds == NULL)
+        return FALSE;
+    defer->bounds = bounds;
+
+    bounded = (BOOL*) realloc(defer->bounded, alloc * sizeof(BOOL));
+    if(bounded == NULL)
+        return FALSE;
+    defer->bounded = bounded;
+
+    next = (UINT*) realloc(defer->next, alloc * sizeof(UINT));
+    if(next == NULL)
+        return FALSE;
+    defer->next = next;
+
+    defer->alloc = alloc;
+    return TRUE;
+}
+
+BOOL
+wd_defer_cmd(WD_HCANVAS hCanvas, wd_defer_t* defer, wd_cmd_t* cmd)
+{
+    UINT i = defer->queue->n;
+
+    switch(cmd->kind) {
+        case WD_CMD_DRAWARC:
+        case WD_CMD_DRAWELLIPSE:
+        case WD_CMD_DRAWLINE:
+        case WD_CMD_DRAWPATH:
+        case WD_CMD_DRAWPIE:
+        case WD_CMD_DRAWRECT:
+        case WD_CMD_FILLELLIPSE:
+        case WD_CMD_FILLPATH:
+        case WD_CMD_FILLMESH:
+        case WD_CMD_FILLPATHMASK:
+        case WD_CMD_FILLPIE:
+        case WD_CMD_FILLRECT:
+        case WD_CMD_FILLINSTANCES:
+        case WD_CMD_BITBLTIMAGE:
+        case WD_CMD_BITBLTCACHED:
+        case WD_CMD_DRAWSTRING:
+        case WD_CMD_DRAWTEXTLAYOUT:
+        case WD_CMD_DRAWGLYPHRUN:
+            break;
+
+        default:
+            /* State changes, and also wdBitBltHICON() as applications often
+             * destroy the icon right after painting it. */
+            wd_defer_flush(hCanvas, defer);
+            return FALSE;
+    }
+
+    if(i >= defer->alloc  &&  !wd_defer_grow(defer)) {
+        WD_TRACE("wd_defer_cmd: wd_defer_grow() failed.");
+        goto err;
+    }
+
+    defer->bounded[i] = wd_cmd_bounds(cmd, &defer->bounds[i]);
+
+    /* The application may reuse the brush with another color (or destroy
+     * it) before the queue gets painted. */
+    wd_cmd_capture(cmd);
+
+    if(!wd_dlist_append(defer->queue, cmd)) {
+        WD_TRACE("wd_defer_cmd: wd_dlist_append() failed.");
+        goto err;
+    }
+
+    /* Get the queue painted before any other object it uses is destroyed
+     * or changed. */
+    wd_hook_hold(hCanvas, cmd);
+
+    defer->calls++;
+    return TRUE;
+
+err:
+    /* Paint it directly, after anything queued before. */
+    wd_defer_flush(hCanvas, defer);
+    return FALSE;
+}
+
+void
+wd_defer_flush(WD_HCANVAS hCanvas, wd_defer_t* defer)
+{
+    wd_dlist_t* queue = defer->queue;
+    UINT n = queue->n;
+    UINT n_batches = 0;
+    UINT changes_before = 0;
+    UINT changes_after = 0;
+    wd_cmd_t cmd;
+    wd_cmd_t prev;
+    BOOL has_prev = FALSE;
+    float margin_x, margin_y;
+    UINT i, j, k;
+
+    if(n == 0)
+        goto out;
+
+    /* There can be as many batches as the commands. Size the array as the
+     * other per-command arrays (see wd_defer_grow()). */
+    if(defer->batches_alloc < defer->alloc) {
+        wd_defer_batch_t* batches;
+
+        batches = (wd_defer_batch_t*) realloc(defer->batches, defer->alloc * sizeof(wd_defer_batch_t));
+        if(batches == NULL) {
+            /* Paint it at least in the original order. */
+            WD_TRACE("wd_defer_flush: realloc() failed.");
+            wd_hook_enter(hCanvas);
+            for(i = 0; i < n; i++) {
+                wd_dlist_get(queue, i, &cmd);
+                wd_cmd_execute(hCanvas, &cmd);
+            }
+            wd_hook_leave(hCanvas);
+            goto out;
+        }
+        defer->batches = batches;
+        defer->batches_alloc = defer->alloc;
+    }
+
+    /* Commands may touch one more device pixel around their bounds because
+     * of anti-aliasing. (All the queued commands share the current world
+     * transformation as any change of it flushes the queue.) */
+    wd_cull_aa_margin(hCanvas, &margin_x, &margin_y);
+
+    /* Distribute the commands into the batches. A command may join an
+     * existing batch only if it does not overlap any later batch. */
+    for(i = 0; i < n; i++) {
+        wd_defer_batch_t* b = NULL;
+
+        if(defer->bounded[i]) {
+            defer->bounds[i].x0 -= margin_x;
+            defer->bounds[i].y0 -= margin_y;
+            defer->bounds[i].x1 += margin_x;
+            defer->bounds[i].y1 += margin_y;
+        }
+
+        wd_dlist_get(queue, i, &cmd);
+        if(i > 0  &&  wd_defer_state_differs(&prev, &cmd))
+            changes_before++;
+        memcpy(&prev, &cmd, sizeof(wd_cmd_t));
+
+        defer->next[i] = WD_DEFER_NONE;
+
+        for(k = n_batches; k > 0  &&  n_batches - k < WD_DEFER_LOOKBACK; k--) {
+            wd_defer_batch_t* bk = &defer->batches[k-1];
+
+            if(wd_defer_batch_matches(bk, &cmd)) {
+                b = bk;
+                break;
+            }
+
+            if(wd_defer_overlap(bk->bounded, &bk->bounds, defer->bounded[i], &defer->bounds[i]))
+                break;
+        }
+
+        if(b != NULL) {
+            defer->next[b->tail] = i;
+            b->tail = i;
+            if(b->bounded  &&  defer->bounded[i]) {
+                b->bounds.x0 = WD_MIN(b->bounds.x0, defer->bounds[i].x0);
+                b->bounds.y0 = WD_MIN(b->bounds.y0, defer->bounds[i].y0);
+                b->bounds.x1 = WD_MAX(b->bounds.x1, defer->bounds[i].x1);
+                b->bounds.y1 = WD_MAX(b->bounds.y1, defer->bounds[i].y1);
+            } else {
+                b->bounded = FALSE;
+            }
+        } else {
+            b = &defer->batches[n_batches++];
+            b->brush = cmd.brush;
+            b->style = cmd.style;
+            b->kind = cmd.kind;
+            b->solid = ((cmd.flags & WD_CMDFLAG_SOLIDCOLOR) != 0);
+            b->color = cmd.color;
+            b->bounded = defer->bounded[i];
+            memcpy(&b->bounds, &defer->bounds[i], sizeof(WD_RECT));
+            b->head = i;
+            b->tail = i;
+        }
+    }
+
+    /* Paint the batches. */
+    wd_hook_enter(hCanvas);
+    for(k = 0; k < n_batches; k++) {
+        for(j = defer->batches[k].head; j != WD_DEFER_NONE; j = defer->next[j]) {
+            wd_dlist_get(queue, j, &cmd);
+            if(has_prev  &&  wd_defer_state_differs(&prev, &cmd))
+                changes_after++;
+            wd_cmd_execute(hCanvas, &cmd);
+            memcpy(&prev, &cmd, sizeof(wd_cmd_t));
+            has_prev = TRUE;
+        }
+    }
+    wd_hook_leave(hCanvas);
+
+    defer->state_changes += changes_after;
+    if(changes_before > changes_after)
+        defer->state_changes_saved += changes_before - changes_after;
+
+out:
+    wd_dlist_reset(defer->queue);
+    wd_hook_unhold(hCanvas);
+}
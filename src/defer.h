@@ -0,0 +1,75 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_DEFER_H
+#define WD_DEFER_H
+
+#include "misc.h"
+#include "hook.h"
+
+
+/* Implementation of WD_CANVAS_DEFERRED.
+ *
+ * The drawing calls are queued and painted only on wd_defer_flush(). At that
+ * time, the queued calls are grouped by the brush (or the color, for solid
+ * brushes), stroke style and kind of the call, so that the back-end has to
+ * change its state less often. A call
+ * is moved ahead of other calls only if it does not overlap with them, so
+ * the result is the same as if painted in the original order.
+ *
+ * Calls which change the canvas state (clip, transformation, clear) flush the
+ * queue and are performed immediately. So all the queued calls always share
+ * the same coordinate system.
+ *
+ * The color of solid brushes is captured when the call is queued. Destroying
+ * or changing any other object used by the queued calls flushes the queue
+ * (see wd_hook_hold()).
+ */
+
+typedef struct wd_defer_batch_tag wd_defer_batch_t;
+
+struct wd_defer_tag {
+    wd_dlist_t* queue;
+    WD_RECT* bounds;            /* Parallel with queue->recs. */
+    BOOL* bounded;              /* Parallel with queue->recs. */
+    UINT* next;                 /* Parallel with queue->recs; links the batch members. */
+    UINT alloc;
+
+    wd_defer_batch_t* batches;
+    UINT batches_alloc;
+
+    /* Statistics. */
+    UINT calls;
+    UINT state_changes;
+    UINT state_changes_saved;
+};
+
+
+BOOL wd_defer_install(WD_HCANVAS hCanvas);
+void wd_defer_free(wd_defer_t* defer);
+
+BOOL wd_defer_cmd(WD_HCANVAS hCanvas, wd_defer_t* defer, wd_cmd_t* cmd);
+void wd_defer_flush(WD_HCANVAS hCanvas, wd_defer_t* defer);
+
+
+#endif  /* WD_DEFER_H */
@@ -0,0 +1,1042 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "dlfile.h"
+#include "dlist.h"
+#include "backend-d2d.h"
+#include "backend-dwrite.h"
+#include "backend-gdix.h"
+
+
+/* Kinds of wd_cmd_t::obj, as far as the file format is concerned. */
+#define DLFILE_OBJ_UNSUPPORTED      (-1)
+#define DLFILE_OBJ_NONE             0
+#define DLFILE_OBJ_PATH             1
+#define DLFILE_OBJ_FONT             2
+
+static int
+dlfile_obj_type(WORD kind)
+{
+    switch(kind) {
+        case WD_CMD_CLEAR:
+        case WD_CMD_ROTATEWORLD:
+        case WD_CMD_TRANSLATEWORLD:
+        case WD_CMD_TRANSFORMWORLD:
+        case WD_CMD_RESETWORLD:
+        case WD_CMD_DRAWARC:
+        case WD_CMD_DRAWELLIPSE:
+        case WD_CMD_DRAWLINE:
+        case WD_CMD_DRAWPIE:
+        case WD_CMD_DRAWRECT:
+        case WD_CMD_FILLELLIPSE:
+        case WD_CMD_FILLPIE:
+        case WD_CMD_FILLRECT:
+            return DLFILE_OBJ_NONE;
+
+        case WD_CMD_SETCLIP:
+        case WD_CMD_DRAWPATH:
+        case WD_CMD_FILLPATH:
+        case WD_CMD_FILLINSTANCES:
+            return DLFILE_OBJ_PATH;
+
+        case WD_CMD_DRAWSTRING:
+            return DLFILE_OBJ_FONT;
+
+        /* Meshes, path masks, images, icons and nested display lists are
+         * device-dependent (or too heavy) to be stored. So are glyph runs
+         * as the glyph indices are specific to the font file. */
+        default:
+            return DLFILE_OBJ_UNSUPPORTED;
+    }
+}
+
+
+/* Flags of wd_cmd_t which make sense in the file for the given kind.
+ * (WD_CMDFLAG_SOLIDCOLOR never does: The file has no place for the color and
+ * the brushes are stored with their colors anyway.) */
+static WORD
+dlfile_cmd_flags(WORD kind)
+{
+    switch(kind) {
+        case WD_CMD_SETCLIP:
+        case WD_CMD_DRAWSTRING:
+            return WD_CMDFLAG_HASRECT;
+
+        case WD_CMD_TRANSFORMWORLD:
+            return WD_CMDFLAG_HASMATRIX;
+
+        default:
+            return 0;
+    }
+}
+
+/* Whether the command paints with a brush (and so it needs one). */
+static BOOL
+dlfile_cmd_needs_brush(WORD kind)
+{
+    switch(kind) {
+        case WD_CMD_DRAWARC:
+        case WD_CMD_DRAWELLIPSE:
+        case WD_CMD_DRAWLINE:
+        case WD_CMD_DRAWPATH:
+        case WD_CMD_DRAWPIE:
+        case WD_CMD_DRAWRECT:
+        case WD_CMD_FILLELLIPSE:
+        case WD_CMD_FILLPATH:
+        case WD_CMD_FILLPIE:
+        case WD_CMD_FILLRECT:
+        case WD_CMD_DRAWSTRING:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* Empty strings paint nothing. They are not stored so that each stored
+ * WD_CMD_DRAWSTRING has its text. */
+static inline BOOL
+dlfile_cmd_skipped(const wd_cmd_t* cmd)
+{
+    return (cmd->kind == WD_CMD_DRAWSTRING  &&  cmd->len <= 0);
+}
+
+
+/*****************
+ ***  Writing  ***
+ *****************/
+
+typedef struct dlfile_buf_tag dlfile_buf_t;
+struct dlfile_buf_tag {
+    BYTE* data;
+    UINT size;
+    UINT alloc;
+};
+
+/* Append size bytes (zeros if data is NULL). Returns offset of the appended
+ * data, or (UINT) -1 on failure. */
+static UINT
+dlfile_buf_append(dlfile_buf_t* buf, const void* data, UINT size)
+{
+    UINT off = buf->size;
+
+    if(buf->size + size > buf->alloc) {
+        UINT alloc = WD_MAX(2 * buf->alloc, buf->size + size);
+        BYTE* tmp;
+
+        alloc = WD_MAX(alloc, 256);
+        tmp = (BYTE*) realloc(buf->data, alloc);
+        if(tmp == NULL) {
+            WD_TRACE("dlfile_buf_append: realloc() failed.");
+            return (UINT) -1;
+        }
+        buf->data = tmp;
+        buf->alloc = alloc;
+    }
+
+    if(data != NULL)
+        memcpy(buf->data + off, data, size);
+    else
+        memset(buf->data + off, 0, size);
+    buf->size += size;
+    return off;
+}
+
+/* Append as a new aligned item of the blob. */
+static UINT
+dlfile_buf_append_item(dlfile_buf_t* buf, const void* data, UINT size)
+{
+    UINT off;
+
+    off = dlfile_buf_append(buf, data, size);
+    if(off == (UINT) -1)
+        return off;
+    if(dlfile_buf_append(buf, NULL, WD_DLFILE_ALIGNED(size) - size) == (UINT) -1)
+        return (UINT) -1;
+    return off;
+}
+
+
+/* Set of the resources (brushes etc.) used by the list. The items are kept
+ * in the order of adding; the hash table (open addressing, size is a power of
+ * 2) maps them to their index + 1. */
+typedef struct dlfile_set_tag dlfile_set_t;
+struct dlfile_set_tag {
+    void** items;
+    UINT n;
+    UINT* table;
+    UINT table_size;
+};
+
+static inline UINT
+dlfile_set_hash(const void* item)
+{
+    return (UINT32) ((UINT_PTR) item >> 4) * 2654435761u;
+}
+
+static void
+dlfile_set_free(dlfile_set_t* set)
+{
+    free(set->items);
+    free(set->table);
+}
+
+static BOOL
+dlfile_set_grow(dlfile_set_t* set)
+{
+    UINT table_size = (set->table_size > 0 ? 2 * set->table_size : 32);
+    UINT mask = table_size - 1;
+    void** items;
+    UINT* table;
+    UINT i, j;
+
+    /* Keep the load factor at most 1/2. */
+    items = (void**) realloc(set->items, (table_size / 2) * sizeof(void*));
+    if(items == NULL)
+        return FALSE;
+    set->items = items;
+
+    table = (UINT*) malloc(table_size * sizeof(UINT));
+    if(table == NULL)
+        return FALSE;
+    memset(table, 0, table_size * sizeof(UINT));
+    for(i = 0; i < set->n; i++) {
+        for(j = dlfile_set_hash(set->items[i]) & mask; table[j] != 0; j = (j + 1) & mask)
+            ;
+        table[j] = i + 1;
+    }
+
+    free(set->table);
+    set->table = table;
+    set->table_size = table_size;
+    return TRUE;
+}
+
+/* Returns index + 1 of the item (adding it if not present yet), zero for NULL
+ * item, or (UINT) -1 on failure. */
+static UINT
+dlfile_set_add(dlfile_set_t* set, void* item)
+{
+    UINT mask;
+    UINT i;
+
+    if(item == NULL)
+        return 0;
+
+    if(2 * (set->n + 1) > set->table_size  &&  !dlfile_set_grow(set)) {
+        WD_TRACE("dlfile_set_add: dlfile_set_grow() failed.");
+        return (UINT) -1;
+    }
+
+    mask = set->table_size - 1;
+    for(i = dlfile_set_hash(item) & mask; set->table[i] != 0; i = (i + 1) & mask) {
+        if(set->items[set->table[i] - 1] == item)
+            return set->table[i];
+    }
+
+    set->items[set->n++] = item;
+    set->table[i] = set->n;
+    return set->n;
+}
+
+
+static BOOL
+dlfile_get_style(WD_HSTROKESTYLE hStrokeStyle, dlfile_buf_t* out, wd_dlfile_style_t* rec)
+{
+    float* dashes;
+    UINT off;
+
+    if(d2d_enabled()) {
+        c_ID2D1StrokeStyle* s = (c_ID2D1StrokeStyle*) hStrokeStyle;
+
+        rec->dash_style = (UINT32) c_ID2D1StrokeStyle_GetDashStyle(s);
+        rec->line_cap = (UINT32) c_ID2D1StrokeStyle_GetStartCap(s);
+        rec->line_join = (UINT32) c_ID2D1StrokeStyle_GetLineJoin(s);
+        rec->n_dashes = c_ID2D1StrokeStyle_GetDashesCount(s);
+        dashes = NULL;
+    } else {
+        gdix_strokestyle_t* s = (gdix_strokestyle_t*) hStrokeStyle;
+
+        rec->dash_style = (UINT32) s->dashStyle;
+        rec->line_cap = (UINT32) s->lineCap;
+        rec->line_join = (UINT32) s->lineJoin;
+        rec->n_dashes = s->dashesCount;
+        dashes = s->dashes;
+    }
+
+    rec->dashes_offset = 0;
+    if(rec->n_dashes > 0) {
+        off = dlfile_buf_append_item(out, dashes, rec->n_dashes * sizeof(float));
+        if(off == (UINT) -1)
+            return FALSE;
+        if(d2d_enabled()) {
+            c_ID2D1StrokeStyle_GetDashes((c_ID2D1StrokeStyle*) hStrokeStyle,
+                        (float*) (out->data + off), rec->n_dashes);
+        }
+        rec->dashes_offset = off;
+    }
+
+    return TRUE;
+}
+
+
+/* The path is stored as GDI+-like arrays of points and point types, built
+ * from the figures the path records (see wdGetPathData()). */
+static BOOL
+dlfile_get_path(WD_HPATH hPath, dlfile_buf_t* out, wd_dlfile_path_t* rec)
+{
+    BYTE* verbs;
+    BYTE* types;
+    UINT n_verbs = 0;
+    UINT points_off;
+    UINT types_off;
+    UINT n = 0;
+    UINT i, j, k;
+
+    wdGetPathData(hPath, NULL, &n_verbs, NULL, &n);
+
+    verbs = (BYTE*) malloc(WD_MAX(n_verbs, 1));
+    if(verbs == NULL) {
+        WD_TRACE("dlfile_get_path: malloc() failed.");
+        return FALSE;
+    }
+
+    points_off = dlfile_buf_append_item(out, NULL, n * 2 * sizeof(float));
+    types_off = dlfile_buf_append_item(out, NULL, n);
+    if(points_off == (UINT) -1  ||  types_off == (UINT) -1) {
+        free(verbs);
+        return FALSE;
+    }
+
+    if(!wdGetPathData(hPath, verbs, &n_verbs,
+                      (WD_POINT*) (out->data + points_off), &n)) {
+        WD_TRACE("dlfile_get_path: wdGetPathData() failed.");
+        free(verbs);
+        return FALSE;
+    }
+
+    types = out->data + types_off;
+    for(i = 0, j = 0; i < n_verbs; i++) {
+        switch(verbs[i]) {
+            case WD_PATHVERB_BEGINFIGURE:
+                types[j++] = WD_DLFILE_PT_START;
+                break;
+
+            case WD_PATHVERB_LINE:
+                types[j++] = WD_DLFILE_PT_LINE;
+                break;
+
+            case WD_PATHVERB_BEZIER:
+                for(k = 0; k < 3; k++)
+                    types[j++] = WD_DLFILE_PT_BEZIER;
+                break;
+
+            case WD_PATHVERB_CLOSEFIGURE:
+                if(j > 0)
+                    types[j - 1] |= WD_DLFILE_PT_CLOSE;
+                break;
+        }
+    }
+    free(verbs);
+
+    rec->n_points = n;
+    rec->points_offset = points_off;
+    rec->types_offset = types_off;
+    rec->reserved = 0;
+    return TRUE;
+}
+
+static BOOL
+dlfile_get_font(WD_HFONT hFont, LOGFONTW* lf)
+{
+    memset(lf, 0, sizeof(LOGFONTW));
+
+    if(d2d_enabled()) {
+        dwrite_font_t* font = (dwrite_font_t*) hFont;
+        HRESULT hr;
+
+        hr = c_IDWriteTextFormat_GetFontFamilyName(font->tf, lf->lfFaceName, LF_FACESIZE);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("dlfile_get_font: "
+                        "IDWriteTextFormat::GetFontFamilyName() failed.");
+            return FALSE;
+        }
+
+        lf->lfHeight = -(LONG) (c_IDWriteTextFormat_GetFontSize(font->tf) + 0.5f);
+        lf->lfWeight = (LONG) c_IDWriteTextFormat_GetFontWeight(font->tf);
+        lf->lfItalic = (c_IDWriteTextFormat_GetFontStyle(font->tf) != c_DWRITE_FONT_STYLE_NORMAL);
+        lf->lfCharSet = DEFAULT_CHARSET;
+    } else {
+        c_GpGraphics* g;
+        HDC dc;
+        int status;
+
+        dc = GetDC(NULL);
+        status = gdix_vtable->fn_CreateFromHDC(dc, &g);
+        if(status == 0) {
+            status = gdix_vtable->fn_GetLogFontW((c_GpFont*) hFont, g, lf);
+            gdix_vtable->fn_DeleteGraphics(g);
+        }
+        ReleaseDC(NULL, dc);
+
+        if(status != 0) {
+            WD_TRACE("dlfile_get_font: GdipGetLogFontW() failed. [%d]", status);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static BOOL
+dlfile_write(HANDLE file, const void* data, UINT size)
+{
+    DWORD n;
+
+    if(!WriteFile(file, data, size, &n, NULL)  ||  n != size) {
+        WD_TRACE_ERR("dlfile_write: WriteFile() failed.");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Serialize the (recorded) display list into out. */
+static BOOL
+dlfile_build(wd_dlist_t* dlist, dlfile_buf_t* out)
+{
+    dlfile_set_t brushes = { 0 };
+    dlfile_set_t styles = { 0 };
+    dlfile_set_t paths = { 0 };
+    dlfile_set_t fonts = { 0 };
+    wd_dlfile_header_t* hdr;
+    UINT n_cmds = 0;
+    UINT off;
+    UINT i, j;
+    BOOL ret = FALSE;
+
+    /* Pass 1: Collect the resources. */
+    for(i = 0; i < dlist->n; i++) {
+        wd_cmd_t cmd_buf;
+        const wd_cmd_t* cmd = &cmd_buf;
+        int obj_type;
+
+        wd_dlist_get(dlist, i, &cmd_buf);
+        if(dlfile_cmd_skipped(cmd))
+            continue;
+        n_cmds++;
+        obj_type = dlfile_obj_type(cmd->kind);
+        if(obj_type == DLFILE_OBJ_UNSUPPORTED) {
+            WD_TRACE("dlfile_build: Command kind %u cannot be saved.", (unsigned) cmd->kind);
+            goto out;
+        }
+
+        if(dlfile_set_add(&brushes, cmd->brush) == (UINT) -1  ||
+           dlfile_set_add(&styles, cmd->style) == (UINT) -1  ||
+           dlfile_set_add((obj_type == DLFILE_OBJ_FONT ? &fonts : &paths),
+                          (obj_type != DLFILE_OBJ_NONE ? cmd->obj : NULL)) == (UINT) -1)
+            goto out;
+    }
+
+    /* Layout the header and the tables. The blob follows them. */
+    if(dlfile_buf_append(out, NULL, WD_DLFILE_ALIGNED(sizeof(wd_dlfile_header_t))) == (UINT) -1)
+        goto out;
+    hdr = (wd_dlfile_header_t*) out->data;
+    memcpy(hdr->magic, WD_DLFILE_MAGIC, sizeof(hdr->magic));
+    hdr->version = WD_DLFILE_VERSION;
+    hdr->flags = (dlist->has_clip ? WD_DLFILE_HASCLIP : 0);
+
+#define DLFILE_TABLE(table, cnt, item_size)                                     \
+        do {                                                                    \
+            off = dlfile_buf_append_item(out, NULL, (cnt) * (item_size));       \
+            if(off == (UINT) -1)                                                \
+                goto out;                                                       \
+            ((wd_dlfile_header_t*) out->data)->table.count = (cnt);             \
+            ((wd_dlfile_header_t*) out->data)->table.offset = off;              \
+        } while(0)
+
+    DLFILE_TABLE(cmds, n_cmds, sizeof(wd_dlfile_cmd_t));
+    DLFILE_TABLE(brushes, brushes.n, sizeof(wd_dlfile_brush_t));
+    DLFILE_TABLE(styles, styles.n, sizeof(wd_dlfile_style_t));
+    DLFILE_TABLE(paths, paths.n, sizeof(wd_dlfile_path_t));
+    DLFILE_TABLE(fonts, fonts.n, sizeof(LOGFONTW));
+
+#undef DLFILE_TABLE
+
+    /* Pass 2: The resources. Note the blob may reallocate the buffer so we
+     * cannot keep any pointers into it. */
+#define DLFILE_ITEM(table, type, i)                                             \
+        ((type*) (out->data + ((wd_dlfile_header_t*) out->data)->table.offset) + (i))
+
+    for(i = 0; i < brushes.n; i++) {
+        wd_dlfile_brush_t rec;
+
+        if(!wd_brush_solid_color((WD_HBRUSH) brushes.items[i], (WD_COLOR*) &rec.color)) {
+            WD_TRACE("dlfile_build: Only solid brushes are supported.");
+            goto out;
+        }
+        memcpy(DLFILE_ITEM(brushes, wd_dlfile_brush_t, i), &rec, sizeof(rec));
+    }
+
+    for(i = 0; i < styles.n; i++) {
+        wd_dlfile_style_t rec;
+
+        if(!dlfile_get_style((WD_HSTROKESTYLE) styles.items[i], out, &rec))
+            goto out;
+        memcpy(DLFILE_ITEM(styles, wd_dlfile_style_t, i), &rec, sizeof(rec));
+    }
+
+    for(i = 0; i < paths.n; i++) {
+        wd_dlfile_path_t rec;
+
+        if(!dlfile_get_path((WD_HPATH) paths.items[i], out, &rec))
+            goto out;
+        memcpy(DLFILE_ITEM(paths, wd_dlfile_path_t, i), &rec, sizeof(rec));
+    }
+
+    for(i = 0; i < fonts.n; i++) {
+        LOGFONTW lf;
+
+        if(!dlfile_get_font((WD_HFONT) fonts.items[i], &lf))
+            goto out;
+        memcpy(DLFILE_ITEM(fonts, LOGFONTW, i), &lf, sizeof(lf));
+    }
+
+    /* Pass 3: The commands. */
+    for(i = 0, j = 0; i < dlist->n; i++) {
+        wd_cmd_t cmd_buf;
+        const wd_cmd_t* cmd = &cmd_buf;
+        int obj_type;
+        wd_dlfile_cmd_t rec;
+
+        wd_dlist_get(dlist, i, &cmd_buf);
+        if(dlfile_cmd_skipped(cmd))
+            continue;
+        obj_type = dlfile_obj_type(cmd->kind);
+
+        memset(&rec, 0, sizeof(rec));
+        rec.kind = cmd->kind;
+        rec.flags = cmd->flags & dlfile_cmd_flags(cmd->kind);
+        rec.dw = cmd->dw;
+        rec.len = cmd->len;
+        rec.brush = dlfile_set_add(&brushes, cmd->brush);
+        rec.style = dlfile_set_add(&styles, cmd->style);
+        if(obj_type == DLFILE_OBJ_PATH)
+            rec.obj = dlfile_set_add(&paths, cmd->obj);
+        else if(obj_type == DLFILE_OBJ_FONT)
+            rec.obj = dlfile_set_add(&fonts, cmd->obj);
+        memcpy(rec.a, cmd->a, sizeof(rec.a));
+
+        if(wd_cmd_data_size(cmd) > 0) {
+            off = dlfile_buf_append_item(out, cmd->data, wd_cmd_data_size(cmd));
+            if(off == (UINT) -1)
+                goto out;
+            rec.data_offset = off;
+        }
+
+        memcpy(DLFILE_ITEM(cmds, wd_dlfile_cmd_t, j), &rec, sizeof(rec));
+        j++;
+    }
+
+#undef DLFILE_ITEM
+
+    ((wd_dlfile_header_t*) out->data)->size = out->size;
+    ret = TRUE;
+
+out:
+    dlfile_set_free(&brushes);
+    dlfile_set_free(&styles);
+    dlfile_set_free(&paths);
+    dlfile_set_free(&fonts);
+    return ret;
+}
+
+
+/*****************
+ ***  Mapping  ***
+ *****************/
+
+struct wd_dlmap_tag {
+    HANDLE file;
+    HANDLE mapping;
+    const BYTE* base;
+    const wd_dlfile_header_t* hdr;
+    BOOL prepared;
+    UINT canvas_serial;             /* Canvas the brushes are created for. */
+    WD_HBRUSH* brushes;
+    WD_HSTROKESTYLE* styles;
+    WD_HPATH* paths;
+    WD_HFONT* fonts;
+};
+
+static BOOL
+dlfile_check_table(const wd_dlfile_header_t* hdr, const wd_dlfile_table_t* table, UINT item_size)
+{
+    if(table->offset % 4 != 0  ||  table->offset > hdr->size)
+        return FALSE;
+    if(table->count > (hdr->size - table->offset) / item_size)
+        return FALSE;
+    return TRUE;
+}
+
+/* Check the array of n items at offset off is within the file. */
+static BOOL
+dlfile_check_range(const wd_dlfile_header_t* hdr, UINT32 off, UINT32 n, UINT item_size)
+{
+    if(off > hdr->size)
+        return FALSE;
+    if(n > (hdr->size - off) / item_size)
+        return FALSE;
+    return TRUE;
+}
+
+static wd_dlmap_t*
+wd_dlmap_open(const WCHAR* path)
+{
+    HANDLE file;
+    HANDLE mapping;
+    const BYTE* base;
+    const wd_dlfile_header_t* hdr;
+    DWORD file_size;
+    UINT n_slots;
+    wd_dlmap_t* map;
+
+    file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        WD_TRACE_ERR("wd_dlmap_open: CreateFileW() failed.");
+        goto err_CreateFile;
+    }
+
+    file_size = GetFileSize(file, NULL);
+    if(file_size == INVALID_FILE_SIZE  ||  file_size < sizeof(wd_dlfile_header_t)) {
+        WD_TRACE("wd_dlmap_open: Not a display list file.");
+        goto err_GetFileSize;
+    }
+
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping == NULL) {
+        WD_TRACE_ERR("wd_dlmap_open: CreateFileMappingW() failed.");
+        goto err_CreateFileMapping;
+    }
+
+    base = (const BYTE*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(base == NULL) {
+        WD_TRACE_ERR("wd_dlmap_open: MapViewOfFile() failed.");
+        goto err_MapViewOfFile;
+    }
+
+    hdr = (const wd_dlfile_header_t*) base;
+    if(memcmp(hdr->magic, WD_DLFILE_MAGIC, sizeof(hdr->magic)) != 0  ||
+       hdr->version != WD_DLFILE_VERSION  ||  hdr->size > file_size  ||
+       !dlfile_check_table(hdr, &hdr->cmds, sizeof(wd_dlfile_cmd_t))  ||
+       !dlfile_check_table(hdr, &hdr->brushes, sizeof(wd_dlfile_brush_t))  ||
+       !dlfile_check_table(hdr, &hdr->styles, sizeof(wd_dlfile_style_t))  ||
+       !dlfile_check_table(hdr, &hdr->paths, sizeof(wd_dlfile_path_t))  ||
+       !dlfile_check_table(hdr, &hdr->fonts, sizeof(LOGFONTW)))
+    {
+        WD_TRACE("wd_dlmap_open: Not a display list file or unsupported version.");
+        goto err_header;
+    }
+
+    /* Allocate the slots for the resources together with the map. */
+    n_slots = hdr->brushes.count + hdr->styles.count + hdr->paths.count + hdr->fonts.count;
+    map = (wd_dlmap_t*) malloc(sizeof(wd_dlmap_t) + n_slots * sizeof(void*));
+    if(map == NULL) {
+        WD_TRACE("wd_dlmap_open: malloc() failed.");
+        goto err_malloc;
+    }
+
+    memset(map, 0, sizeof(wd_dlmap_t) + n_slots * sizeof(void*));
+    map->file = file;
+    map->mapping = mapping;
+    map->base = base;
+    map->hdr = hdr;
+    map->brushes = (WD_HBRUSH*) (map + 1);
+    map->styles = (WD_HSTROKESTYLE*) (map->brushes + hdr->brushes.count);
+    map->paths = (WD_HPATH*) (map->styles + hdr->styles.count);
+    map->fonts = (WD_HFONT*) (map->paths + hdr->paths.count);
+    return map;
+
+    /* Error path unwinding */
+err_malloc:
+err_header:
+    UnmapViewOfFile(base);
+err_MapViewOfFile:
+    CloseHandle(mapping);
+err_CreateFileMapping:
+err_GetFileSize:
+    CloseHandle(file);
+err_CreateFile:
+    return NULL;
+}
+
+static void
+wd_dlmap_release_brushes(wd_dlmap_t* map)
+{
+    UINT i;
+
+    for(i = 0; i < map->hdr->brushes.count; i++) {
+        if(map->brushes[i] != NULL) {
+            wdDestroyBrush(map->brushes[i]);
+            map->brushes[i] = NULL;
+        }
+    }
+    map->canvas_serial = 0;
+}
+
+void
+wd_dlmap_close(wd_dlmap_t* map)
+{
+    const wd_dlfile_header_t* hdr = map->hdr;
+    UINT i;
+
+    wd_dlmap_release_brushes(map);
+    for(i = 0; i < hdr->styles.count; i++) {
+        if(map->styles[i] != NULL)
+            wdDestroyStrokeStyle(map->styles[i]);
+    }
+    for(i = 0; i < hdr->paths.count; i++) {
+        if(map->paths[i] != NULL)
+            wdDestroyPath(map->paths[i]);
+    }
+    for(i = 0; i < hdr->fonts.count; i++) {
+        if(map->fonts[i] != NULL)
+            wdDestroyFont(map->fonts[i]);
+    }
+
+    UnmapViewOfFile(map->base);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+    free(map);
+}
+
+static WD_HSTROKESTYLE
+wd_dlmap_create_style(const wd_dlmap_t* map, const wd_dlfile_style_t* rec)
+{
+    const float* dashes = NULL;
+
+    /* dash_style is the back-end style (see dlfile_get_style()). Only the
+     * custom one may have the dashes. */
+    if(rec->dash_style > WD_STROKESTYLE_DASH_CUSTOM  ||
+       rec->line_cap > WD_LINECAP_TRIANGLE  ||  rec->line_join > WD_LINEJOIN_ROUND)
+        return NULL;
+
+    if(rec->n_dashes > 0) {
+        if(rec->dash_style != WD_STROKESTYLE_DASH_CUSTOM  ||  rec->dashes_offset % 4 != 0  ||
+           !dlfile_check_range(map->hdr, rec->dashes_offset, rec->n_dashes, sizeof(float)))
+            return NULL;
+        dashes = (const float*) (map->base + rec->dashes_offset);
+    }
+
+    return wd_stroke_style_create(rec->dash_style, dashes, rec->n_dashes,
+                                  rec->line_cap, rec->line_join);
+}
+
+static WD_HPATH
+wd_dlmap_create_path(const wd_dlmap_t* map, WD_HCANVAS hCanvas, const wd_dlfile_path_t* rec)
+{
+    const float* pts;
+    const BYTE* types;
+    WD_HPATH path;
+    WD_PATHSINK sink;
+    BOOL in_figure = FALSE;
+    UINT i;
+
+    if(rec->points_offset % 4 != 0  ||
+       !dlfile_check_range(map->hdr, rec->points_offset, rec->n_points, 2 * sizeof(float))  ||
+       !dlfile_check_range(map->hdr, rec->types_offset, rec->n_points, sizeof(BYTE)))
+        return NULL;
+    pts = (const float*) (map->base + rec->points_offset);
+    types = map->base + rec->types_offset;
+
+    path = wdCreatePath(hCanvas);
+    if(path == NULL)
+        return NULL;
+    if(!wdOpenPathSink(&sink, path)) {
+        wdDestroyPath(path);
+        return NULL;
+    }
+
+    for(i = 0; i < rec->n_points; i++) {
+        const float* p = &pts[2 * i];
+
+        switch(types[i] & WD_DLFILE_PT_TYPEMASK) {
+            case WD_DLFILE_PT_START:
+                if(in_figure)
+                    wdEndFigure(&sink, FALSE);
+                wdBeginFigure(&sink, p[0], p[1]);
+                in_figure = TRUE;
+                break;
+
+            case WD_DLFILE_PT_LINE:
+                wdAddLine(&sink, p[0], p[1]);
+                break;
+
+            case WD_DLFILE_PT_BEZIER:
+                if(i + 2 >= rec->n_points)
+                    goto err_malformed;
+                wdAddBezier(&sink, p[0], p[1], p[2], p[3], p[4], p[5]);
+                i += 2;
+                break;
+
+            default:
+                goto err_malformed;
+        }
+
+        if(types[i] & WD_DLFILE_PT_CLOSE) {
+            if(in_figure)
+                wdEndFigure(&sink, TRUE);
+            in_figure = FALSE;
+        }
+    }
+
+    if(in_figure)
+        wdEndFigure(&sink, FALSE);
+    wdClosePathSink(&sink);
+    return path;
+
+err_malformed:
+    WD_TRACE("wd_dlmap_create_path: Malformed path.");
+    if(in_figure)
+        wdEndFigure(&sink, FALSE);
+    wdClosePathSink(&sink);
+    wdDestroyPath(path);
+    return NULL;
+}
+
+BOOL
+wd_dlmap_prepare(wd_dlmap_t* map, WD_HCANVAS hCanvas)
+{
+    const wd_dlfile_header_t* hdr = map->hdr;
+    UINT i;
+
+    /* Brushes are bound to the canvas. Everything else is created only once,
+     * on the first replay. (The canvas is identified by its serial as a new
+     * canvas may get the address of an already destroyed one.) */
+    if(wd_canvas_serial(hCanvas) != map->canvas_serial) {
+        const wd_dlfile_brush_t* brushes =
+                    (const wd_dlfile_brush_t*) (map->base + hdr->brushes.offset);
+
+        wd_dlmap_release_brushes(map);
+        for(i = 0; i < hdr->brushes.count; i++) {
+            map->brushes[i] = wdCreateSolidBrush(hCanvas, brushes[i].color);
+            if(map->brushes[i] == NULL)
+                goto err;
+        }
+        map->canvas_serial = wd_canvas_serial(hCanvas);
+    }
+
+    if(!map->prepared) {
+        const wd_dlfile_style_t* styles =
+                    (const wd_dlfile_style_t*) (map->base + hdr->styles.offset);
+        const wd_dlfile_path_t* paths =
+                    (const wd_dlfile_path_t*) (map->base + hdr->paths.offset);
+        const LOGFONTW* fonts = (const LOGFONTW*) (map->base + hdr->fonts.offset);
+
+        for(i = 0; i < hdr->styles.count; i++) {
+            if(map->styles[i] == NULL) {
+                map->styles[i] = wd_dlmap_create_style(map, &styles[i]);
+                if(map->styles[i] == NULL)
+                    goto err;
+            }
+        }
+
+        for(i = 0; i < hdr->paths.count; i++) {
+            if(map->paths[i] == NULL) {
+                map->paths[i] = wd_dlmap_create_path(map, hCanvas, &paths[i]);
+                if(map->paths[i] == NULL)
+                    goto err;
+            }
+        }
+
+        for(i = 0; i < hdr->fonts.count; i++) {
+            if(map->fonts[i] == NULL) {
+                LOGFONTW lf;
+
+                memcpy(&lf, &fonts[i], sizeof(LOGFONTW));
+                lf.lfFaceName[LF_FACESIZE - 1] = L'\0';
+                map->fonts[i] = wdCreateFont(&lf);
+                if(map->fonts[i] == NULL)
+                    goto err;
+            }
+        }
+
+        map->prepared = TRUE;
+    }
+
+    return TRUE;
+
+err:
+    WD_TRACE("wd_dlmap_prepare: Failed to create resources of the display list.");
+    return FALSE;
+}
+
+BOOL
+wd_dlmap_get_cmd(const wd_dlmap_t* map, UINT i, wd_cmd_t* cmd)
+{
+    const wd_dlfile_header_t* hdr = map->hdr;
+    const wd_dlfile_cmd_t* rec;
+    int obj_type;
+    UINT item_size;
+
+    rec = (const wd_dlfile_cmd_t*) (map->base + hdr->cmds.offset) + i;
+    obj_type = dlfile_obj_type(rec->kind);
+    item_size = (rec->kind == WD_CMD_FILLINSTANCES ? sizeof(WD_INSTANCE) : sizeof(WCHAR));
+
+    if(obj_type == DLFILE_OBJ_UNSUPPORTED  ||
+       (rec->flags & ~dlfile_cmd_flags(rec->kind)) != 0  ||
+       rec->brush > hdr->brushes.count  ||  rec->style > hdr->styles.count  ||
+       (obj_type == DLFILE_OBJ_PATH  &&  rec->obj > hdr->paths.count)  ||
+       (obj_type == DLFILE_OBJ_FONT  &&  rec->obj > hdr->fonts.count)  ||
+       rec->len < 0  ||
+       (rec->len > 0  &&  (rec->data_offset % WD_MIN(item_size, sizeof(float)) != 0  ||
+            !dlfile_check_range(hdr, rec->data_offset, rec->len, item_size))))
+        goto err;
+
+    /* Check the command has everything its kind needs. */
+    if(dlfile_cmd_needs_brush(rec->kind)  &&  rec->brush == 0)
+        goto err;
+    switch(rec->kind) {
+        case WD_CMD_TRANSFORMWORLD:
+            if(!(rec->flags & WD_CMDFLAG_HASMATRIX))
+                goto err;
+            break;
+
+        case WD_CMD_DRAWPATH:
+        case WD_CMD_FILLPATH:
+        case WD_CMD_FILLINSTANCES:
+            if(rec->obj == 0)
+                goto err;
+            break;
+
+        case WD_CMD_DRAWSTRING:
+            if(rec->obj == 0  ||  rec->len == 0  ||  !(rec->flags & WD_CMDFLAG_HASRECT))
+                goto err;
+            break;
+    }
+
+    memset(cmd, 0, sizeof(wd_cmd_t));
+    cmd->kind = rec->kind;
+    cmd->flags = rec->flags;
+    cmd->dw = rec->dw;
+    cmd->len = rec->len;
+    if(rec->brush > 0)
+        cmd->brush = map->brushes[rec->brush - 1];
+    if(rec->style > 0)
+        cmd->style = map->styles[rec->style - 1];
+    if(rec->obj > 0  &&  obj_type == DLFILE_OBJ_PATH)
+        cmd->obj = map->paths[rec->obj - 1];
+    else if(rec->obj > 0  &&  obj_type == DLFILE_OBJ_FONT)
+        cmd->obj = map->fonts[rec->obj - 1];
+    if(rec->len > 0)
+        cmd->data = map->base + rec->data_offset;
+    memcpy(cmd->a, rec->a, sizeof(cmd->a));
+    return TRUE;
+
+err:
+    WD_TRACE("wd_dlmap_get_cmd: Malformed command #%u.", i);
+    return FALSE;
+}
+
+
+/**************************
+ ***  Public interface  ***
+ **************************/
+
+BOOL
+wdSaveDisplayList(WD_HDISPLAYLIST hList, const WCHAR* pszPath)
+{
+    wd_dlist_t* dlist = (wd_dlist_t*) hList;
+    dlfile_buf_t out = { 0 };
+    const void* data;
+    UINT size;
+    HANDLE file;
+    BOOL ret;
+
+    if(dlist->mapped != NULL) {
+        /* Already in the file format. */
+        data = dlist->mapped->base;
+        size = dlist->mapped->hdr->size;
+    } else {
+        if(!dlfile_build(dlist, &out)) {
+            WD_TRACE("wdSaveDisplayList: dlfile_build() failed.");
+            free(out.data);
+            return FALSE;
+        }
+        data = out.data;
+        size = out.size;
+    }
+
+    file = CreateFileW(pszPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        WD_TRACE_ERR("wdSaveDisplayList: CreateFileW() failed.");
+        free(out.data);
+        return FALSE;
+    }
+
+    ret = dlfile_write(file, data, size);
+    CloseHandle(file);
+    free(out.data);
+
+    if(!ret)
+        DeleteFileW(pszPath);
+    return ret;
+}
+
+WD_HDISPLAYLIST
+wdLoadDisplayListMapped(const WCHAR* pszPath)
+{
+    wd_dlmap_t* map;
+    wd_dlist_t* dlist;
+    wd_cmd_t cmd;
+    UINT i;
+
+    map = wd_dlmap_open(pszPath);
+    if(map == NULL) {
+        WD_TRACE("wdLoadDisplayListMapped: wd_dlmap_open() failed.");
+        return NULL;
+    }
+
+    /* Refuse the whole file if any command is broken, rather than to replay
+     * it only partially. */
+    for(i = 0; i < map->hdr->cmds.count; i++) {
+        if(!wd_dlmap_get_cmd(map, i, &cmd)) {
+            WD_TRACE("wdLoadDisplayListMapped: wd_dlmap_get_cmd() failed.");
+            wd_dlmap_close(map);
+            return NULL;
+        }
+    }
+
+    dlist = wd_dlist_alloc();
+    if(dlist == NULL) {
+        WD_TRACE("wdLoadDisplayListMapped: wd_dlist_alloc() failed.");
+        wd_dlmap_close(map);
+        return NULL;
+    }
+
+    dlist->mapped = map;
+    dlist->n = map->hdr->cmds.count;
+    dlist->has_clip = ((map->hdr->flags & WD_DLFILE_HASCLIP) != 0);
+    return (WD_HDISPLAYLIST) dlist;
+}
@@ -0,0 +1,151 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_DLFILE_H
+#define WD_DLFILE_H
+
+#include "misc.h"
+#include "hook.h"
+
+
+/* Display list file
+ * =================
+ *
+ * wdSaveDisplayList() stores a display list into a compact binary file which
+ * wdLoadDisplayListMapped() maps into memory and replays in place: There is
+ * no parsing of the commands and no allocation per command; only the header
+ * and the resource tables are validated on load.
+ *
+ * File format (all little-endian, all offsets from the start of the file):
+ *
+ *   wd_dlfile_header_t
+ *   wd_dlfile_cmd_t[n_cmds]
+ *   wd_dlfile_brush_t[n_brushes]
+ *   wd_dlfile_style_t[n_styles]
+ *   wd_dlfile_path_t[n_paths]
+ *   LOGFONTW[n_fonts]
+ *   blob (texts, dashes, points and point types)
+ *
+ * Each table and each item in the blob starts on an offset aligned to
+ * WD_DLFILE_ALIGN. The commands refer to the resources by (index + 1) into
+ * the respective table; zero means NULL.
+ *
+ * Paths are stored as GDI+ stores them: An array of points and an array of
+ * point types (WD_DLFILE_PT_xxx). Arcs are stored as Bezier curves.
+ */
+
+#define WD_DLFILE_MAGIC             "WDDLIST"
+#define WD_DLFILE_VERSION           1
+#define WD_DLFILE_ALIGN             8
+
+#define WD_DLFILE_ALIGNED(sz)       (((sz) + WD_DLFILE_ALIGN - 1) & ~(WD_DLFILE_ALIGN - 1))
+
+/* wd_dlfile_header_t::flags */
+#define WD_DLFILE_HASCLIP           0x0001
+
+/* Point types. (Same as GDI+ PathPointType.) */
+#define WD_DLFILE_PT_START          0x00
+#define WD_DLFILE_PT_LINE           0x01
+#define WD_DLFILE_PT_BEZIER         0x03
+#define WD_DLFILE_PT_TYPEMASK       0x07
+#define WD_DLFILE_PT_CLOSE          0x80
+
+#pragma pack(push, 4)
+
+typedef struct wd_dlfile_table_tag wd_dlfile_table_t;
+struct wd_dlfile_table_tag {
+    UINT32 count;
+    UINT32 offset;
+};
+
+typedef struct wd_dlfile_header_tag wd_dlfile_header_t;
+struct wd_dlfile_header_tag {
+    char magic[8];
+    UINT32 version;
+    UINT32 size;            /* Size of the whole file. */
+    UINT32 flags;
+    UINT32 reserved;
+    wd_dlfile_table_t cmds;
+    wd_dlfile_table_t brushes;
+    wd_dlfile_table_t styles;
+    wd_dlfile_table_t paths;
+    wd_dlfile_table_t fonts;
+};
+
+typedef struct wd_dlfile_cmd_tag wd_dlfile_cmd_t;
+struct wd_dlfile_cmd_tag {
+    UINT16 kind;            /* WD_CMD_xxx */
+    UINT16 flags;           /* WD_CMDFLAG_xxx */
+    UINT32 dw;
+    INT32 len;              /* Length of the text (in WCHARs), or count of instances. */
+    UINT32 data_offset;     /* Offset of the text or of the WD_INSTANCE array. */
+    UINT32 brush;           /* Index + 1 into the table of brushes. */
+    UINT32 style;           /* Index + 1 into the table of stroke styles. */
+    UINT32 obj;             /* Index + 1 into the table of paths or fonts. */
+    UINT32 reserved;
+    float a[8];
+};
+
+typedef struct wd_dlfile_brush_tag wd_dlfile_brush_t;
+struct wd_dlfile_brush_tag {
+    UINT32 color;
+};
+
+typedef struct wd_dlfile_style_tag wd_dlfile_style_t;
+struct wd_dlfile_style_tag {
+    UINT32 dash_style;      /* 0 for solid, 5 for custom dashes. */
+    UINT32 line_cap;
+    UINT32 line_join;
+    UINT32 n_dashes;
+    UINT32 dashes_offset;   /* float[n_dashes] */
+};
+
+typedef struct wd_dlfile_path_tag wd_dlfile_path_t;
+struct wd_dlfile_path_tag {
+    UINT32 n_points;
+    UINT32 points_offset;   /* float[2 * n_points] */
+    UINT32 types_offset;    /* BYTE[n_points] */
+    UINT32 reserved;
+};
+
+#pragma pack(pop)
+
+
+/* Mapped display list file. (Display lists loaded by wdLoadDisplayListMapped()
+ * refer to it via wd_dlist_t::mapped.) */
+typedef struct wd_dlmap_tag wd_dlmap_t;
+
+void wd_dlmap_close(wd_dlmap_t* map);
+
+/* Create the resources the commands refer to (if not done yet) so they can be
+ * used on the canvas. */
+BOOL wd_dlmap_prepare(wd_dlmap_t* map, WD_HCANVAS hCanvas);
+
+/* Fill wd_cmd_t with the i-th command. Returns FALSE if the command is
+ * malformed: It refers to anything outside of the file, it has flags its
+ * kind does not use, or it lacks an object (brush, path, font, text) its
+ * kind needs. */
+BOOL wd_dlmap_get_cmd(const wd_dlmap_t* map, UINT i, wd_cmd_t* cmd);
+
+
+#endif  /* WD_DLFILE_H */
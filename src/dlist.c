@@ -0,0 +1,281 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "misc.h"
+#include "dlist.h"
+#include "apitrace.h"
+
+
+wd_dlist_t*
+wd_dlist_alloc(void)
+{
+    wd_dlist_t* dlist;
+
+    dlist = (wd_dlist_t*) malloc(sizeof(wd_dlist_t));
+    if(dlist == NULL) {
+        WD_TRACE("wd_dlist_alloc: malloc() failed.");
+        return NULL;
+    }
+
+    memset(dlist, 0, sizeof(wd_dlist_t));
+    wd_arena_init(&dlist->arena);
+    return dlist;
+}
+
+void
+wd_dlist_free(wd_dlist_t* dlist)
+{
+    if(dlist->mapped != NULL)
+        wd_dlmap_close(dlist->mapped);
+    wd_arena_fini(&dlist->arena);
+    free(dlist->recs);
+    free(dlist);
+}
+
+void
+wd_dlist_reset(wd_dlist_t* dlist)
+{
+    /* Keep the buffers allocated for the reuse. */
+    wd_arena_reset(&dlist->arena);
+    dlist->n = 0;
+    dlist->has_clip = FALSE;
+}
+
+BOOL
+wd_dlist_append(wd_dlist_t* dlist, const wd_cmd_t* cmd)
+{
+    wd_dlrec_t rec;
+    UINT data_size = wd_cmd_data_size(cmd);
+    size_t size;
+    BYTE* ptr;
+    int n_args;
+
+    if(dlist->n >= dlist->alloc) {
+        UINT alloc = (dlist->alloc > 0 ? 2 * dlist->alloc : 64);
+        wd_dlrec_t** recs;
+
+        recs = (wd_dlrec_t**) realloc(dlist->recs, alloc * sizeof(wd_dlrec_t*));
+        if(recs == NULL) {
+            WD_TRACE("wd_dlist_append: realloc() failed.");
+            return FALSE;
+        }
+
+        dlist->recs = recs;
+        dlist->alloc = alloc;
+    }
+
+    for(n_args = WD_SIZEOF_ARRAY(cmd->a); n_args > 0; n_args--) {
+        if(cmd->a[n_args-1] != 0.0f)
+            break;
+    }
+
+    rec.kind = cmd->kind;
+    rec.flags = cmd->flags;
+    rec.fields = 0;
+    rec.n_args = (BYTE) n_args;
+    rec.reserved = 0;
+    size = sizeof(wd_dlrec_t);
+
+    if(cmd->brush != NULL)  { rec.fields |= WD_DLREC_BRUSH; size += sizeof(void*); }
+    if(cmd->style != NULL)  { rec.fields |= WD_DLREC_STYLE; size += sizeof(void*); }
+    if(cmd->obj != NULL)    { rec.fields |= WD_DLREC_OBJ;   size += sizeof(void*); }
+    if(cmd->dw != 0)        { rec.fields |= WD_DLREC_DW;    size += sizeof(DWORD); }
+    if(cmd->len != 0)       { rec.fields |= WD_DLREC_LEN;   size += sizeof(int); }
+    if(cmd->flags & WD_CMDFLAG_SOLIDCOLOR)  size += sizeof(WD_COLOR);
+    size += n_args * sizeof(float);
+    /* The data (text or instances) is owned by the caller, so we need our
+     * own copy of it. */
+    if(data_size > 0)       { rec.fields |= WD_DLREC_DATA;  size += data_size; }
+
+    ptr = (BYTE*) wd_arena_alloc(&dlist->arena, size);
+    if(ptr == NULL) {
+        WD_TRACE("wd_dlist_append: wd_arena_alloc() failed.");
+        return FALSE;
+    }
+    dlist->recs[dlist->n] = (wd_dlrec_t*) ptr;
+
+#define PUT(src, sz)    do { memcpy(ptr, (src), (sz)); ptr += (sz); } while(0)
+    PUT(&rec, sizeof(wd_dlrec_t));
+    if(rec.fields & WD_DLREC_BRUSH)  PUT(&cmd->brush, sizeof(void*));
+    if(rec.fields & WD_DLREC_STYLE)  PUT(&cmd->style, sizeof(void*));
+    if(rec.fields & WD_DLREC_OBJ)    PUT(&cmd->obj, sizeof(void*));
+    if(rec.fields & WD_DLREC_DW)     PUT(&cmd->dw, sizeof(DWORD));
+    if(rec.fields & WD_DLREC_LEN)    PUT(&cmd->len, sizeof(int));
+    if(rec.flags & WD_CMDFLAG_SOLIDCOLOR)  PUT(&cmd->color, sizeof(WD_COLOR));
+    PUT(cmd->a, n_args * sizeof(float));
+    if(rec.fields & WD_DLREC_DATA)   PUT(cmd->data, data_size);
+#undef PUT
+
+    if(cmd->kind == WD_CMD_SETCLIP)
+        dlist->has_clip = TRUE;
+
+    dlist->n++;
+    return TRUE;
+}
+
+void
+wd_dlist_get(const wd_dlist_t* dlist, UINT i, wd_cmd_t* cmd)
+{
+    const wd_dlrec_t* rec = dlist->recs[i];
+    const BYTE* ptr = (const BYTE*) (rec + 1);
+
+    wd_cmd_init(cmd, rec->kind);
+    cmd->flags = rec->flags;
+
+#define GET(dst, sz)    do { memcpy((dst), ptr, (sz)); ptr += (sz); } while(0)
+    if(rec->fields & WD_DLREC_BRUSH)  GET(&cmd->brush, sizeof(void*));
+    if(rec->fields & WD_DLREC_STYLE)  GET(&cmd->style, sizeof(void*));
+    if(rec->fields & WD_DLREC_OBJ)    GET(&cmd->obj, sizeof(void*));
+    if(rec->fields & WD_DLREC_DW)     GET(&cmd->dw, sizeof(DWORD));
+    if(rec->fields & WD_DLREC_LEN)    GET(&cmd->len, sizeof(int));
+    if(rec->flags & WD_CMDFLAG_SOLIDCOLOR)  GET(&cmd->color, sizeof(WD_COLOR));
+    GET(cmd->a, rec->n_args * sizeof(float));
+#undef GET
+
+    if(rec->fields & WD_DLREC_DATA)
+        cmd->data = ptr;
+}
+
+void
+wd_dlist_replay(WD_HCANVAS hCanvas, wd_dlist_t* dlist, const WD_MATRIX* pMatrix)
+{
+    WD_MATRIX saved_matrix;
+    WD_MATRIX base_matrix;
+    UINT i;
+
+    /* Commands of the mapped list refer to the resources by indexes. Make
+     * sure they exist for this canvas. */
+    if(dlist->mapped != NULL  &&  !wd_dlmap_prepare(dlist->mapped, hCanvas)) {
+        WD_TRACE("wd_dlist_replay: wd_dlmap_prepare() failed.");
+        return;
+    }
+
+    /* Make the commands paint directly, even if the canvas is hooked. */
+    wd_hook_enter(hCanvas);
+
+    wd_canvas_get_transform(hCanvas, &saved_matrix);
+    if(pMatrix != NULL) {
+        wdTransformWorld(hCanvas, pMatrix);
+        wd_canvas_get_transform(hCanvas, &base_matrix);
+    } else {
+        memcpy(&base_matrix, &saved_matrix, sizeof(WD_MATRIX));
+    }
+
+    for(i = 0; i < dlist->n; i++) {
+        wd_cmd_t cmd;
+
+        if(dlist->mapped != NULL) {
+            /* Read the command in place from the mapped file. */
+            if(!wd_dlmap_get_cmd(dlist->mapped, i, &cmd))
+                break;
+        } else {
+            wd_dlist_get(dlist, i, &cmd);
+        }
+
+        /* wdResetWorld() in the list resets to what the world has been when
+         * the replay started. */
+        if(cmd.kind == WD_CMD_RESETWORLD)
+            wd_canvas_set_transform(hCanvas, &base_matrix);
+        else
+            wd_cmd_execute(hCanvas, &cmd);
+    }
+
+    if(dlist->has_clip)
+        wdSetClip(hCanvas, NULL, NULL);
+    wd_canvas_set_transform(hCanvas, &saved_matrix);
+
+    wd_hook_leave(hCanvas);
+}
+
+BOOL
+wdBeginRecording(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook;
+
+    hook = wd_hook_acquire(hCanvas);
+    if(hook == NULL) {
+        WD_TRACE("wdBeginRecording: wd_hook_acquire() failed.");
+        return FALSE;
+    }
+
+    if(hook->recording != NULL) {
+        WD_TRACE("wdBeginRecording: Logical error: Already recording.");
+        return FALSE;
+    }
+
+    hook->recording = wd_dlist_alloc();
+    if(hook->recording == NULL) {
+        WD_TRACE("wdBeginRecording: wd_dlist_alloc() failed.");
+        wd_hook_release(hCanvas);
+        return FALSE;
+    }
+
+    wd_apitrace_handle(WD_APITRACE_OP_BEGINRECORDING, hCanvas);
+    return TRUE;
+}
+
+WD_HDISPLAYLIST
+wdEndRecording(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+    wd_dlist_t* dlist;
+
+    if(hook == NULL  ||  hook->recording == NULL) {
+        WD_TRACE("wdEndRecording: Logical error: Not recording.");
+        return NULL;
+    }
+
+    dlist = hook->recording;
+    hook->recording = NULL;
+    wd_hook_release(hCanvas);
+
+    wd_apitrace_create(WD_APITRACE_OP_ENDRECORDING, dlist, hCanvas, NULL, 0, NULL, 0, NULL, 0);
+    return (WD_HDISPLAYLIST) dlist;
+}
+
+void
+wdReplayDisplayList(WD_HCANVAS hCanvas, WD_HDISPLAYLIST hList, const WD_MATRIX* pMatrix)
+{
+    if(wd_hooked(hCanvas)) {
+        wd_cmd_t cmd;
+
+        wd_cmd_init(&cmd, WD_CMD_REPLAY);
+        cmd.obj = hList;
+        if(pMatrix != NULL) {
+            memcpy(cmd.a, pMatrix, sizeof(WD_MATRIX));
+            cmd.flags |= WD_CMDFLAG_HASMATRIX;
+        }
+        if(wd_hook_cmd(hCanvas, &cmd))
+            return;
+    }
+
+    wd_dlist_replay(hCanvas, (wd_dlist_t*) hList, pMatrix);
+}
+
+void
+wdDestroyDisplayList(WD_HDISPLAYLIST hList)
+{
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYDISPLAYLIST, hList);
+    wd_hook_object_changing(hList);
+    wd_dlist_free((wd_dlist_t*) hList);
+}
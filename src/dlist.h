@@ -0,0 +1,80 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_DLIST_H
+#define WD_DLIST_H
+
+#include "misc.h"
+#include "arena.h"
+#include "hook.h"
+#include "dlfile.h"
+
+
+/* The commands are stored in the arena as variable-sized records. The header
+ * is followed only by the members the command really uses, in this order:
+ *  - brush, style, obj (pointers; each only if non-NULL);
+ *  - dw, len (each only if non-zero);
+ *  - color (only with WD_CMDFLAG_SOLIDCOLOR);
+ *  - n_args floats (the trailing zeros of wd_cmd_t::a[] are dropped);
+ *  - the data (see wd_cmd_data_size()), inline.
+ */
+#define WD_DLREC_BRUSH      0x01
+#define WD_DLREC_STYLE      0x02
+#define WD_DLREC_OBJ        0x04
+#define WD_DLREC_DW         0x08
+#define WD_DLREC_LEN        0x10
+#define WD_DLREC_DATA       0x20
+
+typedef struct wd_dlrec_tag wd_dlrec_t;
+struct wd_dlrec_tag {
+    WORD kind;
+    WORD flags;         /* wd_cmd_t::flags */
+    BYTE fields;        /* WD_DLREC_xxx */
+    BYTE n_args;
+    WORD reserved;      /* Keeps the pointers which follow aligned. */
+};
+
+struct wd_dlist_tag {
+    wd_dlrec_t** recs;  /* Index of the records (for the random access). */
+    UINT n;
+    UINT alloc;
+    BOOL has_clip;      /* Some command sets a clip. */
+    wd_arena_t arena;   /* Holds the records. */
+    wd_dlmap_t* mapped; /* Non-NULL if loaded by wdLoadDisplayListMapped(). */
+};
+
+
+wd_dlist_t* wd_dlist_alloc(void);
+void wd_dlist_free(wd_dlist_t* dlist);
+void wd_dlist_reset(wd_dlist_t* dlist);
+
+BOOL wd_dlist_append(wd_dlist_t* dlist, const wd_cmd_t* cmd);
+
+/* Decode i-th command. Its data (if any) point into the list. Not usable for
+ * the lists loaded by wdLoadDisplayListMapped(). */
+void wd_dlist_get(const wd_dlist_t* dlist, UINT i, wd_cmd_t* cmd);
+
+void wd_dlist_replay(WD_HCANVAS hCanvas, wd_dlist_t* dlist, const WD_MATRIX* pMatrix);
+
+
+#endif  /* WD_DLIST_H */
@@ -31,6 +31,15 @@ void
 wdDrawEllipseArcStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy, float rx, float ry,
           float fBaseAngle, float fSweepAngle, float fStrokeWidth, WD_HSTROKESTYLE hStrokeStyle)
 {
+    float a[7] = { cx, cy, rx, ry, fBaseAngle, fSweepAngle, fStrokeWidth };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_DRAWARC, (void*) hBrush, (void*) hStrokeStyle, NULL, a, 7))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWARC, NULL, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
@@ -52,7 +61,7 @@ wdDrawEllipseArcStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy,
         float dx = 2.0f * rx;
         float dy = 2.0f * ry;
 
-        gdix_setpen(c->pen, b, fStrokeWidth, s);
+        gdix_setpen(c, b, fStrokeWidth, s);
 
         gdix_vtable->fn_DrawArc(c->graphics, c->pen, cx - rx, cy - ry, dx, dy,
                      fBaseAngle, fSweepAngle);
@@ -63,6 +72,15 @@ void
 wdDrawEllipseStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy, float rx, float ry,
              float fStrokeWidth, WD_HSTROKESTYLE hStrokeStyle)
 {
+    float a[5] = { cx, cy, rx, ry, fStrokeWidth };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_DRAWELLIPSE, (void*) hBrush, (void*) hStrokeStyle, NULL, a, 5))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWELLIPSE, NULL, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
@@ -77,7 +95,7 @@ wdDrawEllipseStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy, fl
         float dx = 2.0f * rx;
         float dy = 2.0f * ry;
 
-        gdix_setpen(c->pen, b, fStrokeWidth, s);
+        gdix_setpen(c, b, fStrokeWidth, s);
 
         gdix_vtable->fn_DrawEllipse(c->graphics, (void*)c->pen,
                 cx - rx, cy - ry, dx, dy);
@@ -88,6 +106,15 @@ void
 wdDrawLineStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
            float x0, float y0, float x1, float y1, float fStrokeWidth, WD_HSTROKESTYLE hStrokeStyle)
 {
+    float a[5] = { x0, y0, x1, y1, fStrokeWidth };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_DRAWLINE, (void*) hBrush, (void*) hStrokeStyle, NULL, a, 5))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWLINE, NULL, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
@@ -101,7 +128,7 @@ wdDrawLineStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
         gdix_strokestyle_t* s = (gdix_strokestyle_t*)hStrokeStyle;
         c_GpBrush* b = (c_GpBrush*)hBrush;
 
-        gdix_setpen(c->pen, b, fStrokeWidth, s);
+        gdix_setpen(c, b, fStrokeWidth, s);
 
         gdix_vtable->fn_DrawLine(c->graphics, c->pen, x0, y0, x1, y1);
     }
@@ -111,9 +138,25 @@ void
 wdDrawPathStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, const WD_HPATH hPath,
             float fStrokeWidth, WD_HSTROKESTYLE hStrokeStyle)
 {
+    float a[1] = { fStrokeWidth };
+    void* geometry;
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_DRAWPATH, (void*) hBrush, (void*) hStrokeStyle, (void*) hPath, a, 1))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWPATH, (void*) hPath, 0, a))
+        return;
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wdDrawPathStyled: wd_path_geometry() failed.");
+        return;
+    }
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
-        c_ID2D1Geometry* g = (c_ID2D1Geometry*) hPath;
+        c_ID2D1Geometry* g = (c_ID2D1Geometry*) geometry;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
         c_ID2D1StrokeStyle* s = (c_ID2D1StrokeStyle*)hStrokeStyle;
 
@@ -123,9 +166,9 @@ wdDrawPathStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, const WD_HPATH hPath,
         gdix_strokestyle_t* s = (gdix_strokestyle_t*)hStrokeStyle;
         c_GpBrush* b = (c_GpBrush*)hBrush;
 
-        gdix_setpen(c->pen, b, fStrokeWidth, s);
+        gdix_setpen(c, b, fStrokeWidth, s);
 
-        gdix_vtable->fn_DrawPath(c->graphics, (void*)c->pen, (void*)hPath);
+        gdix_vtable->fn_DrawPath(c->graphics, (void*)c->pen, geometry);
     }
 }
 
@@ -133,6 +176,15 @@ void
 wdDrawEllipsePieStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy, float rx, float ry,
                 float fBaseAngle, float fSweepAngle, float fStrokeWidth, WD_HSTROKESTYLE hStrokeStyle)
 {
+    float a[7] = { cx, cy, rx, ry, fBaseAngle, fSweepAngle, fStrokeWidth };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_DRAWPIE, (void*) hBrush, (void*) hStrokeStyle, NULL, a, 7))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWPIE, NULL, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
@@ -154,7 +206,7 @@ wdDrawEllipsePieStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy,
         float dx = 2.0f * rx;
         float dy = 2.0f * ry;
 
-        gdix_setpen(c->pen, b, fStrokeWidth, s);
+        gdix_setpen(c, b, fStrokeWidth, s);
 
         gdix_vtable->fn_DrawPie(c->graphics, c->pen, cx - rx, cy - ry, dx, dy,
                                 fBaseAngle, fSweepAngle);
@@ -165,6 +217,15 @@ void
 wdDrawRectStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
            float x0, float y0, float x1, float y1, float fStrokeWidth, WD_HSTROKESTYLE hStrokeStyle)
 {
+    float a[5] = { x0, y0, x1, y1, fStrokeWidth };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_DRAWRECT, (void*) hBrush, (void*) hStrokeStyle, NULL, a, 5))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWRECT, NULL, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
@@ -182,7 +243,7 @@ wdDrawRectStyled(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
         if(x0 > x1) { tmp = x0; x0 = x1; x1 = tmp; }
         if(y0 > y1) { tmp = y0; y0 = y1; y1 = tmp; }
 
-        gdix_setpen(c->pen, b, fStrokeWidth, s);
+        gdix_setpen(c, b, fStrokeWidth, s);
 
         gdix_vtable->fn_DrawRectangle(c->graphics, c->pen, x0, y0, x1 - x0, y1 - y0);
     }
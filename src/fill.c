@@ -27,9 +27,23 @@
 #include "lock.h"
 
 
+/* Minimal count of instances for which wdFillPathInstances() considers
+ * rasterizing the path into a mask. */
+#define FILL_INSTANCES_MASK_MIN     32
+
+
 void
 wdFillEllipse(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy, float rx, float ry)
 {
+    float a[4] = { cx, cy, rx, ry };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_FILLELLIPSE, (void*) hBrush, NULL, NULL, a, 4))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_FILLELLIPSE, NULL, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
@@ -48,16 +62,316 @@ wdFillEllipse(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy, float rx
 void
 wdFillPath(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, const WD_HPATH hPath)
 {
+    void* geometry;
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_FILLPATH, (void*) hBrush, NULL, (void*) hPath, NULL, 0))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_FILLPATH, (void*) hPath, 0, NULL))
+        return;
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wdFillPath: wd_path_geometry() failed.");
+        return;
+    }
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
-        c_ID2D1Geometry* g = (c_ID2D1Geometry*) hPath;
+        c_ID2D1Geometry* g = (c_ID2D1Geometry*) geometry;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
 
         c_ID2D1RenderTarget_FillGeometry(c->target, g, b, NULL);
     } else {
         gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
 
-        gdix_vtable->fn_FillPath(c->graphics, (void*) hBrush, (void*) hPath);
+        gdix_vtable->fn_FillPath(c->graphics, (void*) hBrush, geometry);
+    }
+}
+
+/* Is the path (with the given bounds) transformed by the matrix outside of
+ * the visible area? */
+static BOOL
+wd_instance_culled(const WD_MATRIX* m, const WD_RECT* path_rect, const WD_RECT* visible)
+{
+    WD_RECT r;
+
+    wd_cull_transform_rect(m, path_rect, &r);
+
+    /* The visible area already includes the anti-aliasing margin. */
+    return (r.x1 < visible->x0  ||  r.x0 > visible->x1  ||
+            r.y1 < visible->y0  ||  r.y0 > visible->y1);
+}
+
+/* res = inst * base, i.e. the instance transformation applied first. */
+static void
+wd_instance_matrix(const WD_MATRIX* inst, const WD_MATRIX* base, WD_MATRIX* res)
+{
+    res->m11 = inst->m11 * base->m11 + inst->m12 * base->m21;
+    res->m12 = inst->m11 * base->m12 + inst->m12 * base->m22;
+    res->m21 = inst->m21 * base->m11 + inst->m22 * base->m21;
+    res->m22 = inst->m21 * base->m12 + inst->m22 * base->m22;
+    res->dx = inst->dx * base->m11 + inst->dy * base->m21 + base->dx;
+    res->dy = inst->dx * base->m12 + inst->dy * base->m22 + base->dy;
+}
+
+/* Does the matrix only move by whole pixels? */
+static inline BOOL
+wd_is_pixel_shift(const WD_MATRIX* m)
+{
+    return (m->m11 == 1.0f  &&  m->m12 == 0.0f  &&  m->m21 == 0.0f  &&
+            m->m22 == 1.0f  &&  m->dx == floorf(m->dx)  &&  m->dy == floorf(m->dy));
+}
+
+void
+wdFillPathInstances(WD_HCANVAS hCanvas, const WD_HPATH hPath,
+                    const WD_INSTANCE* pInstances, UINT uCount)
+{
+    void* geometry;
+    WD_RECT path_rect;
+    WD_RECT visible;
+    BOOL can_cull;
+    BOOL pixel_shifts_only = TRUE;
+    UINT n_culled = 0;
+    UINT i;
+
+    if(uCount == 0)
+        return;
+
+    if(wd_hooked(hCanvas)) {
+        wd_cmd_t cmd;
+
+        wd_cmd_init(&cmd, WD_CMD_FILLINSTANCES);
+        cmd.obj = (void*) hPath;
+        cmd.data = pInstances;
+        cmd.len = (int) uCount;
+        if(wd_hook_cmd(hCanvas, &cmd))
+            return;
+    }
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wdFillPathInstances: wd_path_geometry() failed.");
+        return;
+    }
+
+    /* Instances are culled one by one, against the visible area as it is
+     * before we start to play with the transformation. */
+    can_cull = (wd_cull_visible(hCanvas, &visible)  &&  wdGetPathBounds(hPath, &path_rect));
+
+    for(i = 0; i < uCount; i++) {
+        if(!wd_is_pixel_shift(&pInstances[i].matrix)) {
+            pixel_shifts_only = FALSE;
+            break;
+        }
+    }
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        c_ID2D1Geometry* g = (c_ID2D1Geometry*) geometry;
+        c_D2D1_COLOR_F color = { 0.0f, 0.0f, 0.0f, 0.0f };
+        c_D2D1_MATRIX_3X2_F saved;
+        c_ID2D1SolidColorBrush* b;
+        d2d_pathmask_t* mask = NULL;
+        HRESULT hr;
+
+        hr = c_ID2D1RenderTarget_CreateSolidColorBrush(c->target, &color, NULL, &b);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdFillPathInstances: "
+                        "ID2D1RenderTarget::CreateSolidColorBrush() failed.");
+            return;
+        }
+
+        c_ID2D1RenderTarget_GetTransform(c->target, &saved);
+
+        /* If the marker is only moved around by whole pixels (and the canvas
+         * does not scale, rotate or shift it by a fraction of pixel either),
+         * each instance covers exactly the same pixels as the mask of the
+         * path. So we stamp the mask (cached on the path). Otherwise fall
+         * back to filling the geometry for each instance. */
+        if(pixel_shifts_only  &&  uCount >= FILL_INSTANCES_MASK_MIN  &&
+           saved._11 == 1.0f  &&  saved._12 == 0.0f  &&
+           saved._21 == 0.0f  &&  saved._22 == 1.0f  &&
+           saved._31 - D2D_BASEDELTA_X == floorf(saved._31 - D2D_BASEDELTA_X)  &&
+           saved._32 - D2D_BASEDELTA_Y == floorf(saved._32 - D2D_BASEDELTA_Y))
+        {
+            mask = (d2d_pathmask_t*) wd_path_mask(hPath, hCanvas);
+        }
+
+        if(mask != NULL) {
+            c_ID2D1Brush* brush = (c_ID2D1Brush*) b;
+            c_D2D1_ANTIALIAS_MODE old_mode;
+            c_D2D1_RECT_F dest;
+
+            /* ID2D1RenderTarget::FillOpacityMask() requires aliased mode. */
+            old_mode = c_ID2D1RenderTarget_GetAntialiasMode(c->target);
+            c_ID2D1RenderTarget_SetAntialiasMode(c->target, c_D2D1_ANTIALIAS_MODE_ALIASED);
+            for(i = 0; i < uCount; i++) {
+                const WD_INSTANCE* inst = &pInstances[i];
+
+                if(can_cull  &&  wd_instance_culled(&inst->matrix, &path_rect, &visible)) {
+                    n_culled++;
+                    continue;
+                }
+
+                d2d_init_color(&color, inst->color);
+                c_ID2D1SolidColorBrush_SetColor(b, &color);
+                dest.left = inst->matrix.dx + mask->rect.left;
+                dest.top = inst->matrix.dy + mask->rect.top;
+                dest.right = inst->matrix.dx + mask->rect.right;
+                dest.bottom = inst->matrix.dy + mask->rect.bottom;
+                c_ID2D1RenderTarget_FillOpacityMask(c->target, mask->bitmap, brush,
+                        c_D2D1_OPACITY_MASK_CONTENT_GRAPHICS, &dest, NULL);
+            }
+            c_ID2D1RenderTarget_SetAntialiasMode(c->target, old_mode);
+        } else {
+            const WD_MATRIX* base = (const WD_MATRIX*) &saved;
+            c_D2D1_MATRIX_3X2_F m;
+
+            for(i = 0; i < uCount; i++) {
+                const WD_INSTANCE* inst = &pInstances[i];
+
+                if(can_cull  &&  wd_instance_culled(&inst->matrix, &path_rect, &visible)) {
+                    n_culled++;
+                    continue;
+                }
+
+                /* (c_D2D1_MATRIX_3X2_F has the same layout as WD_MATRIX.) */
+                wd_instance_matrix(&inst->matrix, base, (WD_MATRIX*) &m);
+                c_ID2D1RenderTarget_SetTransform(c->target, &m);
+                d2d_init_color(&color, inst->color);
+                c_ID2D1SolidColorBrush_SetColor(b, &color);
+                c_ID2D1RenderTarget_FillGeometry(c->target, g, (c_ID2D1Brush*) b, NULL);
+            }
+            c_ID2D1RenderTarget_SetTransform(c->target, &saved);
+        }
+
+        c_ID2D1SolidColorBrush_Release(b);
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        c_GpSolidFill* b;
+        c_GpMatrix* saved;
+        c_GpMatrix* matrix;
+        WD_MATRIX base;
+        WD_MATRIX m;
+        int status;
+
+        status = gdix_vtable->fn_CreateSolidFill(0, &b);
+        if(status != 0) {
+            WD_TRACE("wdFillPathInstances: GdipCreateSolidFill() failed. [%d]", status);
+            goto err_CreateSolidFill;
+        }
+        status = gdix_vtable->fn_CreateMatrix(&saved);
+        if(status != 0) {
+            WD_TRACE("wdFillPathInstances: GdipCreateMatrix() failed. [%d]", status);
+            goto err_CreateMatrix_saved;
+        }
+        status = gdix_vtable->fn_CreateMatrix(&matrix);
+        if(status != 0) {
+            WD_TRACE("wdFillPathInstances: GdipCreateMatrix() failed. [%d]", status);
+            goto err_CreateMatrix;
+        }
+
+        gdix_vtable->fn_GetWorldTransform(c->graphics, saved);
+        gdix_vtable->fn_GetMatrixElements(saved, (float*) &base);
+
+        /* Compose the matrices ourselves, so each instance costs just one
+         * GdipSetWorldTransform(). */
+        for(i = 0; i < uCount; i++) {
+            const WD_INSTANCE* inst = &pInstances[i];
+
+            if(can_cull  &&  wd_instance_culled(&inst->matrix, &path_rect, &visible)) {
+                n_culled++;
+                continue;
+            }
+
+            wd_instance_matrix(&inst->matrix, &base, &m);
+            gdix_vtable->fn_SetMatrixElements(matrix, m.m11, m.m12, m.m21, m.m22, m.dx, m.dy);
+            gdix_vtable->fn_SetWorldTransform(c->graphics, matrix);
+            gdix_vtable->fn_SetSolidFillColor(b, (c_ARGB) inst->color);
+            gdix_vtable->fn_FillPath(c->graphics, (void*) b, geometry);
+        }
+        gdix_vtable->fn_SetWorldTransform(c->graphics, saved);
+
+        gdix_delete_matrix(matrix);
+err_CreateMatrix:
+        gdix_delete_matrix(saved);
+err_CreateMatrix_saved:
+        gdix_vtable->fn_DeleteBrush((void*) b);
+        /* The pen of the canvas remembers the brush by its address, which
+         * may be reused by a brush created later. */
+        gdix_brush_changed();
+err_CreateSolidFill:
+        ;
+    }
+
+    wd_canvas_cull(hCanvas)->culled += n_culled;
+}
+
+void
+wdFillMesh(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, const WD_HMESH hMesh)
+{
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_FILLMESH, (void*) hBrush, NULL, (void*) hMesh, NULL, 0))
+            return;
+    }
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        c_ID2D1Mesh* m = (c_ID2D1Mesh*) hMesh;
+        c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
+        c_D2D1_ANTIALIAS_MODE old_mode;
+
+        /* ID2D1RenderTarget::FillMesh() requires aliased mode. */
+        old_mode = c_ID2D1RenderTarget_GetAntialiasMode(c->target);
+        c_ID2D1RenderTarget_SetAntialiasMode(c->target, c_D2D1_ANTIALIAS_MODE_ALIASED);
+        c_ID2D1RenderTarget_FillMesh(c->target, m, b);
+        c_ID2D1RenderTarget_SetAntialiasMode(c->target, old_mode);
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+
+        gdix_vtable->fn_FillPath(c->graphics, (void*) hBrush, (void*) hMesh);
+    }
+}
+
+void
+wdFillCachedPathMask(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
+                     const WD_HCACHEDPATHMASK hMask, float x, float y)
+{
+    float a[2] = { x, y };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_FILLPATHMASK, (void*) hBrush, NULL, (void*) hMask, a, 2))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_FILLPATHMASK, (void*) hMask, 0, a))
+        return;
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        d2d_pathmask_t* mask = (d2d_pathmask_t*) hMask;
+        c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
+        c_D2D1_ANTIALIAS_MODE old_mode;
+        c_D2D1_RECT_F dest;
+
+        dest.left = x + mask->rect.left;
+        dest.top = y + mask->rect.top;
+        dest.right = x + mask->rect.right;
+        dest.bottom = y + mask->rect.bottom;
+
+        /* ID2D1RenderTarget::FillOpacityMask() requires aliased mode. */
+        old_mode = c_ID2D1RenderTarget_GetAntialiasMode(c->target);
+        c_ID2D1RenderTarget_SetAntialiasMode(c->target, c_D2D1_ANTIALIAS_MODE_ALIASED);
+        c_ID2D1RenderTarget_FillOpacityMask(c->target, mask->bitmap, b,
+                c_D2D1_OPACITY_MASK_CONTENT_GRAPHICS, &dest, NULL);
+        c_ID2D1RenderTarget_SetAntialiasMode(c->target, old_mode);
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+
+        gdix_vtable->fn_TranslateWorldTransform(c->graphics, x, y, c_MatrixOrderPrepend);
+        gdix_vtable->fn_FillPath(c->graphics, (void*) hBrush, (void*) hMask);
+        gdix_vtable->fn_TranslateWorldTransform(c->graphics, -x, -y, c_MatrixOrderPrepend);
     }
 }
 
@@ -65,6 +379,15 @@ void
 wdFillEllipsePie(WD_HCANVAS hCanvas, WD_HBRUSH hBrush, float cx, float cy, float rx, float ry,
           float fBaseAngle, float fSweepAngle)
 {
+    float a[6] = { cx, cy, rx, ry, fBaseAngle, fSweepAngle };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_FILLPIE, (void*) hBrush, NULL, NULL, a, 6))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_FILLPIE, NULL, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
@@ -92,6 +415,15 @@ void
 wdFillRect(WD_HCANVAS hCanvas, WD_HBRUSH hBrush,
            float x0, float y0, float x1, float y1)
 {
+    float a[4] = { x0, y0, x1, y1 };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_FILLRECT, (void*) hBrush, NULL, NULL, a, 4))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_FILLRECT, NULL, 0, a))
+        return;
+
     if(d2d_enabled()) {
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
@@ -26,6 +26,8 @@
 #include "backend-dwrite.h"
 #include "backend-gdix.h"
 #include "lock.h"
+#include "apitrace.h"
+#include "hook.h"
 
 static void
 wd_get_default_gui_fontface(WCHAR buffer[LF_FACESIZE])
@@ -42,8 +44,8 @@ wd_get_default_gui_fontface(WCHAR buffer[LF_FACESIZE])
 }
 
 
-WD_HFONT
-wdCreateFont(const LOGFONTW* pLogFont)
+static WD_HFONT
+font_create(const LOGFONTW* pLogFont)
 {
     if(d2d_enabled()) {
         static WCHAR no_locale[] = L"";
@@ -57,9 +59,11 @@ wdCreateFont(const LOGFONTW* pLogFont)
 
         font = (dwrite_font_t*) malloc(sizeof(dwrite_font_t));
         if(font == NULL) {
-            WD_TRACE("wdCreateFont: malloc() failed.");
+            WD_TRACE("font_create: malloc() failed.");
             return NULL;
         }
+        memset(font, 0, sizeof(dwrite_font_t));
+        dwrite_font_init(font);
 
         dwrite_default_user_locale(user_locale);
         locales[0] = user_locale;
@@ -71,7 +75,8 @@ wdCreateFont(const LOGFONTW* pLogFont)
         if(wcscmp(pLogFont->lfFaceName, L"MS Shell Dlg") != 0  &&
            wcscmp(pLogFont->lfFaceName, L"MS Shell Dlg 2") != 0) {
             for(i = 0; i < WD_SIZEOF_ARRAY(locales); i++) {
-                font->tf = dwrite_create_text_format(locales[i], pLogFont, &font->metrics);
+                font->tf = dwrite_create_text_format(locales[i], pLogFont,
+                                            &font->metrics, &font->face);
                 if(font->tf != NULL)
                     return (WD_HFONT) font;
             }
@@ -88,14 +93,16 @@ wdCreateFont(const LOGFONTW* pLogFont)
             wcsncpy(tmp.lfFaceName, default_fontface, LF_FACESIZE);
 
             for(i = 0; i < WD_SIZEOF_ARRAY(locales); i++) {
-                font->tf = dwrite_create_text_format(locales[i], &tmp, &font->metrics);
+                font->tf = dwrite_create_text_format(locales[i], &tmp,
+                                            &font->metrics, &font->face);
                 if(font->tf != NULL)
                     return (WD_HFONT) font;
             }
         }
 
-        WD_TRACE("wdCreateFont: dwrite_create_text_format(%S, %S) failed.",
+        WD_TRACE("font_create: dwrite_create_text_format(%S, %S) failed.",
                  pLogFont->lfFaceName, user_locale);
+        dwrite_font_cleanup(font);
         free(font);
         return NULL;
     } else {
@@ -118,7 +125,7 @@ wdCreateFont(const LOGFONTW* pLogFont)
         ReleaseDC(NULL, dc);
 
         if(status != 0) {
-            WD_TRACE("wdCreateFont: GdipCreateFontFromLogfontW(%S) failed. [%d]",
+            WD_TRACE("font_create: GdipCreateFontFromLogfontW(%S) failed. [%d]",
                      pLogFont->lfFaceName, status);
             return NULL;
         }
@@ -127,24 +134,13 @@ wdCreateFont(const LOGFONTW* pLogFont)
     }
 }
 
-WD_HFONT
-wdCreateFontWithGdiHandle(HFONT hGdiFont)
-{
-    LOGFONTW lf;
-
-    if(hGdiFont == NULL)
-        hGdiFont = GetStockObject(SYSTEM_FONT);
-
-    GetObjectW(hGdiFont, sizeof(LOGFONTW), &lf);
-    return wdCreateFont(&lf);
-}
-
-void
-wdDestroyFont(WD_HFONT hFont)
+static void
+font_destroy(WD_HFONT hFont)
 {
     if(d2d_enabled()) {
         dwrite_font_t* font = (dwrite_font_t*) hFont;
 
+        dwrite_font_cleanup(font);
         c_IDWriteTextFormat_Release(font->tf);
         free(font);
     } else {
@@ -152,16 +148,9 @@ wdDestroyFont(WD_HFONT hFont)
     }
 }
 
-void
-wdFontMetrics(WD_HFONT hFont, WD_FONTMETRICS* pMetrics)
+static void
+font_compute_metrics(WD_HFONT hFont, WD_FONTMETRICS* pMetrics)
 {
-    if(hFont == NULL) {
-        /* Treat NULL as "no font". This simplifies paint code when font
-         * creation fails. */
-        WD_TRACE("wdFontMetrics: font == NULL");
-        goto err;
-    }
-
     if(d2d_enabled()) {
         dwrite_font_t* font = (dwrite_font_t*) hFont;
         float factor;
@@ -189,7 +178,7 @@ wdFontMetrics(WD_HFONT hFont, WD_FONTMETRICS* pMetrics)
 
         status = gdix_vtable->fn_GetFamily((void*) hFont, &font_family);
         if(status != 0) {
-            WD_TRACE("wdFontMetrics: GdipGetFamily() failed. [%d]", status);
+            WD_TRACE("font_compute_metrics: GdipGetFamily() failed. [%d]", status);
             goto err;
         }
         gdix_vtable->fn_GetCellAscent(font_family, font_style, &cell_ascent);
@@ -212,3 +201,305 @@ err:
     pMetrics->fDescent = 0.0f;
     pMetrics->fLeading = 0.0f;
 }
+
+
+/* Fonts are cached process-wide, keyed by the complete LOGFONTW. Creating a
+ * font (especially with DirectWrite, where it involves a font collection
+ * lookup) is expensive and applications tend to create the same fonts again
+ * and again, e.g. on every zoom step or whenever a control is re-laid out.
+ *
+ * The handles are reference-counted: wdCreateFont() for an already cached
+ * font returns the very same handle, and the font is really released only
+ * after it has been unused for a while (see FONT_CACHE_MAX_IDLE).
+ *
+ * The metrics (which for GDI+ need a font family to be instantiated) are
+ * computed once when the font is created. */
+
+#define FONT_CACHE_BUCKETS      64
+#define FONT_CACHE_MAX_IDLE     32
+
+typedef struct font_entry_tag font_entry_t;
+struct font_entry_tag {
+    font_entry_t* next_by_key;
+    font_entry_t* next_by_font;
+    WD_HFONT font;
+    LOGFONTW key;
+    UINT32 hash;
+    WD_FONTMETRICS metrics;
+    UINT refs;
+    UINT stamp;     /* For LRU eviction of idle entries. */
+};
+
+static font_entry_t* font_cache_by_key[FONT_CACHE_BUCKETS];
+static font_entry_t* font_cache_by_font[FONT_CACHE_BUCKETS];
+static UINT font_cache_n_idle = 0;
+static UINT font_cache_stamp = 0;
+
+UINT font_cache_hits = 0;
+UINT font_cache_misses = 0;
+
+
+static void
+font_cache_make_key(const LOGFONTW* lf, LOGFONTW* key)
+{
+    /* Normalize the key so that any garbage after the string terminator of
+     * the face name (or in the structure padding) does not matter. */
+    memset(key, 0, sizeof(LOGFONTW));
+    memcpy(key, lf, WD_OFFSETOF(LOGFONTW, lfFaceName));
+    wcsncpy(key->lfFaceName, lf->lfFaceName, LF_FACESIZE);
+    key->lfFaceName[LF_FACESIZE-1] = L'\0';
+}
+
+static UINT32
+font_cache_hash(const LOGFONTW* key)
+{
+    const BYTE* data = (const BYTE*) key;
+    UINT32 hash = 2166136261U;
+    size_t i;
+
+    /* FNV-1a */
+    for(i = 0; i < sizeof(LOGFONTW); i++) {
+        hash ^= data[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static UINT
+font_cache_font_bucket(WD_HFONT font)
+{
+    return (UINT) (((UINT_PTR) font >> 4) % FONT_CACHE_BUCKETS);
+}
+
+static font_entry_t*
+font_cache_find_by_key(const LOGFONTW* key, UINT32 hash)
+{
+    font_entry_t* e;
+
+    for(e = font_cache_by_key[hash % FONT_CACHE_BUCKETS]; e != NULL; e = e->next_by_key) {
+        if(e->hash == hash  &&  memcmp(&e->key, key, sizeof(LOGFONTW)) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static font_entry_t*
+font_cache_find_by_font(WD_HFONT font)
+{
+    font_entry_t* e;
+
+    for(e = font_cache_by_font[font_cache_font_bucket(font)]; e != NULL; e = e->next_by_font) {
+        if(e->font == font)
+            return e;
+    }
+    return NULL;
+}
+
+static void
+font_cache_unlink(font_entry_t* entry)
+{
+    font_entry_t** pp;
+
+    pp = &font_cache_by_key[entry->hash % FONT_CACHE_BUCKETS];
+    while(*pp != entry)
+        pp = &(*pp)->next_by_key;
+    *pp = entry->next_by_key;
+
+    pp = &font_cache_by_font[font_cache_font_bucket(entry->font)];
+    while(*pp != entry)
+        pp = &(*pp)->next_by_font;
+    *pp = entry->next_by_font;
+}
+
+/* Called with the lock held. Returns an idle entry which should be destroyed
+ * (after unlocking), if there are too many of them. */
+static font_entry_t*
+font_cache_evict(void)
+{
+    font_entry_t* victim = NULL;
+    font_entry_t* e;
+    UINT i;
+
+    if(font_cache_n_idle <= FONT_CACHE_MAX_IDLE)
+        return NULL;
+
+    for(i = 0; i < FONT_CACHE_BUCKETS; i++) {
+        for(e = font_cache_by_key[i]; e != NULL; e = e->next_by_key) {
+            if(e->refs == 0  &&  (victim == NULL  ||
+                    (int) (e->stamp - victim->stamp) < 0))
+                victim = e;
+        }
+    }
+
+    if(victim != NULL) {
+        font_cache_unlink(victim);
+        font_cache_n_idle--;
+    }
+    return victim;
+}
+
+void
+wd_font_cache_fini(void)
+{
+    font_entry_t* e;
+    UINT i;
+
+    /* Called from wdTerminate() which already holds the lock. Any fonts the
+     * application still holds are released as well, as they cannot outlive
+     * the back-end anyway. */
+    for(i = 0; i < FONT_CACHE_BUCKETS; i++) {
+        while(font_cache_by_key[i] != NULL) {
+            e = font_cache_by_key[i];
+            font_cache_by_key[i] = e->next_by_key;
+            font_destroy(e->font);
+            free(e);
+        }
+        font_cache_by_font[i] = NULL;
+    }
+    font_cache_n_idle = 0;
+}
+
+
+WD_HFONT
+wdCreateFont(const LOGFONTW* pLogFont)
+{
+    LOGFONTW key;
+    UINT32 hash;
+    font_entry_t* entry;
+    font_entry_t* racer;
+    WD_HFONT font;
+
+    font_cache_make_key(pLogFont, &key);
+    hash = font_cache_hash(&key);
+
+    wd_lock();
+    entry = font_cache_find_by_key(&key, hash);
+    if(entry != NULL) {
+        if(entry->refs == 0)
+            font_cache_n_idle--;
+        entry->refs++;
+        font_cache_hits++;
+        font = entry->font;
+    }
+    wd_unlock();
+
+    if(entry != NULL)
+        goto done;
+
+    font = font_create(pLogFont);
+    if(font == NULL)
+        return NULL;
+
+    entry = (font_entry_t*) malloc(sizeof(font_entry_t));
+    if(entry == NULL) {
+        /* Not fatal: Just return the font uncached. */
+        WD_TRACE("wdCreateFont: malloc() failed.");
+        goto done;
+    }
+
+    memcpy(&entry->key, &key, sizeof(LOGFONTW));
+    entry->hash = hash;
+    entry->font = font;
+    entry->refs = 1;
+    entry->stamp = 0;
+    font_compute_metrics(font, &entry->metrics);
+
+    wd_lock();
+    /* Another thread may have created the same font meanwhile. */
+    racer = font_cache_find_by_key(&key, hash);
+    if(racer != NULL) {
+        if(racer->refs == 0)
+            font_cache_n_idle--;
+        racer->refs++;
+        font_cache_hits++;
+    } else {
+        UINT b;
+
+        b = hash % FONT_CACHE_BUCKETS;
+        entry->next_by_key = font_cache_by_key[b];
+        font_cache_by_key[b] = entry;
+        b = font_cache_font_bucket(font);
+        entry->next_by_font = font_cache_by_font[b];
+        font_cache_by_font[b] = entry;
+        font_cache_misses++;
+    }
+    wd_unlock();
+
+    if(racer != NULL) {
+        font_destroy(font);
+        free(entry);
+        font = racer->font;
+    }
+
+done:
+    wd_apitrace_create(WD_APITRACE_OP_CREATEFONT, font, NULL,
+                       pLogFont, sizeof(LOGFONTW), NULL, 0, NULL, 0);
+    return font;
+}
+
+WD_HFONT
+wdCreateFontWithGdiHandle(HFONT hGdiFont)
+{
+    LOGFONTW lf;
+
+    if(hGdiFont == NULL)
+        hGdiFont = GetStockObject(SYSTEM_FONT);
+
+    GetObjectW(hGdiFont, sizeof(LOGFONTW), &lf);
+    return wdCreateFont(&lf);
+}
+
+void
+wdDestroyFont(WD_HFONT hFont)
+{
+    font_entry_t* entry;
+    font_entry_t* victim = NULL;
+
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYFONT, hFont);
+    wd_hook_object_changing(hFont);
+
+    wd_lock();
+    entry = font_cache_find_by_font(hFont);
+    if(entry != NULL) {
+        entry->refs--;
+        if(entry->refs == 0) {
+            entry->stamp = font_cache_stamp++;
+            font_cache_n_idle++;
+            victim = font_cache_evict();
+        }
+    }
+    wd_unlock();
+
+    if(entry == NULL) {
+        font_destroy(hFont);
+    } else if(victim != NULL) {
+        font_destroy(victim->font);
+        free(victim);
+    }
+}
+
+void
+wdFontMetrics(WD_HFONT hFont, WD_FONTMETRICS* pMetrics)
+{
+    font_entry_t* entry;
+
+    if(hFont == NULL) {
+        /* Treat NULL as "no font". This simplifies paint code when font
+         * creation fails. */
+        WD_TRACE("wdFontMetrics: font == NULL");
+        pMetrics->fEmHeight = 0.0f;
+        pMetrics->fAscent = 0.0f;
+        pMetrics->fDescent = 0.0f;
+        pMetrics->fLeading = 0.0f;
+        return;
+    }
+
+    wd_lock();
+    entry = font_cache_find_by_font(hFont);
+    if(entry != NULL)
+        memcpy(pMetrics, &entry->metrics, sizeof(WD_FONTMETRICS));
+    wd_unlock();
+
+    if(entry == NULL)
+        font_compute_metrics(hFont, pMetrics);
+}
@@ -0,0 +1,730 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "framediff.h"
+#include "backend-d2d.h"
+#include "dlist.h"
+
+
+/* Record types. */
+#define WD_FRAMEDIFF_STATE      0   /* Changes transformation or clip. Not diffed. */
+#define WD_FRAMEDIFF_PAINT      1
+
+#define WD_FRAMEDIFF_NONE       ((UINT) -1)
+
+/* FNV-1a */
+#define WD_FRAMEDIFF_HASHINIT   2166136261U
+#define WD_FRAMEDIFF_HASHPRIME  16777619U
+
+
+struct wd_framediff_rec_tag {
+    UINT type;
+    UINT32 hash;        /* Covers also the bounds. */
+    WD_RECT bounds;     /* In device space. */
+};
+
+
+static UINT32
+wd_framediff_hash(UINT32 hash, const void* data, size_t size)
+{
+    const BYTE* bytes = (const BYTE*) data;
+    size_t i;
+
+    for(i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= WD_FRAMEDIFF_HASHPRIME;
+    }
+    return hash;
+}
+
+/* Gradient brushes may be changed in place between the frames (e.g. by
+ * wdSetLinearGradientBrushPoints()), so hash their parameters. */
+static UINT32
+wd_framediff_hash_brush(UINT32 hash, c_ID2D1Brush* b)
+{
+    c_ID2D1LinearGradientBrush* linear;
+    c_ID2D1RadialGradientBrush* radial;
+    c_ID2D1GradientStopCollection* collection = NULL;
+    c_D2D1_MATRIX_3X2_F matrix;
+    c_D2D1_POINT_2F pt[2];
+    c_D2D1_GRADIENT_STOP stops[16];
+    UINT32 n;
+    HRESULT hr;
+
+    hash = wd_framediff_hash(hash, &b, sizeof(void*));
+    c_ID2D1Brush_GetTransform(b, &matrix);
+    hash = wd_framediff_hash(hash, &matrix, sizeof(c_D2D1_MATRIX_3X2_F));
+
+    hr = c_ID2D1Brush_QueryInterface(b, &c_IID_ID2D1LinearGradientBrush,
+                (void**) &linear);
+    if(SUCCEEDED(hr)) {
+        c_ID2D1LinearGradientBrush_GetStartPoint(linear, &pt[0]);
+        c_ID2D1LinearGradientBrush_GetEndPoint(linear, &pt[1]);
+        hash = wd_framediff_hash(hash, pt, sizeof(pt));
+        c_ID2D1LinearGradientBrush_GetGradientStopCollection(linear,
+                &collection);
+        c_ID2D1LinearGradientBrush_Release(linear);
+    }
+
+    hr = c_ID2D1Brush_QueryInterface(b, &c_IID_ID2D1RadialGradientBrush,
+                (void**) &radial);
+    if(SUCCEEDED(hr)) {
+        float r[2];
+
+        c_ID2D1RadialGradientBrush_GetCenter(radial, &pt[0]);
+        c_ID2D1RadialGradientBrush_GetGradientOriginOffset(radial, &pt[1]);
+        r[0] = c_ID2D1RadialGradientBrush_GetRadiusX(radial);
+        r[1] = c_ID2D1RadialGradientBrush_GetRadiusY(radial);
+        hash = wd_framediff_hash(hash, pt, sizeof(pt));
+        hash = wd_framediff_hash(hash, r, sizeof(r));
+        c_ID2D1RadialGradientBrush_GetGradientStopCollection(radial,
+                &collection);
+        c_ID2D1RadialGradientBrush_Release(radial);
+    }
+
+    if(collection != NULL) {
+        /* The stops cannot be changed through our API, but the application
+         * may destroy the brush and create a new one at the same address. */
+        n = c_ID2D1GradientStopCollection_GetGradientStopCount(collection);
+        hash = wd_framediff_hash(hash, &n, sizeof(UINT32));
+        n = WD_MIN(n, WD_SIZEOF_ARRAY(stops));
+        c_ID2D1GradientStopCollection_GetGradientStops(collection, stops, n);
+        hash = wd_framediff_hash(hash, stops, n * sizeof(c_D2D1_GRADIENT_STOP));
+        c_ID2D1GradientStopCollection_Release(collection);
+    }
+
+    return hash;
+}
+
+static inline BOOL
+wd_framediff_overlap(const WD_RECT* r0, const WD_RECT* r1)
+{
+    return (r0->x0 < r1->x1  &&  r1->x0 < r0->x1  &&
+            r0->y0 < r1->y1  &&  r1->y0 < r0->y1);
+}
+
+static inline void
+wd_framediff_intersect(WD_RECT* r, const WD_RECT* r1)
+{
+    r->x0 = WD_MAX(r->x0, r1->x0);
+    r->y0 = WD_MAX(r->y0, r1->y0);
+    r->x1 = WD_MIN(r->x1, r1->x1);
+    r->y1 = WD_MIN(r->y1, r1->y1);
+}
+
+static inline BOOL
+wd_framediff_axis_aligned(const WD_MATRIX* m)
+{
+    return (m->m12 == 0.0f  &&  m->m21 == 0.0f  &&  m->m11 != 0.0f  &&  m->m22 != 0.0f);
+}
+
+/* Bounding box of the rectangle transformed by the matrix. */
+static void
+wd_framediff_transform_rect(const WD_MATRIX* m, const WD_RECT* r, WD_RECT* res)
+{
+    float xs[4] = { r->x0, r->x1, r->x0, r->x1 };
+    float ys[4] = { r->y0, r->y0, r->y1, r->y1 };
+    int i;
+
+    for(i = 0; i < 4; i++) {
+        float x = xs[i] * m->m11 + ys[i] * m->m21 + m->dx;
+        float y = xs[i] * m->m12 + ys[i] * m->m22 + m->dy;
+
+        if(i == 0  ||  x < res->x0)  res->x0 = x;
+        if(i == 0  ||  y < res->y0)  res->y0 = y;
+        if(i == 0  ||  x > res->x1)  res->x1 = x;
+        if(i == 0  ||  y > res->y1)  res->y1 = y;
+    }
+}
+
+/* Device space bounds of what a command with the given world bounds (see
+ * wd_cmd_bounds()) may paint, including the pixel anti-aliasing may touch
+ * around it. */
+static void
+wd_framediff_device_bounds(const WD_MATRIX* m, const WD_RECT* r, WD_RECT* res)
+{
+    wd_framediff_transform_rect(m, r, res);
+    res->x0 -= 1.0f;
+    res->y0 -= 1.0f;
+    res->x1 += 1.0f;
+    res->y1 += 1.0f;
+}
+
+BOOL
+wd_framediff_install(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook;
+    wd_framediff_t* fd;
+
+    hook = wd_hook_acquire(hCanvas);
+    if(hook == NULL) {
+        WD_TRACE("wd_framediff_install: wd_hook_acquire() failed.");
+        goto err_wd_hook_acquire;
+    }
+
+    fd = (wd_framediff_t*) malloc(sizeof(wd_framediff_t));
+    if(fd == NULL) {
+        WD_TRACE("wd_framediff_install: malloc() failed.");
+        goto err_malloc;
+    }
+    memset(fd, 0, sizeof(wd_framediff_t));
+
+    fd->frame = wd_dlist_alloc();
+    if(fd->frame == NULL) {
+        WD_TRACE("wd_framediff_install: wd_dlist_alloc() failed.");
+        goto err_wd_dlist_alloc;
+    }
+
+    hook->framediff = fd;
+    return TRUE;
+
+    /* Error path unwinding */
+err_wd_dlist_alloc:
+    free(fd);
+err_malloc:
+    wd_hook_release(hCanvas);
+err_wd_hook_acquire:
+    return FALSE;
+}
+
+void
+wd_framediff_free(wd_framediff_t* fd)
+{
+    if(fd->in_frame)
+        WD_TRACE("wd_framediff_free: Logical error: Unpaired wdBeginPaint()/wdEndPaint().");
+
+    wd_dlist_free(fd->frame);
+    free(fd->recs);
+    free(fd->prev_recs);
+    free(fd);
+}
+
+void
+wd_framediff_invalidate(wd_framediff_t* fd)
+{
+    fd->prev_valid = FALSE;
+    fd->n_prev = 0;
+}
+
+void
+wd_framediff_begin(WD_HCANVAS hCanvas, wd_framediff_t* fd)
+{
+    d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+    c_D2D1_SIZE_U size;
+
+    c_ID2D1RenderTarget_GetPixelSize(c->target, &size);
+    fd->canvas.x0 = 0.0f;
+    fd->canvas.y0 = 0.0f;
+    fd->canvas.x1 = (float) size.width;
+    fd->canvas.y1 = (float) size.height;
+
+    wd_dlist_reset(fd->frame);
+    wd_canvas_get_transform(hCanvas, &fd->base_matrix);
+    memcpy(&fd->matrix, &fd->base_matrix, sizeof(WD_MATRIX));
+    fd->matrix_stale = FALSE;
+    fd->has_clip = FALSE;
+    fd->clip_hash = 0;
+    fd->full = !fd->prev_valid;
+    fd->failed = FALSE;
+    fd->spilled = FALSE;
+    fd->in_frame = TRUE;
+}
+
+static void
+wd_framediff_track_clip(WD_HCANVAS hCanvas, wd_framediff_t* fd, const wd_cmd_t* cmd)
+{
+    WD_RECT r;
+    BOOL bounded = FALSE;
+
+    fd->has_clip = FALSE;
+    fd->clip_hash = 0;
+
+    if(!(cmd->flags & WD_CMDFLAG_HASRECT)  &&  cmd->obj == NULL)
+        return;
+
+    /* We can replay a clip intersected with a dirty rectangle only if it is
+     * aligned with the device axes (see wd_framediff_replay_clip()). */
+    if(!wd_framediff_axis_aligned(&fd->matrix))
+        fd->full = TRUE;
+
+    if(cmd->flags & WD_CMDFLAG_HASRECT) {
+        wd_framediff_transform_rect(&fd->matrix, (const WD_RECT*) &cmd->a[0], &r);
+        bounded = TRUE;
+    }
+
+    if(cmd->obj != NULL) {
+        wd_cmd_t path_cmd;
+        WD_RECT path_bounds;
+
+        /* Reuse the bounds of the path as if filled. */
+        wd_cmd_init(&path_cmd, WD_CMD_FILLPATH);
+        path_cmd.obj = cmd->obj;
+        if(wd_cmd_bounds(&path_cmd, &path_bounds)) {
+            WD_RECT tmp;
+
+            wd_framediff_device_bounds(&fd->matrix, &path_bounds, &tmp);
+            if(bounded) {
+                wd_framediff_intersect(&r, &tmp);
+            } else {
+                memcpy(&r, &tmp, sizeof(WD_RECT));
+                bounded = TRUE;
+            }
+        }
+    }
+
+    fd->clip_hash = wd_framediff_hash(WD_FRAMEDIFF_HASHINIT, cmd->a, 4 * sizeof(float));
+    fd->clip_hash = wd_framediff_hash(fd->clip_hash, &cmd->flags, sizeof(WORD));
+    fd->clip_hash = wd_framediff_hash(fd->clip_hash, &cmd->obj, sizeof(void*));
+    fd->clip_hash = wd_framediff_hash(fd->clip_hash, &fd->matrix, sizeof(WD_MATRIX));
+
+    if(bounded) {
+        fd->has_clip = TRUE;
+        memcpy(&fd->clip, &r, sizeof(WD_RECT));
+    }
+}
+
+static void
+wd_framediff_paint_rec(wd_framediff_t* fd, const wd_cmd_t* cmd, wd_framediff_rec_t* rec)
+{
+    WD_RECT r;
+    UINT32 hash = WD_FRAMEDIFF_HASHINIT;
+
+    rec->type = WD_FRAMEDIFF_PAINT;
+
+    /* Device space bounds. */
+    if(cmd->kind != WD_CMD_CLEAR  &&  wd_cmd_bounds(cmd, &r)) {
+        wd_framediff_device_bounds(&fd->matrix, &r, &rec->bounds);
+        wd_framediff_intersect(&rec->bounds, &fd->canvas);
+    } else {
+        memcpy(&rec->bounds, &fd->canvas, sizeof(WD_RECT));
+    }
+    if(fd->has_clip)
+        wd_framediff_intersect(&rec->bounds, &fd->clip);
+
+    /* The hash. Objects other than brushes are identified only by their
+     * handles. */
+    hash = wd_framediff_hash(hash, &cmd->kind, sizeof(WORD));
+    hash = wd_framediff_hash(hash, &cmd->flags, sizeof(WORD));
+    hash = wd_framediff_hash(hash, &cmd->dw, sizeof(DWORD));
+    hash = wd_framediff_hash(hash, &cmd->len, sizeof(int));
+    hash = wd_framediff_hash(hash, cmd->a, sizeof(cmd->a));
+    if(cmd->flags & WD_CMDFLAG_SOLIDCOLOR)
+        hash = wd_framediff_hash(hash, &cmd->color, sizeof(WD_COLOR));
+    else if(cmd->brush != NULL)
+        hash = wd_framediff_hash_brush(hash, (c_ID2D1Brush*) cmd->brush);
+    hash = wd_framediff_hash(hash, &cmd->style, sizeof(void*));
+    hash = wd_framediff_hash(hash, &cmd->obj, sizeof(void*));
+    if(wd_cmd_data_size(cmd) > 0)
+        hash = wd_framediff_hash(hash, cmd->data, wd_cmd_data_size(cmd));
+    hash = wd_framediff_hash(hash, &fd->matrix, sizeof(WD_MATRIX));
+    hash = wd_framediff_hash(hash, &fd->clip_hash, sizeof(UINT32));
+    hash = wd_framediff_hash(hash, &rec->bounds, sizeof(WD_RECT));
+    rec->hash = hash;
+}
+
+BOOL
+wd_framediff_cmd(WD_HCANVAS hCanvas, wd_framediff_t* fd, wd_cmd_t* cmd)
+{
+    UINT i = fd->frame->n;
+    BOOL consumed = TRUE;
+
+    if(!fd->in_frame)
+        return FALSE;
+
+    if(i >= fd->alloc) {
+        UINT alloc = (fd->alloc > 0 ? 2 * fd->alloc : 64);
+        wd_framediff_rec_t* recs;
+
+        recs = (wd_framediff_rec_t*) realloc(fd->recs, alloc * sizeof(wd_framediff_rec_t));
+        if(recs == NULL) {
+            WD_TRACE("wd_framediff_cmd: realloc() failed.");
+            goto err_realloc;
+        }
+        fd->recs = recs;
+        fd->alloc = alloc;
+    }
+
+    if(fd->matrix_stale) {
+        wd_canvas_get_transform(hCanvas, &fd->matrix);
+        fd->matrix_stale = FALSE;
+    }
+
+    wd_cmd_capture(cmd);
+
+    switch(cmd->kind) {
+        case WD_CMD_ROTATEWORLD:
+        case WD_CMD_TRANSLATEWORLD:
+        case WD_CMD_TRANSFORMWORLD:
+        case WD_CMD_RESETWORLD:
+            /* Let the transformation be applied right now too, so we can
+             * compute the device space bounds of the following calls. */
+            fd->recs[i].type = WD_FRAMEDIFF_STATE;
+            fd->matrix_stale = TRUE;
+            consumed = FALSE;
+            break;
+
+        case WD_CMD_SETCLIP:
+            fd->recs[i].type = WD_FRAMEDIFF_STATE;
+            wd_framediff_track_clip(hCanvas, fd, cmd);
+            break;
+
+        default:
+            wd_framediff_paint_rec(fd, cmd, &fd->recs[i]);
+            fd->calls++;
+            break;
+    }
+
+    /* After wd_framediff_spill(), the rest of the frame is painted directly.
+     * It is still recorded so the next frame can be compared with it. */
+    if(fd->spilled  &&  consumed) {
+        if(fd->recs[i].type == WD_FRAMEDIFF_PAINT)
+            fd->calls_painted++;
+        consumed = FALSE;
+    }
+
+    if(!wd_dlist_append(fd->frame, cmd)) {
+        WD_TRACE("wd_framediff_cmd: wd_dlist_append() failed.");
+        goto err_wd_dlist_append;
+    }
+
+    if(consumed)
+        wd_hook_hold(hCanvas, cmd);
+    return consumed;
+
+    /* Error path unwinding */
+err_wd_dlist_append:
+err_realloc:
+    /* We cannot paint the call out of order, so it is lost. At least make
+     * sure the damage does not persist in the next frames. */
+    fd->full = TRUE;
+    fd->failed = TRUE;
+    return TRUE;
+}
+
+/* Add rectangle into the set of the dirty ones, merging it with the ones it
+ * overlaps or touches. */
+static void
+wd_framediff_add_dirty(wd_framediff_t* fd, const WD_RECT* rect)
+{
+    WD_RECT r;
+    UINT k;
+
+    memcpy(&r, rect, sizeof(WD_RECT));
+    wd_framediff_intersect(&r, &fd->canvas);
+    if(r.x0 >= r.x1  ||  r.y0 >= r.y1)
+        return;
+
+    /* Align to whole pixels. */
+    r.x0 = floorf(r.x0);
+    r.y0 = floorf(r.y0);
+    r.x1 = ceilf(r.x1);
+    r.y1 = ceilf(r.y1);
+
+again:
+    for(k = 0; k < fd->n_dirty; k++) {
+        WD_RECT* d = &fd->dirty[k];
+
+        if(r.x0 <= d->x1  &&  d->x0 <= r.x1  &&  r.y0 <= d->y1  &&  d->y0 <= r.y1)
+            break;
+    }
+
+    if(k >= fd->n_dirty  &&  fd->n_dirty >= WD_FRAMEDIFF_MAXRECTS) {
+        /* No room. Merge with the one which grows the least. */
+        float r_area = (r.x1 - r.x0) * (r.y1 - r.y0);
+        float best = FLT_MAX;
+        UINT best_k = 0;
+
+        for(k = 0; k < fd->n_dirty; k++) {
+            WD_RECT* d = &fd->dirty[k];
+            float growth = (WD_MAX(r.x1, d->x1) - WD_MIN(r.x0, d->x0)) *
+                           (WD_MAX(r.y1, d->y1) - WD_MIN(r.y0, d->y0)) -
+                           (d->x1 - d->x0) * (d->y1 - d->y0) - r_area;
+            if(growth < best) {
+                best = growth;
+                best_k = k;
+            }
+        }
+        k = best_k;
+    }
+
+    if(k < fd->n_dirty) {
+        WD_RECT* d = &fd->dirty[k];
+
+        r.x0 = WD_MIN(r.x0, d->x0);
+        r.y0 = WD_MIN(r.y0, d->y0);
+        r.x1 = WD_MAX(r.x1, d->x1);
+        r.y1 = WD_MAX(r.y1, d->y1);
+
+        /* Remove it and try again as the union may now overlap others. */
+        fd->n_dirty--;
+        memcpy(d, &fd->dirty[fd->n_dirty], sizeof(WD_RECT));
+        goto again;
+    }
+
+    memcpy(&fd->dirty[fd->n_dirty++], &r, sizeof(WD_RECT));
+}
+
+/* Compare the frame with the previous one and collect the dirty rectangles.
+ *
+ * The records of both frames are matched by their hash and bounds. A match
+ * has to keep the order of the calls (it matters when they overlap). We do
+ * this greedily: A call whose earliest unmatched counterpart precedes the
+ * last matched one is considered changed. */
+static BOOL
+wd_framediff_diff(wd_framediff_t* fd)
+{
+    typedef struct slot_tag slot_t;
+    struct slot_tag {
+        UINT head;          /* Unmatched records of the previous frame with */
+        UINT tail;          /* the same hash and bounds, in their order. */
+    };
+
+    const wd_framediff_rec_t* prev = fd->prev_recs;
+    const wd_framediff_rec_t* cur = fd->recs;
+    UINT n_prev = fd->n_prev;
+    UINT n_cur = fd->frame->n;
+    UINT mask;
+    slot_t* slots;
+    UINT* next;
+    BYTE* matched;
+    UINT last_matched = 0;
+    BOOL any_matched = FALSE;
+    UINT i, j, k;
+
+    for(mask = 15; mask < 2 * n_prev; mask = 2 * mask + 1);
+
+    slots = (slot_t*) malloc((mask + 1) * sizeof(slot_t) + n_prev * (sizeof(UINT) + 1));
+    if(slots == NULL) {
+        WD_TRACE("wd_framediff_diff: malloc() failed.");
+        return FALSE;
+    }
+    next = (UINT*) (slots + mask + 1);
+    matched = (BYTE*) (next + n_prev);
+
+    for(k = 0; k <= mask; k++)
+        slots[k].head = WD_FRAMEDIFF_NONE;
+    memset(matched, 0, n_prev);
+
+#define SLOT_MATCHES(s, rec)                                                    \
+        (prev[(s)->head].hash == (rec)->hash  &&                                \
+         memcmp(&prev[(s)->head].bounds, &(rec)->bounds, sizeof(WD_RECT)) == 0)
+
+    for(j = 0; j < n_prev; j++) {
+        if(prev[j].type != WD_FRAMEDIFF_PAINT)
+            continue;
+
+        next[j] = WD_FRAMEDIFF_NONE;
+        for(k = prev[j].hash & mask; slots[k].head != WD_FRAMEDIFF_NONE; k = (k + 1) & mask) {
+            if(SLOT_MATCHES(&slots[k], &prev[j]))
+                break;
+        }
+
+        if(slots[k].head == WD_FRAMEDIFF_NONE) {
+            slots[k].head = j;
+        } else {
+            next[slots[k].tail] = j;
+        }
+        slots[k].tail = j;
+    }
+
+    for(i = 0; i < n_cur; i++) {
+        if(cur[i].type != WD_FRAMEDIFF_PAINT)
+            continue;
+
+        for(k = cur[i].hash & mask; slots[k].head != WD_FRAMEDIFF_NONE; k = (k + 1) & mask) {
+            if(SLOT_MATCHES(&slots[k], &cur[i]))
+                break;
+        }
+
+        j = slots[k].head;
+        if(j != WD_FRAMEDIFF_NONE  &&  !matched[j]  &&  (!any_matched  ||  j > last_matched)) {
+            matched[j] = TRUE;
+            last_matched = j;
+            any_matched = TRUE;
+            /* Keep the slot occupied even if its list gets empty, so the
+             * probing of other keys still works. */
+            if(next[j] != WD_FRAMEDIFF_NONE)
+                slots[k].head = next[j];
+            continue;
+        }
+
+        wd_framediff_add_dirty(fd, &cur[i].bounds);
+    }
+
+#undef SLOT_MATCHES
+
+    for(j = 0; j < n_prev; j++) {
+        if(prev[j].type == WD_FRAMEDIFF_PAINT  &&  !matched[j])
+            wd_framediff_add_dirty(fd, &prev[j].bounds);
+    }
+
+    free(slots);
+    return TRUE;
+}
+
+static void
+wd_framediff_replay_clip(WD_HCANVAS hCanvas, const wd_cmd_t* cmd, const WD_RECT* dirty)
+{
+    WD_MATRIX m;
+    WD_RECT r;
+
+    wd_canvas_get_transform(hCanvas, &m);
+
+    if(!wd_framediff_axis_aligned(&m)) {
+        /* The whole frame is being repainted (see wd_framediff_track_clip()),
+         * so the clip of the call is all what matters. */
+        wd_cmd_execute(hCanvas, cmd);
+        return;
+    }
+
+    /* Map the dirty rectangle into the world space and intersect with the
+     * clip rectangle of the call (if any). */
+    r.x0 = (dirty->x0 - m.dx) / m.m11;
+    r.x1 = (dirty->x1 - m.dx) / m.m11;
+    r.y0 = (dirty->y0 - m.dy) / m.m22;
+    r.y1 = (dirty->y1 - m.dy) / m.m22;
+    if(r.x0 > r.x1) { float tmp = r.x0; r.x0 = r.x1; r.x1 = tmp; }
+    if(r.y0 > r.y1) { float tmp = r.y0; r.y0 = r.y1; r.y1 = tmp; }
+
+    if(cmd->flags & WD_CMDFLAG_HASRECT) {
+        const WD_RECT* cr = (const WD_RECT*) &cmd->a[0];
+
+        r.x0 = WD_MAX(r.x0, WD_MIN(cr->x0, cr->x1));
+        r.y0 = WD_MAX(r.y0, WD_MIN(cr->y0, cr->y1));
+        r.x1 = WD_MIN(r.x1, WD_MAX(cr->x0, cr->x1));
+        r.y1 = WD_MIN(r.y1, WD_MAX(cr->y0, cr->y1));
+        if(r.x1 < r.x0)  r.x1 = r.x0;
+        if(r.y1 < r.y0)  r.y1 = r.y0;
+    }
+
+    wdSetClip(hCanvas, &r, (WD_HPATH) cmd->obj);
+}
+
+static void
+wd_framediff_replay(WD_HCANVAS hCanvas, wd_framediff_t* fd)
+{
+    static const WD_MATRIX identity = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+    WD_MATRIX end_matrix;
+    UINT i, k;
+
+    wd_canvas_get_transform(hCanvas, &end_matrix);
+    wd_hook_enter(hCanvas);
+
+    for(k = 0; k < fd->n_dirty; k++) {
+        const WD_RECT* dirty = &fd->dirty[k];
+
+        wd_canvas_set_transform(hCanvas, &identity);
+        wdSetClip(hCanvas, dirty, NULL);
+        wd_canvas_set_transform(hCanvas, &fd->base_matrix);
+
+        for(i = 0; i < fd->frame->n; i++) {
+            const wd_framediff_rec_t* rec = &fd->recs[i];
+            wd_cmd_t cmd;
+
+            if(rec->type == WD_FRAMEDIFF_PAINT) {
+                if(!wd_framediff_overlap(&rec->bounds, dirty))
+                    continue;
+                fd->calls_painted++;
+            }
+
+            wd_dlist_get(fd->frame, i, &cmd);
+            if(cmd.kind == WD_CMD_SETCLIP)
+                wd_framediff_replay_clip(hCanvas, &cmd, dirty);
+            else
+                wd_cmd_execute(hCanvas, &cmd);
+        }
+    }
+
+    if(fd->n_dirty > 0)
+        wdSetClip(hCanvas, NULL, NULL);
+    wd_canvas_set_transform(hCanvas, &end_matrix);
+
+    wd_hook_leave(hCanvas);
+}
+
+void
+wd_framediff_spill(WD_HCANVAS hCanvas, wd_framediff_t* fd)
+{
+    WD_MATRIX end_matrix;
+    UINT i;
+
+    if(!fd->in_frame  ||  fd->spilled)
+        return;
+
+    /* The frame cannot be diffed anymore: Paint what is recorded so far as it
+     * is, and let the rest of the frame be painted directly (with the clip
+     * of the last wdSetClip() in effect). */
+    wd_canvas_get_transform(hCanvas, &end_matrix);
+    wd_hook_enter(hCanvas);
+    wd_canvas_set_transform(hCanvas, &fd->base_matrix);
+
+    for(i = 0; i < fd->frame->n; i++) {
+        wd_cmd_t cmd;
+
+        if(fd->recs[i].type == WD_FRAMEDIFF_PAINT)
+            fd->calls_painted++;
+        wd_dlist_get(fd->frame, i, &cmd);
+        wd_cmd_execute(hCanvas, &cmd);
+    }
+
+    wd_canvas_set_transform(hCanvas, &end_matrix);
+    wd_hook_leave(hCanvas);
+
+    fd->spilled = TRUE;
+    fd->full = TRUE;
+    wd_hook_unhold(hCanvas);
+}
+
+void
+wd_framediff_end(WD_HCANVAS hCanvas, wd_framediff_t* fd)
+{
+    wd_framediff_rec_t* tmp_recs;
+    UINT tmp_alloc;
+
+    if(!fd->in_frame)
+        return;
+    fd->in_frame = FALSE;
+
+    fd->n_dirty = 0;
+    if(fd->spilled) {
+        /* Already painted by wd_framediff_spill() and the calls after it. */
+        wd_framediff_add_dirty(fd, &fd->canvas);
+    } else {
+        if(fd->full  ||  !wd_framediff_diff(fd))
+            wd_framediff_add_dirty(fd, &fd->canvas);
+        wd_framediff_replay(hCanvas, fd);
+    }
+    wd_hook_unhold(hCanvas);
+
+    /* The records of this frame become the previous ones. (The caller calls
+     * wd_framediff_invalidate() if the frame does not get presented.) */
+    tmp_recs = fd->prev_recs;
+    tmp_alloc = fd->prev_alloc;
+    fd->prev_recs = fd->recs;
+    fd->prev_alloc = fd->alloc;
+    fd->n_prev = fd->frame->n;
+    fd->recs = tmp_recs;
+    fd->alloc = tmp_alloc;
+    fd->prev_valid = !fd->failed;
+    wd_dlist_reset(fd->frame);
+}
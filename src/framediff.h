@@ -0,0 +1,103 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_FRAMEDIFF_H
+#define WD_FRAMEDIFF_H
+
+#include "misc.h"
+#include "hook.h"
+
+
+/* Implementation of WD_CANVAS_FRAMEDIFF.
+ *
+ * Between wdBeginPaint() and wdEndPaint(), the drawing calls are recorded
+ * and nothing is painted. For each call, a hash of everything which affects
+ * its output (kind, arguments, brush color or gradient, transformation,
+ * clip) is computed together with its bounds in the device space.
+ *
+ * In wdEndPaint(), the list of (hash, bounds) is compared with the one of the
+ * previous frame. The bounds of calls which have no counterpart in the other
+ * frame form the dirty rectangles, and the recorded frame is then replayed
+ * once per each dirty rectangle, with the clip set to it and with the calls
+ * which do not intersect it skipped.
+ *
+ * The previous frame is only trusted if its wdEndPaint() has returned TRUE
+ * (i.e. the canvas retains the contents, see wdBeginPaint() in wdl.h).
+ * Otherwise the whole canvas is repainted.
+ */
+
+/* Max. count of the dirty rectangles. More of them are merged together. */
+#define WD_FRAMEDIFF_MAXRECTS   8
+
+typedef struct wd_framediff_rec_tag wd_framediff_rec_t;
+
+struct wd_framediff_tag {
+    wd_dlist_t* frame;              /* Calls of the current frame. */
+    wd_framediff_rec_t* recs;       /* Parallel with frame->recs. */
+    UINT alloc;
+
+    wd_framediff_rec_t* prev_recs;  /* Records of the previous frame. */
+    UINT n_prev;
+    UINT prev_alloc;
+    BOOL prev_valid;
+
+    /* State tracked while recording. */
+    BOOL in_frame;
+    WD_RECT canvas;                 /* The whole canvas (in device space). */
+    WD_MATRIX base_matrix;          /* Transformation at wdBeginPaint(). */
+    WD_MATRIX matrix;               /* Current complete transformation. */
+    BOOL matrix_stale;
+    BOOL has_clip;
+    WD_RECT clip;                   /* Bounds of the clip (in device space). */
+    UINT32 clip_hash;
+    BOOL full;                      /* Frame has to be repainted completely. */
+    BOOL failed;                    /* Some call could not be recorded. */
+    BOOL spilled;                   /* See wd_framediff_spill(). */
+
+    /* Result of the last wdEndPaint(). */
+    WD_RECT dirty[WD_FRAMEDIFF_MAXRECTS];
+    UINT n_dirty;
+
+    /* Statistics. */
+    UINT calls;
+    UINT calls_painted;
+};
+
+
+BOOL wd_framediff_install(WD_HCANVAS hCanvas);
+void wd_framediff_free(wd_framediff_t* fd);
+
+void wd_framediff_begin(WD_HCANVAS hCanvas, wd_framediff_t* fd);
+BOOL wd_framediff_cmd(WD_HCANVAS hCanvas, wd_framediff_t* fd, wd_cmd_t* cmd);
+void wd_framediff_end(WD_HCANVAS hCanvas, wd_framediff_t* fd);
+
+/* Paint the calls recorded so far and the rest of the frame directly. Called
+ * when an object used by the recorded calls is about to be destroyed or
+ * changed (see wd_hook_object_changing()). */
+void wd_framediff_spill(WD_HCANVAS hCanvas, wd_framediff_t* fd);
+
+/* Forget the previous frame, so the next one is painted completely. */
+void wd_framediff_invalidate(wd_framediff_t* fd);
+
+
+#endif  /* WD_FRAMEDIFF_H */
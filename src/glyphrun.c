@@ -0,0 +1,312 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "misc.h"
+#include "backend-d2d.h"
+#include "backend-dwrite.h"
+#include "backend-gdix.h"
+
+
+/* Glyph runs are processed in chunks of this size so that no temporary
+ * buffers have to be allocated. */
+#define GLYPHRUN_CHUNK      64
+
+
+/* Get the code point at *pos and move *pos past it. An unpaired surrogate is
+ * returned as it is (no font has a glyph for it). */
+static UINT32
+glyphrun_decode(const WCHAR* str, UINT len, UINT* pos)
+{
+    UINT32 ch = str[*pos];
+
+    (*pos)++;
+    if(ch >= 0xd800  &&  ch <= 0xdbff  &&  *pos < len  &&
+       str[*pos] >= 0xdc00  &&  str[*pos] <= 0xdfff)
+    {
+        ch = 0x10000 + ((ch - 0xd800) << 10) + (str[*pos] - 0xdc00);
+        (*pos)++;
+    }
+
+    return ch;
+}
+
+UINT
+wdShapeText(WD_HFONT hFont, const WCHAR* pszText, int iTextLength,
+            UINT16* pGlyphs, float* pAdvances, UINT uMaxCount)
+{
+    UINT len;
+    UINT n_glyphs;
+    UINT n;
+    UINT pos;
+    UINT i, j;
+
+    if(hFont == NULL)
+        return 0;
+
+    if(iTextLength < 0)
+        iTextLength = wcslen(pszText);
+    len = (UINT) iTextLength;
+
+    /* Each code point (i.e. also a surrogate pair) makes one glyph. */
+    n_glyphs = 0;
+    for(pos = 0; pos < len; n_glyphs++)
+        glyphrun_decode(pszText, len, &pos);
+    n = WD_MIN(n_glyphs, uMaxCount);
+    pos = 0;
+
+    if(d2d_enabled()) {
+        dwrite_font_t* font = (dwrite_font_t*) hFont;
+        UINT32 code_points[GLYPHRUN_CHUNK];
+        c_DWRITE_GLYPH_METRICS gm[GLYPHRUN_CHUNK];
+        float factor;
+        UINT chunk;
+        HRESULT hr;
+
+        if(font->face == NULL) {
+            WD_TRACE("wdShapeText: The font has no font face.");
+            return 0;
+        }
+
+        factor = c_IDWriteTextFormat_GetFontSize(font->tf)
+                    / (float) font->metrics.designUnitsPerEm;
+
+        for(i = 0; i < n; i += chunk) {
+            chunk = WD_MIN(n - i, GLYPHRUN_CHUNK);
+
+            for(j = 0; j < chunk; j++)
+                code_points[j] = glyphrun_decode(pszText, len, &pos);
+
+            hr = c_IDWriteFontFace_GetGlyphIndices(font->face, code_points,
+                        chunk, pGlyphs + i);
+            if(FAILED(hr)) {
+                WD_TRACE_HR("wdShapeText: "
+                            "IDWriteFontFace::GetGlyphIndices() failed.");
+                return 0;
+            }
+
+            hr = c_IDWriteFontFace_GetDesignGlyphMetrics(font->face,
+                        pGlyphs + i, chunk, gm, FALSE);
+            if(FAILED(hr)) {
+                WD_TRACE_HR("wdShapeText: "
+                            "IDWriteFontFace::GetDesignGlyphMetrics() failed.");
+                return 0;
+            }
+
+            for(j = 0; j < chunk; j++)
+                pAdvances[i + j] = factor * (float) gm[j].advanceWidth;
+        }
+    } else if(n > 0) {
+        gdix_canvas_t* c;
+        LOGFONTW lf;
+        HFONT gdi_font;
+        HFONT old_font;
+        HDC dc;
+        WCHAR units[GLYPHRUN_CHUNK];
+        INT widths[GLYPHRUN_CHUNK];
+        UINT chunk;
+        int status;
+        BOOL ok = TRUE;
+
+        /* The flat GDI+ API exposes neither glyph indices nor glyph metrics,
+         * so ask GDI about the same font. */
+        c = gdix_measure_canvas();
+        if(c == NULL) {
+            WD_TRACE("wdShapeText: gdix_measure_canvas() failed.");
+            return 0;
+        }
+
+        status = gdix_vtable->fn_GetLogFontW((c_GpFont*) hFont, c->graphics, &lf);
+        if(status != 0) {
+            WD_TRACE("wdShapeText: GdipGetLogFontW() failed. [%d]", status);
+            return 0;
+        }
+
+        gdi_font = CreateFontIndirectW(&lf);
+        if(gdi_font == NULL) {
+            WD_TRACE_ERR("wdShapeText: CreateFontIndirectW() failed.");
+            return 0;
+        }
+
+        dc = GetDC(NULL);
+        old_font = SelectObject(dc, gdi_font);
+
+        for(i = 0; i < n; i += chunk) {
+            chunk = WD_MIN(n - i, GLYPHRUN_CHUNK);
+
+            /* GDI maps only the BMP characters. U+FFFF is a non-character
+             * which no font has a glyph for. */
+            for(j = 0; j < chunk; j++) {
+                UINT32 ch = glyphrun_decode(pszText, len, &pos);
+                units[j] = (ch <= 0xffff ? (WCHAR) ch : 0xffff);
+            }
+
+            if(GetGlyphIndicesW(dc, units, chunk, pGlyphs + i,
+                                GGI_MARK_NONEXISTING_GLYPHS) == GDI_ERROR) {
+                WD_TRACE_ERR("wdShapeText: GetGlyphIndicesW() failed.");
+                ok = FALSE;
+                goto gdi_done;
+            }
+
+            /* Same as DirectWrite: Missing glyphs map to the glyph 0. */
+            for(j = 0; j < chunk; j++) {
+                if(pGlyphs[i + j] == 0xffff)
+                    pGlyphs[i + j] = 0;
+            }
+
+            if(!GetCharWidthI(dc, 0, chunk, pGlyphs + i, widths)) {
+                WD_TRACE_ERR("wdShapeText: GetCharWidthI() failed.");
+                ok = FALSE;
+                goto gdi_done;
+            }
+
+            for(j = 0; j < chunk; j++)
+                pAdvances[i + j] = (float) widths[j];
+        }
+
+gdi_done:
+        SelectObject(dc, old_font);
+        ReleaseDC(NULL, dc);
+        DeleteObject(gdi_font);
+
+        if(!ok)
+            return 0;
+    }
+
+    return n_glyphs;
+}
+
+void
+wdDrawGlyphRun(WD_HCANVAS hCanvas, WD_HFONT hFont, float x, float y,
+               const UINT16* pGlyphs, const float* pAdvances, UINT uCount,
+               WD_HBRUSH hBrush)
+{
+    float a[3] = { x, y, 0.0f };
+    UINT i;
+
+    if(hFont == NULL  ||  uCount == 0)
+        return;
+
+    for(i = 0; i < uCount; i++)
+        a[2] += pAdvances[i];
+
+    /* (A busy hook would not take the call anyway, and the scratch buffer
+     * may be in use then.) */
+    if(wd_hooked(hCanvas)  &&  wd_canvas_hook(hCanvas)->busy == 0) {
+        wd_cmd_t cmd;
+        BYTE* buffer;
+
+        /* The command has just one data buffer, so pack the advances and
+         * the glyphs (in this order, to keep the floats aligned) into one. */
+        buffer = (BYTE*) wd_hook_scratch(hCanvas,
+                    uCount * (sizeof(float) + sizeof(UINT16)));
+        if(buffer == NULL) {
+            WD_TRACE("wdDrawGlyphRun: wd_hook_scratch() failed.");
+            return;
+        }
+        memcpy(buffer, pAdvances, uCount * sizeof(float));
+        memcpy(buffer + uCount * sizeof(float), pGlyphs, uCount * sizeof(UINT16));
+
+        wd_cmd_init(&cmd, WD_CMD_DRAWGLYPHRUN);
+        cmd.brush = hBrush;
+        cmd.obj = hFont;
+        cmd.data = buffer;
+        cmd.len = (int) uCount;
+        memcpy(cmd.a, a, sizeof(a));
+        if(wd_hook_cmd(hCanvas, &cmd))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWGLYPHRUN, (void*) hFont, 0, a))
+        return;
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        dwrite_font_t* font = (dwrite_font_t*) hFont;
+        c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
+        c_D2D1_POINT_2F origin = { x, y };
+        c_D2D1_MATRIX_3X2_F old_matrix;
+        c_DWRITE_GLYPH_RUN run;
+
+        if(font->face == NULL) {
+            WD_TRACE("wdDrawGlyphRun: The font has no font face.");
+            return;
+        }
+
+        run.fontFace = font->face;
+        run.fontEmSize = c_IDWriteTextFormat_GetFontSize(font->tf);
+        run.glyphCount = uCount;
+        run.glyphIndices = pGlyphs;
+        run.glyphAdvances = pAdvances;
+        run.glyphOffsets = NULL;
+        run.isSideways = FALSE;
+        run.bidiLevel = 0;
+
+        /* Do not mirror the glyphs on RTL canvas, only the position. */
+        if(c->flags & D2D_CANVASFLAG_RTL) {
+            d2d_disable_rtl_transform(c, &old_matrix);
+            origin.x = (float)c->width - (x + a[2]);
+        }
+
+        c_ID2D1RenderTarget_DrawGlyphRun(c->target, origin, &run, b,
+                c_DWRITE_MEASURING_MODE_NATURAL);
+
+        if(c->flags & D2D_CANVASFLAG_RTL)
+            c_ID2D1RenderTarget_SetTransform(c->target, &old_matrix);
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        c_GpPointF positions[GLYPHRUN_CHUNK];
+        UINT chunk;
+        UINT j;
+        float pos_x;
+        int status;
+
+        if(c->rtl) {
+            gdix_rtl_transform(c);
+            pos_x = (float)(c->width-1) - (x + a[2]);
+        } else {
+            pos_x = x;
+        }
+
+        for(i = 0; i < uCount; i += chunk) {
+            chunk = WD_MIN(uCount - i, GLYPHRUN_CHUNK);
+
+            for(j = 0; j < chunk; j++) {
+                positions[j].x = pos_x;
+                positions[j].y = y;
+                pos_x += pAdvances[i + j];
+            }
+
+            /* No c_DriverStringOptionsCmapLookup: pGlyphs are glyph indices,
+             * not characters. */
+            status = gdix_vtable->fn_DrawDriverString(c->graphics, pGlyphs + i,
+                        chunk, (c_GpFont*) hFont, (c_GpBrush*) hBrush, positions,
+                        0, NULL);
+            if(status != 0) {
+                WD_TRACE("wdDrawGlyphRun: GdipDrawDriverString() failed. [%d]", status);
+                break;
+            }
+        }
+
+        if(c->rtl)
+            gdix_rtl_transform(c);
+    }
+}
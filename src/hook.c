@@ -0,0 +1,625 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "hook.h"
+#include "backend-d2d.h"
+#include "backend-gdix.h"
+#include "apitrace.h"
+#include "defer.h"
+#include "dlist.h"
+#include "framediff.h"
+#include "cull.h"
+#include "lock.h"
+
+
+/* Hooks holding back some calls (see wd_hook_hold()). Protected by the lock,
+ * except that wd_hook_n_held may be read without it as a quick check. */
+static wd_hook_t* wd_hook_held_list = NULL;
+static volatile UINT wd_hook_n_held = 0;
+
+
+wd_hook_t*
+wd_hook_acquire(WD_HCANVAS hCanvas)
+{
+    wd_hook_t** p_hook = (wd_hook_t**) hCanvas;
+
+    if(*p_hook == NULL) {
+        *p_hook = (wd_hook_t*) malloc(sizeof(wd_hook_t));
+        if(*p_hook == NULL) {
+            WD_TRACE("wd_hook_acquire: malloc() failed.");
+            return NULL;
+        }
+        memset(*p_hook, 0, sizeof(wd_hook_t));
+        (*p_hook)->canvas = hCanvas;
+    }
+
+    return *p_hook;
+}
+
+void
+wd_hook_release(WD_HCANVAS hCanvas)
+{
+    wd_hook_t** p_hook = (wd_hook_t**) hCanvas;
+    wd_hook_t* hook = *p_hook;
+
+    if(hook == NULL  ||  hook->busy > 0)
+        return;
+    if(hook->recording != NULL  ||  hook->defer != NULL  ||
+       hook->framediff != NULL  ||  hook->trace)
+        return;
+
+    wd_hook_unhold(hCanvas);
+    if(hook->solid != NULL)
+        wd_brush_destroy(hook->solid);
+    free(hook->scratch);
+    free(hook);
+    *p_hook = NULL;
+}
+
+void
+wd_hook_destroy(WD_HCANVAS hCanvas)
+{
+    wd_hook_t** p_hook = (wd_hook_t**) hCanvas;
+    wd_hook_t* hook = *p_hook;
+
+    if(hook == NULL)
+        return;
+
+    wd_hook_unhold(hCanvas);
+
+    if(hook->recording != NULL) {
+        WD_TRACE("wdDestroyCanvas: Logical error: Unpaired wdBeginRecording()/wdEndRecording().");
+        wd_dlist_free(hook->recording);
+    }
+    if(hook->defer != NULL)
+        wd_defer_free(hook->defer);
+    if(hook->framediff != NULL)
+        wd_framediff_free(hook->framediff);
+    if(hook->solid != NULL)
+        wd_brush_destroy(hook->solid);
+    free(hook->scratch);
+
+    free(hook);
+    *p_hook = NULL;
+}
+
+BOOL
+wd_hook_cmd(WD_HCANVAS hCanvas, wd_cmd_t* cmd)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
+    if(hook->busy > 0)
+        return FALSE;
+
+    if(hook->trace)
+        wd_apitrace_cmd(hCanvas, cmd);
+
+    if(hook->recording != NULL) {
+        if(!wd_dlist_append(hook->recording, cmd))
+            WD_TRACE("wd_hook_cmd: wd_dlist_append() failed.");
+        return TRUE;
+    }
+
+    if(hook->framediff != NULL)
+        return wd_framediff_cmd(hCanvas, hook->framediff, cmd);
+
+    if(hook->defer != NULL)
+        return wd_defer_cmd(hCanvas, hook->defer, cmd);
+
+    return FALSE;
+}
+
+void*
+wd_hook_scratch(WD_HCANVAS hCanvas, UINT size)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
+    if(size > hook->scratch_size) {
+        void* scratch;
+
+        scratch = realloc(hook->scratch, size);
+        if(scratch == NULL) {
+            WD_TRACE("wd_hook_scratch: realloc() failed.");
+            return NULL;
+        }
+        hook->scratch = scratch;
+        hook->scratch_size = size;
+    }
+
+    return hook->scratch;
+}
+
+void
+wd_hook_flush(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
+    if(hook == NULL)
+        return;
+
+    if(hook->defer != NULL)
+        wd_defer_flush(hCanvas, hook->defer);
+}
+
+void
+wd_cmd_capture(wd_cmd_t* cmd)
+{
+    if(cmd->brush == NULL)
+        return;
+    if(wd_brush_solid_color((WD_HBRUSH) cmd->brush, &cmd->color))
+        cmd->flags |= WD_CMDFLAG_SOLIDCOLOR;
+}
+
+/* The held objects are remembered only in a small Bloom filter: A false
+ * positive just causes a needless flush. */
+static inline UINT
+wd_hook_filter_bit(const void* obj)
+{
+    return ((UINT32) ((UINT_PTR) obj >> 4) * 2654435761u) >> 24;
+}
+
+static inline void
+wd_hook_filter_add(wd_hook_t* hook, const void* obj)
+{
+    UINT bit;
+
+    if(obj == NULL)
+        return;
+    bit = wd_hook_filter_bit(obj);
+    hook->held_filter[bit >> 5] |= (1u << (bit & 31));
+}
+
+void
+wd_hook_hold(WD_HCANVAS hCanvas, const wd_cmd_t* cmd)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
+    /* Solid brushes are not needed anymore once the color is captured. */
+    if(!(cmd->flags & WD_CMDFLAG_SOLIDCOLOR))
+        wd_hook_filter_add(hook, cmd->brush);
+    wd_hook_filter_add(hook, cmd->style);
+    wd_hook_filter_add(hook, cmd->obj);
+
+    if(!hook->held) {
+        hook->held = TRUE;
+        hook->held_thread = GetCurrentThreadId();
+        wd_lock();
+        hook->held_next = wd_hook_held_list;
+        wd_hook_held_list = hook;
+        wd_hook_n_held++;
+        wd_unlock();
+    }
+}
+
+void
+wd_hook_unhold(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+    wd_hook_t** pp;
+
+    if(hook == NULL  ||  !hook->held)
+        return;
+
+    wd_lock();
+    for(pp = &wd_hook_held_list; *pp != NULL; pp = &(*pp)->held_next) {
+        if(*pp == hook) {
+            *pp = hook->held_next;
+            wd_hook_n_held--;
+            break;
+        }
+    }
+    wd_unlock();
+
+    hook->held = FALSE;
+    hook->held_next = NULL;
+    memset(hook->held_filter, 0, sizeof(hook->held_filter));
+}
+
+/* Paint the calls the hook holds back, so they do not outlive the objects
+ * they use. This has to call wd_hook_unhold(). */
+static void
+wd_hook_spill(wd_hook_t* hook)
+{
+    if(hook->framediff != NULL)
+        wd_framediff_spill(hook->canvas, hook->framediff);
+    if(hook->defer != NULL)
+        wd_defer_flush(hook->canvas, hook->defer);
+    wd_hook_unhold(hook->canvas);
+}
+
+void
+wd_hook_object_changing(const void* obj)
+{
+    wd_hook_t* hook;
+    DWORD thread;
+    UINT bit;
+
+    if(wd_hook_n_held == 0  ||  obj == NULL)
+        return;
+
+    /* Only the canvases of the calling thread can be painted here. Canvases
+     * of other threads are not supposed to share objects with this one
+     * anyway. */
+    thread = GetCurrentThreadId();
+    bit = wd_hook_filter_bit(obj);
+
+    while(TRUE) {
+        wd_lock();
+        for(hook = wd_hook_held_list; hook != NULL; hook = hook->held_next) {
+            if(hook->held_thread == thread  &&  hook->busy == 0  &&
+               (hook->held_filter[bit >> 5] & (1u << (bit & 31))))
+                break;
+        }
+        wd_unlock();
+
+        if(hook == NULL)
+            break;
+        wd_hook_spill(hook);
+    }
+}
+
+BOOL
+wd_hook(WD_HCANVAS hCanvas, WORD kind, void* brush, void* style,
+        void* obj, const float* args, UINT n_args)
+{
+    wd_cmd_t cmd;
+
+    wd_cmd_init(&cmd, kind);
+    cmd.brush = brush;
+    cmd.style = style;
+    cmd.obj = obj;
+    if(n_args > 0)
+        memcpy(cmd.a, args, n_args * sizeof(float));
+
+    return wd_hook_cmd(hCanvas, &cmd);
+}
+
+BOOL
+wd_hook_rects(WD_HCANVAS hCanvas, WORD kind, void* obj,
+              const WD_RECT* rect, const WD_RECT* src_rect)
+{
+    wd_cmd_t cmd;
+
+    wd_cmd_init(&cmd, kind);
+    cmd.obj = obj;
+    if(rect != NULL) {
+        memcpy(&cmd.a[0], rect, sizeof(WD_RECT));
+        cmd.flags |= WD_CMDFLAG_HASRECT;
+    }
+    if(src_rect != NULL) {
+        memcpy(&cmd.a[4], src_rect, sizeof(WD_RECT));
+        cmd.flags |= WD_CMDFLAG_HASSRCRECT;
+    }
+
+    return wd_hook_cmd(hCanvas, &cmd);
+}
+
+BOOL
+wd_hook_string(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
+               const WCHAR* pszText, int iTextLength, WD_HBRUSH hBrush,
+               DWORD dwFlags)
+{
+    wd_cmd_t cmd;
+
+    wd_cmd_init(&cmd, WD_CMD_DRAWSTRING);
+    cmd.flags = WD_CMDFLAG_HASRECT;
+    cmd.dw = dwFlags;
+    cmd.brush = hBrush;
+    cmd.obj = hFont;
+    cmd.data = pszText;
+    cmd.len = (iTextLength >= 0 ? iTextLength : (int) wcslen(pszText));
+    memcpy(&cmd.a[0], pRect, sizeof(WD_RECT));
+
+    return wd_hook_cmd(hCanvas, &cmd);
+}
+
+static inline void
+wd_set_bounds(WD_RECT* pRect, float x0, float y0, float x1, float y1)
+{
+    pRect->x0 = WD_MIN(x0, x1);
+    pRect->y0 = WD_MIN(y0, y1);
+    pRect->x1 = WD_MAX(x0, x1);
+    pRect->y1 = WD_MAX(y0, y1);
+}
+
+BOOL
+wd_bounds(WORD kind, void* obj, DWORD dw, const float* a, WD_RECT* pRect)
+{
+    float margin;
+
+    /* Strokes may reach beyond the outline by the half of the stroke width
+     * (a bit more with square caps), so we simply use the whole width. For
+     * shapes with sharp corners, miter joins may reach even further: The
+     * default miter limit is 10.0, i.e. 5 widths from the outline. */
+    switch(kind) {
+        case WD_CMD_DRAWARC:
+        case WD_CMD_DRAWELLIPSE:
+        case WD_CMD_DRAWLINE:
+            margin = a[kind == WD_CMD_DRAWARC ? 6 : 4];
+            break;
+        case WD_CMD_DRAWRECT:
+            margin = a[4];
+            break;
+        case WD_CMD_DRAWPIE:
+            margin = 5.0f * a[6];
+            break;
+        case WD_CMD_DRAWPATH:
+            margin = 5.0f * a[0];
+            break;
+        default:
+            margin = 0.0f;
+            break;
+    }
+
+    switch(kind) {
+        case WD_CMD_DRAWARC:
+        case WD_CMD_DRAWELLIPSE:
+        case WD_CMD_DRAWPIE:
+        case WD_CMD_FILLELLIPSE:
+        case WD_CMD_FILLPIE:
+            wd_set_bounds(pRect, a[0] - a[2], a[1] - a[3], a[0] + a[2], a[1] + a[3]);
+            break;
+
+        case WD_CMD_DRAWLINE:
+        case WD_CMD_DRAWRECT:
+        case WD_CMD_FILLRECT:
+            wd_set_bounds(pRect, a[0], a[1], a[2], a[3]);
+            break;
+
+        case WD_CMD_DRAWPATH:
+        case WD_CMD_FILLPATH:
+            if(!wdGetPathBounds((WD_HPATH) obj, pRect))
+                return FALSE;
+            break;
+
+        case WD_CMD_FILLPATHMASK:
+            if(d2d_enabled()) {
+                d2d_pathmask_t* mask = (d2d_pathmask_t*) obj;
+                pRect->x0 = mask->rect.left;
+                pRect->y0 = mask->rect.top;
+                pRect->x1 = mask->rect.right;
+                pRect->y1 = mask->rect.bottom;
+            } else {
+                if(!wdGetPathBounds((WD_HPATH) obj, pRect))
+                    return FALSE;
+            }
+            pRect->x0 += a[0];
+            pRect->y0 += a[1];
+            pRect->x1 += a[0];
+            pRect->y1 += a[1];
+            break;
+
+        case WD_CMD_BITBLTIMAGE:
+        case WD_CMD_BITBLTHICON:
+            wd_set_bounds(pRect, a[0], a[1], a[2], a[3]);
+            break;
+
+        case WD_CMD_BITBLTCACHED:
+            if(d2d_enabled()) {
+                c_D2D1_SIZE_U sz;
+
+                c_ID2D1Bitmap_GetPixelSize((c_ID2D1Bitmap*) obj, &sz);
+                pRect->x0 = a[0];
+                pRect->y0 = a[1];
+                pRect->x1 = a[0] + (float) sz.width;
+                pRect->y1 = a[1] + (float) sz.height;
+            } else {
+                /* GDI+ provides no way to ask the cached bitmap for its size. */
+                return FALSE;
+            }
+            break;
+
+        case WD_CMD_DRAWSTRING:
+            if(dw & WD_STR_NOCLIP)
+                return FALSE;
+            wd_set_bounds(pRect, a[0], a[1], a[2], a[3]);
+            break;
+
+        case WD_CMD_DRAWTEXTLAYOUT:
+            if(!wd_textlayout_bounds((WD_HTEXTLAYOUT) obj, a[0], a[1], pRect))
+                return FALSE;
+            break;
+
+        case WD_CMD_DRAWGLYPHRUN:
+        {
+            WD_FONTMETRICS fm;
+
+            /* a[0], a[1] is the origin on the base line; a[2] the sum of the
+             * advances. Allow some overhang of the glyphs (e.g. italics). */
+            wdFontMetrics((WD_HFONT) obj, &fm);
+            wd_set_bounds(pRect, a[0] - 0.5f * fm.fEmHeight, a[1] - fm.fAscent,
+                          a[0] + a[2] + 0.5f * fm.fEmHeight, a[1] + fm.fDescent);
+            break;
+        }
+
+        default:
+            /* Clear, mesh (not queryable), nested display list etc. */
+            return FALSE;
+    }
+
+    pRect->x0 -= margin;
+    pRect->y0 -= margin;
+    pRect->x1 += margin;
+    pRect->y1 += margin;
+    return TRUE;
+}
+
+BOOL
+wd_cmd_bounds(const wd_cmd_t* cmd, WD_RECT* pRect)
+{
+    if(cmd->kind == WD_CMD_FILLINSTANCES) {
+        const WD_INSTANCE* inst = (const WD_INSTANCE*) cmd->data;
+        WD_RECT path_rect;
+        WD_RECT r;
+        int i;
+
+        /* Union of the path bounds as transformed for each instance. */
+        if(cmd->len <= 0  ||  !wdGetPathBounds((WD_HPATH) cmd->obj, &path_rect))
+            return FALSE;
+        for(i = 0; i < cmd->len; i++) {
+            wd_cull_transform_rect(&inst[i].matrix, &path_rect, &r);
+            if(i == 0) {
+                memcpy(pRect, &r, sizeof(WD_RECT));
+            } else {
+                pRect->x0 = WD_MIN(pRect->x0, r.x0);
+                pRect->y0 = WD_MIN(pRect->y0, r.y0);
+                pRect->x1 = WD_MAX(pRect->x1, r.x1);
+                pRect->y1 = WD_MAX(pRect->y1, r.y1);
+            }
+        }
+        return TRUE;
+    }
+
+    return wd_bounds(cmd->kind, cmd->obj, cmd->dw, cmd->a, pRect);
+}
+
+static WD_HBRUSH
+wd_hook_solid_brush(WD_HCANVAS hCanvas, WD_HBRUSH fallback, WD_COLOR color)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+
+    if(hook == NULL)
+        return fallback;
+
+    if(hook->solid == NULL) {
+        hook->solid = wd_brush_create_solid(hCanvas, color);
+        if(hook->solid == NULL) {
+            WD_TRACE("wd_hook_solid_brush: wd_brush_create_solid() failed.");
+            return fallback;
+        }
+        hook->solid_color = color;
+    } else if(hook->solid_color != color) {
+        wd_brush_set_solid_color(hook->solid, color);
+        hook->solid_color = color;
+    }
+
+    return hook->solid;
+}
+
+void
+wd_cmd_execute(WD_HCANVAS hCanvas, const wd_cmd_t* cmd)
+{
+    const float* a = cmd->a;
+    const WD_RECT* rect = (cmd->flags & WD_CMDFLAG_HASRECT) ? (const WD_RECT*) &a[0] : NULL;
+    const WD_RECT* src_rect = (cmd->flags & WD_CMDFLAG_HASSRCRECT) ? (const WD_RECT*) &a[4] : NULL;
+    const WD_MATRIX* matrix = (cmd->flags & WD_CMDFLAG_HASMATRIX) ? (const WD_MATRIX*) &a[0] : NULL;
+    WD_HBRUSH b = (WD_HBRUSH) cmd->brush;
+    WD_HSTROKESTYLE s = (WD_HSTROKESTYLE) cmd->style;
+
+    /* The brush of the application may have changed its color, or it may be
+     * even destroyed, since the call has been made. */
+    if(cmd->flags & WD_CMDFLAG_SOLIDCOLOR)
+        b = wd_hook_solid_brush(hCanvas, b, cmd->color);
+
+    switch(cmd->kind) {
+        case WD_CMD_CLEAR:
+            wdClear(hCanvas, (WD_COLOR) cmd->dw);
+            break;
+        case WD_CMD_SETCLIP:
+            wdSetClip(hCanvas, rect, (WD_HPATH) cmd->obj);
+            break;
+        case WD_CMD_ROTATEWORLD:
+            wdRotateWorld(hCanvas, a[0], a[1], a[2]);
+            break;
+        case WD_CMD_TRANSLATEWORLD:
+            wdTranslateWorld(hCanvas, a[0], a[1]);
+            break;
+        case WD_CMD_TRANSFORMWORLD:
+            wdTransformWorld(hCanvas, matrix);
+            break;
+        case WD_CMD_RESETWORLD:
+            wdResetWorld(hCanvas);
+            break;
+        case WD_CMD_DRAWARC:
+            wdDrawEllipseArcStyled(hCanvas, b, a[0], a[1], a[2], a[3], a[4], a[5], a[6], s);
+            break;
+        case WD_CMD_DRAWELLIPSE:
+            wdDrawEllipseStyled(hCanvas, b, a[0], a[1], a[2], a[3], a[4], s);
+            break;
+        case WD_CMD_DRAWLINE:
+            wdDrawLineStyled(hCanvas, b, a[0], a[1], a[2], a[3], a[4], s);
+            break;
+        case WD_CMD_DRAWPATH:
+            wdDrawPathStyled(hCanvas, b, (WD_HPATH) cmd->obj, a[0], s);
+            break;
+        case WD_CMD_DRAWPIE:
+            wdDrawEllipsePieStyled(hCanvas, b, a[0], a[1], a[2], a[3], a[4], a[5], a[6], s);
+            break;
+        case WD_CMD_DRAWRECT:
+            wdDrawRectStyled(hCanvas, b, a[0], a[1], a[2], a[3], a[4], s);
+            break;
+        case WD_CMD_FILLELLIPSE:
+            wdFillEllipse(hCanvas, b, a[0], a[1], a[2], a[3]);
+            break;
+        case WD_CMD_FILLPATH:
+            wdFillPath(hCanvas, b, (WD_HPATH) cmd->obj);
+            break;
+        case WD_CMD_FILLMESH:
+            wdFillMesh(hCanvas, b, (WD_HMESH) cmd->obj);
+            break;
+        case WD_CMD_FILLPATHMASK:
+            wdFillCachedPathMask(hCanvas, b, (WD_HCACHEDPATHMASK) cmd->obj, a[0], a[1]);
+            break;
+        case WD_CMD_FILLPIE:
+            wdFillEllipsePie(hCanvas, b, a[0], a[1], a[2], a[3], a[4], a[5]);
+            break;
+        case WD_CMD_FILLRECT:
+            wdFillRect(hCanvas, b, a[0], a[1], a[2], a[3]);
+            break;
+        case WD_CMD_BITBLTIMAGE:
+            wdBitBltImage(hCanvas, (WD_HIMAGE) cmd->obj, rect, src_rect);
+            break;
+        case WD_CMD_BITBLTCACHED:
+            wdBitBltCachedImage(hCanvas, (WD_HCACHEDIMAGE) cmd->obj, a[0], a[1]);
+            break;
+        case WD_CMD_BITBLTHICON:
+            wdBitBltHICON(hCanvas, (HICON) cmd->obj, rect, src_rect);
+            break;
+        case WD_CMD_DRAWSTRING:
+            wdDrawString(hCanvas, (WD_HFONT) cmd->obj, rect,
+                    (const WCHAR*) cmd->data, cmd->len, b, cmd->dw);
+            break;
+        case WD_CMD_REPLAY:
+            wdReplayDisplayList(hCanvas, (WD_HDISPLAYLIST) cmd->obj, matrix);
+            break;
+        case WD_CMD_FILLINSTANCES:
+            wdFillPathInstances(hCanvas, (WD_HPATH) cmd->obj,
+                    (const WD_INSTANCE*) cmd->data, (UINT) cmd->len);
+            break;
+        case WD_CMD_DRAWTEXTLAYOUT:
+            wdDrawTextLayout(hCanvas, (WD_HTEXTLAYOUT) cmd->obj, a[0], a[1], b);
+            break;
+        case WD_CMD_DRAWGLYPHRUN:
+        {
+            const float* advances = (const float*) cmd->data;
+            const UINT16* glyphs = (const UINT16*) (advances + cmd->len);
+
+            wdDrawGlyphRun(hCanvas, (WD_HFONT) cmd->obj, a[0], a[1],
+                    glyphs, advances, (UINT) cmd->len, b);
+            break;
+        }
+        default:
+            WD_TRACE("wd_cmd_execute: Unknown command kind %u.", (unsigned) cmd->kind);
+            break;
+    }
+}
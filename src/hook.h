@@ -0,0 +1,263 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_HOOK_H
+#define WD_HOOK_H
+
+#include "misc.h"
+
+
+/* Canvas hook
+ * ===========
+ *
+ * Some features (e.g. display list recording) need to intercept the drawing
+ * calls made on a canvas. To allow that, both d2d_canvas_t and gdix_canvas_t
+ * have a pointer to wd_hook_t as their very first member, so it can be
+ * reached without knowing the back-end. The pointer is NULL unless some such
+ * feature is active on the canvas, so the cost for the normal case is just
+ * one test of a pointer.
+ *
+ * When hooked, each drawing function describes the call as wd_cmd_t and
+ * passes it to wd_hook_cmd(). If that returns TRUE, the call has been
+ * consumed and the function returns without painting anything.
+ */
+
+
+/* Command kinds. */
+#define WD_CMD_CLEAR            1
+#define WD_CMD_SETCLIP          2
+#define WD_CMD_ROTATEWORLD      3
+#define WD_CMD_TRANSLATEWORLD   4
+#define WD_CMD_TRANSFORMWORLD   5
+#define WD_CMD_RESETWORLD       6
+#define WD_CMD_DRAWARC          7
+#define WD_CMD_DRAWELLIPSE      8
+#define WD_CMD_DRAWLINE         9
+#define WD_CMD_DRAWPATH         10
+#define WD_CMD_DRAWPIE          11
+#define WD_CMD_DRAWRECT         12
+#define WD_CMD_FILLELLIPSE      13
+#define WD_CMD_FILLPATH         14
+#define WD_CMD_FILLMESH         15
+#define WD_CMD_FILLPATHMASK     16
+#define WD_CMD_FILLPIE          17
+#define WD_CMD_FILLRECT         18
+#define WD_CMD_BITBLTIMAGE      19
+#define WD_CMD_BITBLTCACHED     20
+#define WD_CMD_BITBLTHICON      21
+#define WD_CMD_DRAWSTRING       22
+#define WD_CMD_REPLAY           23
+#define WD_CMD_FILLINSTANCES    24
+#define WD_CMD_DRAWTEXTLAYOUT   25
+#define WD_CMD_DRAWGLYPHRUN     26
+
+/* Command flags. */
+#define WD_CMDFLAG_HASRECT      0x0001  /* a[0..3] is a clip/destination rect. */
+#define WD_CMDFLAG_HASSRCRECT   0x0002  /* a[4..7] is a source rect. */
+#define WD_CMDFLAG_HASMATRIX    0x0004  /* a[0..5] is a matrix. */
+#define WD_CMDFLAG_SOLIDCOLOR   0x0008  /* color is the solid brush color. */
+
+/* Description of a single drawing call. The meaning of the members depends
+ * on the kind:
+ *  - brush, style: The brush and the stroke style (if applicable).
+ *  - obj: Path, mesh, image, font, text layout, display list etc. (if
+ *    applicable).
+ *  - dw: Color for WD_CMD_CLEAR; flags for WD_CMD_DRAWSTRING.
+ *  - color: Color of the solid brush as it has been at the time of the call
+ *    (only with WD_CMDFLAG_SOLIDCOLOR, see wd_cmd_capture()).
+ *  - data, len: The text for WD_CMD_DRAWSTRING; the WD_INSTANCE array for
+ *    WD_CMD_FILLINSTANCES; len advances (floats) followed by len glyph
+ *    indices (UINT16) for WD_CMD_DRAWGLYPHRUN.
+ *  - a[]: The float arguments, in the order of the respective function.
+ */
+typedef struct wd_cmd_tag wd_cmd_t;
+struct wd_cmd_tag {
+    WORD kind;
+    WORD flags;
+    DWORD dw;
+    int len;
+    WD_COLOR color;
+    void* brush;
+    void* style;
+    void* obj;
+    const void* data;
+    float a[8];
+};
+
+typedef struct wd_dlist_tag wd_dlist_t;
+typedef struct wd_defer_tag wd_defer_t;
+typedef struct wd_framediff_tag wd_framediff_t;
+
+typedef struct wd_hook_tag wd_hook_t;
+struct wd_hook_tag {
+    WD_HCANVAS canvas;
+    UINT busy;                  /* Nesting level of wd_hook_enter(). */
+    wd_dlist_t* recording;      /* Non-NULL between wdBeginRecording() and wdEndRecording(). */
+    wd_defer_t* defer;          /* Non-NULL for WD_CANVAS_DEFERRED. */
+    wd_framediff_t* framediff;  /* Non-NULL for WD_CANVAS_FRAMEDIFF. */
+    BOOL trace;                 /* Canvas created while tracing (see apitrace.h). */
+
+    /* Private solid brush to paint calls with WD_CMDFLAG_SOLIDCOLOR. */
+    WD_HBRUSH solid;
+    WD_COLOR solid_color;
+
+    /* Buffer for wd_hook_scratch(). */
+    void* scratch;
+    UINT scratch_size;
+
+    /* Objects used by the calls held back (see wd_hook_hold()). */
+    wd_hook_t* held_next;
+    BOOL held;
+    DWORD held_thread;
+    DWORD held_filter[8];
+};
+
+
+static inline wd_hook_t*
+wd_canvas_hook(WD_HCANVAS hCanvas)
+{
+    return *(wd_hook_t**) hCanvas;
+}
+
+static inline BOOL
+wd_hooked(WD_HCANVAS hCanvas)
+{
+    return (wd_canvas_hook(hCanvas) != NULL);
+}
+
+static inline void
+wd_cmd_init(wd_cmd_t* cmd, WORD kind)
+{
+    memset(cmd, 0, sizeof(wd_cmd_t));
+    cmd->kind = kind;
+}
+
+/* Size (in bytes) of the data the command refers to. */
+static inline UINT
+wd_cmd_data_size(const wd_cmd_t* cmd)
+{
+    if(cmd->data == NULL  ||  cmd->len <= 0)
+        return 0;
+
+    switch(cmd->kind) {
+        case WD_CMD_DRAWSTRING:     return cmd->len * sizeof(WCHAR);
+        case WD_CMD_FILLINSTANCES:  return cmd->len * sizeof(WD_INSTANCE);
+        case WD_CMD_DRAWGLYPHRUN:   return cmd->len * (sizeof(float) + sizeof(UINT16));
+        default:                    return 0;
+    }
+}
+
+/* Get the hook of the canvas, creating it if it does not exist yet. */
+wd_hook_t* wd_hook_acquire(WD_HCANVAS hCanvas);
+
+/* Free the hook of the canvas if no feature uses it anymore. */
+void wd_hook_release(WD_HCANVAS hCanvas);
+
+/* Called when destroying the canvas. */
+void wd_hook_destroy(WD_HCANVAS hCanvas);
+
+/* Between these two, the calls on the canvas are not intercepted. This is
+ * used when the hook itself needs to really paint something (e.g. when
+ * replaying a display list) and by functions implemented on top of other
+ * public functions to avoid seeing the same call twice. */
+static inline void
+wd_hook_enter(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+    if(hook != NULL)
+        hook->busy++;
+}
+
+static inline void
+wd_hook_leave(WD_HCANVAS hCanvas)
+{
+    wd_hook_t* hook = wd_canvas_hook(hCanvas);
+    if(hook != NULL)
+        hook->busy--;
+}
+
+/* Offer the call to the hook. Returns TRUE if the call has been consumed. */
+BOOL wd_hook_cmd(WD_HCANVAS hCanvas, wd_cmd_t* cmd);
+
+/* Get a buffer of at least the given size, for packing the data of a call
+ * before passing it to wd_hook_cmd() (which copies whatever it keeps). The
+ * buffer is owned by the hook and reused by the next call, so it must not be
+ * used while the hook is busy. Returns NULL on failure. */
+void* wd_hook_scratch(WD_HCANVAS hCanvas, UINT size);
+
+/* Convenience wrappers of wd_hook_cmd(). */
+BOOL wd_hook(WD_HCANVAS hCanvas, WORD kind, void* brush, void* style,
+             void* obj, const float* args, UINT n_args);
+BOOL wd_hook_rects(WD_HCANVAS hCanvas, WORD kind, void* obj,
+                   const WD_RECT* rect, const WD_RECT* src_rect);
+BOOL wd_hook_string(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
+                    const WCHAR* pszText, int iTextLength, WD_HBRUSH hBrush,
+                    DWORD dwFlags);
+
+/* Paint anything the hook may be holding back (see WD_CANVAS_DEFERRED). */
+void wd_hook_flush(WD_HCANVAS hCanvas);
+
+/* Remember the color of the solid brush of the call (if it uses one), so it
+ * can be painted later even if the application changes the color or destroys
+ * the brush meanwhile. */
+void wd_cmd_capture(wd_cmd_t* cmd);
+
+/* Features which hold the calls back to paint them later call wd_hook_hold()
+ * for each such call, and wd_hook_unhold() when they no longer hold any.
+ * When any object used by the held calls is about to be destroyed or changed
+ * in place, wd_hook_object_changing() makes them paint the held calls first
+ * (see wd_hook_flush()). */
+void wd_hook_hold(WD_HCANVAS hCanvas, const wd_cmd_t* cmd);
+void wd_hook_unhold(WD_HCANVAS hCanvas);
+void wd_hook_object_changing(const void* obj);
+
+/* Get the bounding box of what the command may paint, in the coordinates of
+ * the current world transformation. Returns FALSE if the box is not known,
+ * i.e. the command has to be assumed to paint anywhere.
+ *
+ * The box does not include the anti-aliasing margin. That is one device
+ * pixel, so the caller has to add it in device space (or see
+ * wd_cull_aa_margin()). */
+BOOL wd_cmd_bounds(const wd_cmd_t* cmd, WD_RECT* pRect);
+
+/* The same for a command given by its members (see wd_cmd_t). This allows
+ * to get the bounds of a call without setting up whole wd_cmd_t. */
+BOOL wd_bounds(WORD kind, void* obj, DWORD dw, const float* a, WD_RECT* pRect);
+
+/* Perform the command on the canvas (by calling the respective public
+ * function). */
+void wd_cmd_execute(WD_HCANVAS hCanvas, const wd_cmd_t* cmd);
+
+/* Get/set the complete transformation of the canvas, including any implicit
+ * parts of it (like the one for WD_CANVAS_LAYOUTRTL). */
+void wd_canvas_get_transform(WD_HCANVAS hCanvas, WD_MATRIX* pMatrix);
+void wd_canvas_set_transform(WD_HCANVAS hCanvas, const WD_MATRIX* pMatrix);
+
+/* Each canvas gets a unique serial number when created. Unlike the handle,
+ * which may be reused by a new canvas once the old one is destroyed, it can
+ * be used as a key of per-canvas caches. */
+UINT wd_canvas_new_serial(void);
+UINT wd_canvas_serial(WD_HCANVAS hCanvas);
+
+
+#endif  /* WD_HOOK_H */
@@ -27,6 +27,54 @@
 #include "backend-gdix.h"
 #include "lock.h"
 #include "memstream.h"
+#include "apitrace.h"
+#include "hook.h"
+
+
+/* If the GDI+ image has an alpha channel but all its pixels are fully opaque,
+ * replace it with a 32bppRGB copy so that wdIsImageOpaque() and the painting
+ * code can take advantage of it. Otherwise the image is returned untouched. */
+static c_GpImage*
+image_gdix_tag_opaque(c_GpImage* img)
+{
+    c_GpBitmapData data;
+    c_GpRectI rect;
+    c_GpBitmap* clone;
+    UINT w, h;
+    BOOL opaque;
+    int status;
+
+    if(gdix_image_is_opaque(img))
+        return img;
+
+    gdix_vtable->fn_GetImageWidth(img, &w);
+    gdix_vtable->fn_GetImageHeight(img, &h);
+    rect.x = 0;
+    rect.y = 0;
+    rect.w = w;
+    rect.h = h;
+
+    /* This fails for metafiles. That's fine, we just keep them as they are. */
+    status = gdix_vtable->fn_BitmapLockBits((c_GpBitmap*) img, &rect,
+                c_ImageLockModeRead, c_PixelFormat32bppARGB, &data);
+    if(status != 0)
+        return img;
+    opaque = wd_alpha_is_opaque((const BYTE*) data.Scan0, data.Stride, w, h);
+    gdix_vtable->fn_BitmapUnlockBits((c_GpBitmap*) img, &data);
+    if(!opaque)
+        return img;
+
+    status = gdix_vtable->fn_CloneBitmapAreaI(0, 0, w, h,
+                c_PixelFormat32bppRGB, (c_GpBitmap*) img, &clone);
+    if(status != 0) {
+        WD_TRACE("image_gdix_tag_opaque: "
+                 "GdipCloneBitmapAreaI() failed. [%d]", status);
+        return img;
+    }
+
+    gdix_vtable->fn_DisposeImage(img);
+    return (c_GpImage*) clone;
+}
 
 
 WD_HIMAGE
@@ -70,6 +118,7 @@ wdCreateImageFromHBITMAPWithAlpha(HBITMAP hBmp, int alphaMode)
 
         IWICBitmap_Release(bitmap);
 
+        wd_apitrace_image((WD_HIMAGE) converted_bitmap, 0, 0, 0, NULL, 0, NULL, 0);
         return (WD_HIMAGE) converted_bitmap;
     } else {
         c_GpBitmap* b;
@@ -90,6 +139,7 @@ wdCreateImageFromHBITMAPWithAlpha(HBITMAP hBmp, int alphaMode)
                             (alphaMode == WD_ALPHA_USE_PREMULTIPLIED));
         }
 
+        wd_apitrace_image((WD_HIMAGE) b, 0, 0, 0, NULL, 0, NULL, 0);
         return (WD_HIMAGE) b;
     }
 }
@@ -131,6 +181,7 @@ wdLoadImageFromFile(const WCHAR* pszPath)
 err_GetFrame:
         IWICBitmapDecoder_Release(decoder);
 err_CreateDecoderFromFilename:
+        wd_apitrace_image((WD_HIMAGE) converted_bitmap, 0, 0, 0, NULL, 0, NULL, 0);
         return (WD_HIMAGE) converted_bitmap;
     } else {
         c_GpImage* img;
@@ -143,6 +194,9 @@ err_CreateDecoderFromFilename:
             return NULL;
         }
 
+        img = image_gdix_tag_opaque(img);
+
+        wd_apitrace_image((WD_HIMAGE) img, 0, 0, 0, NULL, 0, NULL, 0);
         return (WD_HIMAGE) img;
     }
 }
@@ -184,6 +238,7 @@ wdLoadImageFromIStream(IStream* pStream)
 err_GetFrame:
         IWICBitmapDecoder_Release(decoder);
 err_CreateDecoderFromFilename:
+        wd_apitrace_image((WD_HIMAGE) converted_bitmap, 0, 0, 0, NULL, 0, NULL, 0);
         return (WD_HIMAGE) converted_bitmap;
     } else {
         c_GpImage* img;
@@ -196,6 +251,9 @@ err_CreateDecoderFromFilename:
             return NULL;
         }
 
+        img = image_gdix_tag_opaque(img);
+
+        wd_apitrace_image((WD_HIMAGE) img, 0, 0, 0, NULL, 0, NULL, 0);
         return (WD_HIMAGE) img;
     }
 }
@@ -226,6 +284,9 @@ wdLoadImageFromResource(HINSTANCE hInstance, const WCHAR* pszResType,
 void
 wdDestroyImage(WD_HIMAGE hImage)
 {
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYIMAGE, hImage);
+    wd_hook_object_changing(hImage);
+
     if(d2d_enabled()) {
         IWICBitmapSource_Release((IWICBitmapSource*) hImage);
     } else {
@@ -252,6 +313,26 @@ wdGetImageSize(WD_HIMAGE hImage, UINT* puWidth, UINT* puHeight)
     }
 }
 
+BOOL
+wdIsImageOpaque(WD_HIMAGE hImage)
+{
+    if(d2d_enabled()) {
+        GUID pixel_format;
+        HRESULT hr;
+
+        hr = IWICBitmapSource_GetPixelFormat((IWICBitmapSource*) hImage, &pixel_format);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdIsImageOpaque: "
+                        "IWICBitmapSource::GetPixelFormat() failed.");
+            return FALSE;
+        }
+
+        return !wic_format_has_alpha(&pixel_format);
+    } else {
+        return gdix_image_is_opaque((c_GpImage*) hImage);
+    }
+}
+
 
 #define RAW_BUFFER_FLAG_BOTTOMUP            0x0001
 #define RAW_BUFFER_FLAG_HASALPHA            0x0002
@@ -351,6 +432,22 @@ wdCreateImageFromBuffer(UINT uWidth, UINT uHeight, UINT srcStride, const BYTE* p
     UINT dstStride = 0;
     IWICBitmapLock *bitmap_lock = NULL;
     c_GpBitmapData bitmapData;
+    BOOL opaque;
+
+    /* Find out whether we may use a pixel format without alpha channel. Note
+     * all the 4-byte input formats have the alpha in the 4th byte, and the
+     * bottom-up order does not matter for the check. */
+    switch(pixelFormat) {
+        case WD_PIXELFORMAT_PALETTE:
+        case WD_PIXELFORMAT_R8G8B8:
+            opaque = TRUE;
+            break;
+
+        default:
+            opaque = wd_alpha_is_opaque(pBuffer,
+                        (srcStride != 0 ? srcStride : uWidth * 4), uWidth, uHeight);
+            break;
+    }
 
     if (d2d_enabled()) {
         IWICBitmap* bitmap = NULL;
@@ -364,9 +461,11 @@ wdCreateImageFromBuffer(UINT uWidth, UINT uHeight, UINT srcStride, const BYTE* p
         }
 
         /* wic_pixel_format is GUID_WICPixelFormat32bppPBGRA;
-         * i.e. pre-multiplied alpha, BGRA order */
+         * i.e. pre-multiplied alpha, BGRA order. wic_pixel_format_opaque has
+         * the same layout, only the alpha is ignored. */
         hr = IWICImagingFactory_CreateBitmap(wic_factory, uWidth, uHeight,
-                                &wic_pixel_format, WICBitmapCacheOnDemand, &bitmap);
+                                (opaque ? &wic_pixel_format_opaque : &wic_pixel_format),
+                                WICBitmapCacheOnDemand, &bitmap);
         if(FAILED(hr)) {
             WD_TRACE_HR("wdCreateImageFromBuffer: "
                         "IWICImagingFactory::CreateBitmap() failed.");
@@ -390,8 +489,10 @@ wdCreateImageFromBuffer(UINT uWidth, UINT uHeight, UINT srcStride, const BYTE* p
         c_GpBitmap *bitmap = NULL;
         c_GpRectI rect = { 0, 0, uWidth, uHeight };
 
-        if (pixelFormat == WD_PIXELFORMAT_R8G8B8 || pixelFormat == WD_PIXELFORMAT_PALETTE)
-            format = c_PixelFormat24bppRGB;
+        /* Note we always write 4 bytes per pixel (see below), so we must not
+         * use c_PixelFormat24bppRGB here. */
+        if (opaque)
+            format = c_PixelFormat32bppRGB;
         else if (pixelFormat == WD_PIXELFORMAT_R8G8B8A8)
             format = c_PixelFormat32bppARGB;
         else
@@ -447,5 +548,7 @@ wdCreateImageFromBuffer(UINT uWidth, UINT uHeight, UINT srcStride, const BYTE* p
         gdix_vtable->fn_BitmapUnlockBits((c_GpBitmap*) b, &bitmapData);
     }
 
+    wd_apitrace_image(b, uWidth, uHeight, srcStride, pBuffer, pixelFormat,
+                      cPalette, uPaletteSize);
     return b;
 }
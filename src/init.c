@@ -27,6 +27,7 @@
 #include "backend-wic.h"
 #include "backend-gdix.h"
 #include "lock.h"
+#include "apitrace.h"
 
 
 void (*wd_fn_lock)(void) = NULL;
@@ -96,18 +97,19 @@ wd_init_string_api(void)
     if(d2d_enabled()) {
         return dwrite_init();
     } else {
-        /* noop */
-        return 0;
+        return gdix_measure_init();
     }
 }
 
 static void
 wd_fini_string_api(void)
 {
+    wd_font_cache_fini();
+
     if(d2d_enabled()) {
         dwrite_fini();
     } else {
-        /* noop */
+        gdix_measure_fini();
     }
 }
 
@@ -154,6 +156,7 @@ wdInitialize(DWORD dwFlags)
     }
 
     wd_unlock();
+    wd_apitrace_autostart();
     return TRUE;
 
 fail:
@@ -207,6 +210,9 @@ wdTerminate(DWORD dwFlags)
     }
 
     wd_unlock();
+
+    if(wd_init_counter[WD_MOD_COREAPI] == 0)
+        wd_apitrace_autostop();
 }
 
 int
@@ -0,0 +1,272 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "intern.h"
+#include "backend-d2d.h"
+#include "backend-gdix.h"
+
+
+struct wd_intern_entry_tag {
+    wd_intern_entry_t* next_by_key;
+    wd_intern_entry_t* next_by_obj;
+    void* obj;
+    UINT32 hash;
+    UINT refs;
+    UINT stamp;     /* When it has become idle (for the LRU eviction). */
+    UINT key_size;
+    BYTE key[1];    /* Actually key_size bytes. */
+};
+
+
+/* FNV-1a */
+static UINT32
+wd_intern_hash(const void* key, UINT key_size)
+{
+    const BYTE* bytes = (const BYTE*) key;
+    UINT32 hash = 2166136261U;
+    UINT i;
+
+    for(i = 0; i < key_size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static inline UINT
+wd_intern_obj_bucket(void* obj)
+{
+    return (UINT) (((UINT_PTR) obj >> 4) % WD_INTERN_BUCKETS);
+}
+
+static void
+wd_intern_destroy_brush(void* obj)
+{
+    wdDestroyBrush((WD_HBRUSH) obj);
+}
+
+static void
+wd_intern_destroy_style(void* obj)
+{
+    wdDestroyStrokeStyle((WD_HSTROKESTYLE) obj);
+}
+
+static void
+wd_intern_destroy_stops(void* obj)
+{
+    c_ID2D1GradientStopCollection_Release((c_ID2D1GradientStopCollection*) obj);
+}
+
+static void
+wd_intern_remove(wd_intern_table_t* table, wd_intern_entry_t* e)
+{
+    wd_intern_entry_t** pp;
+
+    pp = &table->by_key[e->hash % WD_INTERN_BUCKETS];
+    while(*pp != e)
+        pp = &(*pp)->next_by_key;
+    *pp = e->next_by_key;
+
+    pp = &table->by_obj[wd_intern_obj_bucket(e->obj)];
+    while(*pp != e)
+        pp = &(*pp)->next_by_obj;
+    *pp = e->next_by_obj;
+
+    if(e->refs == 0)
+        table->n_idle--;
+
+    table->destroy(e->obj);
+    free(e);
+}
+
+/* Destroy the least recently used idle entries above the limit. */
+static void
+wd_intern_trim(wd_intern_table_t* table)
+{
+    while(table->n_idle > WD_INTERN_MAX_IDLE) {
+        wd_intern_entry_t* lru = NULL;
+        wd_intern_entry_t* e;
+        UINT i;
+
+        for(i = 0; i < WD_INTERN_BUCKETS; i++) {
+            for(e = table->by_key[i]; e != NULL; e = e->next_by_key) {
+                if(e->refs == 0  &&  (lru == NULL  ||  e->stamp < lru->stamp))
+                    lru = e;
+            }
+        }
+
+        wd_intern_remove(table, lru);
+    }
+}
+
+static void
+wd_intern_fini_table(wd_intern_table_t* table)
+{
+    wd_intern_entry_t* e;
+    UINT i;
+
+    for(i = 0; i < WD_INTERN_BUCKETS; i++) {
+        while(table->by_key[i] != NULL) {
+            e = table->by_key[i];
+            if(e->refs > 0) {
+                WD_TRACE("wd_intern_fini_table: Logical error: Shared resource still referenced.");
+                /* Make it idle, so wd_intern_remove() keeps n_idle consistent. */
+                e->refs = 0;
+                table->n_idle++;
+            }
+            wd_intern_remove(table, e);
+        }
+    }
+}
+
+wd_intern_t*
+wd_canvas_intern(WD_HCANVAS hCanvas)
+{
+    wd_intern_t** p_intern;
+
+    if(d2d_enabled())
+        p_intern = &((d2d_canvas_t*) hCanvas)->intern;
+    else
+        p_intern = &((gdix_canvas_t*) hCanvas)->intern;
+
+    if(*p_intern == NULL) {
+        wd_intern_t* intern;
+
+        intern = (wd_intern_t*) malloc(sizeof(wd_intern_t));
+        if(intern == NULL) {
+            WD_TRACE("wd_canvas_intern: malloc() failed.");
+            return NULL;
+        }
+
+        memset(intern, 0, sizeof(wd_intern_t));
+        intern->brushes.destroy = wd_intern_destroy_brush;
+        intern->styles.destroy = wd_intern_destroy_style;
+        intern->stops.destroy = wd_intern_destroy_stops;
+        *p_intern = intern;
+    }
+
+    return *p_intern;
+}
+
+void
+wd_intern_destroy(WD_HCANVAS hCanvas)
+{
+    wd_intern_t** p_intern;
+
+    if(d2d_enabled())
+        p_intern = &((d2d_canvas_t*) hCanvas)->intern;
+    else
+        p_intern = &((gdix_canvas_t*) hCanvas)->intern;
+
+    if(*p_intern == NULL)
+        return;
+
+    wd_intern_fini_table(&(*p_intern)->brushes);
+    wd_intern_fini_table(&(*p_intern)->styles);
+    wd_intern_fini_table(&(*p_intern)->stops);
+    free(*p_intern);
+    *p_intern = NULL;
+}
+
+void*
+wd_intern_lookup(wd_intern_table_t* table, const void* key, UINT key_size, BOOL bRef)
+{
+    UINT32 hash = wd_intern_hash(key, key_size);
+    wd_intern_entry_t* e;
+
+    for(e = table->by_key[hash % WD_INTERN_BUCKETS]; e != NULL; e = e->next_by_key) {
+        if(e->hash == hash  &&  e->key_size == key_size  &&
+           memcmp(e->key, key, key_size) == 0)
+        {
+            if(bRef) {
+                if(e->refs == 0)
+                    table->n_idle--;
+                e->refs++;
+            } else if(e->refs == 0) {
+                e->stamp = ++table->stamp;
+            }
+            return e->obj;
+        }
+    }
+
+    return NULL;
+}
+
+BOOL
+wd_intern_insert(wd_intern_table_t* table, const void* key, UINT key_size,
+                 void* obj, BOOL bRef)
+{
+    wd_intern_entry_t* e;
+    UINT i;
+
+    e = (wd_intern_entry_t*) malloc(WD_OFFSETOF(wd_intern_entry_t, key) + key_size);
+    if(e == NULL) {
+        WD_TRACE("wd_intern_insert: malloc() failed.");
+        return FALSE;
+    }
+
+    e->obj = obj;
+    e->hash = wd_intern_hash(key, key_size);
+    e->refs = (bRef ? 1 : 0);
+    e->stamp = ++table->stamp;
+    e->key_size = key_size;
+    memcpy(e->key, key, key_size);
+
+    i = e->hash % WD_INTERN_BUCKETS;
+    e->next_by_key = table->by_key[i];
+    table->by_key[i] = e;
+    i = wd_intern_obj_bucket(obj);
+    e->next_by_obj = table->by_obj[i];
+    table->by_obj[i] = e;
+
+    if(!bRef) {
+        table->n_idle++;
+        wd_intern_trim(table);
+    }
+    return TRUE;
+}
+
+BOOL
+wd_intern_release(wd_intern_table_t* table, void* obj)
+{
+    wd_intern_entry_t* e;
+
+    for(e = table->by_obj[wd_intern_obj_bucket(obj)]; e != NULL; e = e->next_by_obj) {
+        if(e->obj == obj) {
+            if(e->refs == 0) {
+                WD_TRACE("wd_intern_release: Logical error: Shared resource not referenced.");
+                return TRUE;
+            }
+            e->refs--;
+            if(e->refs == 0) {
+                e->stamp = ++table->stamp;
+                table->n_idle++;
+                wd_intern_trim(table);
+            }
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,90 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WD_INTERN_H
+#define WD_INTERN_H
+
+#include "misc.h"
+
+
+/* Resource interning
+ * ==================
+ *
+ * Applications often create the very same resources (e.g. a brush of some
+ * color) again and again in their paint code. To make that cheap, a canvas
+ * may keep tables of such resources keyed by their contents, so a repeated
+ * request just finds the existing object.
+ *
+ * Each entry has a reference count. The entries which are not referenced are
+ * still kept for a later reuse, but only up to WD_INTERN_MAX_IDLE of them per
+ * table; when there are more, the least recently used one is destroyed.
+ *
+ * (Some tables hold entries which are never referenced this way, e.g. the
+ * gradient stop collections of Direct2D: The brushes using them keep their
+ * own COM references, so the table is just a cache of them.)
+ */
+
+#define WD_INTERN_BUCKETS       64
+#define WD_INTERN_MAX_IDLE      64
+
+typedef struct wd_intern_entry_tag wd_intern_entry_t;
+
+typedef struct wd_intern_table_tag wd_intern_table_t;
+struct wd_intern_table_tag {
+    wd_intern_entry_t* by_key[WD_INTERN_BUCKETS];
+    wd_intern_entry_t* by_obj[WD_INTERN_BUCKETS];
+    void (*destroy)(void* obj);
+    UINT n_idle;
+    UINT stamp;
+};
+
+typedef struct wd_intern_tag wd_intern_t;
+struct wd_intern_tag {
+    wd_intern_table_t brushes;      /* Solid brushes, keyed by WD_COLOR. */
+    wd_intern_table_t styles;       /* Stroke styles. */
+    wd_intern_table_t stops;        /* Direct2D gradient stop collections. */
+};
+
+
+/* Get the tables of the canvas, creating them if they do not exist yet.
+ * (Returns NULL only on an allocation failure.) */
+wd_intern_t* wd_canvas_intern(WD_HCANVAS hCanvas);
+
+/* Called when destroying the canvas. */
+void wd_intern_destroy(WD_HCANVAS hCanvas);
+
+/* Find the object with the given key. If bRef is set, its reference count is
+ * incremented. Returns NULL if not found. */
+void* wd_intern_lookup(wd_intern_table_t* table, const void* key, UINT key_size, BOOL bRef);
+
+/* Add the object into the table, with the reference count 0 or 1. Returns
+ * FALSE on an allocation failure (the object is then not added). */
+BOOL wd_intern_insert(wd_intern_table_t* table, const void* key, UINT key_size,
+                      void* obj, BOOL bRef);
+
+/* Decrement the reference count of the object. Returns FALSE if the object
+ * is not in the table. */
+BOOL wd_intern_release(wd_intern_table_t* table, void* obj);
+
+
+#endif  /* WD_INTERN_H */
@@ -0,0 +1,133 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "misc.h"
+#include "backend-d2d.h"
+#include "backend-gdix.h"
+#include "apitrace.h"
+#include "hook.h"
+
+
+/* Default flattening tolerance (in DIPs) of Direct2D and GDI+. */
+#define MESH_FLATTENING_TOLERANCE       0.25f
+
+
+WD_HMESH
+wdCreateMeshFromPath(WD_HCANVAS hCanvas, const WD_HPATH hPath)
+{
+    UINT64 path = (UINT64) (UINT_PTR) hPath;
+    void* geometry;
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wdCreateMeshFromPath: wd_path_geometry() failed.");
+        return NULL;
+    }
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        c_ID2D1Geometry* g = (c_ID2D1Geometry*) geometry;
+        c_ID2D1Mesh* m;
+        c_ID2D1TessellationSink* sink;
+        HRESULT hr;
+
+        hr = c_ID2D1RenderTarget_CreateMesh(c->target, &m);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdCreateMeshFromPath: "
+                        "ID2D1RenderTarget::CreateMesh() failed.");
+            goto err_CreateMesh;
+        }
+
+        hr = c_ID2D1Mesh_Open(m, &sink);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdCreateMeshFromPath: ID2D1Mesh::Open() failed.");
+            goto err_Open;
+        }
+
+        hr = c_ID2D1Geometry_Tessellate(g, NULL, MESH_FLATTENING_TOLERANCE, sink);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdCreateMeshFromPath: "
+                        "ID2D1Geometry::Tessellate() failed.");
+            goto err_Tessellate;
+        }
+
+        hr = c_ID2D1TessellationSink_Close(sink);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdCreateMeshFromPath: "
+                        "ID2D1TessellationSink::Close() failed.");
+            goto err_Close;
+        }
+
+        c_ID2D1TessellationSink_Release(sink);
+        wd_apitrace_create(WD_APITRACE_OP_CREATEMESH, m, hCanvas,
+                           &path, sizeof(UINT64), NULL, 0, NULL, 0);
+        return (WD_HMESH) m;
+
+        /* Error path unwinding. */
+err_Close:
+err_Tessellate:
+        c_ID2D1TessellationSink_Release(sink);
+err_Open:
+        c_ID2D1Mesh_Release(m);
+err_CreateMesh:
+        return NULL;
+    } else {
+        /* GDI+ has no notion of a triangle mesh and filling the triangles one
+         * by one would be much slower than filling a polygon. So the mesh is
+         * just a clone of the path with all the curves already flattened into
+         * line segments. That saves the curve flattening on every fill. */
+        c_GpPath* p;
+        int status;
+
+        status = gdix_vtable->fn_ClonePath((c_GpPath*) geometry, &p);
+        if(status != 0) {
+            WD_TRACE("wdCreateMeshFromPath: GdipClonePath() failed. [%d]", status);
+            return NULL;
+        }
+
+        status = gdix_vtable->fn_FlattenPath(p, NULL, MESH_FLATTENING_TOLERANCE);
+        if(status != 0) {
+            WD_TRACE("wdCreateMeshFromPath: GdipFlattenPath() failed. [%d]", status);
+            gdix_vtable->fn_DeletePath(p);
+            return NULL;
+        }
+
+        wd_apitrace_create(WD_APITRACE_OP_CREATEMESH, p, hCanvas,
+                           &path, sizeof(UINT64), NULL, 0, NULL, 0);
+        return (WD_HMESH) p;
+    }
+}
+
+void
+wdDestroyMesh(WD_HMESH hMesh)
+{
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYMESH, hMesh);
+    wd_hook_object_changing(hMesh);
+
+    if(d2d_enabled()) {
+        c_ID2D1Mesh_Release((c_ID2D1Mesh*) hMesh);
+    } else {
+        gdix_vtable->fn_DeletePath((c_GpPath*) hMesh);
+    }
+}
@@ -105,3 +105,36 @@ wd_load_system_dll(const TCHAR* dll_name)
 
     return dll;
 }
+
+BOOL
+wd_alpha_is_opaque(const BYTE* buffer, int stride, UINT width, UINT height)
+{
+    /* Alpha bytes of two pixels in a 64-bit word. We AND 4 pixels at a time
+     * and look at the result only once per line: The lines are typically
+     * short enough so it is cheaper than bailing out early. */
+    const UINT64 mask = ((UINT64) 0xff000000 << 32) | (UINT64) 0xff000000;
+    UINT x, y;
+
+    for(y = 0; y < height; y++) {
+        const BYTE* p = buffer + (INT_PTR) y * stride;
+        UINT64 acc = mask;
+        UINT64 v0, v1;
+
+        for(x = 0; x + 4 <= width; x += 4) {
+            memcpy(&v0, p, sizeof(UINT64));
+            memcpy(&v1, p + 8, sizeof(UINT64));
+            acc &= v0 & v1;
+            p += 16;
+        }
+        for(; x < width; x++) {
+            if(p[3] != 0xff)
+                return FALSE;
+            p += 4;
+        }
+
+        if((acc & mask) != mask)
+            return FALSE;
+    }
+
+    return TRUE;
+}
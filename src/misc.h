@@ -77,6 +77,51 @@ static void no_log(const char* fmt, ...) {}
 /* Safer LoadLibrary() replacement for system DLLs. */
 HMODULE wd_load_system_dll(const TCHAR* dll_name);
 
+/* Get color of a brush created by wdCreateSolidBrush(). Returns FALSE for
+ * other brushes. */
+BOOL wd_brush_solid_color(WD_HBRUSH hBrush, WD_COLOR* color);
+
+/* The same as wdCreateSolidBrush(), wdSetSolidBrushColor() and
+ * wdDestroyBrush(), but for brushes used internally: They are not seen by the
+ * API trace nor by the canvas hooks. */
+WD_HBRUSH wd_brush_create_solid(WD_HCANVAS hCanvas, WD_COLOR color);
+void wd_brush_set_solid_color(WD_HBRUSH hBrush, WD_COLOR color);
+void wd_brush_destroy(WD_HBRUSH hBrush);
+
+/* Back-end dash styles (D2D1_DASH_STYLE and GpDashStyle share the values).
+ * Styles created by this library use only these two. */
+#define WD_STROKESTYLE_DASH_SOLID   0
+#define WD_STROKESTYLE_DASH_CUSTOM  5
+
+/* Create a stroke style with the given back-end dash style (0 to 5). */
+WD_HSTROKESTYLE wd_stroke_style_create(UINT dashStyle, const float* dashes,
+                UINT dashesCount, UINT lineCap, UINT lineJoin);
+
+/* Get the box the text layout paints into when painted at (x, y). Returns
+ * FALSE if it is not limited (WD_STR_NOCLIP). */
+BOOL wd_textlayout_bounds(WD_HTEXTLAYOUT hLayout, float x, float y, WD_RECT* pRect);
+
+/* Check whether all pixels of a 32-bit buffer (with alpha in the 4th byte of
+ * each pixel, as in BGRA and RGBA) are fully opaque. */
+BOOL wd_alpha_is_opaque(const BYTE* buffer, int stride, UINT width, UINT height);
+
+/* Get the back-end geometry of a path (ID2D1Geometry or GpPath), building
+ * it on first use. Returns NULL on failure. The geometry is owned by the path
+ * and lives until the path is destroyed or opened again. */
+void* wd_path_geometry(WD_HPATH hPath);
+
+/* Get the path rasterized into an opacity mask (d2d_pathmask_t) for the given
+ * (Direct2D) canvas, creating it on first use. Only one mask is cached per
+ * path: It is rebuilt when the path is used on another canvas, and it lives
+ * until the path is destroyed or opened again. Returns NULL on failure. */
+void* wd_path_mask(WD_HPATH hPath, WD_HCANVAS hCanvas);
+
+/* Process-wide font cache (see font.c). The fini function has to be called
+ * with the lock held, before the string back-end is uninitialized. */
+extern UINT font_cache_hits;
+extern UINT font_cache_misses;
+void wd_font_cache_fini(void);
+
 
 #ifdef _MSC_VER
     /* MSVC does not understand "inline" when building as pure C (not C++).
@@ -25,37 +25,624 @@
 #include "backend-d2d.h"
 #include "backend-gdix.h"
 #include "lock.h"
+#include "apitrace.h"
+#include "hook.h"
 
 
-WD_HPATH
-wdCreatePath(WD_HCANVAS hCanvas)
+/* Default flattening tolerance (in DIPs) of Direct2D and GDI+. */
+#define PATH_FLATTENING_TOLERANCE       0.25f
+
+/* Max. count of points passed to GDI+ at once when realizing the path. (A
+ * multiple of 3.) */
+#define PATH_GDIX_CHUNK                 255
+
+
+/* The figures of a path are recorded in a buffer of verbs (WD_PATHVERB_xxx)
+ * and points, independently of the back-end. The geometry of the back-end
+ * (ID2D1PathGeometry or GpPath) is built from the buffer only when it is
+ * needed for the first time (see wd_path_geometry()) and then cached.
+ *
+ * The buffer is reference-counted: wdClonePath() and wdCreateTransformedPath()
+ * make paths which share the buffer (and its geometry) with the source path.
+ * A transformed path only adds the matrix; its own geometry (with Direct2D an
+ * ID2D1TransformedGeometry wrapping the shared one) is cached separately.
+ * Before a path sharing its buffer is changed, it gets a private copy (see
+ * wd_path_writable()). */
+typedef struct path_data_tag path_data_t;
+struct path_data_tag {
+    LONG refs;
+    BYTE* verbs;
+    UINT n_verbs;
+    UINT alloc_verbs;
+    WD_POINT* points;
+    UINT n_points;
+    UINT alloc_points;
+    BOOL in_figure;         /* Last figure has not ended yet. */
+    void* geometry;         /* Cached back-end geometry, or NULL. */
+    BOOL has_bounds;        /* Is bounds up to date? */
+    WD_RECT bounds;
+};
+
+typedef struct path_tag path_t;
+struct path_tag {
+    path_data_t* data;
+    BOOL transformed;
+    WD_MATRIX matrix;       /* Only if transformed. */
+    void* geometry;         /* Cached transformed geometry, or NULL. */
+    BOOL has_bounds;        /* Only if transformed. */
+    WD_RECT bounds;
+    void* mask;             /* Cached mask (see wd_path_mask()), or NULL. */
+    UINT mask_canvas;       /* Serial of the canvas the mask is made for. */
+};
+
+
+static void
+path_free_geometry(void** p_geometry)
+{
+    if(*p_geometry == NULL)
+        return;
+
+    if(d2d_enabled())
+        c_ID2D1Geometry_Release((c_ID2D1Geometry*) *p_geometry);
+    else
+        gdix_vtable->fn_DeletePath((c_GpPath*) *p_geometry);
+    *p_geometry = NULL;
+}
+
+static void
+path_free_mask(path_t* path)
+{
+    if(path->mask == NULL)
+        return;
+
+    d2d_destroy_pathmask((d2d_pathmask_t*) path->mask);
+    path->mask = NULL;
+}
+
+/* Store the geometry into the cache, unless other thread has been faster.
+ * Returns the cached geometry. */
+static void*
+path_cache_geometry(void** p_geometry, void* geometry)
+{
+    wd_lock();
+    if(*p_geometry == NULL) {
+        *p_geometry = geometry;
+        geometry = NULL;
+    }
+    wd_unlock();
+
+    path_free_geometry(&geometry);
+    return *p_geometry;
+}
+
+static path_data_t*
+path_data_alloc(void)
+{
+    path_data_t* data;
+
+    data = (path_data_t*) malloc(sizeof(path_data_t));
+    if(data == NULL) {
+        WD_TRACE("path_data_alloc: malloc() failed.");
+        return NULL;
+    }
+
+    memset(data, 0, sizeof(path_data_t));
+    data->refs = 1;
+    return data;
+}
+
+static void
+path_data_unref(path_data_t* data)
 {
+    if(InterlockedDecrement(&data->refs) > 0)
+        return;
+
+    path_free_geometry(&data->geometry);
+    free(data->verbs);
+    free(data->points);
+    free(data);
+}
+
+/* Make room for the given count of more verbs and points. */
+static BOOL
+path_data_reserve(path_data_t* data, UINT n_verbs, UINT n_points)
+{
+    if(data->n_verbs + n_verbs > data->alloc_verbs) {
+        UINT alloc = WD_MAX(data->n_verbs + n_verbs, 2 * data->alloc_verbs);
+        BYTE* verbs;
+
+        alloc = WD_MAX(alloc, 16);
+        verbs = (BYTE*) realloc(data->verbs, alloc);
+        if(verbs == NULL) {
+            WD_TRACE("path_data_reserve: realloc() failed.");
+            return FALSE;
+        }
+        data->verbs = verbs;
+        data->alloc_verbs = alloc;
+    }
+
+    if(data->n_points + n_points > data->alloc_points) {
+        UINT alloc = WD_MAX(data->n_points + n_points, 2 * data->alloc_points);
+        WD_POINT* points;
+
+        alloc = WD_MAX(alloc, 16);
+        points = (WD_POINT*) realloc(data->points, alloc * sizeof(WD_POINT));
+        if(points == NULL) {
+            WD_TRACE("path_data_reserve: realloc() failed.");
+            return FALSE;
+        }
+        data->points = points;
+        data->alloc_points = alloc;
+    }
+
+    return TRUE;
+}
+
+static inline void
+path_transform_point(const WD_MATRIX* m, const WD_POINT* pt, WD_POINT* res)
+{
+    float x = pt->x;
+    float y = pt->y;
+
+    res->x = x * m->m11 + y * m->m21 + m->dx;
+    res->y = x * m->m12 + y * m->m22 + m->dy;
+}
+
+/* Get the buffer of the path ready for a change: Make sure it is not shared
+ * with other paths and it has no transformation pending, and forget the
+ * geometry built from it. */
+static path_data_t*
+path_writable(path_t* path)
+{
+    path_data_t* data = path->data;
+
+    if(data->refs > 1  ||  path->transformed) {
+        path_data_t* copy;
+        UINT i;
+
+        copy = path_data_alloc();
+        if(copy == NULL) {
+            WD_TRACE("path_writable: path_data_alloc() failed.");
+            return NULL;
+        }
+        if(!path_data_reserve(copy, data->n_verbs, data->n_points)) {
+            WD_TRACE("path_writable: path_data_reserve() failed.");
+            path_data_unref(copy);
+            return NULL;
+        }
+
+        memcpy(copy->verbs, data->verbs, data->n_verbs);
+        if(path->transformed) {
+            for(i = 0; i < data->n_points; i++)
+                path_transform_point(&path->matrix, &data->points[i],
+                                     &copy->points[i]);
+        } else {
+            memcpy(copy->points, data->points,
+                   data->n_points * sizeof(WD_POINT));
+        }
+        copy->n_verbs = data->n_verbs;
+        copy->n_points = data->n_points;
+        copy->in_figure = data->in_figure;
+
+        path_data_unref(data);
+        path_free_geometry(&path->geometry);
+        path->data = copy;
+        path->transformed = FALSE;
+        data = copy;
+    }
+
+    path_free_geometry(&data->geometry);
+    data->has_bounds = FALSE;
+    path_free_mask(path);
+    return data;
+}
+
+/* Get the count of the verbs of the same kind starting at i. */
+static inline UINT
+path_data_run(const path_data_t* data, UINT i)
+{
+    UINT n = 1;
+
+    while(i + n < data->n_verbs  &&  data->verbs[i + n] == data->verbs[i])
+        n++;
+    return n;
+}
+
+static c_ID2D1Geometry*
+path_build_d2d(const path_data_t* data)
+{
+    c_ID2D1PathGeometry* g;
+    c_ID2D1GeometrySink* s;
+    const WD_POINT* pts = data->points;
+    UINT i, n;
+    HRESULT hr;
+
+    wd_lock();
+    hr = c_ID2D1Factory_CreatePathGeometry(d2d_factory, &g);
+    wd_unlock();
+    if(FAILED(hr)) {
+        WD_TRACE_HR("path_build_d2d: "
+                    "ID2D1Factory::CreatePathGeometry() failed.");
+        goto err_CreatePathGeometry;
+    }
+
+    hr = c_ID2D1PathGeometry_Open(g, &s);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("path_build_d2d: ID2D1PathGeometry::Open() failed.");
+        goto err_Open;
+    }
+
+    /* The recorded figures are always well-formed (see path_add()), except
+     * that the last one may be left open. Each D2D1_BEZIER_SEGMENT is just
+     * three points, and D2D1_POINT_2F is the same as WD_POINT. */
+    for(i = 0; i < data->n_verbs; i += n) {
+        n = 1;
+        switch(data->verbs[i]) {
+            case WD_PATHVERB_BEGINFIGURE:
+                c_ID2D1GeometrySink_BeginFigure(s, *(const c_D2D1_POINT_2F*) pts,
+                        c_D2D1_FIGURE_BEGIN_FILLED);
+                pts++;
+                break;
+
+            case WD_PATHVERB_LINE:
+                n = path_data_run(data, i);
+                c_ID2D1GeometrySink_AddLines(s,
+                        (const c_D2D1_POINT_2F*) pts, n);
+                pts += n;
+                break;
+
+            case WD_PATHVERB_BEZIER:
+                n = path_data_run(data, i);
+                c_ID2D1GeometrySink_AddBeziers(s,
+                        (const c_D2D1_BEZIER_SEGMENT*) pts, n);
+                pts += 3 * n;
+                break;
+
+            case WD_PATHVERB_ENDFIGURE:
+                c_ID2D1GeometrySink_EndFigure(s, c_D2D1_FIGURE_END_OPEN);
+                break;
+
+            case WD_PATHVERB_CLOSEFIGURE:
+                c_ID2D1GeometrySink_EndFigure(s, c_D2D1_FIGURE_END_CLOSED);
+                break;
+        }
+    }
+    if(data->in_figure)
+        c_ID2D1GeometrySink_EndFigure(s, c_D2D1_FIGURE_END_OPEN);
+
+    hr = c_ID2D1GeometrySink_Close(s);
+    c_ID2D1GeometrySink_Release(s);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("path_build_d2d: ID2D1GeometrySink::Close() failed.");
+        goto err_Close;
+    }
+
+    return (c_ID2D1Geometry*) g;
+
+    /* Error path unwinding */
+err_Close:
+err_Open:
+    c_ID2D1PathGeometry_Release(g);
+err_CreatePathGeometry:
+    return NULL;
+}
+
+/* GDI+ has no idea where the current figure has started, so each chunk of
+ * the points has to begin with the current end point. */
+static void
+path_build_gdix_run(c_GpPath* p, BYTE verb, const WD_POINT* pts, UINT n_points,
+                    WD_POINT* end)
+{
+    c_GpPointF buf[PATH_GDIX_CHUNK + 1];
+    UINT i, n;
+
+    for(i = 0; i < n_points; i += n) {
+        n = WD_MIN(n_points - i, PATH_GDIX_CHUNK);
+        buf[0].x = end->x;
+        buf[0].y = end->y;
+        memcpy(buf + 1, pts + i, n * sizeof(c_GpPointF));
+        if(verb == WD_PATHVERB_LINE)
+            gdix_vtable->fn_AddPathLine2(p, buf, n + 1);
+        else
+            gdix_vtable->fn_AddPathBeziers(p, buf, n + 1);
+        memcpy(end, &pts[i + n - 1], sizeof(WD_POINT));
+    }
+}
+
+static c_GpPath*
+path_build_gdix(const path_data_t* data)
+{
+    c_GpPath* p;
+    const WD_POINT* pts = data->points;
+    WD_POINT end = { 0.0f, 0.0f };
+    UINT i, n;
+    int status;
+
+    status = gdix_vtable->fn_CreatePath(c_FillModeAlternate, &p);
+    if(status != 0) {
+        WD_TRACE("path_build_gdix: GdipCreatePath() failed. [%d]", status);
+        return NULL;
+    }
+
+    for(i = 0; i < data->n_verbs; i += n) {
+        n = 1;
+        switch(data->verbs[i]) {
+            case WD_PATHVERB_BEGINFIGURE:
+                gdix_vtable->fn_StartPathFigure(p);
+                memcpy(&end, pts, sizeof(WD_POINT));
+                pts++;
+                break;
+
+            case WD_PATHVERB_LINE:
+                n = path_data_run(data, i);
+                path_build_gdix_run(p, WD_PATHVERB_LINE, pts, n, &end);
+                pts += n;
+                break;
+
+            case WD_PATHVERB_BEZIER:
+                n = path_data_run(data, i);
+                path_build_gdix_run(p, WD_PATHVERB_BEZIER, pts, 3 * n, &end);
+                pts += 3 * n;
+                break;
+
+            case WD_PATHVERB_ENDFIGURE:
+                break;
+
+            case WD_PATHVERB_CLOSEFIGURE:
+                gdix_vtable->fn_ClosePathFigure(p);
+                break;
+        }
+    }
+
+    return p;
+}
+
+static void*
+path_data_geometry(path_data_t* data)
+{
+    void* geometry;
+
+    if(data->geometry != NULL)
+        return data->geometry;
+
+    if(d2d_enabled())
+        geometry = path_build_d2d(data);
+    else
+        geometry = path_build_gdix(data);
+    if(geometry == NULL)
+        return NULL;
+
+    return path_cache_geometry(&data->geometry, geometry);
+}
+
+/* Extend lo, hi (which already contain p0 and p3) by the extremes of the
+ * Bezier curve in one coordinate. These lie where the derivative,
+ * 3 * (a*t^2 + b*t + c), is zero. */
+static void
+path_bezier_extend(float p0, float p1, float p2, float p3, float* lo, float* hi)
+{
+    float a = -p0 + 3.0f * p1 - 3.0f * p2 + p3;
+    float b = 2.0f * (p0 - 2.0f * p1 + p2);
+    float c = p1 - p0;
+    float t[2];
+    int i, n = 0;
+
+    /* The curve stays within the hull of its control points. */
+    if(*lo <= p1  &&  p1 <= *hi  &&  *lo <= p2  &&  p2 <= *hi)
+        return;
+
+    if(fabsf(a) < 1e-12f) {
+        if(fabsf(b) > 1e-12f)
+            t[n++] = -c / b;
+    } else {
+        float d = b * b - 4.0f * a * c;
+
+        if(d >= 0.0f) {
+            d = sqrtf(d);
+            t[n++] = (-b + d) / (2.0f * a);
+            t[n++] = (-b - d) / (2.0f * a);
+        }
+    }
+
+    for(i = 0; i < n; i++) {
+        float u = 1.0f - t[i];
+        float v;
+
+        if(t[i] <= 0.0f  ||  t[i] >= 1.0f)
+            continue;
+        v = u * u * u * p0 + 3.0f * u * u * t[i] * p1 +
+            3.0f * u * t[i] * t[i] * p2 + t[i] * t[i] * t[i] * p3;
+        *lo = WD_MIN(*lo, v);
+        *hi = WD_MAX(*hi, v);
+    }
+}
+
+static inline void
+path_bounds_add(WD_RECT* r, const WD_POINT* pt, BOOL first)
+{
+    if(first  ||  pt->x < r->x0)  r->x0 = pt->x;
+    if(first  ||  pt->y < r->y0)  r->y0 = pt->y;
+    if(first  ||  pt->x > r->x1)  r->x1 = pt->x;
+    if(first  ||  pt->y > r->y1)  r->y1 = pt->y;
+}
+
+/* Compute the exact bounds of the recorded figures, optionally transformed
+ * by the matrix m. (An affine transformation of a Bezier curve is the curve
+ * of the transformed control points.) */
+static void
+path_compute_bounds(const path_data_t* data, const WD_MATRIX* m, WD_RECT* r)
+{
+    const WD_POINT* pts = data->points;
+    WD_POINT cur = { 0.0f, 0.0f };
+    WD_POINT p[3];
+    UINT i, j;
+
+    memset(r, 0, sizeof(WD_RECT));
+
+    for(i = 0; i < data->n_verbs; i++) {
+        switch(data->verbs[i]) {
+            case WD_PATHVERB_BEGINFIGURE:
+            case WD_PATHVERB_LINE:
+                if(m != NULL)
+                    path_transform_point(m, pts, &cur);
+                else
+                    memcpy(&cur, pts, sizeof(WD_POINT));
+                path_bounds_add(r, &cur, (pts == data->points));
+                pts++;
+                break;
+
+            case WD_PATHVERB_BEZIER:
+                for(j = 0; j < 3; j++) {
+                    if(m != NULL)
+                        path_transform_point(m, &pts[j], &p[j]);
+                    else
+                        memcpy(&p[j], &pts[j], sizeof(WD_POINT));
+                }
+                path_bounds_add(r, &p[2], FALSE);
+                path_bezier_extend(cur.x, p[0].x, p[1].x, p[2].x, &r->x0, &r->x1);
+                path_bezier_extend(cur.y, p[0].y, p[1].y, p[2].y, &r->y0, &r->y1);
+                memcpy(&cur, &p[2], sizeof(WD_POINT));
+                pts += 3;
+                break;
+        }
+    }
+}
+
+void*
+wd_path_geometry(WD_HPATH hPath)
+{
+    path_t* path = (path_t*) hPath;
+    void* base;
+    void* geometry;
+
+    base = path_data_geometry(path->data);
+    if(base == NULL  ||  !path->transformed)
+        return base;
+
+    if(path->geometry != NULL)
+        return path->geometry;
+
     if(d2d_enabled()) {
-        c_ID2D1PathGeometry* g;
+        c_ID2D1Geometry* g;
+        c_D2D1_MATRIX_3X2_F m;
         HRESULT hr;
 
+        m._11 = path->matrix.m11;
+        m._12 = path->matrix.m12;
+        m._21 = path->matrix.m21;
+        m._22 = path->matrix.m22;
+        m._31 = path->matrix.dx;
+        m._32 = path->matrix.dy;
+
+        /* The transformed geometry only refers to the shared one and applies
+         * the matrix on the fly, so this is cheap whatever the path is. */
         wd_lock();
-        hr = c_ID2D1Factory_CreatePathGeometry(d2d_factory, &g);
+        hr = c_ID2D1Factory_CreateTransformedGeometry(d2d_factory,
+                    (c_ID2D1Geometry*) base, &m, &g);
         wd_unlock();
         if(FAILED(hr)) {
-            WD_TRACE_HR("wdCreatePath: "
-                        "ID2D1Factory::CreatePathGeometry() failed.");
+            WD_TRACE_HR("wd_path_geometry: "
+                        "ID2D1Factory::CreateTransformedGeometry() failed.");
             return NULL;
         }
-
-        return (WD_HPATH) g;
+        geometry = g;
     } else {
         c_GpPath* p;
+        c_GpMatrix* matrix;
         int status;
 
-        status = gdix_vtable->fn_CreatePath(c_FillModeAlternate, &p);
+        status = gdix_vtable->fn_ClonePath((c_GpPath*) base, &p);
+        if(status != 0) {
+            WD_TRACE("wd_path_geometry: GdipClonePath() failed. [%d]", status);
+            return NULL;
+        }
+
+        status = gdix_vtable->fn_CreateMatrix2(
+                    path->matrix.m11, path->matrix.m12, path->matrix.m21,
+                    path->matrix.m22, path->matrix.dx, path->matrix.dy, &matrix);
+        if(status == 0) {
+            status = gdix_vtable->fn_TransformPath(p, matrix);
+            gdix_delete_matrix(matrix);
+        }
         if(status != 0) {
-            WD_TRACE("wdCreatePath: GdipCreatePath() failed. [%d]", status);
+            WD_TRACE("wd_path_geometry: "
+                     "Cannot transform the path. [%d]", status);
+            gdix_vtable->fn_DeletePath(p);
             return NULL;
         }
+        geometry = p;
+    }
 
-        return (WD_HPATH) p;
+    return path_cache_geometry(&path->geometry, geometry);
+}
+
+void*
+wd_path_mask(WD_HPATH hPath, WD_HCANVAS hCanvas)
+{
+    path_t* path = (path_t*) hPath;
+    UINT serial = wd_canvas_serial(hCanvas);
+    void* geometry;
+
+    /* Path objects are not used concurrently (see wdPreInitialize()), so
+     * no locking is needed here. */
+    if(path->mask != NULL  &&  path->mask_canvas == serial)
+        return path->mask;
+
+    path_free_mask(path);
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wd_path_mask: wd_path_geometry() failed.");
+        return NULL;
     }
+
+    path->mask = d2d_create_pathmask((d2d_canvas_t*) hCanvas,
+                    (c_ID2D1Geometry*) geometry, 1.0f, 0);
+    if(path->mask == NULL) {
+        WD_TRACE("wd_path_mask: d2d_create_pathmask() failed.");
+        return NULL;
+    }
+    path->mask_canvas = serial;
+    return path->mask;
+}
+
+static path_t*
+path_alloc(path_data_t* data)
+{
+    path_t* path;
+
+    path = (path_t*) malloc(sizeof(path_t));
+    if(path == NULL) {
+        WD_TRACE("path_alloc: malloc() failed.");
+        return NULL;
+    }
+
+    memset(path, 0, sizeof(path_t));
+    path->data = data;
+    return path;
+}
+
+WD_HPATH
+wdCreatePath(WD_HCANVAS hCanvas)
+{
+    path_data_t* data;
+    path_t* path;
+
+    data = path_data_alloc();
+    if(data == NULL) {
+        WD_TRACE("wdCreatePath: path_data_alloc() failed.");
+        return NULL;
+    }
+
+    path = path_alloc(data);
+    if(path == NULL) {
+        WD_TRACE("wdCreatePath: path_alloc() failed.");
+        path_data_unref(data);
+        return NULL;
+    }
+
+    wd_apitrace_create(WD_APITRACE_OP_CREATEPATH, path, hCanvas, NULL, 0, NULL, 0, NULL, 0);
+    return (WD_HPATH) path;
 }
 
 WD_HPATH
@@ -71,7 +658,6 @@ wdCreatePolygonPath(WD_HCANVAS hCanvas, const WD_POINT* pPoints, UINT uCount)
 
     if(uCount > 0) {
         WD_PATHSINK sink;
-        UINT i;
 
         if(!wdOpenPathSink(&sink, p)) {
             WD_TRACE("wdCreatePolygonPath: wdOpenPathSink() failed.");
@@ -80,8 +666,7 @@ wdCreatePolygonPath(WD_HCANVAS hCanvas, const WD_POINT* pPoints, UINT uCount)
         }
 
         wdBeginFigure(&sink, pPoints[0].x, pPoints[0].y);
-        for(i = 1; i < uCount; i++)
-            wdAddLine(&sink, pPoints[i].x, pPoints[i].y);
+        wdAddLines(&sink, pPoints + 1, uCount - 1);
         wdEndFigure(&sink, TRUE);
 
         wdClosePathSink(&sink);
@@ -90,6 +675,56 @@ wdCreatePolygonPath(WD_HCANVAS hCanvas, const WD_POINT* pPoints, UINT uCount)
     return p;
 }
 
+WD_HPATH
+wdCreatePathFromPoints(WD_HCANVAS hCanvas, const WD_POINT* pPoints,
+                       const UINT* puFigureSizes, UINT uFigureCount, DWORD dwFlags)
+{
+    WD_HPATH p;
+    WD_PATHSINK sink;
+    UINT i;
+
+    /* Each Bezier figure is the start point followed by whole curves. */
+    if(dwFlags & WD_PATH_BEZIERS) {
+        for(i = 0; i < uFigureCount; i++) {
+            if(puFigureSizes[i] % 3 != 1) {
+                WD_TRACE("wdCreatePathFromPoints: Invalid figure size %u.",
+                         puFigureSizes[i]);
+                return NULL;
+            }
+        }
+    }
+
+    p = wdCreatePath(hCanvas);
+    if(p == NULL) {
+        WD_TRACE("wdCreatePathFromPoints: wdCreatePath() failed.");
+        return NULL;
+    }
+
+    if(!wdOpenPathSink(&sink, p)) {
+        WD_TRACE("wdCreatePathFromPoints: wdOpenPathSink() failed.");
+        wdDestroyPath(p);
+        return NULL;
+    }
+
+    for(i = 0; i < uFigureCount; i++) {
+        UINT n = puFigureSizes[i];
+
+        if(n > 0) {
+            wdBeginFigure(&sink, pPoints[0].x, pPoints[0].y);
+            if(dwFlags & WD_PATH_BEZIERS)
+                wdAddBeziers(&sink, pPoints + 1, (n - 1) / 3);
+            else
+                wdAddLines(&sink, pPoints + 1, n - 1);
+            wdEndFigure(&sink, (dwFlags & WD_PATH_CLOSEFIGURES));
+        }
+
+        pPoints += n;
+    }
+
+    wdClosePathSink(&sink);
+    return p;
+}
+
 WD_HPATH
 wdCreateRoundedRectPath(WD_HCANVAS hCanvas, const WD_RECT* prc, float r)
 {
@@ -135,62 +770,438 @@ wdCreateRoundedRectPath(WD_HCANVAS hCanvas, const WD_RECT* prc, float r)
     return p;
 }
 
+/* Make a path sharing the buffer with the source one. */
+static path_t*
+path_share(const path_t* src)
+{
+    path_t* path;
+
+    path = path_alloc(src->data);
+    if(path == NULL)
+        return NULL;
+
+    InterlockedIncrement(&src->data->refs);
+    path->transformed = src->transformed;
+    memcpy(&path->matrix, &src->matrix, sizeof(WD_MATRIX));
+    return path;
+}
+
+WD_HPATH
+wdCreateTransformedPath(const WD_HPATH hPath, const WD_MATRIX* pMatrix)
+{
+    const path_t* src = (const path_t*) hPath;
+    path_t* path;
+
+    path = path_share(src);
+    if(path == NULL) {
+        WD_TRACE("wdCreateTransformedPath: path_share() failed.");
+        return NULL;
+    }
+
+    /* Transformation of a transformed path: Apply the source matrix first. */
+    if(src->transformed) {
+        const WD_MATRIX* a = &src->matrix;
+        const WD_MATRIX* b = pMatrix;
+
+        path->matrix.m11 = a->m11 * b->m11 + a->m12 * b->m21;
+        path->matrix.m12 = a->m11 * b->m12 + a->m12 * b->m22;
+        path->matrix.m21 = a->m21 * b->m11 + a->m22 * b->m21;
+        path->matrix.m22 = a->m21 * b->m12 + a->m22 * b->m22;
+        path->matrix.dx = a->dx * b->m11 + a->dy * b->m21 + b->dx;
+        path->matrix.dy = a->dx * b->m12 + a->dy * b->m22 + b->dy;
+    } else {
+        memcpy(&path->matrix, pMatrix, sizeof(WD_MATRIX));
+    }
+    path->transformed = TRUE;
+
+    wd_apitrace_create(WD_APITRACE_OP_CREATETRANSFORMEDPATH, path, hPath,
+                       pMatrix, sizeof(WD_MATRIX), NULL, 0, NULL, 0);
+    return (WD_HPATH) path;
+}
+
+WD_HPATH
+wdClonePath(const WD_HPATH hPath)
+{
+    path_t* path;
+
+    path = path_share((const path_t*) hPath);
+    if(path == NULL) {
+        WD_TRACE("wdClonePath: path_share() failed.");
+        return NULL;
+    }
+
+    wd_apitrace_create(WD_APITRACE_OP_CLONEPATH, path, hPath, NULL, 0, NULL, 0, NULL, 0);
+    return (WD_HPATH) path;
+}
+
 void
 wdDestroyPath(WD_HPATH hPath)
 {
+    path_t* path = (path_t*) hPath;
+
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYPATH, hPath);
+    wd_hook_object_changing(hPath);
+
+    path_free_mask(path);
+    path_free_geometry(&path->geometry);
+    path_data_unref(path->data);
+    free(path);
+}
+
+BOOL
+wdGetPathData(const WD_HPATH hPath, BYTE* pVerbs, UINT* puVerbCount,
+              WD_POINT* pPoints, UINT* puPointCount)
+{
+    const path_t* path = (const path_t*) hPath;
+    const path_data_t* data = path->data;
+    BOOL fits;
+    UINT i;
+
+    fits = (pVerbs != NULL  &&  *puVerbCount >= data->n_verbs  &&
+            pPoints != NULL  &&  *puPointCount >= data->n_points);
+    *puVerbCount = data->n_verbs;
+    *puPointCount = data->n_points;
+    if(!fits)
+        return FALSE;
+
+    memcpy(pVerbs, data->verbs, data->n_verbs);
+    if(path->transformed) {
+        for(i = 0; i < data->n_points; i++)
+            path_transform_point(&path->matrix, &data->points[i], &pPoints[i]);
+    } else {
+        memcpy(pPoints, data->points, data->n_points * sizeof(WD_POINT));
+    }
+    return TRUE;
+}
+
+BOOL
+wdPathContainsPoint(const WD_HPATH hPath, float x, float y)
+{
+    void* geometry;
+    BOOL contains = FALSE;
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wdPathContainsPoint: wd_path_geometry() failed.");
+        return FALSE;
+    }
+
     if(d2d_enabled()) {
-        c_ID2D1PathGeometry_Release((c_ID2D1PathGeometry*) hPath);
+        c_ID2D1Geometry* g = (c_ID2D1Geometry*) geometry;
+        c_D2D1_POINT_2F pt = { x, y };
+        HRESULT hr;
+
+        hr = c_ID2D1Geometry_FillContainsPoint(g, pt, NULL,
+                    PATH_FLATTENING_TOLERANCE, &contains);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdPathContainsPoint: "
+                        "ID2D1Geometry::FillContainsPoint() failed.");
+            return FALSE;
+        }
     } else {
-        gdix_vtable->fn_DeletePath((c_GpPath*) hPath);
+        int status;
+
+        status = gdix_vtable->fn_IsVisiblePathPoint((c_GpPath*) geometry, x, y, NULL, &contains);
+        if(status != 0) {
+            WD_TRACE("wdPathContainsPoint: GdipIsVisiblePathPoint() failed. [%d]", status);
+            return FALSE;
+        }
     }
+
+    return contains;
 }
 
 BOOL
-wdOpenPathSink(WD_PATHSINK* pSink, WD_HPATH hPath)
+wdPathStrokeContainsPoint(const WD_HPATH hPath, float x, float y,
+                          float fStrokeWidth, WD_HSTROKESTYLE hStrokeStyle)
 {
+    void* geometry;
+    BOOL contains = FALSE;
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wdPathStrokeContainsPoint: wd_path_geometry() failed.");
+        return FALSE;
+    }
+
     if(d2d_enabled()) {
-        c_ID2D1PathGeometry* g = (c_ID2D1PathGeometry*) hPath;
-        c_ID2D1GeometrySink* s;
+        c_ID2D1Geometry* g = (c_ID2D1Geometry*) geometry;
+        c_ID2D1StrokeStyle* s = (c_ID2D1StrokeStyle*) hStrokeStyle;
+        c_D2D1_POINT_2F pt = { x, y };
         HRESULT hr;
 
-        hr = c_ID2D1PathGeometry_Open(g, &s);
+        hr = c_ID2D1Geometry_StrokeContainsPoint(g, pt, fStrokeWidth, s, NULL,
+                    PATH_FLATTENING_TOLERANCE, &contains);
         if(FAILED(hr)) {
-            WD_TRACE_HR("wdOpenPathSink: ID2D1PathGeometry::Open() failed.");
+            WD_TRACE_HR("wdPathStrokeContainsPoint: "
+                        "ID2D1Geometry::StrokeContainsPoint() failed.");
             return FALSE;
         }
+    } else {
+        gdix_strokestyle_t* s = (gdix_strokestyle_t*) hStrokeStyle;
+        c_GpPen* pen;
+        int status;
 
-        pSink->pData = (void*) s;
-        return TRUE;
+        /* The pen of a canvas is not available here, so set up our own. */
+        status = gdix_vtable->fn_CreatePen1(0xff000000, fStrokeWidth, c_UnitPixel, &pen);
+        if(status != 0) {
+            WD_TRACE("wdPathStrokeContainsPoint: GdipCreatePen1() failed. [%d]", status);
+            return FALSE;
+        }
+
+        if(s != NULL) {
+            if(s->dashesCount > 0)
+                gdix_vtable->fn_SetPenDashArray(pen, s->dashes, s->dashesCount);
+            else
+                gdix_vtable->fn_SetPenDashStyle(pen, s->dashStyle);
+            gdix_vtable->fn_SetPenStartCap(pen, s->lineCap);
+            gdix_vtable->fn_SetPenEndCap(pen, s->lineCap);
+            gdix_vtable->fn_SetPenLineJoin(pen, s->lineJoin);
+        }
+
+        status = gdix_vtable->fn_IsOutlineVisiblePathPoint((c_GpPath*) geometry,
+                    x, y, pen, NULL, &contains);
+        gdix_vtable->fn_DeletePen(pen);
+        if(status != 0) {
+            WD_TRACE("wdPathStrokeContainsPoint: "
+                     "GdipIsOutlineVisiblePathPoint() failed. [%d]", status);
+            return FALSE;
+        }
+    }
+
+    return contains;
+}
+
+BOOL
+wdGetPathBounds(const WD_HPATH hPath, WD_RECT* pRect)
+{
+    path_t* path = (path_t*) hPath;
+    path_data_t* data = path->data;
+    BOOL* p_has_bounds;
+    WD_RECT* p_bounds;
+
+    /* The bounds are computed when the sink is closed (or, for a transformed
+     * path, on the first call) and then just reused: Culling asks for them
+     * on every paint of the path. */
+    if(path->transformed) {
+        p_has_bounds = &path->has_bounds;
+        p_bounds = &path->bounds;
     } else {
-        /* GDI+ doesn't have any concept of path sink as Direct2D does, it
-         * operates directly with the path object. */
-        pSink->pData = (void*) hPath;
-        return TRUE;
+        p_has_bounds = &data->has_bounds;
+        p_bounds = &data->bounds;
+    }
+
+    if(!*p_has_bounds) {
+        WD_RECT r;
+
+        path_compute_bounds(data, (path->transformed ? &path->matrix : NULL), &r);
+        wd_lock();
+        memcpy(p_bounds, &r, sizeof(WD_RECT));
+        *p_has_bounds = TRUE;
+        wd_unlock();
     }
+
+    memcpy(pRect, p_bounds, sizeof(WD_RECT));
+    return TRUE;
 }
 
-void
-wdClosePathSink(WD_PATHSINK* pSink)
+float
+wdGetPathLength(const WD_HPATH hPath)
 {
+    void* geometry;
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wdGetPathLength: wd_path_geometry() failed.");
+        return 0.0f;
+    }
+
     if(d2d_enabled()) {
-        c_ID2D1GeometrySink* s = (c_ID2D1GeometrySink*) pSink->pData;
-        c_ID2D1GeometrySink_Close(s);
-        c_ID2D1GeometrySink_Release(s);
+        c_ID2D1Geometry* g = (c_ID2D1Geometry*) geometry;
+        FLOAT length;
+        HRESULT hr;
+
+        hr = c_ID2D1Geometry_ComputeLength(g, NULL, PATH_FLATTENING_TOLERANCE, &length);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdGetPathLength: ID2D1Geometry::ComputeLength() failed.");
+            return 0.0f;
+        }
+        return length;
     } else {
-        /* noop */
+        c_GpPath* p;
+        c_GpPointF* points = NULL;
+        BYTE* types;
+        INT count = 0;
+        INT i, start = 0;
+        float length = 0.0f;
+        int status;
+
+        /* GDI+ cannot measure the path, so flatten its copy into polylines
+         * and sum the segments. */
+        status = gdix_vtable->fn_ClonePath((c_GpPath*) geometry, &p);
+        if(status != 0) {
+            WD_TRACE("wdGetPathLength: GdipClonePath() failed. [%d]", status);
+            return 0.0f;
+        }
+
+        status = gdix_vtable->fn_FlattenPath(p, NULL, PATH_FLATTENING_TOLERANCE);
+        if(status != 0) {
+            WD_TRACE("wdGetPathLength: GdipFlattenPath() failed. [%d]", status);
+            goto done;
+        }
+
+        gdix_vtable->fn_GetPointCount(p, &count);
+        if(count <= 0)
+            goto done;
+
+        points = (c_GpPointF*) malloc(count * (sizeof(c_GpPointF) + sizeof(BYTE)));
+        if(points == NULL) {
+            WD_TRACE("wdGetPathLength: malloc() failed.");
+            goto done;
+        }
+        types = (BYTE*) (points + count);
+        gdix_vtable->fn_GetPathPoints(p, points, count);
+        gdix_vtable->fn_GetPathTypes(p, types, count);
+
+        for(i = 0; i < count; i++) {
+            c_GpPointF* a;
+            c_GpPointF* b;
+
+            if((types[i] & c_PathPointTypePathTypeMask) == c_PathPointTypeStart) {
+                start = i;
+            } else {
+                a = &points[i-1];
+                b = &points[i];
+                length += sqrtf((b->x - a->x) * (b->x - a->x) + (b->y - a->y) * (b->y - a->y));
+            }
+
+            if(types[i] & c_PathPointTypeCloseSubpath) {
+                a = &points[i];
+                b = &points[start];
+                length += sqrtf((b->x - a->x) * (b->x - a->x) + (b->y - a->y) * (b->y - a->y));
+            }
+        }
+
+done:
+        free(points);
+        gdix_vtable->fn_DeletePath(p);
+        return length;
+    }
+}
+
+BOOL
+wdOpenPathSink(WD_PATHSINK* pSink, WD_HPATH hPath)
+{
+    path_t* path = (path_t*) hPath;
+    path_data_t* data;
+
+    /* Anything painted later with the path has to see the changes. */
+    wd_hook_object_changing(hPath);
+
+    data = path_writable(path);
+    if(data == NULL) {
+        WD_TRACE("wdOpenPathSink: path_writable() failed.");
+        return FALSE;
+    }
+
+    /* A path opened again continues where it has ended. */
+    pSink->pData = (void*) path;
+    if(data->n_points > 0) {
+        memcpy(&pSink->ptEnd, &data->points[data->n_points - 1],
+               sizeof(WD_POINT));
+    } else {
+        pSink->ptEnd.x = 0.0f;
+        pSink->ptEnd.y = 0.0f;
+    }
+
+    wd_apitrace_create(WD_APITRACE_OP_OPENPATHSINK, path, hPath, NULL, 0, NULL, 0, NULL, 0);
+    return TRUE;
+}
+
+void
+wdClosePathSink(WD_PATHSINK* pSink)
+{
+    path_t* path = (path_t*) pSink->pData;
+    path_data_t* data = path->data;
+
+    wd_apitrace_handle(WD_APITRACE_OP_CLOSEPATHSINK, pSink->pData);
+
+    /* Drop the geometry in case the path has been painted while open, and
+     * the unused room of the buffer. */
+    path_free_geometry(&data->geometry);
+    path_compute_bounds(data, NULL, &data->bounds);
+    data->has_bounds = TRUE;
+    if(data->alloc_verbs > data->n_verbs  &&  data->n_verbs > 0) {
+        BYTE* verbs = (BYTE*) realloc(data->verbs, data->n_verbs);
+        if(verbs != NULL) {
+            data->verbs = verbs;
+            data->alloc_verbs = data->n_verbs;
+        }
+    }
+    if(data->alloc_points > data->n_points  &&  data->n_points > 0) {
+        WD_POINT* points = (WD_POINT*) realloc(data->points,
+                    data->n_points * sizeof(WD_POINT));
+        if(points != NULL) {
+            data->points = points;
+            data->alloc_points = data->n_points;
+        }
+    }
+}
+
+/* Append verbs of the given kind and return where their points have to be
+ * written. The figures are kept well-formed: A new figure ends the current
+ * one, and a segment added outside of any figure starts a new one at the
+ * current point. */
+static WD_POINT*
+path_add(WD_PATHSINK* pSink, BYTE verb, UINT n_verbs, UINT n_points)
+{
+    path_data_t* data;
+    WD_POINT* points;
+
+    data = path_writable((path_t*) pSink->pData);
+    if(data == NULL) {
+        WD_TRACE("path_add: path_writable() failed.");
+        return NULL;
+    }
+
+    if(verb == WD_PATHVERB_BEGINFIGURE  &&  data->in_figure) {
+        if(!path_data_reserve(data, 1, 0))
+            goto err_reserve;
+        data->verbs[data->n_verbs++] = WD_PATHVERB_ENDFIGURE;
+    } else if(verb != WD_PATHVERB_BEGINFIGURE  &&  !data->in_figure) {
+        if(!path_data_reserve(data, 1, 1))
+            goto err_reserve;
+        data->verbs[data->n_verbs++] = WD_PATHVERB_BEGINFIGURE;
+        memcpy(&data->points[data->n_points++], &pSink->ptEnd,
+               sizeof(WD_POINT));
     }
+    data->in_figure = TRUE;
+
+    if(!path_data_reserve(data, n_verbs, n_points))
+        goto err_reserve;
+    memset(data->verbs + data->n_verbs, verb, n_verbs);
+    points = data->points + data->n_points;
+    data->n_verbs += n_verbs;
+    data->n_points += n_points;
+    return points;
+
+err_reserve:
+    WD_TRACE("path_add: path_data_reserve() failed.");
+    return NULL;
 }
 
 void
 wdBeginFigure(WD_PATHSINK* pSink, float x, float y)
 {
-    if(d2d_enabled()) {
-        c_ID2D1GeometrySink* s = (c_ID2D1GeometrySink*) pSink->pData;
-        c_D2D1_POINT_2F pt = { x, y };
+    float args[2] = { x, y };
+    WD_POINT* pt;
 
-        c_ID2D1GeometrySink_BeginFigure(s, pt, c_D2D1_FIGURE_BEGIN_FILLED);
-    } else {
-        gdix_vtable->fn_StartPathFigure(pSink->pData);
+    wd_apitrace_create(WD_APITRACE_OP_BEGINFIGURE, pSink->pData, NULL, args, sizeof(args), NULL, 0, NULL, 0);
+
+    pt = path_add(pSink, WD_PATHVERB_BEGINFIGURE, 1, 1);
+    if(pt != NULL) {
+        pt->x = x;
+        pt->y = y;
     }
 
     pSink->ptEnd.x = x;
@@ -200,32 +1211,62 @@ wdBeginFigure(WD_PATHSINK* pSink, float x, float y)
 void
 wdEndFigure(WD_PATHSINK* pSink, BOOL bCloseFigure)
 {
-    if(d2d_enabled()) {
-        c_ID2D1GeometrySink_EndFigure((c_ID2D1GeometrySink*) pSink->pData,
-                (bCloseFigure ? c_D2D1_FIGURE_END_CLOSED : c_D2D1_FIGURE_END_OPEN));
-    } else {
-        if(bCloseFigure)
-            gdix_vtable->fn_ClosePathFigure(pSink->pData);
+    UINT32 args[1] = { bCloseFigure };
+    path_data_t* data;
+
+    wd_apitrace_create(WD_APITRACE_OP_ENDFIGURE, pSink->pData, NULL, args, sizeof(args), NULL, 0, NULL, 0);
+
+    data = path_writable((path_t*) pSink->pData);
+    if(data == NULL  ||  !data->in_figure)
+        return;
+    if(!path_data_reserve(data, 1, 0)) {
+        WD_TRACE("wdEndFigure: path_data_reserve() failed.");
+        return;
     }
+
+    data->verbs[data->n_verbs++] = (bCloseFigure ? WD_PATHVERB_CLOSEFIGURE
+                                                 : WD_PATHVERB_ENDFIGURE);
+    data->in_figure = FALSE;
 }
 
 void
 wdAddLine(WD_PATHSINK* pSink, float x, float y)
 {
-    if(d2d_enabled()) {
-        c_ID2D1GeometrySink* s = (c_ID2D1GeometrySink*) pSink->pData;
-        c_D2D1_POINT_2F pt = { x, y };
+    float args[2] = { x, y };
+    WD_POINT* pt;
 
-        c_ID2D1GeometrySink_AddLine(s, pt);
-    } else {
-        gdix_vtable->fn_AddPathLine(pSink->pData,
-                        pSink->ptEnd.x, pSink->ptEnd.y, x, y);
+    wd_apitrace_create(WD_APITRACE_OP_ADDLINE, pSink->pData, NULL, args, sizeof(args), NULL, 0, NULL, 0);
+
+    pt = path_add(pSink, WD_PATHVERB_LINE, 1, 1);
+    if(pt != NULL) {
+        pt->x = x;
+        pt->y = y;
     }
 
     pSink->ptEnd.x = x;
     pSink->ptEnd.y = y;
 }
 
+void
+wdAddLines(WD_PATHSINK* pSink, const WD_POINT* pPoints, UINT uCount)
+{
+    UINT32 args[1] = { uCount };
+    WD_POINT* pts;
+
+    if(uCount == 0)
+        return;
+
+    wd_apitrace_create(WD_APITRACE_OP_ADDLINES, pSink->pData, NULL, args, sizeof(args),
+                       pPoints, uCount * sizeof(WD_POINT), NULL, 0);
+
+    pts = path_add(pSink, WD_PATHVERB_LINE, uCount, uCount);
+    if(pts != NULL)
+        memcpy(pts, pPoints, uCount * sizeof(WD_POINT));
+
+    pSink->ptEnd.x = pPoints[uCount - 1].x;
+    pSink->ptEnd.y = pPoints[uCount - 1].y;
+}
+
 void
 wdAddArc(WD_PATHSINK* pSink, float cx, float cy, float fSweepAngle)
 {
@@ -234,7 +1275,12 @@ wdAddArc(WD_PATHSINK* pSink, float cx, float cy, float fSweepAngle)
     float xdiff = ax - cx;
     float ydiff = ay - cy;
     float r;
-    float base_angle;
+    float angle, step, k;
+    float args[3] = { cx, cy, fSweepAngle };
+    WD_POINT* pts;
+    UINT i, n;
+
+    wd_apitrace_create(WD_APITRACE_OP_ADDARC, pSink->pData, NULL, args, sizeof(args), NULL, 0, NULL, 0);
 
     r = sqrtf(xdiff * xdiff + ydiff * ydiff);
 
@@ -242,39 +1288,72 @@ wdAddArc(WD_PATHSINK* pSink, float cx, float cy, float fSweepAngle)
     if(r < 0.001f)
         return;
 
-    base_angle = atan2f(ydiff, xdiff) * (180.0f / WD_PI);
+    /* The arc is recorded as Bezier curves, one per each (at most) quarter
+     * of the circle. The control points lie on the tangents in the distance
+     * k * r, which keeps the error below 0.03 % of the radius. */
+    n = (UINT) ceilf(fabsf(fSweepAngle) / 90.0f);
+    if(n == 0)
+        return;
+    angle = atan2f(ydiff, xdiff);
+    step = fSweepAngle * (WD_PI / 180.0f) / (float) n;
+    k = (4.0f / 3.0f) * tanf(step / 4.0f);
 
-    if(d2d_enabled()) {
-        c_ID2D1GeometrySink* s = (c_ID2D1GeometrySink*) pSink->pData;
-        c_D2D1_ARC_SEGMENT arc_seg;
+    pts = path_add(pSink, WD_PATHVERB_BEZIER, n, 3 * n);
+    if(pts == NULL)
+        return;
 
-        d2d_setup_arc_segment(&arc_seg, cx, cy, r, r, base_angle, fSweepAngle);
-        c_ID2D1GeometrySink_AddArc(s, &arc_seg);
-        pSink->ptEnd.x = arc_seg.point.x;
-        pSink->ptEnd.y = arc_seg.point.y;
-    } else {
-        float d = 2.0f * r;
-        float sweep_rads = (base_angle + fSweepAngle) * (WD_PI / 180.0f);
+    for(i = 0; i < n; i++) {
+        float cos0 = cosf(angle);
+        float sin0 = sinf(angle);
+        float cos1 = cosf(angle + step);
+        float sin1 = sinf(angle + step);
 
-        gdix_vtable->fn_AddPathArc(pSink->pData, cx - r, cy - r, d, d, base_angle, fSweepAngle);
-        pSink->ptEnd.x = cx + r * cosf(sweep_rads);
-        pSink->ptEnd.y = cy + r * sinf(sweep_rads);
+        pts[0].x = cx + r * (cos0 - k * sin0);
+        pts[0].y = cy + r * (sin0 + k * cos0);
+        pts[1].x = cx + r * (cos1 + k * sin1);
+        pts[1].y = cy + r * (sin1 - k * cos1);
+        pts[2].x = cx + r * cos1;
+        pts[2].y = cy + r * sin1;
+        pts += 3;
+        angle += step;
     }
+
+    pSink->ptEnd.x = pts[-1].x;
+    pSink->ptEnd.y = pts[-1].y;
 }
 
 void
 wdAddBezier(WD_PATHSINK* pSink, float x0, float y0, float x1, float y1, float x2, float y2)
 {
-    if(d2d_enabled()) {
-        c_ID2D1GeometrySink* s = (c_ID2D1GeometrySink*) pSink->pData;
-        c_D2D1_BEZIER_SEGMENT bezier_seg;
+    float args[6] = { x0, y0, x1, y1, x2, y2 };
+    WD_POINT* pts;
+
+    wd_apitrace_create(WD_APITRACE_OP_ADDBEZIER, pSink->pData, NULL, args, sizeof(args), NULL, 0, NULL, 0);
+
+    pts = path_add(pSink, WD_PATHVERB_BEZIER, 1, 3);
+    if(pts != NULL)
+        memcpy(pts, args, 3 * sizeof(WD_POINT));
 
-        d2d_setup_bezier_segment(&bezier_seg, x0, y0, x1, y1, x2, y2);
-        c_ID2D1GeometrySink_AddBezier(s, &bezier_seg);
-    } else {
-        gdix_vtable->fn_AddPathBezier(pSink->pData, pSink->ptEnd.x, pSink->ptEnd.y,
-                                      x0, y0, x1, y1, x2, y2);
-    }
     pSink->ptEnd.x = x2;
     pSink->ptEnd.y = y2;
 }
+
+void
+wdAddBeziers(WD_PATHSINK* pSink, const WD_POINT* pPoints, UINT uCount)
+{
+    UINT32 args[1] = { uCount };
+    WD_POINT* pts;
+
+    if(uCount == 0)
+        return;
+
+    wd_apitrace_create(WD_APITRACE_OP_ADDBEZIERS, pSink->pData, NULL, args, sizeof(args),
+                       pPoints, 3 * uCount * sizeof(WD_POINT), NULL, 0);
+
+    pts = path_add(pSink, WD_PATHVERB_BEZIER, uCount, 3 * uCount);
+    if(pts != NULL)
+        memcpy(pts, pPoints, 3 * uCount * sizeof(WD_POINT));
+
+    pSink->ptEnd.x = pPoints[3 * uCount - 1].x;
+    pSink->ptEnd.y = pPoints[3 * uCount - 1].y;
+}
@@ -0,0 +1,317 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "misc.h"
+
+
+/* The index is a bounding volume hierarchy built top-down: Each node is split
+ * at the median of the path centers along the longer axis of its bounds,
+ * until a node has at most WD_PATHINDEX_LEAFSIZE paths. That keeps the tree
+ * balanced, so its depth is logarithmic in the count of the paths.
+ *
+ * The index is immutable once built. All the nodes live in one array, with
+ * the two children of a node always next to each other.
+ */
+
+#define WD_PATHINDEX_LEAFSIZE       4
+#define WD_PATHINDEX_MAXDEPTH       64
+
+/* Default miter limit of Direct2D and GDI+. The outline of a path may reach
+ * this multiple of the half stroke width beyond the bounds of the path. */
+#define WD_PATHINDEX_MITERLIMIT     10.0f
+
+
+typedef struct wd_pathindex_node_tag wd_pathindex_node_t;
+struct wd_pathindex_node_tag {
+    WD_RECT bounds;
+    UINT first;     /* Leaf: Index into items[]. Otherwise: Index of the left child. */
+    UINT count;     /* Leaf: Count of the items. Otherwise zero. */
+};
+
+typedef struct wd_pathindex_tag wd_pathindex_t;
+struct wd_pathindex_tag {
+    WD_HPATH* paths;
+    WD_RECT* bounds;
+    UINT* items;                /* Path indexes, each leaf covers a range of them. */
+    UINT n_items;               /* (Paths with no bounds are left out.) */
+    wd_pathindex_node_t* nodes;
+    UINT n_nodes;
+};
+
+
+static inline float
+wd_pathindex_center(const wd_pathindex_t* index, UINT item, int axis)
+{
+    const WD_RECT* r = &index->bounds[item];
+    return (axis == 0 ? r->x0 + r->x1 : r->y0 + r->y1);
+}
+
+/* Reorder the items so that the k-th one is where it would be if sorted by
+ * the center along the axis, with no bigger one before and no smaller one
+ * after it. (Three-way partitioning keeps this linear even when many paths
+ * share the same center.) */
+static void
+wd_pathindex_select(const wd_pathindex_t* index, UINT* items, UINT n, UINT k, int axis)
+{
+    UINT lo = 0;
+    UINT hi = n;
+
+    while(hi - lo > 1) {
+        float pivot = wd_pathindex_center(index, items[lo + (hi - lo) / 2], axis);
+        UINT lt = lo;   /* items[lo, lt) are smaller than pivot. */
+        UINT i = lo;    /* items[lt, i) are equal to pivot. */
+        UINT gt = hi;   /* items[gt, hi) are bigger than pivot. */
+
+        while(i < gt) {
+            float c = wd_pathindex_center(index, items[i], axis);
+            UINT tmp = items[i];
+
+            if(c < pivot) {
+                items[i++] = items[lt];
+                items[lt++] = tmp;
+            } else if(c > pivot) {
+                items[i] = items[--gt];
+                items[gt] = tmp;
+            } else {
+                i++;
+            }
+        }
+
+        if(k < lt)
+            hi = lt;
+        else if(k >= gt)
+            lo = gt;
+        else
+            break;
+    }
+}
+
+static void
+wd_pathindex_build(wd_pathindex_t* index, UINT node, UINT first, UINT count)
+{
+    wd_pathindex_node_t* n = &index->nodes[node];
+    float cx0, cy0, cx1, cy1;
+    UINT i, mid, left;
+
+    n->bounds = index->bounds[index->items[first]];
+    cx0 = cx1 = wd_pathindex_center(index, index->items[first], 0);
+    cy0 = cy1 = wd_pathindex_center(index, index->items[first], 1);
+    for(i = first + 1; i < first + count; i++) {
+        const WD_RECT* r = &index->bounds[index->items[i]];
+        float cx = wd_pathindex_center(index, index->items[i], 0);
+        float cy = wd_pathindex_center(index, index->items[i], 1);
+
+        n->bounds.x0 = WD_MIN(n->bounds.x0, r->x0);
+        n->bounds.y0 = WD_MIN(n->bounds.y0, r->y0);
+        n->bounds.x1 = WD_MAX(n->bounds.x1, r->x1);
+        n->bounds.y1 = WD_MAX(n->bounds.y1, r->y1);
+        cx0 = WD_MIN(cx0, cx);
+        cy0 = WD_MIN(cy0, cy);
+        cx1 = WD_MAX(cx1, cx);
+        cy1 = WD_MAX(cy1, cy);
+    }
+
+    if(count <= WD_PATHINDEX_LEAFSIZE) {
+        n->first = first;
+        n->count = count;
+        return;
+    }
+
+    mid = count / 2;
+    wd_pathindex_select(index, index->items + first, count, mid,
+                        (cx1 - cx0 >= cy1 - cy0 ? 0 : 1));
+
+    left = index->n_nodes;
+    index->n_nodes += 2;
+    n->first = left;
+    n->count = 0;
+
+    wd_pathindex_build(index, left, first, mid);
+    wd_pathindex_build(index, left + 1, first + mid, count - mid);
+}
+
+WD_HPATHINDEX
+wdCreatePathIndex(const WD_HPATH* phPaths, UINT uCount)
+{
+    wd_pathindex_t* index;
+    UINT i;
+
+    index = (wd_pathindex_t*) malloc(sizeof(wd_pathindex_t));
+    if(index == NULL) {
+        WD_TRACE("wdCreatePathIndex: malloc() failed.");
+        goto err_malloc;
+    }
+    memset(index, 0, sizeof(wd_pathindex_t));
+
+    /* Each leaf gets at least two items, so the tree has less than uCount
+     * nodes. (One more covers the corner cases.) */
+    index->paths = (WD_HPATH*) malloc(uCount * sizeof(WD_HPATH) + 1);
+    index->bounds = (WD_RECT*) malloc(uCount * sizeof(WD_RECT) + 1);
+    index->items = (UINT*) malloc(uCount * sizeof(UINT) + 1);
+    index->nodes = (wd_pathindex_node_t*) malloc((uCount + 1) * sizeof(wd_pathindex_node_t));
+    if(index->paths == NULL  ||  index->bounds == NULL  ||
+       index->items == NULL  ||  index->nodes == NULL) {
+        WD_TRACE("wdCreatePathIndex: malloc() failed.");
+        goto err_malloc_arrays;
+    }
+
+    memcpy(index->paths, phPaths, uCount * sizeof(WD_HPATH));
+    for(i = 0; i < uCount; i++) {
+        WD_RECT* r = &index->bounds[i];
+
+        /* Empty paths have no (or inverted) bounds and they can never be
+         * hit anyway. */
+        if(phPaths[i] == NULL  ||  !wdGetPathBounds(phPaths[i], r))
+            continue;
+        if(!(r->x0 <= r->x1  &&  r->y0 <= r->y1))
+            continue;
+        index->items[index->n_items++] = i;
+    }
+
+    if(index->n_items > 0) {
+        index->n_nodes = 1;
+        wd_pathindex_build(index, 0, 0, index->n_items);
+    }
+
+    return (WD_HPATHINDEX) index;
+
+    /* Error path unwinding */
+err_malloc_arrays:
+    free(index->nodes);
+    free(index->items);
+    free(index->bounds);
+    free(index->paths);
+    free(index);
+err_malloc:
+    return NULL;
+}
+
+void
+wdDestroyPathIndex(WD_HPATHINDEX hIndex)
+{
+    wd_pathindex_t* index = (wd_pathindex_t*) hIndex;
+
+    free(index->nodes);
+    free(index->items);
+    free(index->bounds);
+    free(index->paths);
+    free(index);
+}
+
+int
+wdHitTestPathIndex(WD_HPATHINDEX hIndex, float x, float y, float fStrokeWidth)
+{
+    wd_pathindex_t* index = (wd_pathindex_t*) hIndex;
+    UINT stack[WD_PATHINDEX_MAXDEPTH];
+    UINT n_stack = 0;
+    float margin = 0.0f;
+    int hit = -1;
+
+    if(index->n_nodes == 0)
+        return -1;
+
+    if(fStrokeWidth > 0.0f)
+        margin = 0.5f * fStrokeWidth * WD_PATHINDEX_MITERLIMIT;
+
+    stack[n_stack++] = 0;
+    while(n_stack > 0) {
+        const wd_pathindex_node_t* n = &index->nodes[stack[--n_stack]];
+        UINT i;
+
+        if(x < n->bounds.x0 - margin  ||  x > n->bounds.x1 + margin  ||
+           y < n->bounds.y0 - margin  ||  y > n->bounds.y1 + margin)
+            continue;
+
+        if(n->count == 0) {
+            stack[n_stack++] = n->first;
+            stack[n_stack++] = n->first + 1;
+            continue;
+        }
+
+        for(i = n->first; i < n->first + n->count; i++) {
+            UINT item = index->items[i];
+            const WD_RECT* r = &index->bounds[item];
+
+            /* Only a path above the one already found can change the result. */
+            if((int) item <= hit)
+                continue;
+            if(x < r->x0 - margin  ||  x > r->x1 + margin  ||
+               y < r->y0 - margin  ||  y > r->y1 + margin)
+                continue;
+
+            if(wdPathContainsPoint(index->paths[item], x, y)  ||
+               (fStrokeWidth > 0.0f  &&  wdPathStrokeContainsPoint(
+                        index->paths[item], x, y, fStrokeWidth, NULL)))
+                hit = (int) item;
+        }
+    }
+
+    return hit;
+}
+
+UINT
+wdQueryPathIndex(WD_HPATHINDEX hIndex, const WD_RECT* pRect,
+                 UINT* puIndexes, UINT uMaxCount)
+{
+    wd_pathindex_t* index = (wd_pathindex_t*) hIndex;
+    UINT stack[WD_PATHINDEX_MAXDEPTH];
+    UINT n_stack = 0;
+    float x0 = WD_MIN(pRect->x0, pRect->x1);
+    float y0 = WD_MIN(pRect->y0, pRect->y1);
+    float x1 = WD_MAX(pRect->x0, pRect->x1);
+    float y1 = WD_MAX(pRect->y0, pRect->y1);
+    UINT count = 0;
+
+    if(index->n_nodes == 0)
+        return 0;
+
+    stack[n_stack++] = 0;
+    while(n_stack > 0) {
+        const wd_pathindex_node_t* n = &index->nodes[stack[--n_stack]];
+        UINT i;
+
+        if(x1 < n->bounds.x0  ||  x0 > n->bounds.x1  ||
+           y1 < n->bounds.y0  ||  y0 > n->bounds.y1)
+            continue;
+
+        if(n->count == 0) {
+            stack[n_stack++] = n->first;
+            stack[n_stack++] = n->first + 1;
+            continue;
+        }
+
+        for(i = n->first; i < n->first + n->count; i++) {
+            UINT item = index->items[i];
+            const WD_RECT* r = &index->bounds[item];
+
+            if(x1 < r->x0  ||  x0 > r->x1  ||  y1 < r->y0  ||  y0 > r->y1)
+                continue;
+
+            if(count < uMaxCount)
+                puIndexes[count] = item;
+            count++;
+        }
+    }
+
+    return count;
+}
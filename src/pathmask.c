@@ -0,0 +1,228 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "misc.h"
+#include "backend-d2d.h"
+#include "backend-gdix.h"
+#include "apitrace.h"
+#include "hook.h"
+
+
+/* Extra margin (in pixels) around the path bounds so the anti-aliased edges
+ * do not get cut off. */
+#define PATHMASK_MARGIN         1.0f
+
+
+d2d_pathmask_t*
+d2d_create_pathmask(d2d_canvas_t* c, c_ID2D1Geometry* g, float fScale, DWORD dwFlags)
+{
+    c_D2D1_MATRIX_3X2_F matrix = { fScale, 0.0f, 0.0f, fScale, 0.0f, 0.0f };
+    c_D2D1_COLOR_F white = { 1.0f, 1.0f, 1.0f, 1.0f };
+    c_D2D1_COLOR_F clear = { 0.0f, 0.0f, 0.0f, 0.0f };
+    c_D2D1_PIXEL_FORMAT format = { c_DXGI_FORMAT_A8_UNORM, c_D2D1_ALPHA_MODE_PREMULTIPLIED };
+    c_D2D1_RECT_F bounds;
+    c_D2D1_SIZE_F size;
+    c_D2D1_SIZE_U pixel_size;
+    c_ID2D1BitmapRenderTarget* bmp_target;
+    c_ID2D1RenderTarget* target;
+    c_ID2D1SolidColorBrush* b;
+    d2d_pathmask_t* mask;
+    float x0, y0;
+    HRESULT hr;
+
+    mask = (d2d_pathmask_t*) malloc(sizeof(d2d_pathmask_t));
+    if(mask == NULL) {
+        WD_TRACE("d2d_create_pathmask: malloc() failed.");
+        goto err_malloc;
+    }
+
+    hr = c_ID2D1Geometry_GetBounds(g, &matrix, &bounds);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("d2d_create_pathmask: "
+                    "ID2D1Geometry::GetBounds() failed.");
+        goto err_GetBounds;
+    }
+
+    /* Empty path yields an "inverted" infinite rectangle. */
+    if(bounds.left > bounds.right  ||  bounds.top > bounds.bottom) {
+        bounds.left = 0.0f;
+        bounds.top = 0.0f;
+        bounds.right = 0.0f;
+        bounds.bottom = 0.0f;
+    }
+
+    /* Snap the bitmap to whole pixels, so it is not blurred by resampling
+     * when painted at integral coordinates. */
+    x0 = floorf(bounds.left) - PATHMASK_MARGIN;
+    y0 = floorf(bounds.top) - PATHMASK_MARGIN;
+    pixel_size.width = (UINT32) (ceilf(bounds.right) + PATHMASK_MARGIN - x0);
+    pixel_size.height = (UINT32) (ceilf(bounds.bottom) + PATHMASK_MARGIN - y0);
+    size.width = (float) pixel_size.width;
+    size.height = (float) pixel_size.height;
+
+    hr = c_ID2D1RenderTarget_CreateCompatibleRenderTarget(c->target,
+            &size, &pixel_size, &format,
+            c_D2D1_COMPATIBLE_RENDER_TARGET_OPTIONS_NONE, &bmp_target);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("d2d_create_pathmask: "
+                    "ID2D1RenderTarget::CreateCompatibleRenderTarget() failed.");
+        goto err_CreateCompatibleRenderTarget;
+    }
+    target = (c_ID2D1RenderTarget*) bmp_target;
+
+    hr = c_ID2D1RenderTarget_CreateSolidColorBrush(target, &white, NULL, &b);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("d2d_create_pathmask: "
+                    "ID2D1RenderTarget::CreateSolidColorBrush() failed.");
+        goto err_CreateSolidColorBrush;
+    }
+
+    /* Same as the canvas base transformation (see d2d_reset_transform()),
+     * so the mask matches what wdFillPath() would paint. */
+    matrix._31 = D2D_BASEDELTA_X - x0;
+    matrix._32 = D2D_BASEDELTA_Y - y0;
+
+    c_ID2D1RenderTarget_BeginDraw(target);
+    c_ID2D1RenderTarget_Clear(target, &clear);
+    c_ID2D1RenderTarget_SetTransform(target, &matrix);
+    if(dwFlags & WD_PATHMASK_ALIASED)
+        c_ID2D1RenderTarget_SetAntialiasMode(target, c_D2D1_ANTIALIAS_MODE_ALIASED);
+    c_ID2D1RenderTarget_FillGeometry(target, g, (c_ID2D1Brush*) b, NULL);
+    hr = c_ID2D1RenderTarget_EndDraw(target, NULL, NULL);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("d2d_create_pathmask: "
+                    "ID2D1RenderTarget::EndDraw() failed.");
+        goto err_EndDraw;
+    }
+
+    hr = c_ID2D1BitmapRenderTarget_GetBitmap(bmp_target, &mask->bitmap);
+    if(FAILED(hr)) {
+        WD_TRACE_HR("d2d_create_pathmask: "
+                    "ID2D1BitmapRenderTarget::GetBitmap() failed.");
+        goto err_GetBitmap;
+    }
+
+    /* Compensate the base transformation of the canvas, so the pixels
+     * of the mask fit precisely into the pixel grid of the canvas. */
+    mask->rect.left = (x0 - D2D_BASEDELTA_X) / fScale;
+    mask->rect.top = (y0 - D2D_BASEDELTA_Y) / fScale;
+    mask->rect.right = (x0 + size.width - D2D_BASEDELTA_X) / fScale;
+    mask->rect.bottom = (y0 + size.height - D2D_BASEDELTA_Y) / fScale;
+
+    c_ID2D1SolidColorBrush_Release(b);
+    c_ID2D1BitmapRenderTarget_Release(bmp_target);
+    return mask;
+
+    /* Error path unwinding. */
+err_GetBitmap:
+err_EndDraw:
+    c_ID2D1SolidColorBrush_Release(b);
+err_CreateSolidColorBrush:
+    c_ID2D1BitmapRenderTarget_Release(bmp_target);
+err_CreateCompatibleRenderTarget:
+err_GetBounds:
+    free(mask);
+err_malloc:
+    return NULL;
+}
+
+void
+d2d_destroy_pathmask(d2d_pathmask_t* mask)
+{
+    c_ID2D1Bitmap_Release(mask->bitmap);
+    free(mask);
+}
+
+WD_HCACHEDPATHMASK
+wdCreateCachedPathMask(WD_HCANVAS hCanvas, const WD_HPATH hPath,
+                       float fScale, DWORD dwFlags)
+{
+    wd_apitrace_pathmask_t args;
+    void* geometry;
+
+    if(fScale <= 0.0f)
+        fScale = 1.0f;
+
+    geometry = wd_path_geometry(hPath);
+    if(geometry == NULL) {
+        WD_TRACE("wdCreateCachedPathMask: wd_path_geometry() failed.");
+        return NULL;
+    }
+
+    args.path = (UINT64) (UINT_PTR) hPath;
+    args.scale = fScale;
+    args.flags = dwFlags;
+
+    if(d2d_enabled()) {
+        d2d_pathmask_t* mask;
+
+        mask = d2d_create_pathmask((d2d_canvas_t*) hCanvas,
+                    (c_ID2D1Geometry*) geometry, fScale, dwFlags);
+        if(mask == NULL) {
+            WD_TRACE("wdCreateCachedPathMask: d2d_create_pathmask() failed.");
+            return NULL;
+        }
+
+        wd_apitrace_create(WD_APITRACE_OP_CREATEPATHMASK, mask, hCanvas,
+                           &args, sizeof(args), NULL, 0, NULL, 0);
+        return (WD_HCACHEDPATHMASK) mask;
+    } else {
+        /* GDI+ cannot use a bitmap as an opacity mask for an arbitrary brush.
+         * So we fall back to a copy of the path with all the curves already
+         * flattened into line segments. The flattening tolerance is adapted
+         * to the scale so the precision matches the intended size. */
+        c_GpPath* p;
+        int status;
+
+        status = gdix_vtable->fn_ClonePath((c_GpPath*) geometry, &p);
+        if(status != 0) {
+            WD_TRACE("wdCreateCachedPathMask: GdipClonePath() failed. [%d]", status);
+            return NULL;
+        }
+
+        status = gdix_vtable->fn_FlattenPath(p, NULL, 0.25f / fScale);
+        if(status != 0) {
+            WD_TRACE("wdCreateCachedPathMask: GdipFlattenPath() failed. [%d]", status);
+            gdix_vtable->fn_DeletePath(p);
+            return NULL;
+        }
+
+        wd_apitrace_create(WD_APITRACE_OP_CREATEPATHMASK, p, hCanvas,
+                           &args, sizeof(args), NULL, 0, NULL, 0);
+        return (WD_HCACHEDPATHMASK) p;
+    }
+}
+
+void
+wdDestroyCachedPathMask(WD_HCACHEDPATHMASK hMask)
+{
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYPATHMASK, hMask);
+    wd_hook_object_changing(hMask);
+
+    if(d2d_enabled()) {
+        d2d_destroy_pathmask((d2d_pathmask_t*) hMask);
+    } else {
+        gdix_vtable->fn_DeletePath((c_GpPath*) hMask);
+    }
+}
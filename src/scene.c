@@ -0,0 +1,662 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "misc.h"
+#include "hook.h"
+#include "cull.h"
+
+
+/* The scene items are indexed with a uniform grid. The grid is sparse: only
+ * the cells which have some items are stored, in a hash table, so the scene
+ * does not need to know its extent in advance.
+ *
+ * Items spanning too many cells (and items with unknown bounds) are not put
+ * into the grid; they are kept in a separate list which is always examined.
+ *
+ * Removed items are unregistered from the grid and their slots are reused by
+ * the items added later. The order of adding is hence tracked separately by
+ * a sequence number.
+ */
+
+#define WD_SCENE_DEFAULT_CELLSIZE   64.0f
+#define WD_SCENE_MAXCELLSPERITEM    256
+
+
+typedef struct wd_scene_item_tag wd_scene_item_t;
+struct wd_scene_item_tag {
+    wd_cmd_t cmd;
+    WD_RECT bounds;
+    int z;
+    UINT seq;
+    UINT stamp;
+    BOOL bounded;
+    BOOL alive;
+    LPARAM lp;
+};
+
+typedef struct wd_scene_cell_tag wd_scene_cell_t;
+struct wd_scene_cell_tag {
+    BOOL used;
+    int ix;
+    int iy;
+    UINT* items;
+    UINT n;
+    UINT alloc;
+};
+
+typedef struct wd_scene_ref_tag wd_scene_ref_t;
+struct wd_scene_ref_tag {
+    int z;
+    UINT seq;
+    UINT index;
+};
+
+typedef struct wd_scene_tag wd_scene_t;
+struct wd_scene_tag {
+    float cell_size;
+
+    wd_scene_item_t* items;
+    UINT n_items;               /* Count of the used slots, alive or dead. */
+    UINT alloc_items;
+    UINT seq;
+
+    UINT* free_slots;           /* Dead slots available for the reuse. */
+    UINT n_free;
+    UINT alloc_free;
+
+    wd_scene_cell_t* cells;     /* Hash table; size is a power of 2. */
+    UINT n_cells;
+    UINT alloc_cells;
+
+    UINT* big;                  /* Items not in the grid. */
+    UINT n_big;
+    UINT alloc_big;
+
+    UINT stamp;                 /* To avoid visiting an item twice in a query. */
+    wd_scene_ref_t* refs;       /* Temporary buffer for wdRenderScene(). */
+    UINT alloc_refs;
+};
+
+
+static BOOL
+wd_scene_push(UINT** p_vec, UINT* p_n, UINT* p_alloc, UINT value)
+{
+    if(*p_n >= *p_alloc) {
+        UINT alloc = (*p_alloc > 0 ? 2 * *p_alloc : 8);
+        UINT* vec;
+
+        vec = (UINT*) realloc(*p_vec, alloc * sizeof(UINT));
+        if(vec == NULL)
+            return FALSE;
+        *p_vec = vec;
+        *p_alloc = alloc;
+    }
+
+    (*p_vec)[(*p_n)++] = value;
+    return TRUE;
+}
+
+static inline UINT
+wd_scene_hash(int ix, int iy)
+{
+    return ((UINT) ix * 73856093U) ^ ((UINT) iy * 19349663U);
+}
+
+static wd_scene_cell_t*
+wd_scene_lookup(wd_scene_t* scene, int ix, int iy)
+{
+    UINT mask = scene->alloc_cells - 1;
+    UINT i;
+
+    if(scene->alloc_cells == 0)
+        return NULL;
+
+    for(i = wd_scene_hash(ix, iy) & mask; scene->cells[i].used; i = (i + 1) & mask) {
+        if(scene->cells[i].ix == ix  &&  scene->cells[i].iy == iy)
+            return &scene->cells[i];
+    }
+
+    return NULL;
+}
+
+static BOOL
+wd_scene_rehash(wd_scene_t* scene)
+{
+    UINT alloc = (scene->alloc_cells > 0 ? 2 * scene->alloc_cells : 256);
+    wd_scene_cell_t* cells;
+    UINT i, j;
+
+    cells = (wd_scene_cell_t*) malloc(alloc * sizeof(wd_scene_cell_t));
+    if(cells == NULL) {
+        WD_TRACE("wd_scene_rehash: malloc() failed.");
+        return FALSE;
+    }
+    memset(cells, 0, alloc * sizeof(wd_scene_cell_t));
+
+    for(i = 0; i < scene->alloc_cells; i++) {
+        if(!scene->cells[i].used)
+            continue;
+        for(j = wd_scene_hash(scene->cells[i].ix, scene->cells[i].iy) & (alloc - 1);
+            cells[j].used; j = (j + 1) & (alloc - 1))
+            ;
+        memcpy(&cells[j], &scene->cells[i], sizeof(wd_scene_cell_t));
+    }
+
+    free(scene->cells);
+    scene->cells = cells;
+    scene->alloc_cells = alloc;
+    return TRUE;
+}
+
+static wd_scene_cell_t*
+wd_scene_insert_cell(wd_scene_t* scene, int ix, int iy)
+{
+    wd_scene_cell_t* cell;
+    UINT mask;
+    UINT i;
+
+    cell = wd_scene_lookup(scene, ix, iy);
+    if(cell != NULL)
+        return cell;
+
+    /* Keep the load factor below 3/4. */
+    if(4 * (scene->n_cells + 1) > 3 * scene->alloc_cells) {
+        if(!wd_scene_rehash(scene))
+            return NULL;
+    }
+
+    mask = scene->alloc_cells - 1;
+    for(i = wd_scene_hash(ix, iy) & mask; scene->cells[i].used; i = (i + 1) & mask)
+        ;
+
+    cell = &scene->cells[i];
+    cell->used = TRUE;
+    cell->ix = ix;
+    cell->iy = iy;
+    scene->n_cells++;
+    return cell;
+}
+
+/* Remove an empty cell from the hash table. The following cells of the same
+ * cluster are moved back so the lookups still find them. */
+static void
+wd_scene_remove_cell(wd_scene_t* scene, wd_scene_cell_t* cell)
+{
+    UINT mask = scene->alloc_cells - 1;
+    UINT i = (UINT) (cell - scene->cells);
+    UINT j, k;
+
+    free(cell->items);
+    memset(cell, 0, sizeof(wd_scene_cell_t));
+    scene->n_cells--;
+
+    for(j = (i + 1) & mask; scene->cells[j].used; j = (j + 1) & mask) {
+        k = wd_scene_hash(scene->cells[j].ix, scene->cells[j].iy) & mask;
+
+        /* Move the cell j into the hole i, unless its home slot k lies
+         * cyclically in (i, j]. */
+        if(i <= j ? (i < k  &&  k <= j) : (i < k  ||  k <= j))
+            continue;
+
+        memcpy(&scene->cells[i], &scene->cells[j], sizeof(wd_scene_cell_t));
+        memset(&scene->cells[j], 0, sizeof(wd_scene_cell_t));
+        i = j;
+    }
+}
+
+/* Remove the value from the vector (if present). The order does not matter. */
+static void
+wd_scene_pop(UINT* vec, UINT* p_n, UINT value)
+{
+    UINT i;
+
+    for(i = 0; i < *p_n; i++) {
+        if(vec[i] == value) {
+            vec[i] = vec[--(*p_n)];
+            return;
+        }
+    }
+}
+
+static inline int
+wd_scene_cell_index(wd_scene_t* scene, float coord)
+{
+    return (int) floorf(coord / scene->cell_size);
+}
+
+/* Get the range of the grid cells the item is registered in. Returns FALSE
+ * if it is kept in the list of the big items instead. */
+static BOOL
+wd_scene_item_cells(wd_scene_t* scene, const wd_scene_item_t* item,
+                    int* ix0, int* iy0, int* ix1, int* iy1)
+{
+    if(!item->bounded)
+        return FALSE;
+
+    *ix0 = wd_scene_cell_index(scene, item->bounds.x0);
+    *iy0 = wd_scene_cell_index(scene, item->bounds.y0);
+    *ix1 = wd_scene_cell_index(scene, item->bounds.x1);
+    *iy1 = wd_scene_cell_index(scene, item->bounds.y1);
+    return ((double)(*ix1 - *ix0 + 1) * (double)(*iy1 - *iy0 + 1) <= WD_SCENE_MAXCELLSPERITEM);
+}
+
+/* Remove all the references to the item from the grid (or from the list of
+ * the big items). Works also for an item registered only partially. */
+static void
+wd_scene_unregister(wd_scene_t* scene, UINT index)
+{
+    int ix0, iy0, ix1, iy1;
+    int ix, iy;
+
+    if(!wd_scene_item_cells(scene, &scene->items[index], &ix0, &iy0, &ix1, &iy1)) {
+        wd_scene_pop(scene->big, &scene->n_big, index);
+        return;
+    }
+
+    for(iy = iy0; iy <= iy1; iy++) {
+        for(ix = ix0; ix <= ix1; ix++) {
+            wd_scene_cell_t* cell = wd_scene_lookup(scene, ix, iy);
+
+            if(cell == NULL)
+                continue;
+            wd_scene_pop(cell->items, &cell->n, index);
+            if(cell->n == 0)
+                wd_scene_remove_cell(scene, cell);
+        }
+    }
+}
+
+static inline BOOL
+wd_scene_overlap(const WD_RECT* r0, const WD_RECT* r1)
+{
+    return (r0->x0 < r1->x1  &&  r1->x0 < r0->x1  &&
+            r0->y0 < r1->y1  &&  r1->y0 < r0->y1);
+}
+
+static BOOL
+wd_scene_item_contains(const wd_scene_item_t* item, float x, float y)
+{
+    const float* a = item->cmd.a;
+    float margin = 0.0f;
+
+    if(!item->bounded)
+        return FALSE;
+
+    if(!(item->bounds.x0 <= x  &&  x <= item->bounds.x1  &&
+         item->bounds.y0 <= y  &&  y <= item->bounds.y1))
+        return FALSE;
+
+    switch(item->cmd.kind) {
+        case WD_CMD_DRAWRECT:
+            margin = 0.5f * a[4];
+            /* Pass through */
+        case WD_CMD_FILLRECT:
+        case WD_CMD_DRAWSTRING:
+        case WD_CMD_BITBLTIMAGE:
+            return (WD_MIN(a[0], a[2]) - margin <= x  &&  x <= WD_MAX(a[0], a[2]) + margin  &&
+                    WD_MIN(a[1], a[3]) - margin <= y  &&  y <= WD_MAX(a[1], a[3]) + margin);
+
+        case WD_CMD_FILLPATH:
+            return wdPathContainsPoint((WD_HPATH) item->cmd.obj, x, y);
+
+        case WD_CMD_DRAWPATH:
+            return wdPathStrokeContainsPoint((WD_HPATH) item->cmd.obj, x, y,
+                        a[0], (WD_HSTROKESTYLE) item->cmd.style);
+
+        default:
+            return TRUE;
+    }
+}
+
+static int
+wd_scene_ref_cmp(const void* p0, const void* p1)
+{
+    const wd_scene_ref_t* r0 = (const wd_scene_ref_t*) p0;
+    const wd_scene_ref_t* r1 = (const wd_scene_ref_t*) p1;
+
+    if(r0->z != r1->z)
+        return (r0->z < r1->z ? -1 : +1);
+    if(r0->seq != r1->seq)
+        return (r0->seq < r1->seq ? -1 : +1);
+    return 0;
+}
+
+WD_HSCENE
+wdCreateScene(float fCellSize)
+{
+    wd_scene_t* scene;
+
+    scene = (wd_scene_t*) malloc(sizeof(wd_scene_t));
+    if(scene == NULL) {
+        WD_TRACE("wdCreateScene: malloc() failed.");
+        return NULL;
+    }
+
+    memset(scene, 0, sizeof(wd_scene_t));
+    scene->cell_size = (fCellSize > 0.0f ? fCellSize : WD_SCENE_DEFAULT_CELLSIZE);
+    return (WD_HSCENE) scene;
+}
+
+void
+wdDestroyScene(WD_HSCENE hScene)
+{
+    wd_scene_t* scene = (wd_scene_t*) hScene;
+    UINT i;
+
+    for(i = 0; i < scene->n_items; i++) {
+        if(scene->items[i].alive)
+            free((void*) scene->items[i].cmd.data);
+    }
+    for(i = 0; i < scene->alloc_cells; i++)
+        free(scene->cells[i].items);
+
+    free(scene->items);
+    free(scene->free_slots);
+    free(scene->cells);
+    free(scene->big);
+    free(scene->refs);
+    free(scene);
+}
+
+UINT
+wdAddSceneItem(WD_HSCENE hScene, const WD_SCENEITEM* pItem)
+{
+    wd_scene_t* scene = (wd_scene_t*) hScene;
+    wd_scene_item_t* item;
+    wd_cmd_t* cmd;
+    UINT index;
+    int ix0, iy0, ix1, iy1;
+    int ix, iy;
+
+    if(scene->n_free == 0  &&  scene->n_items >= scene->alloc_items) {
+        UINT alloc = (scene->alloc_items > 0 ? 2 * scene->alloc_items : 64);
+        wd_scene_item_t* items;
+
+        items = (wd_scene_item_t*) realloc(scene->items, alloc * sizeof(wd_scene_item_t));
+        if(items == NULL) {
+            WD_TRACE("wdAddSceneItem: realloc() failed.");
+            return 0;
+        }
+        scene->items = items;
+        scene->alloc_items = alloc;
+    }
+
+    index = (scene->n_free > 0 ? scene->free_slots[scene->n_free - 1] : scene->n_items);
+    item = &scene->items[index];
+    memset(item, 0, sizeof(wd_scene_item_t));
+    cmd = &item->cmd;
+
+    switch(pItem->uKind) {
+        case WD_SCENEITEM_FILLRECT:
+            wd_cmd_init(cmd, WD_CMD_FILLRECT);
+            break;
+        case WD_SCENEITEM_DRAWRECT:
+            wd_cmd_init(cmd, WD_CMD_DRAWRECT);
+            cmd->a[4] = pItem->fStrokeWidth;
+            break;
+        case WD_SCENEITEM_FILLPATH:
+            wd_cmd_init(cmd, WD_CMD_FILLPATH);
+            cmd->obj = pItem->hPath;
+            break;
+        case WD_SCENEITEM_DRAWPATH:
+            wd_cmd_init(cmd, WD_CMD_DRAWPATH);
+            cmd->obj = pItem->hPath;
+            break;
+        case WD_SCENEITEM_TEXT:
+            wd_cmd_init(cmd, WD_CMD_DRAWSTRING);
+            cmd->obj = pItem->hFont;
+            cmd->dw = pItem->dwTextFlags;
+            break;
+        case WD_SCENEITEM_IMAGE:
+            wd_cmd_init(cmd, WD_CMD_BITBLTIMAGE);
+            cmd->obj = pItem->hImage;
+            break;
+        default:
+            WD_TRACE("wdAddSceneItem: Unknown item kind %u.", pItem->uKind);
+            return 0;
+    }
+
+    cmd->brush = pItem->hBrush;
+    if(cmd->kind == WD_CMD_DRAWRECT  ||  cmd->kind == WD_CMD_DRAWPATH)
+        cmd->style = pItem->hStrokeStyle;
+    if(cmd->kind == WD_CMD_DRAWPATH) {
+        cmd->a[0] = pItem->fStrokeWidth;
+    } else if(cmd->kind != WD_CMD_FILLPATH) {
+        cmd->flags |= WD_CMDFLAG_HASRECT;
+        memcpy(&cmd->a[0], &pItem->rect, sizeof(WD_RECT));
+    }
+
+    if(cmd->kind == WD_CMD_DRAWSTRING) {
+        int len = (pItem->iTextLength >= 0 ? pItem->iTextLength : (int) wcslen(pItem->pszText));
+        WCHAR* text;
+
+        text = (WCHAR*) malloc((len + 1) * sizeof(WCHAR));
+        if(text == NULL) {
+            WD_TRACE("wdAddSceneItem: malloc() failed.");
+            return 0;
+        }
+        memcpy(text, pItem->pszText, len * sizeof(WCHAR));
+        text[len] = L'\0';
+        cmd->data = text;
+        cmd->len = len;
+    }
+
+    item->z = pItem->iZOrder;
+    item->lp = pItem->lParam;
+    item->bounded = wd_cmd_bounds(cmd, &item->bounds);
+
+    /* Register the item in the grid. */
+    if(!wd_scene_item_cells(scene, item, &ix0, &iy0, &ix1, &iy1)) {
+        if(!wd_scene_push(&scene->big, &scene->n_big, &scene->alloc_big, index))
+            goto err_register;
+    } else {
+        for(iy = iy0; iy <= iy1; iy++) {
+            for(ix = ix0; ix <= ix1; ix++) {
+                wd_scene_cell_t* cell;
+
+                cell = wd_scene_insert_cell(scene, ix, iy);
+                if(cell == NULL  ||  !wd_scene_push(&cell->items, &cell->n, &cell->alloc, index))
+                    goto err_register;
+            }
+        }
+    }
+
+    item->alive = TRUE;
+    item->seq = scene->seq++;
+    if(index == scene->n_items)
+        scene->n_items++;
+    else
+        scene->n_free--;
+    return index + 1;
+
+err_register:
+    /* Some cells may already refer to the item. */
+    WD_TRACE("wdAddSceneItem: Failed to register the item in the index.");
+    wd_scene_unregister(scene, index);
+    free((void*) cmd->data);
+    return 0;
+}
+
+void
+wdRemoveSceneItem(WD_HSCENE hScene, UINT uItemId)
+{
+    wd_scene_t* scene = (wd_scene_t*) hScene;
+    wd_scene_item_t* item;
+
+    if(uItemId == 0  ||  uItemId > scene->n_items  ||  !scene->items[uItemId - 1].alive) {
+        WD_TRACE("wdRemoveSceneItem: Invalid item ID.");
+        return;
+    }
+
+    item = &scene->items[uItemId - 1];
+    wd_scene_unregister(scene, uItemId - 1);
+    free((void*) item->cmd.data);
+    item->cmd.data = NULL;
+    item->alive = FALSE;
+
+    /* If this fails, the slot is just not reused. */
+    if(!wd_scene_push(&scene->free_slots, &scene->n_free, &scene->alloc_free, uItemId - 1))
+        WD_TRACE("wdRemoveSceneItem: wd_scene_push() failed.");
+}
+
+static void
+wd_scene_collect(wd_scene_t* scene, const UINT* indexes, UINT n,
+                 const WD_RECT* rect, UINT* p_n_refs)
+{
+    UINT i;
+
+    for(i = 0; i < n; i++) {
+        wd_scene_item_t* item = &scene->items[indexes[i]];
+
+        if(!item->alive  ||  item->stamp == scene->stamp)
+            continue;
+        item->stamp = scene->stamp;
+
+        if(item->bounded  &&  rect != NULL  &&  !wd_scene_overlap(&item->bounds, rect))
+            continue;
+
+        scene->refs[*p_n_refs].z = item->z;
+        scene->refs[*p_n_refs].seq = item->seq;
+        scene->refs[*p_n_refs].index = indexes[i];
+        (*p_n_refs)++;
+    }
+}
+
+void
+wdRenderScene(WD_HCANVAS hCanvas, WD_HSCENE hScene, const WD_RECT* pDirtyRect)
+{
+    wd_scene_t* scene = (wd_scene_t*) hScene;
+    UINT n_refs = 0;
+    UINT i;
+
+    if(scene->alloc_refs < scene->n_items) {
+        wd_scene_ref_t* refs;
+
+        refs = (wd_scene_ref_t*) realloc(scene->refs, scene->alloc_items * sizeof(wd_scene_ref_t));
+        if(refs == NULL) {
+            WD_TRACE("wdRenderScene: realloc() failed.");
+            return;
+        }
+        scene->refs = refs;
+        scene->alloc_refs = scene->alloc_items;
+    }
+
+    scene->stamp++;
+
+    if(pDirtyRect == NULL) {
+        for(i = 0; i < scene->n_items; i++) {
+            if(scene->items[i].alive) {
+                scene->refs[n_refs].z = scene->items[i].z;
+                scene->refs[n_refs].seq = scene->items[i].seq;
+                scene->refs[n_refs].index = i;
+                n_refs++;
+            }
+        }
+    } else {
+        WD_RECT dirty;
+        float margin_x, margin_y;
+        int ix0, iy0, ix1, iy1;
+
+        /* The item bounds do not include the anti-aliasing margin (one device
+         * pixel), so grow the dirty rect instead. */
+        wd_cull_aa_margin(hCanvas, &margin_x, &margin_y);
+        dirty.x0 = pDirtyRect->x0 - margin_x;
+        dirty.y0 = pDirtyRect->y0 - margin_y;
+        dirty.x1 = pDirtyRect->x1 + margin_x;
+        dirty.y1 = pDirtyRect->y1 + margin_y;
+
+        ix0 = wd_scene_cell_index(scene, dirty.x0);
+        iy0 = wd_scene_cell_index(scene, dirty.y0);
+        ix1 = wd_scene_cell_index(scene, dirty.x1);
+        iy1 = wd_scene_cell_index(scene, dirty.y1);
+
+        wd_scene_collect(scene, scene->big, scene->n_big, &dirty, &n_refs);
+
+        if((double)(ix1 - ix0 + 1) * (double)(iy1 - iy0 + 1) <= (double) scene->n_cells) {
+            int ix, iy;
+
+            for(iy = iy0; iy <= iy1; iy++) {
+                for(ix = ix0; ix <= ix1; ix++) {
+                    wd_scene_cell_t* cell = wd_scene_lookup(scene, ix, iy);
+                    if(cell != NULL)
+                        wd_scene_collect(scene, cell->items, cell->n, &dirty, &n_refs);
+                }
+            }
+        } else {
+            /* The dirty rect spans more cells than we have; walk the table. */
+            for(i = 0; i < scene->alloc_cells; i++) {
+                wd_scene_cell_t* cell = &scene->cells[i];
+
+                if(cell->used  &&  ix0 <= cell->ix  &&  cell->ix <= ix1  &&
+                   iy0 <= cell->iy  &&  cell->iy <= iy1)
+                    wd_scene_collect(scene, cell->items, cell->n, &dirty, &n_refs);
+            }
+        }
+    }
+
+    qsort(scene->refs, n_refs, sizeof(wd_scene_ref_t), wd_scene_ref_cmp);
+
+    for(i = 0; i < n_refs; i++)
+        wd_cmd_execute(hCanvas, &scene->items[scene->refs[i].index].cmd);
+}
+
+UINT
+wdSceneHitTest(WD_HSCENE hScene, float x, float y, LPARAM* plParam)
+{
+    wd_scene_t* scene = (wd_scene_t*) hScene;
+    wd_scene_cell_t* cell;
+    UINT best = 0;
+    int best_z = 0;
+    UINT best_seq = 0;
+    UINT pass;
+
+    cell = wd_scene_lookup(scene, wd_scene_cell_index(scene, x),
+                           wd_scene_cell_index(scene, y));
+
+    /* The topmost item is the one with the highest z-order; among equal ones
+     * the later added. */
+    for(pass = 0; pass < 2; pass++) {
+        const UINT* indexes = (pass == 0 ? scene->big : (cell != NULL ? cell->items : NULL));
+        UINT n = (pass == 0 ? scene->n_big : (cell != NULL ? cell->n : 0));
+        UINT i;
+
+        for(i = 0; i < n; i++) {
+            wd_scene_item_t* item = &scene->items[indexes[i]];
+
+            if(!item->alive  ||  !wd_scene_item_contains(item, x, y))
+                continue;
+
+            if(best == 0  ||  item->z > best_z  ||
+               (item->z == best_z  &&  item->seq > best_seq))
+            {
+                best = indexes[i] + 1;
+                best_z = item->z;
+                best_seq = item->seq;
+            }
+        }
+    }
+
+    if(plParam != NULL)
+        *plParam = (best != 0 ? scene->items[best - 1].lp : 0);
+    return best;
+}
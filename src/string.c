@@ -33,32 +33,42 @@ wdDrawString(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
              const WCHAR* pszText, int iTextLength, WD_HBRUSH hBrush,
              DWORD dwFlags)
 {
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook_string(hCanvas, hFont, pRect, pszText, iTextLength, hBrush, dwFlags))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWSTRING, (void*) hFont, dwFlags, (const float*) pRect))
+        return;
+
     if(d2d_enabled()) {
         dwrite_font_t* font = (dwrite_font_t*) hFont;
         c_D2D1_POINT_2F origin = { pRect->x0, pRect->y0 };
         d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
         c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
         c_IDWriteTextLayout* layout;
+        dwrite_layout_t entry;
+        DWORD layout_flags = dwFlags;
         c_D2D1_MATRIX_3X2_F old_matrix;
 
-        layout = dwrite_create_text_layout(font->tf, pRect, pszText, iTextLength, dwFlags);
+        if(c->flags & D2D_CANVASFLAG_RTL)
+            layout_flags |= DWRITE_LAYOUT_RTL;
+
+        layout = dwrite_acquire_text_layout(font, pRect, pszText, iTextLength,
+                                            layout_flags, &entry);
         if(layout == NULL) {
-            WD_TRACE("wdDrawString: dwrite_create_text_layout() failed.");
+            WD_TRACE("wdDrawString: dwrite_acquire_text_layout() failed.");
             return;
         }
 
         if(c->flags & D2D_CANVASFLAG_RTL) {
             d2d_disable_rtl_transform(c, &old_matrix);
             origin.x = (float)c->width - pRect->x1;
-
-            c_IDWriteTextLayout_SetReadingDirection(layout,
-                    c_DWRITE_READING_DIRECTION_RIGHT_TO_LEFT);
         }
 
         c_ID2D1RenderTarget_DrawTextLayout(c->target, origin, layout, b,
                 (dwFlags & WD_STR_NOCLIP) ? 0 : c_D2D1_DRAW_TEXT_OPTIONS_CLIP);
 
-        c_IDWriteTextLayout_Release(layout);
+        dwrite_release_text_layout(font, pszText, &entry);
 
         if(c->flags & D2D_CANVASFLAG_RTL) {
             c_ID2D1RenderTarget_SetTransform(c->target, &old_matrix);
@@ -96,11 +106,13 @@ wdMeasureString(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
     if(d2d_enabled()) {
         dwrite_font_t* font = (dwrite_font_t*) hFont;
         c_IDWriteTextLayout* layout;
+        dwrite_layout_t entry;
         c_DWRITE_TEXT_METRICS tm;
 
-        layout = dwrite_create_text_layout(font->tf, pRect, pszText, iTextLength, dwFlags);
+        layout = dwrite_acquire_text_layout(font, pRect, pszText, iTextLength,
+                                            dwFlags, &entry);
         if(layout == NULL) {
-            WD_TRACE("wdMeasureString: dwrite_create_text_layout() failed.");
+            WD_TRACE("wdMeasureString: dwrite_acquire_text_layout() failed.");
             return;
         }
 
@@ -111,9 +123,8 @@ wdMeasureString(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
         pResult->x1 = pResult->x0 + tm.width;
         pResult->y1 = pResult->y0 + tm.height;
 
-        c_IDWriteTextLayout_Release(layout);
+        dwrite_release_text_layout(font, pszText, &entry);
     } else {
-        HDC screen_dc;
         gdix_canvas_t* c;
         c_GpRectF r;
         c_GpFont* f = (c_GpFont*) hFont;
@@ -122,10 +133,9 @@ wdMeasureString(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
         if(hCanvas != NULL) {
             c = (gdix_canvas_t*) hCanvas;
         } else {
-            screen_dc = GetDCEx(NULL, NULL, DCX_CACHE);
-            c = gdix_canvas_alloc(screen_dc, NULL, pRect->x1 - pRect->x0, FALSE);
+            c = gdix_measure_canvas();
             if(c == NULL) {
-                WD_TRACE("wdMeasureString: gdix_canvas_alloc() failed.");
+                WD_TRACE("wdMeasureString: gdix_measure_canvas() failed.");
                 pResult->x0 = 0.0f;
                 pResult->y0 = 0.0f;
                 pResult->x1 = 0.0f;
@@ -151,11 +161,6 @@ wdMeasureString(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
         if(c->rtl)
             gdix_rtl_transform(c);
 
-        if(hCanvas == NULL) {
-            gdix_canvas_free(c);
-            ReleaseDC(NULL, screen_dc);
-        }
-
         pResult->x0 = br.x;
         pResult->y0 = br.y;
         pResult->x1 = br.x + br.w;
@@ -163,6 +168,90 @@ wdMeasureString(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_RECT* pRect,
     }
 }
 
+void
+wdMeasureStrings(WD_HCANVAS hCanvas, WD_HFONT hFont, const WD_STRINGREF* pStrings,
+                 UINT uCount, float fMaxWidth, DWORD dwFlags, WD_RECT* pResults)
+{
+    WD_RECT rect = { 0.0f, 0.0f, 10000.0f, 10000.0f };
+    UINT i;
+
+    if(fMaxWidth > 0.0f)
+        rect.x1 = fMaxWidth;
+
+    if(d2d_enabled()) {
+        dwrite_font_t* font = (dwrite_font_t*) hFont;
+        c_IDWriteTextLayout* layout;
+        c_DWRITE_TEXT_METRICS tm;
+        int len;
+
+        /* Bypass the layout cache of the font: The strings are typically all
+         * different so they would only flush out the layouts wdDrawString()
+         * reuses on every repaint. */
+        for(i = 0; i < uCount; i++) {
+            len = pStrings[i].iTextLength;
+            if(len < 0)
+                len = wcslen(pStrings[i].pszText);
+
+            layout = dwrite_create_text_layout(font, &rect, pStrings[i].pszText,
+                                               len, dwFlags);
+            if(layout == NULL) {
+                WD_TRACE("wdMeasureStrings: dwrite_create_text_layout() failed.");
+                memset(&pResults[i], 0, sizeof(WD_RECT));
+                continue;
+            }
+
+            c_IDWriteTextLayout_GetMetrics(layout, &tm);
+            c_IDWriteTextLayout_Release(layout);
+
+            pResults[i].x0 = tm.left;
+            pResults[i].y0 = tm.top;
+            pResults[i].x1 = tm.left + tm.width;
+            pResults[i].y1 = tm.top + tm.height;
+        }
+    } else {
+        gdix_canvas_t* c;
+        c_GpRectF r;
+        c_GpFont* f = (c_GpFont*) hFont;
+        c_GpRectF br;
+
+        if(hCanvas != NULL) {
+            c = (gdix_canvas_t*) hCanvas;
+        } else {
+            c = gdix_measure_canvas();
+            if(c == NULL) {
+                WD_TRACE("wdMeasureStrings: gdix_measure_canvas() failed.");
+                memset(pResults, 0, uCount * sizeof(WD_RECT));
+                return;
+            }
+        }
+
+        if(c->rtl) {
+            gdix_rtl_transform(c);
+            r.x = (float)(c->width-1) - rect.x1;
+        } else {
+            r.x = rect.x0;
+        }
+        r.y = rect.y0;
+        r.w = rect.x1 - rect.x0;
+        r.h = rect.y1 - rect.y0;
+
+        gdix_canvas_apply_string_flags(c, dwFlags);
+        for(i = 0; i < uCount; i++) {
+            gdix_vtable->fn_MeasureString(c->graphics, pStrings[i].pszText,
+                    pStrings[i].iTextLength, f, &r, c->string_format, &br,
+                    NULL, NULL);
+
+            pResults[i].x0 = br.x;
+            pResults[i].y0 = br.y;
+            pResults[i].x1 = br.x + br.w;
+            pResults[i].y1 = br.y + br.h;
+        }
+
+        if(c->rtl)
+            gdix_rtl_transform(c);
+    }
+}
+
 float
 wdStringWidth(WD_HCANVAS hCanvas, WD_HFONT hFont, const WCHAR* pszText)
 {
@@ -174,6 +263,31 @@ wdStringWidth(WD_HCANVAS hCanvas, WD_HFONT hFont, const WCHAR* pszText)
     return WD_ABS(rcResult.x1 - rcResult.x0);
 }
 
+float
+wdMeasureStringFast(WD_HCANVAS hCanvas, WD_HFONT hFont, const WCHAR* pszText,
+                    int iTextLength)
+{
+    const WD_RECT rcClip = { 0.0f, 0.0f, 10000.0f, 10000.0f };
+    WD_RECT rcResult;
+
+    if(hFont == NULL)
+        return 0.0f;
+
+    if(d2d_enabled()) {
+        float width;
+
+        if(dwrite_measure_simple((dwrite_font_t*) hFont, pszText, iTextLength, &width))
+            return width;
+    }
+
+    /* Fall back to the full text layout. */
+    if(iTextLength < 0)
+        iTextLength = wcslen(pszText);
+    wdMeasureString(hCanvas, hFont, &rcClip, pszText, iTextLength,
+                &rcResult, WD_STR_LEFTALIGN | WD_STR_NOWRAP);
+    return WD_ABS(rcResult.x1 - rcResult.x0);
+}
+
 float
 wdStringHeight(WD_HFONT hFont, const WCHAR* pszText)
 {
@@ -182,3 +296,31 @@ wdStringHeight(WD_HFONT hFont, const WCHAR* pszText)
     wdFontMetrics(hFont, &metrics);
     return metrics.fLeading;
 }
+
+void
+wdGetTextCacheStats(WD_TEXTCACHESTATS* pStats)
+{
+    wd_lock();
+    pStats->uLayoutHits = dwrite_layout_hits;
+    pStats->uLayoutMisses = dwrite_layout_misses;
+    pStats->uFontHits = font_cache_hits;
+    pStats->uFontMisses = font_cache_misses;
+    wd_unlock();
+}
+
+void
+wdResetTextCacheStats(void)
+{
+    wd_lock();
+    dwrite_layout_hits = 0;
+    dwrite_layout_misses = 0;
+    font_cache_hits = 0;
+    font_cache_misses = 0;
+    wd_unlock();
+}
+
+void
+wdSetTextCacheLimit(UINT uMaxLayouts)
+{
+    dwrite_layout_limit = uMaxLayouts;
+}
@@ -26,6 +26,8 @@
 #include "lock.h"
 #include "backend-d2d.h"
 #include "backend-gdix.h"
+#include "apitrace.h"
+#include "hook.h"
 
 
 static WD_HSTROKESTYLE
@@ -76,6 +78,25 @@ wdCreateStrokeStyleImpl(UINT dashStyle, const float* dashes, UINT dashesCount, U
     }
 }
 
+static WD_HSTROKESTYLE
+wdCreateStrokeStyleTraced(UINT dashStyle, const float* dashes, UINT dashesCount, UINT lineCap, UINT lineJoin)
+{
+    WD_HSTROKESTYLE s;
+    UINT32 args[4] = { dashStyle, lineCap, lineJoin, dashesCount };
+
+    s = wdCreateStrokeStyleImpl(dashStyle, dashes, dashesCount, lineCap, lineJoin);
+    wd_apitrace_create(WD_APITRACE_OP_CREATESTROKESTYLE, s, NULL, args, sizeof(args),
+                       dashes, dashesCount * sizeof(float), NULL, 0);
+    return s;
+}
+
+
+WD_HSTROKESTYLE
+wd_stroke_style_create(UINT dashStyle, const float* dashes, UINT dashesCount,
+                       UINT lineCap, UINT lineJoin)
+{
+    return wdCreateStrokeStyleTraced(dashStyle, dashes, dashesCount, lineCap, lineJoin);
+}
 
 WD_HSTROKESTYLE 
 wdCreateStrokeStyle(UINT dashStyle, UINT lineCap, UINT lineJoin)
@@ -94,14 +115,14 @@ wdCreateStrokeStyle(UINT dashStyle, UINT lineCap, UINT lineJoin)
         const float* pattern;
         UINT pattern_size;
     } style_data[] = {
-        { 0, NULL, 0 },
-        { 5, pattern_dash,         WD_SIZEOF_ARRAY(pattern_dash) },
-        { 5, pattern_dot,          WD_SIZEOF_ARRAY(pattern_dot) },
-        { 5, pattern_dash_dot,     WD_SIZEOF_ARRAY(pattern_dash_dot) },
-        { 5, pattern_dash_dot_dot, WD_SIZEOF_ARRAY(pattern_dash_dot_dot) }
+        { WD_STROKESTYLE_DASH_SOLID,  NULL, 0 },
+        { WD_STROKESTYLE_DASH_CUSTOM, pattern_dash,         WD_SIZEOF_ARRAY(pattern_dash) },
+        { WD_STROKESTYLE_DASH_CUSTOM, pattern_dot,          WD_SIZEOF_ARRAY(pattern_dot) },
+        { WD_STROKESTYLE_DASH_CUSTOM, pattern_dash_dot,     WD_SIZEOF_ARRAY(pattern_dash_dot) },
+        { WD_STROKESTYLE_DASH_CUSTOM, pattern_dash_dot_dot, WD_SIZEOF_ARRAY(pattern_dash_dot_dot) }
     };
 
-    return wdCreateStrokeStyleImpl(style_data[dashStyle].style_id,
+    return wdCreateStrokeStyleTraced(style_data[dashStyle].style_id,
                 style_data[dashStyle].pattern, style_data[dashStyle].pattern_size,
                 lineCap, lineJoin);
 }
@@ -109,15 +130,86 @@ wdCreateStrokeStyle(UINT dashStyle, UINT lineCap, UINT lineJoin)
 WD_HSTROKESTYLE 
 wdCreateStrokeStyleCustom(const float* dashes, UINT dashesCount, UINT lineCap, UINT lineJoin)
 {
-    return wdCreateStrokeStyleImpl(5 /* CUSTOM */, dashes, dashesCount, lineCap, lineJoin);
+    return wdCreateStrokeStyleTraced(WD_STROKESTYLE_DASH_CUSTOM, dashes, dashesCount, lineCap, lineJoin);
 }
 
 void
 wdDestroyStrokeStyle(WD_HSTROKESTYLE hStrokeStyle)
 {
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYSTROKESTYLE, hStrokeStyle);
+    wd_hook_object_changing(hStrokeStyle);
+
     if(d2d_enabled()) {
         c_ID2D1StrokeStyle_Release((c_ID2D1StrokeStyle*) hStrokeStyle);
     } else {
         free((gdix_strokestyle_t*) hStrokeStyle);
     }
 }
+
+
+/* Stroke styles kept by the canvas are identified by this key, followed by
+ * the dashes (if any). Custom styles with longer patterns are not shared. */
+#define STROKESTYLE_CUSTOM          0xffffffff
+#define STROKESTYLE_MAX_DASHES      16
+
+static WD_HSTROKESTYLE
+wd_get_stroke_style(WD_HCANVAS hCanvas, UINT dashStyle, const float* dashes,
+                    UINT dashesCount, UINT lineCap, UINT lineJoin)
+{
+    wd_intern_t* intern = NULL;
+    UINT32 key[4 + STROKESTYLE_MAX_DASHES];
+    UINT key_size = 4 * sizeof(UINT32) + dashesCount * sizeof(float);
+    WD_HSTROKESTYLE s;
+
+    if(dashesCount <= STROKESTYLE_MAX_DASHES) {
+        key[0] = dashStyle;
+        key[1] = lineCap;
+        key[2] = lineJoin;
+        key[3] = dashesCount;
+        if(dashesCount > 0)
+            memcpy(key + 4, dashes, dashesCount * sizeof(float));
+
+        intern = wd_canvas_intern(hCanvas);
+        if(intern != NULL) {
+            s = (WD_HSTROKESTYLE) wd_intern_lookup(&intern->styles, key, key_size, TRUE);
+            if(s != NULL)
+                return s;
+        }
+    }
+
+    if(dashStyle == STROKESTYLE_CUSTOM)
+        s = wdCreateStrokeStyleCustom(dashes, dashesCount, lineCap, lineJoin);
+    else
+        s = wdCreateStrokeStyle(dashStyle, lineCap, lineJoin);
+    if(s == NULL) {
+        WD_TRACE("wd_get_stroke_style: Stroke style creation failed.");
+        return NULL;
+    }
+
+    if(intern != NULL)
+        wd_intern_insert(&intern->styles, key, key_size, s, TRUE);
+    return s;
+}
+
+WD_HSTROKESTYLE
+wdGetStrokeStyle(WD_HCANVAS hCanvas, UINT dashStyle, UINT lineCap, UINT lineJoin)
+{
+    return wd_get_stroke_style(hCanvas, dashStyle, NULL, 0, lineCap, lineJoin);
+}
+
+WD_HSTROKESTYLE
+wdGetStrokeStyleCustom(WD_HCANVAS hCanvas, const float* dashes, UINT dashesCount,
+                       UINT lineCap, UINT lineJoin)
+{
+    return wd_get_stroke_style(hCanvas, STROKESTYLE_CUSTOM, dashes, dashesCount,
+                               lineCap, lineJoin);
+}
+
+void
+wdReleaseStrokeStyle(WD_HCANVAS hCanvas, WD_HSTROKESTYLE hStrokeStyle)
+{
+    wd_intern_t* intern = wd_canvas_intern(hCanvas);
+
+    if(intern == NULL  ||  !wd_intern_release(&intern->styles, hStrokeStyle))
+        wdDestroyStrokeStyle(hStrokeStyle);
+}
@@ -0,0 +1,516 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "misc.h"
+#include "backend-d2d.h"
+#include "backend-dwrite.h"
+#include "backend-gdix.h"
+#include "apitrace.h"
+#include "hook.h"
+
+
+/* With Direct2D, the text layout object is just a wrapper of
+ * IDWriteTextLayout, so the text is shaped only once when the layout is
+ * created.
+ *
+ * GDI+ has no such concept. We keep a copy of the string and measure it
+ * once when creating the layout. The boxes of the individual characters (for
+ * the hit testing) are measured only when first needed.
+ */
+
+/* GDI+ measures at most 32 character ranges per call. */
+#define TEXTLAYOUT_GDIX_MAX_RANGES      32
+
+
+typedef struct textlayout_tag textlayout_t;
+struct textlayout_tag {
+    WD_HFONT font;
+    float width;
+    float height;
+    DWORD flags;
+
+    /* Direct2D only. */
+    c_IDWriteTextLayout* layout;
+    BOOL rtl;                   /* Reading direction currently set. */
+
+    /* GDI+ only. */
+    WCHAR* text;
+    int len;
+    WD_TEXTLAYOUTMETRICS metrics;
+    c_GpRectF* boxes;           /* Boxes of the characters (or NULL). */
+};
+
+
+/* Temporary canvas for the GDI+ measurements. (The layout is not bound to
+ * any canvas so we use the screen as wdMeasureString() does.) */
+static gdix_canvas_t*
+textlayout_gdix_begin(textlayout_t* tl, HDC* p_dc)
+{
+    gdix_canvas_t* c;
+
+    *p_dc = GetDCEx(NULL, NULL, DCX_CACHE);
+    c = gdix_canvas_alloc(*p_dc, NULL, (UINT) tl->width, FALSE);
+    if(c == NULL) {
+        WD_TRACE("textlayout_gdix_begin: gdix_canvas_alloc() failed.");
+        ReleaseDC(NULL, *p_dc);
+        return NULL;
+    }
+
+    gdix_canvas_apply_string_flags(c, tl->flags);
+    return c;
+}
+
+static void
+textlayout_gdix_end(gdix_canvas_t* c, HDC dc)
+{
+    gdix_canvas_free(c);
+    ReleaseDC(NULL, dc);
+}
+
+static BOOL
+textlayout_gdix_measure(textlayout_t* tl)
+{
+    gdix_canvas_t* c;
+    HDC dc;
+    c_GpRectF r = { 0.0f, 0.0f, tl->width, tl->height };
+    c_GpRectF br;
+    int lines = 0;
+    int status;
+
+    c = textlayout_gdix_begin(tl, &dc);
+    if(c == NULL)
+        return FALSE;
+
+    status = gdix_vtable->fn_MeasureString(c->graphics, tl->text, tl->len,
+                (c_GpFont*) tl->font, &r, c->string_format, &br, NULL, &lines);
+    textlayout_gdix_end(c, dc);
+    if(status != 0) {
+        WD_TRACE("textlayout_gdix_measure: GdipMeasureString() failed. [%d]", status);
+        return FALSE;
+    }
+
+    tl->metrics.fLeft = br.x;
+    tl->metrics.fTop = br.y;
+    tl->metrics.fWidth = br.w;
+    tl->metrics.fHeight = br.h;
+    tl->metrics.uLineCount = (UINT) lines;
+    return TRUE;
+}
+
+static BOOL
+textlayout_gdix_boxes(textlayout_t* tl)
+{
+    c_GpCharacterRange ranges[TEXTLAYOUT_GDIX_MAX_RANGES];
+    c_GpRegion* regions[TEXTLAYOUT_GDIX_MAX_RANGES];
+    c_GpRectF r = { 0.0f, 0.0f, tl->width, tl->height };
+    c_GpRectF* boxes;
+    gdix_canvas_t* c;
+    HDC dc;
+    int i, j, n;
+    int n_regions = 0;
+    int status = 0;
+
+    if(tl->boxes != NULL)
+        return TRUE;
+    if(tl->len <= 0)
+        return FALSE;
+
+    boxes = (c_GpRectF*) malloc(tl->len * sizeof(c_GpRectF));
+    if(boxes == NULL) {
+        WD_TRACE("textlayout_gdix_boxes: malloc() failed.");
+        return FALSE;
+    }
+
+    c = textlayout_gdix_begin(tl, &dc);
+    if(c == NULL) {
+        free(boxes);
+        return FALSE;
+    }
+
+    for(n_regions = 0; n_regions < TEXTLAYOUT_GDIX_MAX_RANGES; n_regions++) {
+        status = gdix_vtable->fn_CreateRegion(&regions[n_regions]);
+        if(status != 0) {
+            WD_TRACE("textlayout_gdix_boxes: GdipCreateRegion() failed. [%d]", status);
+            goto done;
+        }
+    }
+
+    for(i = 0; i < tl->len; i += n) {
+        n = WD_MIN(tl->len - i, TEXTLAYOUT_GDIX_MAX_RANGES);
+        for(j = 0; j < n; j++) {
+            ranges[j].first = i + j;
+            ranges[j].length = 1;
+        }
+
+        status = gdix_vtable->fn_SetStringFormatMeasurableCharacterRanges(
+                    c->string_format, n, ranges);
+        if(status == 0) {
+            status = gdix_vtable->fn_MeasureCharacterRanges(c->graphics,
+                    tl->text, tl->len, (c_GpFont*) tl->font, &r,
+                    c->string_format, n, regions);
+        }
+        if(status != 0) {
+            WD_TRACE("textlayout_gdix_boxes: "
+                     "GdipMeasureCharacterRanges() failed. [%d]", status);
+            goto done;
+        }
+
+        for(j = 0; j < n; j++)
+            gdix_vtable->fn_GetRegionBounds(regions[j], c->graphics, &boxes[i + j]);
+    }
+
+done:
+    for(j = 0; j < n_regions; j++)
+        gdix_vtable->fn_DeleteRegion(regions[j]);
+    textlayout_gdix_end(c, dc);
+
+    if(status != 0) {
+        free(boxes);
+        return FALSE;
+    }
+
+    tl->boxes = boxes;
+    return TRUE;
+}
+
+static void
+textlayout_gdix_hit(const textlayout_t* tl, int pos, WD_TEXTHITTEST* pResult)
+{
+    const c_GpRectF* box = &tl->boxes[pos];
+
+    pResult->uPosition = (UINT) pos;
+    pResult->uLength = 1;
+    pResult->rcBox.x0 = box->x;
+    pResult->rcBox.y0 = box->y;
+    pResult->rcBox.x1 = box->x + box->w;
+    pResult->rcBox.y1 = box->y + box->h;
+}
+
+static void
+textlayout_d2d_hit(const c_DWRITE_HIT_TEST_METRICS* htm, WD_TEXTHITTEST* pResult)
+{
+    pResult->uPosition = htm->textPosition;
+    pResult->uLength = htm->length;
+    pResult->rcBox.x0 = htm->left;
+    pResult->rcBox.y0 = htm->top;
+    pResult->rcBox.x1 = htm->left + htm->width;
+    pResult->rcBox.y1 = htm->top + htm->height;
+}
+
+
+WD_HTEXTLAYOUT
+wdCreateTextLayout(WD_HFONT hFont, const WCHAR* pszText, int iTextLength,
+                   float fMaxWidth, float fMaxHeight, DWORD dwFlags)
+{
+    wd_apitrace_textlayout_t args;
+    textlayout_t* tl;
+
+    if(iTextLength < 0)
+        iTextLength = wcslen(pszText);
+
+    tl = (textlayout_t*) malloc(sizeof(textlayout_t));
+    if(tl == NULL) {
+        WD_TRACE("wdCreateTextLayout: malloc() failed.");
+        return NULL;
+    }
+    memset(tl, 0, sizeof(textlayout_t));
+    tl->font = hFont;
+    tl->width = fMaxWidth;
+    tl->height = fMaxHeight;
+    tl->flags = dwFlags;
+
+    if(d2d_enabled()) {
+        WD_RECT rect = { 0.0f, 0.0f, fMaxWidth, fMaxHeight };
+
+        tl->layout = dwrite_create_text_layout((dwrite_font_t*) hFont, &rect,
+                            pszText, iTextLength, dwFlags);
+        if(tl->layout == NULL) {
+            WD_TRACE("wdCreateTextLayout: dwrite_create_text_layout() failed.");
+            goto err;
+        }
+    } else {
+        tl->text = (WCHAR*) malloc((iTextLength + 1) * sizeof(WCHAR));
+        if(tl->text == NULL) {
+            WD_TRACE("wdCreateTextLayout: malloc() failed.");
+            goto err;
+        }
+        memcpy(tl->text, pszText, iTextLength * sizeof(WCHAR));
+        tl->text[iTextLength] = L'\0';
+        tl->len = iTextLength;
+
+        if(!textlayout_gdix_measure(tl)) {
+            WD_TRACE("wdCreateTextLayout: textlayout_gdix_measure() failed.");
+            goto err;
+        }
+    }
+
+    args.width = fMaxWidth;
+    args.height = fMaxHeight;
+    args.flags = dwFlags;
+    args.len = iTextLength;
+    wd_apitrace_create(WD_APITRACE_OP_CREATETEXTLAYOUT, tl, hFont,
+                       &args, sizeof(args), pszText, iTextLength * sizeof(WCHAR), NULL, 0);
+    return (WD_HTEXTLAYOUT) tl;
+
+err:
+    free(tl->text);
+    free(tl);
+    return NULL;
+}
+
+void
+wdDestroyTextLayout(WD_HTEXTLAYOUT hLayout)
+{
+    textlayout_t* tl = (textlayout_t*) hLayout;
+
+    wd_apitrace_handle(WD_APITRACE_OP_DESTROYTEXTLAYOUT, hLayout);
+    wd_hook_object_changing(hLayout);
+
+    if(tl->layout != NULL)
+        c_IDWriteTextLayout_Release(tl->layout);
+    free(tl->boxes);
+    free(tl->text);
+    free(tl);
+}
+
+void
+wdDrawTextLayout(WD_HCANVAS hCanvas, WD_HTEXTLAYOUT hLayout, float x, float y,
+                 WD_HBRUSH hBrush)
+{
+    textlayout_t* tl = (textlayout_t*) hLayout;
+    float a[2] = { x, y };
+
+    if(wd_hooked(hCanvas)) {
+        if(wd_hook(hCanvas, WD_CMD_DRAWTEXTLAYOUT, (void*) hBrush, NULL, (void*) hLayout, a, 2))
+            return;
+    }
+    if(wd_culled(hCanvas, WD_CMD_DRAWTEXTLAYOUT, (void*) hLayout, 0, a))
+        return;
+
+    if(d2d_enabled()) {
+        d2d_canvas_t* c = (d2d_canvas_t*) hCanvas;
+        c_ID2D1Brush* b = (c_ID2D1Brush*) hBrush;
+        c_D2D1_POINT_2F origin = { x, y };
+        c_D2D1_MATRIX_3X2_F old_matrix;
+        BOOL rtl = ((c->flags & D2D_CANVASFLAG_RTL) != 0);
+
+        /* The layout may be painted on canvases of both directions. */
+        if(rtl != tl->rtl) {
+            c_IDWriteTextLayout_SetReadingDirection(tl->layout, (rtl
+                        ? c_DWRITE_READING_DIRECTION_RIGHT_TO_LEFT
+                        : c_DWRITE_READING_DIRECTION_LEFT_TO_RIGHT));
+            tl->rtl = rtl;
+        }
+
+        if(rtl) {
+            d2d_disable_rtl_transform(c, &old_matrix);
+            origin.x = (float)c->width - (x + tl->width);
+        }
+
+        c_ID2D1RenderTarget_DrawTextLayout(c->target, origin, tl->layout, b,
+                (tl->flags & WD_STR_NOCLIP) ? 0 : c_D2D1_DRAW_TEXT_OPTIONS_CLIP);
+
+        if(rtl)
+            c_ID2D1RenderTarget_SetTransform(c->target, &old_matrix);
+    } else {
+        gdix_canvas_t* c = (gdix_canvas_t*) hCanvas;
+        c_GpRectF r;
+
+        if(c->rtl) {
+            gdix_rtl_transform(c);
+            r.x = (float)(c->width-1) - (x + tl->width);
+        } else {
+            r.x = x;
+        }
+        r.y = y;
+        r.w = tl->width;
+        r.h = tl->height;
+
+        gdix_canvas_apply_string_flags(c, tl->flags);
+        gdix_vtable->fn_DrawString(c->graphics, tl->text, tl->len,
+                (c_GpFont*) tl->font, &r, c->string_format, (c_GpBrush*) hBrush);
+
+        if(c->rtl)
+            gdix_rtl_transform(c);
+    }
+}
+
+void
+wdGetTextLayoutMetrics(WD_HTEXTLAYOUT hLayout, WD_TEXTLAYOUTMETRICS* pMetrics)
+{
+    textlayout_t* tl = (textlayout_t*) hLayout;
+
+    if(d2d_enabled()) {
+        c_DWRITE_TEXT_METRICS tm;
+        HRESULT hr;
+
+        hr = c_IDWriteTextLayout_GetMetrics(tl->layout, &tm);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdGetTextLayoutMetrics: "
+                        "IDWriteTextLayout::GetMetrics() failed.");
+            memset(pMetrics, 0, sizeof(WD_TEXTLAYOUTMETRICS));
+            return;
+        }
+
+        pMetrics->fLeft = tm.left;
+        pMetrics->fTop = tm.top;
+        pMetrics->fWidth = tm.width;
+        pMetrics->fHeight = tm.height;
+        pMetrics->uLineCount = tm.lineCount;
+    } else {
+        memcpy(pMetrics, &tl->metrics, sizeof(WD_TEXTLAYOUTMETRICS));
+    }
+}
+
+BOOL
+wdTextLayoutHitTestPoint(WD_HTEXTLAYOUT hLayout, float x, float y,
+                         WD_TEXTHITTEST* pResult)
+{
+    textlayout_t* tl = (textlayout_t*) hLayout;
+
+    memset(pResult, 0, sizeof(WD_TEXTHITTEST));
+
+    if(d2d_enabled()) {
+        c_DWRITE_HIT_TEST_METRICS htm;
+        BOOL trailing;
+        BOOL inside;
+        HRESULT hr;
+
+        hr = c_IDWriteTextLayout_HitTestPoint(tl->layout, x, y, &trailing, &inside, &htm);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdTextLayoutHitTestPoint: "
+                        "IDWriteTextLayout::HitTestPoint() failed.");
+            return FALSE;
+        }
+
+        textlayout_d2d_hit(&htm, pResult);
+        pResult->bTrailing = trailing;
+        pResult->bInside = inside;
+        return inside;
+    } else {
+        const c_GpRectF* box;
+        float dx, dy;
+        float best_dx = FLT_MAX;
+        float best_dy = FLT_MAX;
+        int best = -1;
+        int i;
+
+        if(!textlayout_gdix_boxes(tl))
+            return FALSE;
+
+        /* Find the character under the point or, if there is none, the
+         * nearest one (preferring the nearest line). */
+        for(i = 0; i < tl->len; i++) {
+            box = &tl->boxes[i];
+            if(box->w <= 0.0f  ||  box->h <= 0.0f)
+                continue;   /* Trimmed or clipped out. */
+
+            dx = (x < box->x) ? box->x - x : (x > box->x + box->w) ? x - (box->x + box->w) : 0.0f;
+            dy = (y < box->y) ? box->y - y : (y > box->y + box->h) ? y - (box->y + box->h) : 0.0f;
+            if(dy < best_dy  ||  (dy == best_dy  &&  dx < best_dx)) {
+                best = i;
+                best_dx = dx;
+                best_dy = dy;
+                if(dx == 0.0f  &&  dy == 0.0f)
+                    break;
+            }
+        }
+
+        if(best < 0)
+            return FALSE;
+
+        box = &tl->boxes[best];
+        textlayout_gdix_hit(tl, best, pResult);
+        pResult->bTrailing = (x > box->x + 0.5f * box->w);
+        pResult->bInside = (best_dx == 0.0f  &&  best_dy == 0.0f);
+        return pResult->bInside;
+    }
+}
+
+void
+wdTextLayoutHitTestPosition(WD_HTEXTLAYOUT hLayout, UINT uPosition, BOOL bTrailing,
+                            float* pfX, float* pfY, WD_TEXTHITTEST* pResult)
+{
+    textlayout_t* tl = (textlayout_t*) hLayout;
+    WD_TEXTHITTEST dummy;
+    float x = 0.0f;
+    float y = 0.0f;
+
+    if(pResult == NULL)
+        pResult = &dummy;
+    memset(pResult, 0, sizeof(WD_TEXTHITTEST));
+
+    if(d2d_enabled()) {
+        c_DWRITE_HIT_TEST_METRICS htm;
+        HRESULT hr;
+
+        hr = c_IDWriteTextLayout_HitTestTextPosition(tl->layout, uPosition,
+                    bTrailing, &x, &y, &htm);
+        if(FAILED(hr)) {
+            WD_TRACE_HR("wdTextLayoutHitTestPosition: "
+                        "IDWriteTextLayout::HitTestTextPosition() failed.");
+        } else {
+            textlayout_d2d_hit(&htm, pResult);
+            pResult->bTrailing = bTrailing;
+            pResult->bInside = TRUE;
+        }
+    } else {
+        if(textlayout_gdix_boxes(tl)) {
+            int pos = (int) uPosition;
+
+            /* The position just after the last character is the trailing
+             * edge of that character. */
+            if(pos >= tl->len) {
+                pos = tl->len - 1;
+                bTrailing = TRUE;
+            }
+
+            textlayout_gdix_hit(tl, pos, pResult);
+            pResult->bTrailing = bTrailing;
+            pResult->bInside = TRUE;
+            x = (bTrailing ? pResult->rcBox.x1 : pResult->rcBox.x0);
+            y = pResult->rcBox.y0;
+        }
+    }
+
+    if(pfX != NULL)
+        *pfX = x;
+    if(pfY != NULL)
+        *pfY = y;
+}
+
+BOOL
+wd_textlayout_bounds(WD_HTEXTLAYOUT hLayout, float x, float y, WD_RECT* pRect)
+{
+    textlayout_t* tl = (textlayout_t*) hLayout;
+
+    if(tl->flags & WD_STR_NOCLIP)
+        return FALSE;
+
+    pRect->x0 = x;
+    pRect->y0 = y;
+    pRect->x1 = x + tl->width;
+    pRect->y1 = y + tl->height;
+    return TRUE;
+}
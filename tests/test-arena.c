@@ -0,0 +1,105 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2015-2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Checks that an arena refilled after wd_arena_reset() to the same size
+ * reuses its blocks, i.e. allocates no memory in the steady state. */
+
+#include <stdio.h>
+
+#include "arena.h"
+
+
+#define N_RECORDS       200
+
+/* Record sizes of a display list: Mostly small, sometimes bigger. In total
+ * well over one arena block. */
+static size_t
+record_size(int i)
+{
+    return (i % 10 == 0 ? 300 : 40 + (i % 7) * 8);
+}
+
+static int
+fill(wd_arena_t* arena, void** ptrs)
+{
+    size_t total = 0;
+    int i;
+
+    for(i = 0; i < N_RECORDS; i++) {
+        ptrs[i] = wd_arena_alloc(arena, record_size(i));
+        if(ptrs[i] == NULL) {
+            printf("wd_arena_alloc() failed.\n");
+            return -1;
+        }
+        memset(ptrs[i], i & 0xff, record_size(i));
+        total += record_size(i);
+    }
+
+    return (int) total;
+}
+
+int
+main(int argc, char** argv)
+{
+    static void* first[N_RECORDS];
+    static void* second[N_RECORDS];
+    wd_arena_t arena;
+    UINT n_blocks;
+    int total;
+    int i;
+    int ret = 1;
+
+    wd_arena_init(&arena);
+
+    total = fill(&arena, first);
+    if(total < 0)
+        goto out;
+    n_blocks = arena.n_blocks;
+    if(total <= 4096  ||  n_blocks < 2) {
+        printf("The first cycle (%d bytes) should span more blocks.\n", total);
+        goto out;
+    }
+
+    wd_arena_reset(&arena);
+    if(fill(&arena, second) < 0)
+        goto out;
+
+    if(arena.n_blocks != n_blocks) {
+        printf("The second cycle has allocated %u more blocks.\n",
+               arena.n_blocks - n_blocks);
+        goto out;
+    }
+    for(i = 0; i < N_RECORDS; i++) {
+        if(second[i] != first[i]) {
+            printf("Record %d has not reused its memory.\n", i);
+            goto out;
+        }
+    }
+
+    printf("OK: %d bytes in %u blocks, reused after the reset.\n", total, n_blocks);
+    ret = 0;
+
+out:
+    wd_arena_fini(&arena);
+    return ret;
+}
@@ -0,0 +1,1040 @@
+/*
+ * WinDrawLib
+ * Copyright (c) 2016 Martin Mitas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* wd-replay: Replays a trace recorded with wdStartApiTrace() on offscreen
+ * canvases and reports how much time the calls of each type have taken.
+ *
+ * Usage: wd-replay [--gdiplus] [--repeat N] TRACEFILE
+ *
+ * Note that Direct2D queues most of the drawing and does the real work only
+ * in wdEndPaint() (or when its internal queue gets full), so with that
+ * back-end, the time of the individual drawing calls is mostly the cost of
+ * the queuing and the rest is accounted to wdEndPaint().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apitrace.h"
+
+
+/**********************
+ ***  Handle Table  ***
+ **********************/
+
+/* Maps the handles as seen in the trace to the handles we have created when
+ * replaying it. Removed entries keep their key with a NULL value, as the
+ * traced application may get the same pointer value again later. */
+
+typedef struct replay_entry_tag replay_entry_t;
+struct replay_entry_tag {
+    UINT64 key;
+    void* value;
+    UINT op;        /* Op which has created the value (see replay_object_set()). */
+    UINT refs;      /* Count of the creations not destroyed yet (fonts). */
+};
+
+typedef struct replay_map_tag replay_map_t;
+struct replay_map_tag {
+    replay_entry_t* entries;
+    UINT count;
+    UINT alloc;     /* Always a power of 2. */
+};
+
+static UINT
+replay_map_hash(UINT64 key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (UINT) key;
+}
+
+static replay_entry_t*
+replay_map_slot(replay_map_t* map, UINT64 key)
+{
+    UINT i = replay_map_hash(key) & (map->alloc - 1);
+
+    while(map->entries[i].key != 0  &&  map->entries[i].key != key)
+        i = (i + 1) & (map->alloc - 1);
+    return &map->entries[i];
+}
+
+static void*
+replay_map_get(replay_map_t* map, UINT64 key)
+{
+    if(key == 0  ||  map->alloc == 0)
+        return NULL;
+    return replay_map_slot(map, key)->value;
+}
+
+static void
+replay_map_set(replay_map_t* map, UINT64 key, void* value)
+{
+    replay_entry_t* e;
+
+    if(key == 0)
+        return;
+
+    if(2 * (map->count + 1) > map->alloc) {
+        replay_entry_t* old_entries = map->entries;
+        UINT old_alloc = map->alloc;
+        UINT i;
+
+        map->alloc = (old_alloc > 0 ? 2 * old_alloc : 256);
+        map->entries = (replay_entry_t*) calloc(map->alloc, sizeof(replay_entry_t));
+        if(map->entries == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            exit(1);
+        }
+        for(i = 0; i < old_alloc; i++) {
+            if(old_entries[i].key != 0)
+                *replay_map_slot(map, old_entries[i].key) = old_entries[i];
+        }
+        free(old_entries);
+    }
+
+    e = replay_map_slot(map, key);
+    if(e->key == 0) {
+        e->key = key;
+        map->count++;
+    }
+    e->value = value;
+}
+
+static void
+replay_map_fini(replay_map_t* map)
+{
+    free(map->entries);
+    memset(map, 0, sizeof(replay_map_t));
+}
+
+
+/****************
+ ***  Timing  ***
+ ****************/
+
+typedef struct replay_stat_tag replay_stat_t;
+struct replay_stat_tag {
+    UINT count;
+    LONGLONG ticks;
+};
+
+#define REPLAY_MAX_OP       128
+#define REPLAY_MAX_CMD      32
+
+static replay_stat_t replay_op_stats[REPLAY_MAX_OP];
+static replay_stat_t replay_cmd_stats[REPLAY_MAX_CMD];
+static LARGE_INTEGER replay_freq;
+static LARGE_INTEGER replay_t0;
+
+static const char* replay_op_names[REPLAY_MAX_OP] = {
+    [WD_APITRACE_OP_CREATECANVAS] = "wdCreateCanvas",
+    [WD_APITRACE_OP_DESTROYCANVAS] = "wdDestroyCanvas",
+    [WD_APITRACE_OP_BEGINPAINT] = "wdBeginPaint",
+    [WD_APITRACE_OP_ENDPAINT] = "wdEndPaint",
+    [WD_APITRACE_OP_FLUSHCANVAS] = "wdFlushCanvas",
+    [WD_APITRACE_OP_RESIZECANVAS] = "wdResizeCanvas",
+    [WD_APITRACE_OP_STARTGDI] = "wdStartGdi",
+    [WD_APITRACE_OP_SETCANVASQUALITY] = "wdSetCanvasQualityParam",
+    [WD_APITRACE_OP_CREATESOLIDBRUSH] = "wdCreateSolidBrush",
+    [WD_APITRACE_OP_CREATELINEARBRUSH] = "wdCreateLinearGradientBrush",
+    [WD_APITRACE_OP_CREATERADIALBRUSH] = "wdCreateRadialGradientBrush",
+    [WD_APITRACE_OP_SETSOLIDBRUSHCOLOR] = "wdSetSolidBrushColor",
+    [WD_APITRACE_OP_DESTROYBRUSH] = "wdDestroyBrush",
+    [WD_APITRACE_OP_SETLINEARBRUSHPOINTS] = "wdSetLinearGradientBrushPoints",
+    [WD_APITRACE_OP_SETRADIALBRUSHGEOMETRY] = "wdSetRadialGradientBrushGeometry",
+    [WD_APITRACE_OP_SETBRUSHTRANSFORM] = "wdSetBrushTransform",
+    [WD_APITRACE_OP_CREATEIMAGEBRUSH] = "wdCreateImageBrush",
+    [WD_APITRACE_OP_CREATESTROKESTYLE] = "wdCreateStrokeStyle",
+    [WD_APITRACE_OP_DESTROYSTROKESTYLE] = "wdDestroyStrokeStyle",
+    [WD_APITRACE_OP_CREATEPATH] = "wdCreatePath",
+    [WD_APITRACE_OP_CLONEPATH] = "wdClonePath",
+    [WD_APITRACE_OP_CREATETRANSFORMEDPATH] = "wdCreateTransformedPath",
+    [WD_APITRACE_OP_DESTROYPATH] = "wdDestroyPath",
+    [WD_APITRACE_OP_OPENPATHSINK] = "wdOpenPathSink",
+    [WD_APITRACE_OP_CLOSEPATHSINK] = "wdClosePathSink",
+    [WD_APITRACE_OP_BEGINFIGURE] = "wdBeginFigure",
+    [WD_APITRACE_OP_ENDFIGURE] = "wdEndFigure",
+    [WD_APITRACE_OP_ADDLINE] = "wdAddLine",
+    [WD_APITRACE_OP_ADDARC] = "wdAddArc",
+    [WD_APITRACE_OP_ADDBEZIER] = "wdAddBezier",
+    [WD_APITRACE_OP_ADDLINES] = "wdAddLines",
+    [WD_APITRACE_OP_ADDBEZIERS] = "wdAddBeziers",
+    [WD_APITRACE_OP_CREATEIMAGE] = "wdCreateImage*",
+    [WD_APITRACE_OP_DESTROYIMAGE] = "wdDestroyImage",
+    [WD_APITRACE_OP_CREATECACHEDIMAGE] = "wdCreateCachedImage",
+    [WD_APITRACE_OP_DESTROYCACHEDIMAGE] = "wdDestroyCachedImage",
+    [WD_APITRACE_OP_CREATEMESH] = "wdCreateMeshFromPath",
+    [WD_APITRACE_OP_DESTROYMESH] = "wdDestroyMesh",
+    [WD_APITRACE_OP_CREATEPATHMASK] = "wdCreateCachedPathMask",
+    [WD_APITRACE_OP_DESTROYPATHMASK] = "wdDestroyCachedPathMask",
+    [WD_APITRACE_OP_CREATEFONT] = "wdCreateFont",
+    [WD_APITRACE_OP_DESTROYFONT] = "wdDestroyFont",
+    [WD_APITRACE_OP_CREATETEXTLAYOUT] = "wdCreateTextLayout",
+    [WD_APITRACE_OP_DESTROYTEXTLAYOUT] = "wdDestroyTextLayout",
+    [WD_APITRACE_OP_BEGINRECORDING] = "wdBeginRecording",
+    [WD_APITRACE_OP_ENDRECORDING] = "wdEndRecording",
+    [WD_APITRACE_OP_DESTROYDISPLAYLIST] = "wdDestroyDisplayList",
+};
+
+static const char* replay_cmd_names[REPLAY_MAX_CMD] = {
+    [WD_CMD_CLEAR] = "wdClear",
+    [WD_CMD_SETCLIP] = "wdSetClip",
+    [WD_CMD_ROTATEWORLD] = "wdRotateWorld",
+    [WD_CMD_TRANSLATEWORLD] = "wdTranslateWorld",
+    [WD_CMD_TRANSFORMWORLD] = "wdTransformWorld",
+    [WD_CMD_RESETWORLD] = "wdResetWorld",
+    [WD_CMD_DRAWARC] = "wdDrawArc",
+    [WD_CMD_DRAWELLIPSE] = "wdDrawEllipse",
+    [WD_CMD_DRAWLINE] = "wdDrawLine",
+    [WD_CMD_DRAWPATH] = "wdDrawPath",
+    [WD_CMD_DRAWPIE] = "wdDrawPie",
+    [WD_CMD_DRAWRECT] = "wdDrawRect",
+    [WD_CMD_FILLELLIPSE] = "wdFillEllipse",
+    [WD_CMD_FILLPATH] = "wdFillPath",
+    [WD_CMD_FILLMESH] = "wdFillMesh",
+    [WD_CMD_FILLPATHMASK] = "wdFillCachedPathMask",
+    [WD_CMD_FILLPIE] = "wdFillPie",
+    [WD_CMD_FILLRECT] = "wdFillRect",
+    [WD_CMD_BITBLTIMAGE] = "wdBitBltImage",
+    [WD_CMD_BITBLTCACHED] = "wdBitBltCachedImage",
+    [WD_CMD_BITBLTHICON] = "wdBitBltHICON (skipped)",
+    [WD_CMD_DRAWSTRING] = "wdDrawString",
+    [WD_CMD_REPLAY] = "wdReplayDisplayList",
+    [WD_CMD_FILLINSTANCES] = "wdFillPathInstances",
+    [WD_CMD_DRAWTEXTLAYOUT] = "wdDrawTextLayout",
+    [WD_CMD_DRAWGLYPHRUN] = "wdDrawGlyphRun",
+};
+
+static void
+replay_start_timer(void)
+{
+    QueryPerformanceCounter(&replay_t0);
+}
+
+static void
+replay_stop_timer(replay_stat_t* stat)
+{
+    LARGE_INTEGER t1;
+
+    QueryPerformanceCounter(&t1);
+    stat->count++;
+    stat->ticks += t1.QuadPart - replay_t0.QuadPart;
+}
+
+static void
+replay_print_stats(const char* title, const replay_stat_t* stats,
+                   const char** names, UINT n)
+{
+    UINT i;
+
+    printf("\n%-32s %10s %12s %12s\n", title, "count", "total [ms]", "avg [us]");
+    for(i = 0; i < n; i++) {
+        double ms;
+
+        if(stats[i].count == 0)
+            continue;
+
+        ms = (double) stats[i].ticks * 1000.0 / (double) replay_freq.QuadPart;
+        printf("%-32s %10u %12.3f %12.3f\n", (names[i] != NULL ? names[i] : "?"),
+               stats[i].count, ms, ms * 1000.0 / stats[i].count);
+    }
+}
+
+
+/****************
+ ***  Replay  ***
+ ****************/
+
+/* We paint into a DIB section, so there is no need for any window. */
+typedef struct replay_canvas_tag replay_canvas_t;
+struct replay_canvas_tag {
+    WD_HCANVAS canvas;
+    HDC dc;
+    HBITMAP bmp;
+    HBITMAP orig_bmp;
+};
+
+static replay_map_t replay_canvases;    /* replay_canvas_t* */
+static replay_map_t replay_sinks;       /* WD_PATHSINK* */
+static replay_map_t replay_objects;     /* Everything else. */
+
+static replay_canvas_t*
+replay_create_canvas(UINT width, UINT height, DWORD flags)
+{
+    replay_canvas_t* rc;
+    BITMAPINFO bmi;
+    RECT rect;
+    void* bits;
+
+    rc = (replay_canvas_t*) malloc(sizeof(replay_canvas_t));
+    if(rc == NULL)
+        return NULL;
+
+    memset(&bmi, 0, sizeof(BITMAPINFO));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = WD_MAX(width, 1);
+    bmi.bmiHeader.biHeight = -(LONG) WD_MAX(height, 1);
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    rc->dc = CreateCompatibleDC(NULL);
+    rc->bmp = CreateDIBSection(rc->dc, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+    if(rc->dc == NULL  ||  rc->bmp == NULL) {
+        fprintf(stderr, "Failed to create a %ux%u DIB section.\n", width, height);
+        goto err;
+    }
+    rc->orig_bmp = SelectObject(rc->dc, rc->bmp);
+
+    SetRect(&rect, 0, 0, WD_MAX(width, 1), WD_MAX(height, 1));
+    rc->canvas = wdCreateCanvasWithHDC(rc->dc, &rect, flags);
+    if(rc->canvas == NULL) {
+        fprintf(stderr, "wdCreateCanvasWithHDC() failed.\n");
+        SelectObject(rc->dc, rc->orig_bmp);
+        goto err;
+    }
+
+    return rc;
+
+err:
+    if(rc->bmp != NULL)
+        DeleteObject(rc->bmp);
+    if(rc->dc != NULL)
+        DeleteDC(rc->dc);
+    free(rc);
+    return NULL;
+}
+
+static void
+replay_destroy_canvas(replay_canvas_t* rc)
+{
+    wdDestroyCanvas(rc->canvas);
+    SelectObject(rc->dc, rc->orig_bmp);
+    DeleteObject(rc->bmp);
+    DeleteDC(rc->dc);
+    free(rc);
+}
+
+static WD_HCANVAS
+replay_canvas(UINT64 id)
+{
+    replay_canvas_t* rc = (replay_canvas_t*) replay_map_get(&replay_canvases, id);
+    return (rc != NULL ? rc->canvas : NULL);
+}
+
+/* Remember the object the op has created (or forget the handle if obj is
+ * NULL), so replay_cleanup() knows how to destroy it. */
+static void
+replay_object_set(UINT64 handle, void* obj, UINT op)
+{
+    replay_entry_t* e;
+
+    replay_map_set(&replay_objects, handle, obj);
+    if(handle == 0)
+        return;
+
+    e = replay_map_slot(&replay_objects, handle);
+    if(obj == NULL)
+        e->refs = 0;
+    else if(e->op == op  &&  e->refs > 0)
+        e->refs++;      /* wdCreateFont() has returned the shared font again. */
+    else
+        e->refs = 1;
+    e->op = op;
+}
+
+static void
+replay_object_destroy(UINT op, void* obj)
+{
+    switch(op) {
+        case WD_APITRACE_OP_CREATESOLIDBRUSH:
+        case WD_APITRACE_OP_CREATELINEARBRUSH:
+        case WD_APITRACE_OP_CREATERADIALBRUSH:
+        case WD_APITRACE_OP_CREATEIMAGEBRUSH:       wdDestroyBrush(obj); break;
+        case WD_APITRACE_OP_CREATESTROKESTYLE:      wdDestroyStrokeStyle(obj); break;
+        case WD_APITRACE_OP_CREATEPATH:
+        case WD_APITRACE_OP_CLONEPATH:
+        case WD_APITRACE_OP_CREATETRANSFORMEDPATH:  wdDestroyPath(obj); break;
+        case WD_APITRACE_OP_CREATEIMAGE:            wdDestroyImage(obj); break;
+        case WD_APITRACE_OP_CREATECACHEDIMAGE:      wdDestroyCachedImage(obj); break;
+        case WD_APITRACE_OP_CREATEMESH:             wdDestroyMesh(obj); break;
+        case WD_APITRACE_OP_CREATEPATHMASK:         wdDestroyCachedPathMask(obj); break;
+        case WD_APITRACE_OP_CREATEFONT:             wdDestroyFont(obj); break;
+        case WD_APITRACE_OP_CREATETEXTLAYOUT:       wdDestroyTextLayout(obj); break;
+        case WD_APITRACE_OP_ENDRECORDING:           wdDestroyDisplayList(obj); break;
+    }
+}
+
+static WD_HIMAGE
+replay_create_image(const wd_apitrace_image_t* args, const BYTE* data)
+{
+    const COLORREF* palette = (const COLORREF*) data;
+    const BYTE* buffer = data + args->palette_size * sizeof(COLORREF);
+    WD_HIMAGE img;
+    BYTE* gray;
+    UINT i;
+
+    if(args->format != 0) {
+        return wdCreateImageFromBuffer(args->width, args->height, args->stride,
+                    buffer, args->format, palette, args->palette_size);
+    }
+
+    /* The traced application has loaded the image from somewhere else.
+     * Use a placeholder of the same size. */
+    gray = (BYTE*) malloc(args->width * args->height * 4);
+    if(gray == NULL)
+        return NULL;
+    for(i = 0; i < args->width * args->height; i++)
+        ((UINT32*) gray)[i] = 0xff808080;
+    img = wdCreateImageFromBuffer(args->width, args->height, args->width * 4,
+                gray, WD_PIXELFORMAT_B8G8R8A8_PREMULTIPLIED, NULL, 0);
+    free(gray);
+    return img;
+}
+
+static void
+replay_cmd(WD_HCANVAS canvas, const wd_apitrace_cmd_t* args, const void* data)
+{
+    wd_cmd_t cmd;
+
+    if(args->kind >= REPLAY_MAX_CMD)
+        return;
+
+    /* HICON cannot be serialized. */
+    if(args->kind == WD_CMD_BITBLTHICON) {
+        replay_cmd_stats[args->kind].count++;
+        return;
+    }
+
+    wd_cmd_init(&cmd, args->kind);
+    cmd.flags = args->flags;
+    cmd.dw = args->dw;
+    cmd.len = args->len;
+    cmd.brush = replay_map_get(&replay_objects, args->brush);
+    cmd.style = replay_map_get(&replay_objects, args->style);
+    cmd.obj = replay_map_get(&replay_objects, args->obj);
+    cmd.data = data;
+    memcpy(cmd.a, args->a, sizeof(cmd.a));
+
+    replay_start_timer();
+    wd_cmd_execute(canvas, &cmd);
+    replay_stop_timer(&replay_cmd_stats[args->kind]);
+}
+
+static void
+replay_record(UINT op, const wd_apitrace_ids_t* ids, const BYTE* args)
+{
+    WD_HCANVAS owner = replay_canvas(ids->owner);
+    replay_stat_t* stat = &replay_op_stats[op < REPLAY_MAX_OP ? op : 0];
+    void* obj = replay_map_get(&replay_objects, ids->handle);
+    void* res = NULL;
+    const float* f = (const float*) args;
+    const UINT32* u = (const UINT32*) args;
+
+    /* The drawing calls are timed in replay_cmd(). */
+    if(op == WD_APITRACE_OP_CMD) {
+        WD_HCANVAS canvas = replay_canvas(ids->handle);
+        if(canvas != NULL) {
+            replay_cmd(canvas, (const wd_apitrace_cmd_t*) args,
+                       args + sizeof(wd_apitrace_cmd_t));
+        }
+        return;
+    }
+
+    replay_start_timer();
+
+    switch(op) {
+        case WD_APITRACE_OP_CREATECANVAS:
+            res = replay_create_canvas(u[0], u[1], u[2]);
+            replay_map_set(&replay_canvases, ids->handle, res);
+            break;
+
+        case WD_APITRACE_OP_DESTROYCANVAS:
+        {
+            replay_canvas_t* rc = replay_map_get(&replay_canvases, ids->handle);
+            if(rc != NULL)
+                replay_destroy_canvas(rc);
+            replay_map_set(&replay_canvases, ids->handle, NULL);
+            break;
+        }
+
+        case WD_APITRACE_OP_BEGINPAINT:
+            if(replay_canvas(ids->handle) != NULL)
+                wdBeginPaint(replay_canvas(ids->handle));
+            break;
+
+        case WD_APITRACE_OP_ENDPAINT:
+            if(replay_canvas(ids->handle) != NULL)
+                wdEndPaint(replay_canvas(ids->handle));
+            break;
+
+        case WD_APITRACE_OP_FLUSHCANVAS:
+            if(replay_canvas(ids->handle) != NULL)
+                wdFlushCanvas(replay_canvas(ids->handle));
+            break;
+
+        case WD_APITRACE_OP_RESIZECANVAS:
+            /* Our canvases are bound to a DC of the size given upon their
+             * creation. */
+            break;
+
+        case WD_APITRACE_OP_STARTGDI:
+            if(replay_canvas(ids->handle) != NULL) {
+                HDC dc = wdStartGdi(replay_canvas(ids->handle), TRUE);
+                if(dc != NULL)
+                    wdEndGdi(replay_canvas(ids->handle), dc);
+            }
+            break;
+
+        case WD_APITRACE_OP_SETCANVASQUALITY:
+            if(replay_canvas(ids->handle) != NULL)
+                wdSetCanvasQualityParam(replay_canvas(ids->handle), u[0], u[1]);
+            break;
+
+        case WD_APITRACE_OP_CREATESOLIDBRUSH:
+            res = wdCreateSolidBrush(owner, (WD_COLOR) u[0]);
+            break;
+
+        case WD_APITRACE_OP_CREATELINEARBRUSH:
+        {
+            UINT n = u[4];
+            const WD_COLOR* colors = (const WD_COLOR*) (u + 5);
+            res = wdCreateLinearGradientBrushEx(owner, f[0], f[1], f[2], f[3],
+                        colors, (const float*) (colors + n), n);
+            break;
+        }
+
+        case WD_APITRACE_OP_CREATERADIALBRUSH:
+        {
+            UINT n = u[5];
+            const WD_COLOR* colors = (const WD_COLOR*) (u + 6);
+            res = wdCreateRadialGradientBrushEx(owner, f[0], f[1], f[2], f[3], f[4],
+                        colors, (const float*) (colors + n), n);
+            break;
+        }
+
+        case WD_APITRACE_OP_CREATEIMAGEBRUSH:
+        {
+            const wd_apitrace_imagebrush_t* a = (const wd_apitrace_imagebrush_t*) args;
+            WD_HIMAGE img = replay_map_get(&replay_objects, a->image);
+            if(owner != NULL  &&  img != NULL)
+                res = wdCreateImageBrush(owner, img, a->extend_x, a->extend_y, &a->matrix);
+            break;
+        }
+
+        case WD_APITRACE_OP_SETSOLIDBRUSHCOLOR:
+            if(obj != NULL)
+                wdSetSolidBrushColor((WD_HBRUSH) obj, (WD_COLOR) u[0]);
+            break;
+
+        case WD_APITRACE_OP_SETLINEARBRUSHPOINTS:
+            if(obj != NULL)
+                wdSetLinearGradientBrushPoints((WD_HBRUSH) obj, f[0], f[1], f[2], f[3]);
+            break;
+
+        case WD_APITRACE_OP_SETRADIALBRUSHGEOMETRY:
+            if(obj != NULL)
+                wdSetRadialGradientBrushGeometry((WD_HBRUSH) obj, f[0], f[1], f[2], f[3], f[4]);
+            break;
+
+        case WD_APITRACE_OP_SETBRUSHTRANSFORM:
+            if(obj != NULL)
+                wdSetBrushTransform((WD_HBRUSH) obj, (const WD_MATRIX*) f);
+            break;
+
+        case WD_APITRACE_OP_CREATESTROKESTYLE:
+            if(u[3] > 0)
+                res = wdCreateStrokeStyleCustom((const float*) (u + 4), u[3], u[1], u[2]);
+            else
+                res = wdCreateStrokeStyle(WD_DASHSTYLE_SOLID, u[1], u[2]);
+            break;
+
+        case WD_APITRACE_OP_CREATEPATH:
+            res = wdCreatePath(owner);
+            break;
+
+        case WD_APITRACE_OP_CLONEPATH:
+        case WD_APITRACE_OP_CREATETRANSFORMEDPATH:
+        {
+            WD_HPATH path = replay_map_get(&replay_objects, ids->owner);
+            if(path == NULL)
+                break;
+            if(op == WD_APITRACE_OP_CLONEPATH)
+                res = wdClonePath(path);
+            else
+                res = wdCreateTransformedPath(path, (const WD_MATRIX*) f);
+            break;
+        }
+
+        case WD_APITRACE_OP_OPENPATHSINK:
+        {
+            WD_HPATH path = (WD_HPATH) replay_map_get(&replay_objects, ids->owner);
+            WD_PATHSINK* sink = (WD_PATHSINK*) malloc(sizeof(WD_PATHSINK));
+
+            if(sink != NULL  &&  path != NULL  &&  wdOpenPathSink(sink, path)) {
+                replay_map_set(&replay_sinks, ids->handle, sink);
+            } else {
+                free(sink);
+                replay_map_set(&replay_sinks, ids->handle, NULL);
+            }
+            break;
+        }
+
+        case WD_APITRACE_OP_CLOSEPATHSINK:
+        {
+            WD_PATHSINK* sink = replay_map_get(&replay_sinks, ids->handle);
+            if(sink != NULL) {
+                wdClosePathSink(sink);
+                free(sink);
+            }
+            replay_map_set(&replay_sinks, ids->handle, NULL);
+            break;
+        }
+
+        case WD_APITRACE_OP_BEGINFIGURE:
+        case WD_APITRACE_OP_ENDFIGURE:
+        case WD_APITRACE_OP_ADDLINE:
+        case WD_APITRACE_OP_ADDARC:
+        case WD_APITRACE_OP_ADDBEZIER:
+        case WD_APITRACE_OP_ADDLINES:
+        case WD_APITRACE_OP_ADDBEZIERS:
+        {
+            WD_PATHSINK* sink = replay_map_get(&replay_sinks, ids->handle);
+            if(sink == NULL)
+                break;
+            switch(op) {
+                case WD_APITRACE_OP_BEGINFIGURE:  wdBeginFigure(sink, f[0], f[1]); break;
+                case WD_APITRACE_OP_ENDFIGURE:    wdEndFigure(sink, u[0]); break;
+                case WD_APITRACE_OP_ADDLINE:      wdAddLine(sink, f[0], f[1]); break;
+                case WD_APITRACE_OP_ADDARC:       wdAddArc(sink, f[0], f[1], f[2]); break;
+                case WD_APITRACE_OP_ADDBEZIER:    wdAddBezier(sink, f[0], f[1], f[2], f[3], f[4], f[5]); break;
+                case WD_APITRACE_OP_ADDLINES:     wdAddLines(sink, (const WD_POINT*) (u + 1), u[0]); break;
+                case WD_APITRACE_OP_ADDBEZIERS:   wdAddBeziers(sink, (const WD_POINT*) (u + 1), u[0]); break;
+            }
+            break;
+        }
+
+        case WD_APITRACE_OP_CREATEIMAGE:
+            res = replay_create_image((const wd_apitrace_image_t*) args,
+                        args + sizeof(wd_apitrace_image_t));
+            break;
+
+        case WD_APITRACE_OP_CREATECACHEDIMAGE:
+        {
+            WD_HIMAGE img = replay_map_get(&replay_objects, *(const UINT64*) args);
+            if(owner != NULL  &&  img != NULL)
+                res = wdCreateCachedImage(owner, img);
+            break;
+        }
+
+        case WD_APITRACE_OP_CREATEMESH:
+        {
+            WD_HPATH path = replay_map_get(&replay_objects, *(const UINT64*) args);
+            if(owner != NULL  &&  path != NULL)
+                res = wdCreateMeshFromPath(owner, path);
+            break;
+        }
+
+        case WD_APITRACE_OP_CREATEPATHMASK:
+        {
+            const wd_apitrace_pathmask_t* pm = (const wd_apitrace_pathmask_t*) args;
+            WD_HPATH path = replay_map_get(&replay_objects, pm->path);
+            if(owner != NULL  &&  path != NULL)
+                res = wdCreateCachedPathMask(owner, path, pm->scale, pm->flags);
+            break;
+        }
+
+        case WD_APITRACE_OP_CREATEFONT:
+            res = wdCreateFont((const LOGFONTW*) args);
+            break;
+
+        case WD_APITRACE_OP_CREATETEXTLAYOUT:
+        {
+            const wd_apitrace_textlayout_t* a = (const wd_apitrace_textlayout_t*) args;
+            WD_HFONT font = replay_map_get(&replay_objects, ids->owner);
+            if(font != NULL) {
+                res = wdCreateTextLayout(font, (const WCHAR*) (a + 1), a->len,
+                            a->width, a->height, a->flags);
+            }
+            break;
+        }
+
+        case WD_APITRACE_OP_BEGINRECORDING:
+            if(replay_canvas(ids->handle) != NULL)
+                wdBeginRecording(replay_canvas(ids->handle));
+            break;
+
+        case WD_APITRACE_OP_ENDRECORDING:
+            if(owner != NULL)
+                res = wdEndRecording(owner);
+            break;
+
+        case WD_APITRACE_OP_DESTROYBRUSH:
+        case WD_APITRACE_OP_DESTROYSTROKESTYLE:
+        case WD_APITRACE_OP_DESTROYPATH:
+        case WD_APITRACE_OP_DESTROYIMAGE:
+        case WD_APITRACE_OP_DESTROYCACHEDIMAGE:
+        case WD_APITRACE_OP_DESTROYMESH:
+        case WD_APITRACE_OP_DESTROYPATHMASK:
+        case WD_APITRACE_OP_DESTROYFONT:
+        case WD_APITRACE_OP_DESTROYTEXTLAYOUT:
+        case WD_APITRACE_OP_DESTROYDISPLAYLIST:
+            if(obj == NULL)
+                break;
+            switch(op) {
+                case WD_APITRACE_OP_DESTROYBRUSH:       wdDestroyBrush(obj); break;
+                case WD_APITRACE_OP_DESTROYSTROKESTYLE: wdDestroyStrokeStyle(obj); break;
+                case WD_APITRACE_OP_DESTROYPATH:        wdDestroyPath(obj); break;
+                case WD_APITRACE_OP_DESTROYIMAGE:       wdDestroyImage(obj); break;
+                case WD_APITRACE_OP_DESTROYCACHEDIMAGE: wdDestroyCachedImage(obj); break;
+                case WD_APITRACE_OP_DESTROYMESH:        wdDestroyMesh(obj); break;
+                case WD_APITRACE_OP_DESTROYPATHMASK:    wdDestroyCachedPathMask(obj); break;
+                case WD_APITRACE_OP_DESTROYFONT:        wdDestroyFont(obj); break;
+                case WD_APITRACE_OP_DESTROYTEXTLAYOUT:  wdDestroyTextLayout(obj); break;
+                case WD_APITRACE_OP_DESTROYDISPLAYLIST: wdDestroyDisplayList(obj); break;
+            }
+            /* Fonts are shared and reference-counted (wdCreateFont() returns
+             * the same handle for the same LOGFONTW), so the handle may still
+             * be alive. */
+            if(op == WD_APITRACE_OP_DESTROYFONT) {
+                replay_entry_t* e = replay_map_slot(&replay_objects, ids->handle);
+                if(--e->refs > 0)
+                    break;
+            }
+            replay_object_set(ids->handle, NULL, 0);
+            break;
+
+        default:
+            fprintf(stderr, "Unknown record type %u.\n", op);
+            return;
+    }
+
+    replay_stop_timer(stat);
+
+    switch(op) {
+        case WD_APITRACE_OP_CREATESOLIDBRUSH:
+        case WD_APITRACE_OP_CREATELINEARBRUSH:
+        case WD_APITRACE_OP_CREATERADIALBRUSH:
+        case WD_APITRACE_OP_CREATEIMAGEBRUSH:
+        case WD_APITRACE_OP_CREATESTROKESTYLE:
+        case WD_APITRACE_OP_CREATEPATH:
+        case WD_APITRACE_OP_CLONEPATH:
+        case WD_APITRACE_OP_CREATETRANSFORMEDPATH:
+        case WD_APITRACE_OP_CREATEIMAGE:
+        case WD_APITRACE_OP_CREATECACHEDIMAGE:
+        case WD_APITRACE_OP_CREATEMESH:
+        case WD_APITRACE_OP_CREATEPATHMASK:
+        case WD_APITRACE_OP_CREATEFONT:
+        case WD_APITRACE_OP_CREATETEXTLAYOUT:
+        case WD_APITRACE_OP_ENDRECORDING:
+            replay_object_set(ids->handle, res, op);
+            break;
+    }
+}
+
+/* Check the args (of the given size) of the record are long enough for all
+ * replay_record() reads from them. */
+static BOOL
+replay_check_args(UINT op, const BYTE* args, UINT size)
+{
+    const UINT32* u = (const UINT32*) args;
+    UINT64 need;
+
+    /* The fixed part. */
+    switch(op) {
+        case WD_APITRACE_OP_CMD:                    need = sizeof(wd_apitrace_cmd_t); break;
+        case WD_APITRACE_OP_CREATECANVAS:           need = 3 * sizeof(UINT32); break;
+        case WD_APITRACE_OP_RESIZECANVAS:
+        case WD_APITRACE_OP_SETCANVASQUALITY:       need = 2 * sizeof(UINT32); break;
+        case WD_APITRACE_OP_CREATESOLIDBRUSH:
+        case WD_APITRACE_OP_SETSOLIDBRUSHCOLOR:
+        case WD_APITRACE_OP_ENDFIGURE:
+        case WD_APITRACE_OP_ADDLINES:
+        case WD_APITRACE_OP_ADDBEZIERS:             need = sizeof(UINT32); break;
+        case WD_APITRACE_OP_CREATELINEARBRUSH:      need = 5 * sizeof(UINT32); break;
+        case WD_APITRACE_OP_CREATERADIALBRUSH:      need = 6 * sizeof(UINT32); break;
+        case WD_APITRACE_OP_CREATEIMAGEBRUSH:       need = sizeof(wd_apitrace_imagebrush_t); break;
+        case WD_APITRACE_OP_SETLINEARBRUSHPOINTS:   need = 4 * sizeof(float); break;
+        case WD_APITRACE_OP_SETRADIALBRUSHGEOMETRY: need = 5 * sizeof(float); break;
+        case WD_APITRACE_OP_SETBRUSHTRANSFORM:
+        case WD_APITRACE_OP_CREATETRANSFORMEDPATH:  need = sizeof(WD_MATRIX); break;
+        case WD_APITRACE_OP_CREATESTROKESTYLE:      need = 4 * sizeof(UINT32); break;
+        case WD_APITRACE_OP_BEGINFIGURE:
+        case WD_APITRACE_OP_ADDLINE:                need = 2 * sizeof(float); break;
+        case WD_APITRACE_OP_ADDARC:                 need = 3 * sizeof(float); break;
+        case WD_APITRACE_OP_ADDBEZIER:              need = 6 * sizeof(float); break;
+        case WD_APITRACE_OP_CREATEIMAGE:            need = sizeof(wd_apitrace_image_t); break;
+        case WD_APITRACE_OP_CREATECACHEDIMAGE:
+        case WD_APITRACE_OP_CREATEMESH:             need = sizeof(UINT64); break;
+        case WD_APITRACE_OP_CREATEPATHMASK:         need = sizeof(wd_apitrace_pathmask_t); break;
+        case WD_APITRACE_OP_CREATEFONT:             need = sizeof(LOGFONTW); break;
+        case WD_APITRACE_OP_CREATETEXTLAYOUT:       need = sizeof(wd_apitrace_textlayout_t); break;
+        default:                                    need = 0; break;
+    }
+    if(size < need)
+        return FALSE;
+
+    /* The variable part (its size is given in the fixed part). */
+    switch(op) {
+        case WD_APITRACE_OP_CMD:
+        {
+            const wd_apitrace_cmd_t* a = (const wd_apitrace_cmd_t*) args;
+            wd_cmd_t cmd;
+
+            if(a->len < 0)
+                return FALSE;
+            wd_cmd_init(&cmd, a->kind);
+            cmd.len = a->len;
+            cmd.data = args;
+            need += wd_cmd_data_size(&cmd);
+            break;
+        }
+
+        case WD_APITRACE_OP_CREATELINEARBRUSH:
+            need += (UINT64) u[4] * (sizeof(WD_COLOR) + sizeof(float));
+            break;
+
+        case WD_APITRACE_OP_CREATERADIALBRUSH:
+            need += (UINT64) u[5] * (sizeof(WD_COLOR) + sizeof(float));
+            break;
+
+        case WD_APITRACE_OP_CREATESTROKESTYLE:
+            need += (UINT64) u[3] * sizeof(float);
+            break;
+
+        case WD_APITRACE_OP_ADDLINES:
+            need += (UINT64) u[0] * sizeof(WD_POINT);
+            break;
+
+        case WD_APITRACE_OP_ADDBEZIERS:
+            need += (UINT64) u[0] * 3 * sizeof(WD_POINT);
+            break;
+
+        case WD_APITRACE_OP_CREATEIMAGE:
+        {
+            const wd_apitrace_image_t* a = (const wd_apitrace_image_t*) args;
+
+            if(a->format != 0) {
+                need += (UINT64) a->palette_size * sizeof(COLORREF) +
+                        (UINT64) a->stride * a->height;
+            }
+            break;
+        }
+
+        case WD_APITRACE_OP_CREATETEXTLAYOUT:
+        {
+            const wd_apitrace_textlayout_t* a = (const wd_apitrace_textlayout_t*) args;
+
+            if(a->len < 0)
+                return FALSE;
+            need += (UINT64) a->len * sizeof(WCHAR);
+            break;
+        }
+    }
+
+    return (size >= need);
+}
+
+/* Returns number of the replayed records, or -1 if the trace is malformed. */
+static int
+replay_trace(const BYTE* data, size_t size)
+{
+    size_t off = sizeof(wd_apitrace_header_t);
+    int n = 0;
+
+    while(off + sizeof(wd_apitrace_record_t) <= size) {
+        const wd_apitrace_record_t* rec = (const wd_apitrace_record_t*) (data + off);
+        const BYTE* payload = data + off + sizeof(wd_apitrace_record_t);
+
+        if(rec->size < sizeof(wd_apitrace_ids_t)  ||
+           off + sizeof(wd_apitrace_record_t) + rec->size > size  ||
+           !replay_check_args(rec->op, payload + sizeof(wd_apitrace_ids_t),
+                              rec->size - sizeof(wd_apitrace_ids_t))) {
+            fprintf(stderr, "Malformed record at offset %lu.\n", (unsigned long) off);
+            return -1;
+        }
+
+        replay_record(rec->op, (const wd_apitrace_ids_t*) payload,
+                      payload + sizeof(wd_apitrace_ids_t));
+        n++;
+
+        off += sizeof(wd_apitrace_record_t) + rec->size;
+        off = (off + WD_APITRACE_ALIGN - 1) & ~((size_t) WD_APITRACE_ALIGN - 1);
+    }
+
+    return n;
+}
+
+/* Destroy whatever the traced application has leaked (or what is left over
+ * from an incomplete trace), so that the next repetition starts from the same
+ * state. The objects are destroyed before the ones they may use. */
+static void
+replay_cleanup(void)
+{
+    static const UINT order[] = {
+        WD_APITRACE_OP_ENDRECORDING,
+        WD_APITRACE_OP_CREATETEXTLAYOUT,
+        WD_APITRACE_OP_CREATEPATHMASK,
+        WD_APITRACE_OP_CREATEMESH,
+        WD_APITRACE_OP_CREATECACHEDIMAGE,
+        WD_APITRACE_OP_CREATESOLIDBRUSH,
+        WD_APITRACE_OP_CREATELINEARBRUSH,
+        WD_APITRACE_OP_CREATERADIALBRUSH,
+        WD_APITRACE_OP_CREATEIMAGEBRUSH,
+        WD_APITRACE_OP_CREATESTROKESTYLE,
+        WD_APITRACE_OP_CREATETRANSFORMEDPATH,
+        WD_APITRACE_OP_CLONEPATH,
+        WD_APITRACE_OP_CREATEPATH,
+        WD_APITRACE_OP_CREATEIMAGE,
+        WD_APITRACE_OP_CREATEFONT
+    };
+    UINT i, j;
+
+    for(i = 0; i < replay_sinks.alloc; i++) {
+        if(replay_sinks.entries[i].value != NULL) {
+            wdClosePathSink((WD_PATHSINK*) replay_sinks.entries[i].value);
+            free(replay_sinks.entries[i].value);
+        }
+    }
+    for(j = 0; j < WD_SIZEOF_ARRAY(order); j++) {
+        for(i = 0; i < replay_objects.alloc; i++) {
+            replay_entry_t* e = &replay_objects.entries[i];
+
+            if(e->value == NULL  ||  e->op != order[j])
+                continue;
+            while(e->refs > 0) {
+                replay_object_destroy(e->op, e->value);
+                e->refs--;
+            }
+            e->value = NULL;
+        }
+    }
+    for(i = 0; i < replay_canvases.alloc; i++) {
+        if(replay_canvases.entries[i].value != NULL)
+            replay_destroy_canvas((replay_canvas_t*) replay_canvases.entries[i].value);
+    }
+
+    replay_map_fini(&replay_sinks);
+    replay_map_fini(&replay_canvases);
+    replay_map_fini(&replay_objects);
+}
+
+static BYTE*
+replay_load(const char* path, size_t* p_size)
+{
+    FILE* f;
+    BYTE* data;
+    long size;
+
+    f = fopen(path, "rb");
+    if(f == NULL) {
+        fprintf(stderr, "Cannot open %s.\n", path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = (BYTE*) malloc(size > 0 ? size : 1);
+    if(data == NULL  ||  fread(data, 1, size, f) != (size_t) size) {
+        fprintf(stderr, "Cannot read %s.\n", path);
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+
+    fclose(f);
+    *p_size = size;
+    return data;
+}
+
+int
+main(int argc, char** argv)
+{
+    const wd_apitrace_header_t* header;
+    const char* path = NULL;
+    BOOL use_gdiplus = FALSE;
+    int repeat = 1;
+    BYTE* data;
+    size_t size;
+    int i, n = 0;
+
+    for(i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--gdiplus") == 0)
+            use_gdiplus = TRUE;
+        else if(strcmp(argv[i], "--repeat") == 0  &&  i + 1 < argc)
+            repeat = WD_MAX(atoi(argv[++i]), 1);
+        else
+            path = argv[i];
+    }
+
+    if(path == NULL) {
+        fprintf(stderr, "Usage: %s [--gdiplus] [--repeat N] TRACEFILE\n", argv[0]);
+        return 2;
+    }
+
+    data = replay_load(path, &size);
+    if(data == NULL)
+        return 1;
+
+    header = (const wd_apitrace_header_t*) data;
+    if(size < sizeof(wd_apitrace_header_t)  ||
+       memcmp(header->magic, WD_APITRACE_MAGIC, sizeof(WD_APITRACE_MAGIC)) != 0  ||
+       header->version != WD_APITRACE_VERSION) {
+        fprintf(stderr, "%s is not a supported trace file.\n", path);
+        free(data);
+        return 1;
+    }
+
+    if(use_gdiplus)
+        wdPreInitialize(NULL, NULL, WD_DISABLE_D2D);
+    if(!wdInitialize(WD_INIT_IMAGEAPI | WD_INIT_STRINGAPI)) {
+        fprintf(stderr, "wdInitialize() failed.\n");
+        free(data);
+        return 1;
+    }
+
+    QueryPerformanceFrequency(&replay_freq);
+
+    for(i = 0; i < repeat; i++) {
+        n = replay_trace(data, size);
+        replay_cleanup();
+        if(n < 0)
+            break;
+    }
+
+    printf("Trace: %s (recorded with %s back-end)\n", path,
+           (header->backend == WD_BACKEND_D2D ? "D2D" : "GDI+"));
+    printf("Replayed: %d records x %d with %s back-end\n", n, repeat,
+           (wdBackend() == WD_BACKEND_D2D ? "D2D" : "GDI+"));
+    replay_print_stats("Call", replay_op_stats, replay_op_names, REPLAY_MAX_OP);
+    replay_print_stats("Drawing call", replay_cmd_stats, replay_cmd_names, REPLAY_MAX_CMD);
+
+    wdTerminate(WD_INIT_IMAGEAPI | WD_INIT_STRINGAPI);
+    free(data);
+    return (n < 0 ? 1 : 0);
+}